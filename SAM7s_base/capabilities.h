@@ -30,6 +30,34 @@
 
 //logging
 #define LOG_BUFFER_SIZE			1024
+//in RAM sample history in bytes, must be a power of 2.  0 turns it
+//off: what MK1 could spare would hold a few seconds, and it comes out
+//of the heap
+#define SAMPLE_HISTORY_SIZE		0
+//most channels a telemetry subscription may select
+#define MAX_SUBSCRIPTION_CHANNELS	32
+
+//predictive timing
+//reference points kept per lap, 16 bytes each, one lap more than
+//there are reference laps is kept
+#define PREDICTIVE_TIMER_SAMPLES	96
+//reference laps predicted against, 1 - 3: the best lap, then the
+//session best and a target lap
+#define PREDICTIVE_TIMER_REFS		1
+
+//track detection
+//start and sector points in the track index, 6 bytes each
+#define TRACK_INDEX_POINTS		160
+
+//track DB
+//flash page the track DB is updated in, staged in RAM while it is
+//written
+#define TRACKS_FLASH_PAGE_SIZE		256
+
+//track map
+//points in the learned outline of the track, 24 bytes each as it is
+//kept and saved
+#define TRACK_MAP_POINTS		32
 
 //system info
 #define DEVICE_NAME    "RCP"
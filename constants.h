@@ -28,6 +28,8 @@
 
 #define SYSTEM_APIS {LOGGER_API, NULL_API }
 
+#define SYSTEM_STREAM_APIS {LOGGER_STREAM_API, NULL_STREAM_API }
+
 #define WATCHDOG_TIMEOUT_MS 2000
 
 
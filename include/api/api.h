@@ -22,6 +22,9 @@
 #include "jsmn.h"
 #include "serial.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #define API_SUCCESS_NO_RETURN 	2
 #define API_SUCCESS 			1
 
@@ -44,8 +47,43 @@ typedef struct _api_t {
 
 #define NULL_API {NULL, NULL}
 
+/*
+ * Handler for messages that may be too big to hold in memory.  The
+ * payload is walked one member at a time; members that are arrays are
+ * walked one element at a time.  Each value is handed over as a small
+ * jsmn token tree that is only valid for the duration of the call.
+ */
+typedef struct _api_stream_t {
+    const char *cmd;
+    /* Called once the message name is known */
+    void (*begin)(Serial *serial);
+    /*
+     * Called for each payload member, or each element of a member that is
+     * an array.  index is the element index, or -1 for a plain member.
+     * more is set when json is a piece of a long string and more of it
+     * follows.  Anything but API_SUCCESS stops the walk.
+     */
+    int (*value)(Serial *serial, const char *member, int index,
+                 const jsmntok_t *json, bool more);
+    /*
+     * Called at the end of the message with the result so far, which is
+     * an error if the walk was stopped or the message was broken.
+     * Returns the final result.
+     */
+    int (*end)(Serial *serial, int result);
+} api_stream_t;
+
+#define NULL_STREAM_API {NULL, NULL, NULL, NULL}
+
 void initApi();
 
+/**
+ * Finds the handler for an API message.
+ * @param name The name of the message
+ * @return The api_t entry for the message, or NULL if it is unknown.
+ */
+const api_t* find_api(const char *name);
+
 void json_valueStart(Serial *serial, const char *name);
 void json_null(Serial *serial, const char *name, int more);
 void json_int(Serial *serial, const char *name, int value, int more);
@@ -53,6 +91,7 @@ void json_uint(Serial *serial, const char *name, unsigned int value, int more);
 void json_escapedString(Serial *serial, const char *name, const char *value, int more);
 void json_string(Serial *serial, const char *name, const char *value, int more);
 void json_float(Serial *serial, const char *name, float value, int precision, int more);
+void json_double(Serial *serial, const char *name, double value, int precision, int more);
 void json_objStartString(Serial *serial, const char * label);
 void json_objStartInt(Serial *serial, int label);
 void json_objStart(Serial *serial);
@@ -61,9 +100,43 @@ void json_arrayStart(Serial *serial, const char * name);
 void json_arrayElementString(Serial *serial, const char *value, int more);
 void json_arrayElementInt(Serial *serial, int value, int more);
 void json_arrayElementFloat(Serial *serial, float value, int precision, int more);
+void json_arrayElementDouble(Serial *serial, double value, int precision, int more);
 void json_arrayEnd(Serial *serial, int more);
 void json_sendResult(Serial *serial, const char *messageName, int resultCode);
 
 int process_api(Serial *serial, char * buffer, size_t bufferSize);
 
+/**
+ * Starts processing a message that did not fit the line buffer.  The
+ * message is then fed in pieces with api_stream_feed and finished off with
+ * api_stream_end.  Only messages with a streaming handler can be handled
+ * this way.
+ */
+void api_stream_begin(Serial *serial);
+
+/**
+ * Feeds the next piece of a streamed message.
+ * @return true if the message is complete or broken and nothing more
+ * needs to be fed, false if more is expected.
+ */
+bool api_stream_feed(const char *data, size_t len);
+
+/**
+ * Finishes a streamed message and sends the reply.
+ * @return The result of the message, as with process_api.
+ */
+int api_stream_end(void);
+
+/**
+ * Runs an already parsed payload through the streaming handler for a
+ * message, so that messages small enough to be parsed whole may use the
+ * same forms as streamed ones.
+ * @param serial The port the message came from.
+ * @param name The name of the message.
+ * @param payload The payload of the message.
+ * @return The result of the handler.
+ */
+int api_stream_payload(Serial *serial, const char *name,
+                       const jsmntok_t *payload);
+
 #endif /* API_H_ */
@@ -29,6 +29,12 @@
  */
 #define MAX_DIST_FROM_SF 1000
 
+/**
+ * Tracks whose nearest points are closer together than this, like layouts
+ * sharing a start finish line, are picked between by their sector points.
+ */
+#define TRACK_AMBIGUOUS_DIST 50
+
 /**
  * Automatically picks the best track (if available) and updates the config to use this
  * track.
@@ -1,5 +1,6 @@
 #ifndef CELLMODEM_H_
 #define CELLMODEM_H_
+#include <stddef.h>
 #include <stdint.h>
 #include "serial.h"
 
@@ -9,6 +10,23 @@ typedef enum {
     CELLMODEM_STATUS_NO_NETWORK
 } cellmodem_status_t;
 
+typedef enum {
+    CELL_STEP_PENDING = 0,
+    CELL_STEP_CONNECTED,
+    CELL_STEP_FAILED
+} cell_step_t;
+
+/* Where the last bring-up gave up */
+typedef enum {
+    CELL_FAIL_NONE = 0,
+    /* No network registration or GPRS attach, even after power cycling */
+    CELL_FAIL_REGISTRATION,
+    /* APN or IP setup was refused */
+    CELL_FAIL_NET_CONFIG,
+    /* The server could not be reached */
+    CELL_FAIL_CONNECT
+} cell_fail_t;
+
 cellmodem_status_t cellmodem_get_status( void );
 
 int cell_get_signal_strength();
@@ -16,12 +34,56 @@ char * cell_get_subscriber_number();
 char * cell_get_IMEI();
 void setCellBuffer(char *buffer, size_t len);
 int loadDefaultCellConfig(Serial *serial);
-int initCellModem(Serial *serial);
-int configureNet(Serial *serial, const char *apnHost, const char *apnUser, const char *apnPass);
-int connectNet(Serial *serial, const char *host, const char *port, int udpMode);
+
+/**
+ * Starts bringing the modem up: hang up, reset, wait for the network,
+ * set up GPRS and connect to the server.  Nothing is sent until
+ * cell_modem_step is called.  The strings must stay around until the
+ * bring-up is done.
+ */
+void cell_modem_start(const char *apnHost, const char *apnUser, const char *apnPass,
+                      const char *host, const char *port, int udpMode);
+
+/**
+ * Advances the bring-up as far as it can go without waiting.  Call it
+ * regularly, every few ticks, until it stops returning CELL_STEP_PENDING.
+ * @return CELL_STEP_CONNECTED once the server connection is up,
+ * CELL_STEP_FAILED if the bring-up gave up (see cell_modem_failure) or was
+ * never started.
+ */
+cell_step_t cell_modem_step(Serial *serial);
+
+/**
+ * Abandons any bring-up in progress.
+ */
+void cell_modem_stop(void);
+
+/**
+ * @return Where the last bring-up gave up.
+ */
+cell_fail_t cell_modem_failure(void);
+
+/**
+ * Reads what the modem has sent without waiting.
+ * @return The next complete non-empty line, or NULL if there is none yet.
+ * The line lives in the cell buffer.
+ */
+const char * cell_read_line(Serial *serial);
+
+/**
+ * Starts a datagram on a UDP connection.  Write the data and then call
+ * cell_end_datagram.  Everything in between goes out as one datagram.
+ * @return 0 if the modem is ready for the data, -1 if it did not ask for it.
+ */
+int cell_begin_datagram(Serial *serial);
+
+/**
+ * Sends the datagram started with cell_begin_datagram.
+ */
+void cell_end_datagram(Serial *serial);
+
 int closeNet(Serial *serial);
 int isNetConnectionErrorOrClosed();
-const char * readsCell(Serial *serial, size_t timeout);
 void putsCell(Serial *serial, const char *data);
 void putQuotedStringCell(Serial *serial, char *s);
 void putUintCell(Serial *serial, uint32_t num);
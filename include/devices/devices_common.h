@@ -10,15 +10,21 @@
 
 #include "serial.h"
 
+#include <stdbool.h>
+
 typedef struct _DeviceConfig {
     Serial *serial;
     char * buffer;
     size_t length;
+    /* Set by init_connection if telemetry goes out as datagrams */
+    bool datagram;
 } DeviceConfig;
 
 
 #define DEVICE_INIT_SUCCESS 			0
 #define DEVICE_INIT_FAIL				1
+/* Still coming up.  Call init again in a little while */
+#define DEVICE_INIT_PENDING				2
 
 #define DEVICE_STATUS_NO_ERROR 			0
 #define DEVICE_STATUS_DISCONNECTED		1
@@ -27,5 +27,7 @@ int32_t sim900_active_time();
 int sim900_disconnect(DeviceConfig *config);
 int sim900_init_connection(DeviceConfig *config);
 int sim900_check_connection_status(DeviceConfig *config);
+int sim900_begin_datagram(DeviceConfig *config);
+void sim900_end_datagram(DeviceConfig *config);
 
 #endif /* SIM900_H_ */
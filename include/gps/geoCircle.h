@@ -28,6 +28,8 @@
 struct GeoCircle {
     GeoPoint point;
     float radius;
+    /* A frame around the point, so that no trig is needed per check */
+    struct gp_projection proj;
 };
 
 /**
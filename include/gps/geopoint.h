@@ -22,27 +22,136 @@
 #define GEOPOINT_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Coordinates are fixed point, in units of 1e-7 degrees.  That is about a
+ * centimeter, where a float in degrees only manages about a meter at
+ * typical latitudes, and it is what the binary GPS protocols report.
+ * Differences between points are exact, so distances worked out from them
+ * hold up without double precision math.
+ */
+#define GEO_POINT_SCALE		10000000
+
+/* The fixed point value of a constant number of degrees, for initializers */
+#define GP_DEGREES(d)	((int32_t) ((d) * GEO_POINT_SCALE + ((d) < 0 ? -0.5 : 0.5)))
 
 typedef struct _GeoPoint {
-    float latitude;
-    float longitude;
+    int32_t latitude;
+    int32_t longitude;
 } GeoPoint;
 
 // Make into Enum?
 #define GP_EARTH_RADIUS_KM	6371
 #define GP_EARTH_RADIUS_M	6371000
 
+/* Meters along a meridian per fixed point unit: 2 pi R / 360 / 1e7 */
+#define GP_METERS_PER_UNIT	0.0111194927f
+
+/*
+ * A flat frame around an origin for the distance math done on every fix.
+ * The cosine of the latitude is worked out once, when the frame is set
+ * up, and not for every distance.  Within a few kilometers north or south
+ * of the origin it is as good as #distPythag.
+ */
+struct gp_projection {
+        GeoPoint origin;
+        /* Meters per fixed point unit of longitude at the origin */
+        float lon_scale;
+};
+
 /**
  * Finds the distance between the two geopoints using the
- * basic Pythagoras' Theorem.  This is only useful for small distances as
- * the inaccuracies will increase as the distance does.  However this is
- * also one of the fastest methods of calculating this distance.
+ * basic Pythagoras' Theorem in a flat projection around the two points.
+ * This is only useful for small distances as the inaccuracies will
+ * increase as the distance does.  However this is also one of the fastest
+ * methods of calculating this distance.
  * @param a Point a
  * @param b Point b
  * @return The distance between the two points in Meters
  */
 float distPythag(const GeoPoint *a, const GeoPoint *b);
 
+/**
+ * @return The difference in longitude from a to b, the short way round,
+ * in fixed point units.  Right across the antimeridian too.
+ */
+int64_t gp_lon_diff(const GeoPoint *a, const GeoPoint *b);
+
+/**
+ * Sets up a flat frame around the given origin.
+ */
+void gp_projection_init(struct gp_projection *proj, const GeoPoint *origin);
+
+/**
+ * Moves the frame to the given point if it has gone so far north or south
+ * of the origin that the frame would no longer be accurate there.
+ * @return true if the frame was moved.
+ */
+bool gp_projection_follow(struct gp_projection *proj, const GeoPoint *point);
+
+/**
+ * Where a point is in the frame.
+ * @param x Meters east of the origin.
+ * @param y Meters north of the origin.
+ */
+void gp_project(const struct gp_projection *proj, const GeoPoint *point,
+                float *x, float *y);
+
+/**
+ * The distance between two points near the origin of the frame, squared.
+ * Compare it against a squared radius to save the square root.
+ * @return The distance in meters, squared.
+ */
+float gp_dist_sq(const struct gp_projection *proj, const GeoPoint *a,
+                 const GeoPoint *b);
+
+/**
+ * @return The distance between two points near the origin of the frame,
+ * in meters.
+ */
+float gp_dist(const struct gp_projection *proj, const GeoPoint *a,
+              const GeoPoint *b);
+
+/**
+ * How far along the line from s to e the point m is level with, measured
+ * in a frame.
+ * @return 0 at s, 1 at e.  Below 0 or above 1 if m is before s or past e.
+ */
+float gp_fraction_along(const struct gp_projection *proj, const GeoPoint *s,
+                        const GeoPoint *e, const GeoPoint *m);
+
+/**
+ * @return The fixed point value of the given degrees, rounded.
+ */
+int32_t gp_from_degrees(double degrees);
+
+/**
+ * @return The given fixed point value in degrees.
+ */
+double gp_to_degrees(int32_t value);
+
+/**
+ * @return A GeoPoint from a latitude and longitude in degrees.
+ */
+GeoPoint gp_create(double latitude, double longitude);
+
+/**
+ * Parses decimal degrees, like "-47.8069345", straight into fixed point
+ * so that no precision is lost on the way.
+ * @return The fixed point value.  0 if there is no number.
+ */
+int32_t gp_parse_degrees(const char *str);
+
+/**
+ * Parses an NMEA coordinate, degrees followed by decimal minutes like
+ * "2503.6319" or "12136.0099", into fixed point.
+ * @param str The coordinate, without the hemisphere.
+ * @param degree_digits 2 for a latitude, 3 for a longitude.
+ * @return The fixed point value.  0 if there is no number.
+ */
+int32_t gp_parse_nmea(const char *str, int degree_digits);
+
 /**
  * @return true if the given point is valid, false otherwise.
  */
@@ -42,14 +42,33 @@ typedef struct _GpsSample {
     uint8_t satellites;
     uint8_t fixMode;
     float DOP;
+    /*
+     * Uptime when the first byte of this fix came in from the receiver.
+     * 0 if the driver does not know.
+     */
+    tiny_millis_t uptime;
 } GpsSample;
 
 typedef struct _GpsSnapshot {
     GpsSample sample;
     tiny_millis_t deltaFirstFix;
     GeoPoint previousPoint;
+    tiny_millis_t previousDeltaFirstFix;
+    float previousSpeed;
 } GpsSnapshot;
 
+/*
+ * How long fixes take from their first byte coming in to being processed:
+ * the rest of the transfer plus the parse.
+ */
+typedef struct _GpsLatencyStats {
+    tiny_millis_t last;
+    tiny_millis_t min;
+    tiny_millis_t max;
+    uint32_t total;
+    uint32_t count;
+} GpsLatencyStats;
+
 typedef enum {
     GPS_STATUS_NOT_INIT = 0,
     GPS_STATUS_PROVISIONED,
@@ -68,9 +87,15 @@ float getTimeDiff(float from, float to);
 
 float getTimeSince(float t1);
 
-float GPS_getLatitude();
+/**
+ * @return The latitude in degrees.
+ */
+double GPS_getLatitude();
 
-float GPS_getLongitude();
+/**
+ * @return The longitude in degrees.
+ */
+double GPS_getLongitude();
 
 float getAltitude();
 
@@ -132,9 +157,21 @@ tiny_millis_t getMillisSinceFirstFix();
 
 /**
  * @return The uptime when our most recent GPS sample was taken.  0 indicates no sample.
+ * This is when its first byte came in if the driver tells us, so the time
+ * spent on the transfer and the parse is not counted against the fix.
  */
 tiny_millis_t getUptimeAtSample();
 
+/**
+ * @return The latency of the fixes since GPS_init.
+ */
+GpsLatencyStats GPS_getLatencyStats();
+
+/**
+ * @return The average latency of the fixes in ms.  0 if there were none.
+ */
+int GPS_getAverageLatency();
+
 float getGpsSpeedInMph();
 
 int GPS_processUpdate(Serial *serial);
@@ -0,0 +1,88 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPS_FUSION_H_
+#define _GPS_FUSION_H_
+
+#include "dateTime.h"
+#include "gps.h"
+
+#include <stdbool.h>
+
+/*
+ * Fills in position, speed and heading between GPS fixes so that channels
+ * sampled faster than the GPS do not step.  At each fix the state is set
+ * to what the GPS says.  Between fixes it is carried forward with the
+ * longitudinal acceleration and yaw rate.
+ *
+ * Those rates come from the IMU through a linear model per axis that is
+ * fitted at every fix against the rates the GPS itself shows.  That takes
+ * care of the IMU's zero offset, scale and mounting, and with no IMU at
+ * all the model falls back to the rates of the last fixes.
+ *
+ * Fixes may be added from any task.  Everything else belongs to the one
+ * task that calls gps_fusion_update.
+ */
+
+/* How long past a fix we are willing to extrapolate */
+#define GPS_FUSION_MAX_EXTRAPOLATION_MS	1000
+
+/**
+ * Forgets all state, the learned IMU models included.
+ */
+void gps_fusion_init(void);
+
+/**
+ * Hands a new fix to the filter.  It is picked up by the next update.
+ * @param s The fix.
+ * @param uptime The uptime in ms when the fix arrived.
+ */
+void gps_fusion_add_fix(const GpsSample *s, tiny_millis_t uptime);
+
+/**
+ * Takes in any new fix and moves the state forward to the given time.
+ * Calling it again for the same time does nothing.
+ * @param accel_g The longitudinal acceleration from the IMU in G.
+ * @param yaw_dps The yaw rate from the IMU in degrees per second.
+ * @param uptime The current uptime in ms.
+ */
+void gps_fusion_update(float accel_g, float yaw_dps, tiny_millis_t uptime);
+
+/**
+ * @return true once there is a fix to work from.
+ */
+bool gps_fusion_valid(void);
+
+double gps_fusion_get_latitude(void);
+
+double gps_fusion_get_longitude(void);
+
+/**
+ * @return The speed in KPH.
+ */
+float gps_fusion_get_speed(void);
+
+/**
+ * @return The heading in degrees clockwise from north, 0 to 360.
+ */
+float gps_fusion_get_heading(void);
+
+#endif /* _GPS_FUSION_H_ */
@@ -0,0 +1,126 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NMEA_H_
+#define _NMEA_H_
+
+#include "gps.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming NMEA 0183 tokenizer.  Bytes are fed in as they come off the
+ * UART.  Each byte is looked at once: it goes into the running checksum
+ * and, if it is a separator, ends a field.  Fields stay where they are in
+ * the sentence buffer, terminated in place, so decoders get at any field
+ * by index without scanning or copying.  A sentence is handed over as
+ * soon as its checksum is in; the line end is not waited for.
+ */
+
+/* The standard allows 82 characters including the '$' and the line end */
+#define NMEA_MAX_SENTENCE	96
+#define NMEA_MAX_FIELDS		24
+
+enum nmea_sentence {
+        NMEA_UNKNOWN = 0,
+        NMEA_GGA,
+        NMEA_GLL,
+        NMEA_GSA,
+        NMEA_GSV,
+        NMEA_RMC,
+        NMEA_VTG,
+        NMEA_ZDA,
+};
+
+enum nmea_result {
+        /* More bytes are needed */
+        NMEA_PENDING = 0,
+        /* A sentence with a good checksum is ready */
+        NMEA_READY,
+        /* The sentence was dropped.  See the stats for why */
+        NMEA_ERROR,
+};
+
+struct nmea_stats {
+        uint32_t sentences;
+        uint32_t checksum_errors;
+        /* Too long, too many fields or cut short */
+        uint32_t framing_errors;
+};
+
+struct nmea_parser {
+        char buffer[NMEA_MAX_SENTENCE];
+        uint8_t len;
+        /* Offsets of the fields in the buffer.  Field 0 is the address */
+        uint8_t fields[NMEA_MAX_FIELDS];
+        uint8_t field_count;
+        uint8_t state;
+        uint8_t checksum;
+        uint8_t rx_checksum;
+        enum nmea_sentence sentence;
+        /* The last RMC date and its midnight, in ms since the epoch */
+        int32_t date_key;
+        millis_t midnight;
+        struct nmea_stats stats;
+};
+
+/**
+ * Resets the parser, stats included.
+ */
+void nmea_init(struct nmea_parser *p);
+
+/**
+ * Feeds one byte to the parser.  Anything outside of a sentence is
+ * ignored.  A '$' always starts a new sentence.
+ * @return NMEA_READY when the byte completed a valid sentence.
+ */
+enum nmea_result nmea_feed(struct nmea_parser *p, char c);
+
+/**
+ * @return The type of the sentence that is ready.  The talker (GP, GN,
+ * GL...) is not looked at.
+ */
+enum nmea_sentence nmea_sentence(const struct nmea_parser *p);
+
+/**
+ * @return The number of fields in the sentence that is ready, the address
+ * field included.
+ */
+size_t nmea_field_count(const struct nmea_parser *p);
+
+/**
+ * @return Field i of the sentence that is ready.  Field 0 is the address,
+ * like "GPRMC".  An empty string if there is no such field.
+ */
+const char* nmea_field(const struct nmea_parser *p, size_t i);
+
+/**
+ * Decodes the sentence that is ready into a sample.  GGA fills in the fix
+ * quality, satellites, DOP and altitude.  RMC fills in the position,
+ * speed and time.  Other sentences leave the sample alone.  The parser
+ * remembers the last date, which is why it is not const.
+ * @return The type of the sentence.
+ */
+enum nmea_sentence nmea_decode(struct nmea_parser *p, GpsSample *sample);
+
+#endif /* _NMEA_H_ */
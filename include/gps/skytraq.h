@@ -0,0 +1,124 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SKYTRAQ_H_
+#define _SKYTRAQ_H_
+
+#include "gps.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming decoder for the Skytraq binary protocol.  Bytes are fed in as
+ * they come off the UART.  A message is framed as 0xA0 0xA1, a big endian
+ * payload length, the payload, an XOR checksum of the payload and CR LF.
+ * The first payload byte is the message ID.  A message is handed over as
+ * soon as its checksum is in; the line end is not waited for.
+ */
+
+#define SKYTRAQ_MAX_PAYLOAD		256
+
+/* Every frame starts with these two bytes */
+#define SKYTRAQ_SYNC_1			0xA0
+#define SKYTRAQ_SYNC_2			0xA1
+
+#define SKYTRAQ_MSG_ACK			0x83
+#define SKYTRAQ_MSG_NACK		0x84
+#define SKYTRAQ_MSG_NAVIGATION_DATA	0xA8
+
+enum skytraq_result {
+        /* More bytes are needed */
+        SKYTRAQ_PENDING = 0,
+        /* A message with a good checksum is ready */
+        SKYTRAQ_READY,
+        /* The message was dropped.  See the stats for why */
+        SKYTRAQ_ERROR,
+};
+
+struct skytraq_stats {
+        uint32_t messages;
+        uint32_t checksum_errors;
+        /* Bad length */
+        uint32_t framing_errors;
+};
+
+struct skytraq_parser {
+        uint8_t payload[SKYTRAQ_MAX_PAYLOAD];
+        uint16_t len;
+        uint16_t pos;
+        uint8_t state;
+        uint8_t checksum;
+        struct skytraq_stats stats;
+};
+
+/**
+ * Resets the parser, stats included.
+ */
+void skytraq_init(struct skytraq_parser *p);
+
+/**
+ * Feeds one byte to the parser.  Anything outside of a message, NMEA
+ * included, is ignored.
+ * @return SKYTRAQ_READY when the byte completed a valid message.
+ */
+enum skytraq_result skytraq_feed(struct skytraq_parser *p, uint8_t c);
+
+/**
+ * @return The ID of the message that is ready.
+ */
+uint8_t skytraq_message_id(const struct skytraq_parser *p);
+
+/**
+ * @return The length of the payload of the message that is ready, its ID
+ * included.
+ */
+size_t skytraq_payload_len(const struct skytraq_parser *p);
+
+/**
+ * @return The payload of the message that is ready.  Byte 0 is the ID.
+ */
+const uint8_t* skytraq_payload(const struct skytraq_parser *p);
+
+/**
+ * Decodes the message that is ready into a sample if it is a navigation
+ * data message.  Position, speed, altitude, DOP, satellites, fix quality
+ * and time are filled in.  The receiver reports GPS time; it is turned
+ * into UTC.
+ * @return true if the sample was filled in, false if the message is not
+ * navigation data.
+ */
+bool skytraq_decode_navigation(const struct skytraq_parser *p,
+                               GpsSample *sample);
+
+/**
+ * Frames a payload as a message.
+ * @param buf Where the message goes.
+ * @param size The size of buf.
+ * @param payload The payload, ID first.
+ * @param len The length of the payload.
+ * @return The length of the message, or 0 if it does not fit.
+ */
+size_t skytraq_frame(uint8_t *buf, size_t size, const uint8_t *payload,
+                     size_t len);
+
+#endif /* _SKYTRAQ_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSMN_STREAM_H_
+#define _JSMN_STREAM_H_
+
+#include "jsmn.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Incremental JSON parser.  Where jsmn needs the whole message in memory
+ * this one is fed bytes as they arrive and reports what it finds through
+ * a callback, so the memory it needs does not depend on the size of the
+ * message.  Only keys and scalar values are buffered.  A consumer that
+ * wants a small object or array in one piece (say one element of a big
+ * array) can ask for the container to be captured whole and then run it
+ * through jsmn as usual.
+ */
+
+/* Deepest nesting of objects and arrays we will follow */
+#define JSMN_STREAM_MAX_DEPTH	8
+
+/*
+ * Size of the key / value / capture buffer.  It must hold the largest
+ * config section that getAllCfg sends whole.  lapCfg, at about 1100
+ * bytes, is sent one channel at a time.
+ */
+#ifndef JSMN_STREAM_BUFFER_SIZE
+#define JSMN_STREAM_BUFFER_SIZE	768
+#endif
+
+typedef enum {
+        JSMN_STREAM_OBJECT_START,
+        JSMN_STREAM_OBJECT_END,
+        JSMN_STREAM_ARRAY_START,
+        JSMN_STREAM_ARRAY_END,
+        /* An object key.  Data is the raw key text, without the quotes */
+        JSMN_STREAM_KEY,
+        /* A complete value, or the last piece of a long string */
+        JSMN_STREAM_VALUE,
+        /* A piece of a string value too long for the buffer.  More follow */
+        JSMN_STREAM_VALUE_PART,
+} jsmn_stream_event_t;
+
+struct jsmn_stream_parser;
+
+/**
+ * Receives parser events.  For VALUE events data is the raw text of a
+ * primitive, the raw (still escaped) contents of a string or the full text
+ * of a captured container.  Data is always NUL terminated and may be
+ * modified in place.  Escape sequences are never split between the pieces
+ * of a long string.
+ * @param p The parser.  p->depth is the number of open containers, which
+ * includes the new one on START events.
+ * @param event What was found.
+ * @param type The JSON type of what was found.
+ * @param data The text for KEY and VALUE events, NULL otherwise.
+ * @param len The length of data.
+ * @param ctx The context given to jsmn_stream_init.
+ * @return For START events true to capture the container whole and have it
+ * delivered as a single VALUE event, false to stream its contents.
+ * Ignored for all other events.
+ */
+typedef bool jsmn_stream_callback_t(struct jsmn_stream_parser *p,
+                                    jsmn_stream_event_t event,
+                                    jsmntype_t type, char *data,
+                                    size_t len, void *ctx);
+
+struct jsmn_stream_parser {
+        jsmn_stream_callback_t *callback;
+        void *ctx;
+        int state;
+        bool key_next;
+        bool escape;
+        /* Open containers */
+        uint8_t depth;
+        uint8_t stack[JSMN_STREAM_MAX_DEPTH];
+        /* Nesting within the container being captured */
+        uint8_t capture_depth;
+        jsmntype_t capture_type;
+        size_t len;
+        char buf[JSMN_STREAM_BUFFER_SIZE + 1];
+};
+
+/**
+ * Readies the parser for a new document.
+ * @param p The parser.
+ * @param callback Receives the parser events.
+ * @param ctx Passed through to the callback.
+ */
+void jsmn_stream_init(struct jsmn_stream_parser *p,
+                      jsmn_stream_callback_t *callback, void *ctx);
+
+/**
+ * Feeds the next piece of the document to the parser.  Anything that
+ * follows the end of the top level value, other than whitespace, is an
+ * error.
+ * @param p The parser.
+ * @param data The bytes.
+ * @param len The number of bytes.
+ * @return JSMN_SUCCESS once the top level value is complete,
+ * JSMN_ERROR_PART while more is expected, JSMN_ERROR_INVAL if the document
+ * is broken or JSMN_ERROR_NOMEM if it nests too deep or holds a key,
+ * primitive or capture that does not fit the buffer.  Errors are sticky.
+ */
+jsmnerr_t jsmn_stream_parse(struct jsmn_stream_parser *p, const char *data,
+                            size_t len);
+
+#endif /* _JSMN_STREAM_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LAP_EVENTS_H_
+#define _LAP_EVENTS_H_
+
+#include "dateTime.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Lap and sector crossings as events, for the connectivity tasks to send
+ * on as soon as they happen rather than waiting for the LapCount and
+ * Sector channels to go out at the telemetry rate.
+ *
+ * lap_stats pushes the events into a small ring.  Each reader keeps its
+ * own position, so every connection sees every event.  Positions only
+ * ever grow; a reader that falls more than a ring behind carries on from
+ * the oldest event still held.
+ */
+
+/* Events held.  Must be a power of 2 */
+#define LAP_EVENT_QUEUE_SIZE	8
+
+enum lap_event_type {
+        /* A lap was completed */
+        LAP_EVENT_LAP,
+        /* A sector was completed */
+        LAP_EVENT_SECTOR,
+        /* The predicted lap time, as of a sector crossing */
+        LAP_EVENT_PREDICTED,
+};
+
+struct lap_event {
+        enum lap_event_type type;
+        /* The lap count for LAP_EVENT_LAP, the current lap otherwise */
+        int lap;
+        /* The sector completed.  Only for LAP_EVENT_SECTOR */
+        int sector;
+        /* The lap time, sector time or predicted lap time in ms */
+        tiny_millis_t time;
+        /* When it happened, in ms since the first fix */
+        tiny_millis_t at;
+};
+
+/**
+ * Drops all events held.  Positions held by readers stay valid.
+ */
+void lap_events_reset(void);
+
+/**
+ * Adds an event, dropping the oldest if the ring is full.
+ */
+void lap_events_push(const struct lap_event *e);
+
+/**
+ * @return The position the next event will go to.  A new reader starts
+ * here so that it only gets what happens from now on.
+ */
+uint32_t lap_events_position(void);
+
+/**
+ * Reads the event at a position and moves on to the next one.
+ * @param pos The reader's position.
+ * @param e Where the event goes.
+ * @return true if there was an event, false if the reader is up to date.
+ */
+bool lap_events_read(uint32_t *pos, struct lap_event *e);
+
+#endif /* _LAP_EVENTS_H_ */
@@ -58,6 +58,42 @@ tiny_millis_t getLastSectorTime();
 
 float getLastSectorTimeInMinutes();
 
+/**
+ * @return The theoretical best lap, the sum of the best time of every
+ * sector this session, in milliseconds.  0 until every sector has been
+ * timed.
+ */
+tiny_millis_t lapstats_optimal_lap_time();
+
+/**
+ * @return The theoretical best lap in minutes.
+ */
+float lapstats_optimal_lap_time_minutes();
+
+/**
+ * @return How much slower the last sector was than the best before it, in
+ * milliseconds.  Negative if it was faster, 0 if it had no best yet.
+ * Updated at each sector crossing.
+ */
+tiny_millis_t lapstats_sector_delta();
+
+/**
+ * @return The sector delta in seconds.
+ */
+float lapstats_sector_delta_seconds();
+
+/**
+ * @return How far behind the theoretical best lap we were at the last
+ * sector crossing, in milliseconds.  0 if a sector so far this lap had no
+ * best yet.  Updated at each sector crossing.
+ */
+tiny_millis_t lapstats_optimal_delta();
+
+/**
+ * @return The theoretical best delta in seconds.
+ */
+float lapstats_optimal_delta_seconds();
+
 int getSector();
 
 int getLastSector();
@@ -66,12 +102,31 @@ int getAtStartFinish();
 
 int getAtSector();
 
+/**
+ * Starts the lap distance over.
+ */
 void lapstats_reset_distance();
 
+/**
+ * Starts the session distance over.  Call when logging starts.
+ */
+void lapstats_start_session();
+
+/**
+ * @return The distance driven this lap, in km.
+ */
 float getLapDistance();
 
 float getLapDistanceInMiles();
 
+/**
+ * @return The distance driven since #lapstats_start_session, in km.  It
+ * comes from the same count as the lap distance.
+ */
+float lapstats_session_distance();
+
+float lapstats_session_distance_miles();
+
 /**
  * @return True if we are in the middle of a lap.  False otherwise.
  */
@@ -0,0 +1,150 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRACK_MAP_H_
+#define _TRACK_MAP_H_
+
+#include "capabilities.h"
+#include "geopoint.h"
+#include "gps.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An outline of the track, learned from the line driven on the first
+ * clean lap: one with no gap in the fixes and a good DOP throughout.  It
+ * is simplified as it is recorded, into at most #TRACK_MAP_POINTS
+ * points.
+ *
+ * The simplification is an opening window, the on-line form of
+ * Douglas-Peucker.  Fixes since the last point kept are held in a small
+ * window.  Once one of them strays further than the tolerance from the
+ * line between the last point kept and the newest fix, the fix before is
+ * kept as a point.  If the points run out the tolerance is doubled and
+ * the points already kept are simplified again.
+ *
+ * Once there is an outline every fix is placed on it, for the distance
+ * along the track and how far round the lap that is.  Only a few
+ * segments around the last match are searched, unless we are lost.
+ */
+
+/* Version of the format #track_map_save writes */
+#define TRACK_MAP_FORMAT_VERSION	1
+
+/* The most bytes #track_map_save needs */
+#define TRACK_MAP_SAVE_SIZE	(24 + 12 * TRACK_MAP_POINTS)
+
+/* The tolerance an outline starts out with, in meters */
+#define TRACK_MAP_TOLERANCE	1.0f
+
+struct track_map_point {
+        GeoPoint point;
+        /* Meters driven from the start of the lap, as it was learned */
+        float distance;
+};
+
+/**
+ * Drops the outline and any lap being learned.  Call when the track
+ * changes.
+ */
+void track_map_reset(void);
+
+/**
+ * Starts learning the outline, unless we already have one.  Call when a
+ * lap starts.
+ * @param start Where the lap started.
+ */
+void track_map_start_lap(const GeoPoint *start);
+
+/**
+ * Takes in a fix.  It is added to the outline being learned, or placed
+ * on the outline we have.  Call after the lap has been started or
+ * finished on it.
+ */
+void track_map_update(const GpsSnapshot *snap);
+
+/**
+ * Finishes learning the outline, if the lap was clean.  Call when a lap
+ * finishes, before the fix it finished on is taken in.
+ * @param finish Where the lap finished.
+ * @return true if we have just learned the outline.
+ */
+bool track_map_finish_lap(const GeoPoint *finish);
+
+/**
+ * @return true if there is an outline to place fixes on.
+ */
+bool track_map_available(void);
+
+/**
+ * @return The number of points in the outline, or in the one being
+ * learned.
+ */
+size_t track_map_count(void);
+
+/**
+ * @return The points of the outline, or of the one being learned.
+ */
+const struct track_map_point* track_map_points(void);
+
+/**
+ * @return The tolerance the outline was simplified to, in meters.
+ */
+float track_map_tolerance(void);
+
+/**
+ * @return The distance along the track of the last fix, in meters.  0 if
+ * there is no outline.
+ */
+float track_map_distance(void);
+
+float track_map_distance_miles(void);
+
+/**
+ * @return How far round the lap the last fix is, in percent.  0 if there
+ * is no outline.
+ */
+float track_map_lap_percent(void);
+
+/**
+ * Writes the outline out for #track_map_load.
+ * @param track_id The track it is of.
+ * @param track_hash A hash of the track definition.
+ * @param buf Where to write it.
+ * @param size The size of buf.  #TRACK_MAP_SAVE_SIZE is always enough.
+ * @return The number of bytes written, 0 if there is no outline or it
+ * does not fit.
+ */
+size_t track_map_save(const int32_t track_id, const uint32_t track_hash,
+                      uint8_t *buf, const size_t size);
+
+/**
+ * Makes an outline written by #track_map_save ours, unless we already
+ * have one.  An outline of another track, another format version or
+ * that is corrupt is not loaded.
+ * @return true if it was loaded.
+ */
+bool track_map_load(const int32_t track_id, const uint32_t track_hash,
+                    const uint8_t *buf, const size_t len);
+
+#endif /* _TRACK_MAP_H_ */
@@ -17,6 +17,9 @@ typedef struct _ConnParams {
     int (*disconnect)(DeviceConfig *config);
     int (*init_connection)(DeviceConfig *config);
     int (*check_connection_status)(DeviceConfig *config);
+    /* Frame a datagram.  Only used if init_connection sets config->datagram */
+    int (*begin_datagram)(DeviceConfig *config);
+    void (*end_datagram)(DeviceConfig *config);
     serial_id_t serial;
     size_t periodicMeta;
     uint32_t connection_timeout;
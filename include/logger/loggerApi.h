@@ -21,10 +21,18 @@
 #include "serial.h"
 #include "jsmn.h"
 #include "api.h"
+#include "lap_events.h"
 #include "sampleRecord.h"
+#include "telemetry_subscription.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define LOGGER_API \
 {"s", api_sampleData}, \
+{"getHist", api_getHistory}, \
+{"subscribe", api_subscribe}, \
 {"hb", api_heart_beat}, \
 {"getVer", api_getVersion}, \
 {"getStatus", api_getStatus}, \
@@ -59,12 +67,22 @@
 {"setObd2Cfg", api_setObd2Config}, \
 {"getScriptCfg", api_getScript}, \
 {"setScriptCfg", api_setScript}, \
+{"getCfgHash", api_getConfigHash}, \
+{"getAllCfg", api_getAllConfig}, \
+{"setAllCfg", api_setAllConfig}, \
 {"runScript", api_runScript}, \
 {"addTrackDb", api_addTrackDb}, \
 {"getTrackDb", api_getTrackDb}, \
 {"sysReset", api_systemReset}, \
 {"facReset", api_factoryReset}
 
+/* Messages that can also be streamed when too big for the line buffer */
+#define LOGGER_STREAM_API \
+{"setObd2Cfg", api_setObd2ConfigBegin, api_setObd2ConfigValue, api_setObd2ConfigEnd}, \
+{"setScriptCfg", api_setScriptBegin, api_setScriptValue, api_setScriptEnd}, \
+{"addTrackDb", api_addTrackDbBegin, api_addTrackDbValue, api_addTrackDbEnd}, \
+{"setAllCfg", api_setAllConfigBegin, api_setAllConfigValue, api_setAllConfigEnd}
+
 
 //commands
 int api_getVersion(Serial *serial, const jsmntok_t *json);
@@ -73,6 +91,8 @@ int api_getStatus(Serial *serial, const jsmntok_t *json);
 int api_systemReset(Serial *serial, const jsmntok_t *json);
 int api_factoryReset(Serial *serial, const jsmntok_t *json);
 int api_sampleData(Serial *serial, const jsmntok_t *json);
+int api_getHistory(Serial *serial, const jsmntok_t *json);
+int api_subscribe(Serial *serial, const jsmntok_t *json);
 int api_heart_beat(Serial *serial, const jsmntok_t *json);
 int api_log(Serial *serial, const jsmntok_t *json);
 int api_getMeta(Serial *serial, const jsmntok_t *json);
@@ -107,12 +127,46 @@ int api_setCanConfig(Serial *serial, const jsmntok_t *json);
 int api_getScript(Serial *serial, const jsmntok_t *json);
 int api_setScript(Serial *serial, const jsmntok_t *json);
 int api_runScript(Serial *serial, const jsmntok_t *json);
+int api_getConfigHash(Serial *serial, const jsmntok_t *json);
+int api_getAllConfig(Serial *serial, const jsmntok_t *json);
+int api_setAllConfig(Serial *serial, const jsmntok_t *json);
+
+//streamed commands
+void api_setObd2ConfigBegin(Serial *serial);
+int api_setObd2ConfigValue(Serial *serial, const char *member, int index,
+                           const jsmntok_t *json, bool more);
+int api_setObd2ConfigEnd(Serial *serial, int result);
+void api_setScriptBegin(Serial *serial);
+int api_setScriptValue(Serial *serial, const char *member, int index,
+                       const jsmntok_t *json, bool more);
+int api_setScriptEnd(Serial *serial, int result);
+void api_addTrackDbBegin(Serial *serial);
+int api_addTrackDbValue(Serial *serial, const char *member, int index,
+                        const jsmntok_t *json, bool more);
+int api_addTrackDbEnd(Serial *serial, int result);
+void api_setAllConfigBegin(Serial *serial);
+int api_setAllConfigValue(Serial *serial, const char *member, int index,
+                          const jsmntok_t *json, bool more);
+int api_setAllConfigEnd(Serial *serial, int result);
 
 //messages
 void api_sendLogStart(Serial *serial);
 void api_sendLogEnd(Serial *serial);
+void api_send_lap_event(Serial *serial, const struct lap_event *e);
 void api_send_sample_record(Serial *serial, struct sample *sample,
-                            unsigned int tick, int sendMeta);
+                            unsigned int tick, int sendMeta,
+                            bool drop_low_priority,
+                            const struct telemetry_subscription *sub);
+
+void api_send_sample_datagram(Serial *serial, const struct sample *sample,
+                              uint32_t seq, unsigned int tick, uint32_t layout,
+                              bool drop_low_priority,
+                              const struct telemetry_subscription *sub);
+
+void api_send_meta_datagram(Serial *serial, const struct sample *sample,
+                            uint32_t seq, uint32_t layout, size_t first,
+                            size_t count,
+                            const struct telemetry_subscription *sub);
 
 //Utility functions
 void unescapeTextField(char *data);
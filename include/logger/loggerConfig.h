@@ -47,7 +47,7 @@
 #define FILTER_ALPHA_PRECISION				2
 #define SCALING_MAP_BIN_PRECISION			2
 
-#define DEFAULT_GPS_POSITION_PRECISION 		6
+#define DEFAULT_GPS_POSITION_PRECISION 		7
 #define DEFAULT_GPS_RADIUS_PRECISION 		5
 #define DEFAULT_VOLTAGE_SCALING_PRECISION	2
 #define DEFAULT_ANALOG_SCALING_PRECISION	2
@@ -343,6 +343,11 @@ typedef struct _GPSConfig {
     ChannelConfig satellites;
     ChannelConfig quality;
     ChannelConfig DOP;
+    /* Filled in between fixes from the IMU.  See gps_fusion.h */
+    ChannelConfig fusedLatitude;
+    ChannelConfig fusedLongitude;
+    ChannelConfig fusedSpeed;
+    ChannelConfig heading;
 } GPSConfig;
 
 
@@ -357,6 +362,10 @@ typedef struct _GPSConfig {
 #define DEFAULT_GPS_SATELLITE_CONFIG {"GPSSats", "", 0, 20, DEFAULT_GPS_SAMPLE_RATE, 0, 0}
 #define DEFAULT_GPS_QUALITY_CONFIG {"GPSQual", "", 0, 5, DEFAULT_GPS_SAMPLE_RATE, 0, 0}
 #define DEFAULT_GPS_DOP_CONFIG {"GPSDOP", "", 0, 20, DEFAULT_GPS_SAMPLE_RATE, 1, 0}
+#define DEFAULT_GPS_FUSED_LATITUDE_CONFIG {"FusedLat", "Degrees", -180, 180, SAMPLE_DISABLED, 7, 0}
+#define DEFAULT_GPS_FUSED_LONGITUDE_CONFIG {"FusedLon", "Degrees", -180, 180, SAMPLE_DISABLED, 7, 0}
+#define DEFAULT_GPS_FUSED_SPEED_CONFIG {"FusedSpeed", "MPH", 0, 150, SAMPLE_DISABLED, 2, 0}
+#define DEFAULT_GPS_HEADING_CONFIG {"Heading", "Degrees", 0, 360, SAMPLE_DISABLED, 1, 0}
 
 #define DEFAULT_GPS_CONFIG {                   \
 		DEFAULT_GPS_LATITUDE_CONFIG,           \
@@ -366,7 +375,11 @@ typedef struct _GPSConfig {
 		DEFAULT_GPS_ALTITUDE_CONFIG,           \
 		DEFAULT_GPS_SATELLITE_CONFIG,          \
 		DEFAULT_GPS_QUALITY_CONFIG,            \
-		DEFAULT_GPS_DOP_CONFIG                 \
+		DEFAULT_GPS_DOP_CONFIG,                \
+		DEFAULT_GPS_FUSED_LATITUDE_CONFIG,     \
+		DEFAULT_GPS_FUSED_LONGITUDE_CONFIG,    \
+		DEFAULT_GPS_FUSED_SPEED_CONFIG,        \
+		DEFAULT_GPS_HEADING_CONFIG             \
          }
 
 typedef struct _LapConfig {
@@ -377,6 +390,19 @@ typedef struct _LapConfig {
     ChannelConfig predTimeCfg;
     ChannelConfig elapsed_time_cfg;
     ChannelConfig current_lap_cfg;
+    /* Theoretical best lap and deltas to the best sectors */
+    ChannelConfig optimal_time_cfg;
+    ChannelConfig sector_delta_cfg;
+    ChannelConfig optimal_delta_cfg;
+    /* Predicted deltas to the best, session best and target laps */
+    ChannelConfig pred_delta_cfg;
+    ChannelConfig session_delta_cfg;
+    ChannelConfig target_delta_cfg;
+    /* Distance driven since logging started */
+    ChannelConfig session_distance_cfg;
+    /* Where we are on the learned track outline */
+    ChannelConfig track_distance_cfg;
+    ChannelConfig lap_percent_cfg;
 } LapConfig;
 
 #define DEFAULT_LAPSTATS_SAMPLE_RATE SAMPLE_10Hz
@@ -388,6 +414,15 @@ typedef struct _LapConfig {
 #define DEFAULT_PRED_TIME_CONFIG {"PredTime", "Min", 0, 0, SAMPLE_5Hz, 4, 0}
 #define DEFAULT_ELAPSED_LAP_TIME_CONFIG {"ElapsedTime", "Min", 0, 0, DEFAULT_LAPSTATS_SAMPLE_RATE, 4, 0}
 #define DEFAULT_CURRENT_LAP_CONFIG {"CurrentLap", "", 0, 0, DEFAULT_LAPSTATS_SAMPLE_RATE, 0, 0}
+#define DEFAULT_OPTIMAL_TIME_CONFIG {"OptTime", "Min", 0, 0, SAMPLE_DISABLED, 4, 0}
+#define DEFAULT_SECTOR_DELTA_CONFIG {"SectorDelta", "Sec", -60, 60, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_OPTIMAL_DELTA_CONFIG {"OptDelta", "Sec", -60, 60, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_PRED_DELTA_CONFIG {"PredDelta", "Sec", -60, 60, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_SESSION_DELTA_CONFIG {"SessDelta", "Sec", -60, 60, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_TARGET_DELTA_CONFIG {"TargetDelta", "Sec", -60, 60, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_SESSION_DISTANCE_CONFIG {"SessionDist", "Miles", 0, 0, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_TRACK_DISTANCE_CONFIG {"TrackDist", "Miles", 0, 0, SAMPLE_DISABLED, 3, 0}
+#define DEFAULT_LAP_PERCENT_CONFIG {"LapPct", "%", 0, 100, SAMPLE_DISABLED, 1, 0}
 
 #define DEFAULT_LAP_CONFIG {                                    \
                 DEFAULT_LAP_COUNT_CONFIG,                       \
@@ -396,7 +431,16 @@ typedef struct _LapConfig {
                         DEFAULT_SECTOR_TIME_CONFIG,             \
                         DEFAULT_PRED_TIME_CONFIG,               \
                         DEFAULT_ELAPSED_LAP_TIME_CONFIG,        \
-                        DEFAULT_CURRENT_LAP_CONFIG              \
+                        DEFAULT_CURRENT_LAP_CONFIG,             \
+                        DEFAULT_OPTIMAL_TIME_CONFIG,            \
+                        DEFAULT_SECTOR_DELTA_CONFIG,            \
+                        DEFAULT_OPTIMAL_DELTA_CONFIG,           \
+                        DEFAULT_PRED_DELTA_CONFIG,              \
+                        DEFAULT_SESSION_DELTA_CONFIG,           \
+                        DEFAULT_TARGET_DELTA_CONFIG,            \
+                        DEFAULT_SESSION_DISTANCE_CONFIG,        \
+                        DEFAULT_TRACK_DISTANCE_CONFIG,          \
+                        DEFAULT_LAP_PERCENT_CONFIG              \
                         }
 
 typedef struct _TrackConfig {
@@ -453,10 +497,15 @@ typedef struct _CellularConfig {
 #define BACKGROUND_STREAMING_ENABLED				1
 #define BACKGROUND_STREAMING_DISABLED				0
 
+/* Telemetry over a TCP session, or as self contained UDP datagrams */
+#define TELEMETRY_UDP_DISABLED					0
+#define TELEMETRY_UDP_ENABLED					1
+
 typedef struct _TelemetryConfig {
     unsigned char backgroundStreaming;
     char telemetryDeviceId[DEVICE_ID_LENGTH + 1];
     char telemetryServerHost[TELEMETRY_SERVER_HOST_LENGTH + 1];
+    unsigned char udpMode;
 } TelemetryConfig;
 
 
@@ -527,6 +576,7 @@ int decodeSampleRate(int sampleRateCode);
 
 unsigned char filterAnalogScalingMode(unsigned char mode);
 unsigned char filterBgStreamingMode(unsigned char mode);
+unsigned char filterUdpMode(unsigned char mode);
 unsigned char filterSdLoggingMode(unsigned char mode);
 char filterGpioMode(int config);
 char filterPwmOutputMode(int config);
@@ -8,6 +8,7 @@
 #ifndef LOGGERTASKEX_H_
 #define LOGGERTASKEX_H_
 
+#include "loggerConfig.h"
 #include "loggerNotifications.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -15,6 +16,12 @@
 void startLogging();
 void stopLogging();
 
+/**
+ * @return The encoded rate at which the logger hands samples to the
+ * telemetry connections for the given configuration.
+ */
+int getTelemetrySampleRate(LoggerConfig *config);
+
 void startLoggerTaskEx( int priority);
 void loggerTaskEx(void *params);
 
@@ -37,6 +37,7 @@ int Lua_GetGPSQuality(lua_State *L);
 int Lua_GetLapTime(lua_State *L);
 int Lua_GetGPSDistance(lua_State *L);
 int Lua_GetLapCount(lua_State *L);
+int Lua_SetTargetLap(lua_State *L);
 int Lua_GetGpsSecondsSinceFirstFix(lua_State *L);
 int Lua_GetGPSAtStartFinish(lua_State *L);
 int Lua_GetTickCount(lua_State *L);
@@ -20,6 +20,7 @@ enum LoggerMessageType {
     LoggerMessageType_Sample,
     LoggerMessageType_Start,
     LoggerMessageType_Stop,
+    LoggerMessageType_FastLap,
 };
 
 /*
@@ -43,6 +44,8 @@ typedef struct _ChannelSample {
     ChannelConfig *cfg;
     size_t channelIndex;
     bool populated;
+    /* Sensor channels that telemetry may shed when the link backs up */
+    bool low_priority;
 
     enum SampleData sampleData;
     union {
@@ -0,0 +1,97 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SAMPLE_HISTORY_H_
+#define _SAMPLE_HISTORY_H_
+
+#include "sampleRecord.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * In RAM history of the samples the logger task hands to telemetry, so
+ * that a client that just (re)connected can catch up without reading the
+ * SD card.  Records are packed: a header, a bitmap of the channels that
+ * were populated and then the raw values of only those channels.  The
+ * oldest records are dropped to make room.
+ *
+ * Records are addressed by position.  Positions only ever grow, so a
+ * position held on to by a reader simply becomes invalid once the record
+ * it points at is dropped.
+ *
+ * How far back that goes depends on SAMPLE_HISTORY_SIZE.  The default
+ * config makes records of about 100 bytes, so at 10Hz telemetry that is
+ * about 1KB a second: some 30s on MK2.  MK1 keeps no history.  More
+ * channels or a higher telemetry rate mean less.  A client asking for
+ * more gets what is held.
+ */
+
+/* Largest record we will keep.  Bigger samples are not recorded */
+#define SAMPLE_HISTORY_RECORD_MAX	512
+
+/**
+ * Drops all history and sets the number of channels in the records that
+ * follow.  Call whenever the channel layout changes.
+ */
+void sample_history_reset(const size_t channel_count);
+
+/**
+ * Appends a sample to the history, dropping the oldest records as
+ * needed.  Safe to call while readers are active.
+ */
+void sample_history_add(const struct sample *s);
+
+/**
+ * @return The number of records currently held.
+ */
+size_t sample_history_count(void);
+
+/**
+ * @return The position of the n-th newest record, or of the oldest record
+ * if fewer than n are held.
+ */
+uint32_t sample_history_last(const size_t n);
+
+/**
+ * @return The position of the first record newer than the given tick, or
+ * the end position if there is none.
+ */
+uint32_t sample_history_since(const size_t ticks);
+
+/**
+ * @return true if pos points at a record that is still held.
+ */
+bool sample_history_valid(const uint32_t pos);
+
+/**
+ * Reads a record into a sample and advances to the next one.  The
+ * sample must have been set up for the current channel layout.  Channels
+ * not in the record are marked as not populated.
+ * @param pos The position to read, updated to the next record.
+ * @param s The sample to fill.
+ * @return true if the sample was read, false if pos is not valid or the
+ * sample does not match the channel layout.
+ */
+bool sample_history_read(uint32_t *pos, struct sample *s);
+
+#endif /* _SAMPLE_HISTORY_H_ */
@@ -0,0 +1,111 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TELEMETRY_DATAGRAM_H_
+#define _TELEMETRY_DATAGRAM_H_
+
+#include "sampleRecord.h"
+#include "telemetry_subscription.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Telemetry as UDP datagrams.  Nothing is retransmitted and datagrams may
+ * go missing or arrive out of order, so each one stands on its own: it
+ * carries a sequence number, the tick and the latest value of every
+ * channel, not just the ones sampled this time.  A slow channel whose
+ * update got lost simply shows up again in the next datagram.  The
+ * receiver uses the sequence numbers to measure loss.
+ *
+ * The channel meta is too big to go along every time.  Each sample
+ * datagram names its layout by a hash instead, and the meta goes out in
+ * datagrams of its own, in pieces, whenever the layout changes and again
+ * every so often for receivers that missed it.
+ */
+
+/* Sample datagrams between repeats of the meta */
+#define TELEMETRY_DATAGRAM_META_INTERVAL	100
+
+/* Channels per meta datagram.  Keeps them well under the modem limit */
+#define TELEMETRY_DATAGRAM_META_CHANNELS	8
+
+struct telemetry_datagram {
+        uint32_t seq;
+        /* Hash of the channel layout.  0 until worked out */
+        uint32_t layout;
+        /* The layout the meta last went out for */
+        uint32_t meta_layout;
+        /* Sample datagrams since the meta last went out */
+        size_t since_meta;
+        /* The latest value of every channel */
+        struct sample held;
+};
+
+/**
+ * Readies a datagram stream for a new connection.
+ */
+void telemetry_datagram_init(struct telemetry_datagram *td);
+
+/**
+ * Releases the memory held for the latest values.
+ */
+void telemetry_datagram_free(struct telemetry_datagram *td);
+
+/**
+ * Takes in the values of a new sample.  Call it for every sample, sent
+ * or not.
+ * @return The sample to send, which holds the latest value of every
+ * channel seen so far.  NULL if there was no memory for it.
+ */
+const struct sample* telemetry_datagram_update(struct telemetry_datagram *td,
+                                               const struct sample *s);
+
+/**
+ * Forgets the layout hash so that it is worked out again and the meta is
+ * sent with the next datagram.  Call when the subscription changes.
+ */
+void telemetry_datagram_layout_changed(struct telemetry_datagram *td);
+
+/**
+ * @return The hash identifying the channels sent and their settings.
+ */
+uint32_t telemetry_datagram_layout(struct telemetry_datagram *td,
+                                   const struct telemetry_subscription *sub);
+
+/**
+ * @return true if the meta should go out before the next sample.  Call
+ * after telemetry_datagram_layout.
+ */
+bool telemetry_datagram_meta_due(const struct telemetry_datagram *td);
+
+/**
+ * Notes that the meta went out.
+ */
+void telemetry_datagram_meta_sent(struct telemetry_datagram *td);
+
+/**
+ * @return The sequence number for the next datagram.
+ */
+uint32_t telemetry_datagram_next_seq(struct telemetry_datagram *td);
+
+#endif /* _TELEMETRY_DATAGRAM_H_ */
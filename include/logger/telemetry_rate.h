@@ -0,0 +1,112 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TELEMETRY_RATE_H_
+#define _TELEMETRY_RATE_H_
+
+#include "sampleRecord.h"
+#include "serial.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Backpressure control for a telemetry connection.  The connectivity
+ * task feeds the controller the depth of its sample queue and the time
+ * it took to push the last sample out the serial port.  When the link
+ * can't keep up the controller walks down a ladder of levels:
+ *
+ * level 0: every sample the logger hands us, all channels.
+ * level 1: same rate, low priority (sensor) channels are shed.
+ * level 2+: low priority channels shed and the rate is stepped down
+ *           through the standard sample rates, down to 1Hz.
+ *
+ * Once the link has been clear for a while it climbs back up one level
+ * at a time.
+ */
+
+/* Queue depth at which we consider the link congested */
+#define TELEMETRY_RATE_BACKLOG_HIGH	3
+/* Updates to wait after stepping down before stepping down again */
+#define TELEMETRY_RATE_SETTLE_UPDATES	5
+/* Consecutive clear updates required before stepping back up */
+#define TELEMETRY_RATE_RECOVER_UPDATES	50
+
+struct telemetry_rate {
+        int base_rate;
+        int rate;
+        size_t level;
+        size_t max_level;
+        size_t settle_count;
+        size_t clear_count;
+        size_t credit;
+        size_t last_ticks;
+};
+
+/**
+ * Sets up the controller at full speed.
+ * @param tr The controller.
+ * @param base_rate The encoded telemetry sample rate of the logger.
+ */
+void telemetry_rate_init(struct telemetry_rate *tr, const int base_rate);
+
+/**
+ * Feeds one observation of the link into the controller.  Call this once
+ * for every sample received from the logger, whether it was sent or not.
+ * @param tr The controller.
+ * @param backlog Number of messages still waiting in the sample queue.
+ * @param send_ticks Ticks spent writing the sample out, 0 if not sent.
+ */
+void telemetry_rate_update(struct telemetry_rate *tr, const size_t backlog,
+                           const size_t send_ticks);
+
+/**
+ * Decides if a sample should go out at the current level.  Samples that
+ * carry a channel slower than the current rate are always sent so that
+ * slow channels never go silent.
+ * @return true if the sample should be sent, false if it should be dropped.
+ */
+bool telemetry_rate_should_send(struct telemetry_rate *tr,
+                                const struct sample *s);
+
+/**
+ * @return true if low priority channels should be left out of samples.
+ */
+bool telemetry_rate_drop_low_priority(const struct telemetry_rate *tr);
+
+/**
+ * @return The encoded sample rate telemetry is currently running at.
+ */
+int telemetry_rate_get_rate(const struct telemetry_rate *tr);
+
+/**
+ * Records the rate a connection is currently streaming at so that it
+ * may be reported in the status.  Use SAMPLE_DISABLED when not streaming.
+ */
+void telemetry_rate_set_current(const serial_id_t port, const int rate);
+
+/**
+ * @return The effective telemetry rate in Hz for the given port, or 0 if
+ * nothing is streaming on it.
+ */
+int telemetry_rate_get_current(const serial_id_t port);
+
+#endif /* _TELEMETRY_RATE_H_ */
@@ -0,0 +1,156 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TELEMETRY_SUBSCRIPTION_H_
+#define _TELEMETRY_SUBSCRIPTION_H_
+
+#include "capabilities.h"
+#include "sampleRecord.h"
+#include "serial.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per connection telemetry subscriptions.  A client may ask for just the
+ * channels it cares about, at a rate slower than the telemetry rate.
+ * Channel names are looked up once, when the client subscribes, and kept
+ * as indexes into the sample so that filtering a sample costs no more than
+ * walking that list.
+ *
+ * A subscription belongs to the serial port it was made on.  It lasts
+ * until the client changes it, the connection drops or the channel layout
+ * of the logger changes.  Any config change counts as a layout change:
+ * the same number of channels may well be different channels.
+ */
+
+struct telemetry_subscription {
+        const Serial *serial;
+        /* Bumped on every change so the connection can tell */
+        size_t generation;
+        /* Encoded sample rate.  SAMPLE_DISABLED for the telemetry rate */
+        int rate;
+        /* Channel layout the indexes were made for */
+        size_t layout;
+        /* Sample channel count the indexes were made for.  0 if unused */
+        size_t channel_count;
+        /* Number of subscribed channels.  0 for all of them */
+        size_t count;
+        size_t credit;
+        size_t last_ticks;
+        uint16_t index[MAX_SUBSCRIPTION_CHANNELS];
+};
+
+/**
+ * @return The subscription of the given port, made empty if the port did
+ * not have one yet.  NULL if there is no room for another.
+ */
+struct telemetry_subscription* telemetry_subscription_get(const Serial *serial);
+
+/**
+ * Drops the subscription so that everything is sent at the telemetry rate.
+ */
+void telemetry_subscription_clear(struct telemetry_subscription *sub);
+
+/**
+ * Notes that the channel layout of the logger changed.  Subscriptions made
+ * before no longer match.  Safe to call from any task.
+ */
+void telemetry_subscription_layout_changed(void);
+
+/**
+ * @return The current channel layout.  Take it before looking up the
+ * channels of a new subscription.
+ */
+size_t telemetry_subscription_layout(void);
+
+/**
+ * Replaces the subscription.
+ * @param sub The subscription.
+ * @param layout The channel layout index refers to.
+ * @param channel_count The channel count of the samples index refers to.
+ * @param index Indexes of the wanted channels within the sample, in the
+ * order they should be sent.
+ * @param count The number of indexes, 0 for all channels.
+ * @param rate The encoded sample rate, SAMPLE_DISABLED for the telemetry
+ * rate.
+ * @return true if set, false if there were too many channels.
+ */
+bool telemetry_subscription_set(struct telemetry_subscription *sub,
+                                const size_t layout,
+                                const size_t channel_count,
+                                const uint16_t *index, const size_t count,
+                                const int rate);
+
+/**
+ * @return The index of the named channel within the sample, or -1 if the
+ * sample does not have it.
+ */
+int telemetry_subscription_find_channel(const struct sample *s,
+                                        const char *name);
+
+/**
+ * @return true if the subscription limits what is sent.  sub may be NULL.
+ */
+bool telemetry_subscription_active(const struct telemetry_subscription *sub);
+
+/**
+ * @return true if the subscription was made for the current channel
+ * layout and that of the sample.
+ */
+bool telemetry_subscription_matches(const struct telemetry_subscription *sub,
+                                    const struct sample *s);
+
+/**
+ * @return The encoded rate samples should be sent at given the logger's
+ * telemetry rate.  The subscription can only slow things down.  sub may
+ * be NULL.
+ */
+int telemetry_subscription_get_rate(const struct telemetry_subscription *sub,
+                                    const int telemetry_rate);
+
+/**
+ * Decides if a sample should go out under the subscription.  Samples
+ * without any subscribed data are dropped, the rest are thinned out to the
+ * subscribed rate.  Like telemetry_rate_should_send, samples that carry a
+ * subscribed channel slower than that rate always go.  Everything goes if
+ * sub is NULL or not active.
+ */
+bool telemetry_subscription_should_send(struct telemetry_subscription *sub,
+                                        const struct sample *s);
+
+/**
+ * @return The number of channels sent under the subscription.  sub may
+ * be NULL for all channels.
+ */
+size_t telemetry_subscription_channel_count(const struct telemetry_subscription *sub,
+                                            const struct sample *s);
+
+/**
+ * @return The i-th channel sent under the subscription.  sub may be NULL
+ * for all channels.
+ */
+const ChannelSample*
+telemetry_subscription_channel(const struct telemetry_subscription *sub,
+                               const struct sample *s, const size_t i);
+
+#endif /* _TELEMETRY_SUBSCRIPTION_H_ */
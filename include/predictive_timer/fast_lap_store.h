@@ -0,0 +1,82 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FAST_LAP_STORE_H_
+#define _FAST_LAP_STORE_H_
+
+#include "tracks.h"
+
+#include <stdbool.h>
+
+/*
+ * Keeps the fast lap of the predictive timer on the SD card, one file per
+ * track, so that predicted times and splits are there from the first lap
+ * after a power cycle.  The learned outline of the track goes along with
+ * it, in a file of its own.
+ *
+ * The SD card belongs to the file writer task, so the GPS task only asks
+ * for a fast lap to be saved or loaded and the file writer does the file
+ * work when it gets to it.  Only one request is outstanding at a time.
+ */
+
+/**
+ * Saves the fast lap of the predictive timer and the track outline as
+ * those of the given track.  Call from the GPS task when a new fast lap
+ * is set or the outline is learned.
+ * @return true if the save was asked for, false if there is nothing to
+ * save or a request is still outstanding.
+ */
+bool fast_lap_store_save(const Track *track);
+
+/**
+ * Asks for the saved fast lap and outline of a track.  Call from the GPS task once the
+ * track is known.
+ * @return true if the load was asked for, false if a request is still
+ * outstanding.
+ */
+bool fast_lap_store_load(const Track *track);
+
+/**
+ * Hands a fast lap the file writer read to the predictive timer, and the
+ * outline to the track map.  Call from the GPS task.
+ * @return true if either was loaded.
+ */
+bool fast_lap_store_apply(void);
+
+/**
+ * Does the outstanding file work.  Call from the file writer task.
+ * @param mounted true if the file system is already mounted, as it is
+ * while logging.  Otherwise it is mounted for the duration.
+ * @return 0 on success, or the error.
+ */
+int fast_lap_store_sync(const bool mounted);
+
+/**
+ * @return The name of the file the fast lap of the track is kept in.
+ */
+const char * fast_lap_store_file_name(const Track *track);
+
+/**
+ * @return The name of the file the outline of the track is kept in.
+ */
+const char * fast_lap_store_map_file_name(const Track *track);
+
+#endif /* _FAST_LAP_STORE_H_ */
@@ -12,18 +12,46 @@
 /* extern "C" { */
 /* #endif */
 
+#include "capabilities.h"
 #include "dateTime.h"
 #include "geopoint.h"
 #include "gps.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Version of the format #saveFastLap writes.  Bump it whenever the format or the meaning of
+ * what is in it changes.  Fast laps saved in any other version are discarded.
+ */
+#define FAST_LAP_FORMAT_VERSION 1
+
+/**
+ * The most bytes #saveFastLap needs.
+ */
+#define FAST_LAP_SAVE_SIZE (32 + 6 * PREDICTIVE_TIMER_SAMPLES)
+
+/**
+ * The laps we predict against.  Only the first #PREDICTIVE_TIMER_REFS of them are kept.
+ */
+enum PredictiveRef {
+    // The fastest lap there is for the track, loaded or driven.  What the predicted time uses.
+    PREDICTIVE_REF_BEST = 0,
+    // The fastest lap driven since the timer was reset.
+    PREDICTIVE_REF_SESSION,
+    // A lap the driver picked with #setTargetLap.  It stays until they pick another.
+    PREDICTIVE_REF_TARGET,
+};
 
 /**
  * Called when we finish a lap.  Adds the final sample and adjusts sample rates
  * in preperation for the next lap.  Must be called after #startLap is called.
- * @param gpsSnapshot The GPS state when the lap was completed.
+ * @param point The position when the lap finished.
+ * @param time The time (millis) when the lap finished.
+ * @return true if the lap is the new fast lap, false otherwise.
  */
-void finishLap(const GpsSnapshot *gpsSnapshot);
+bool finishLap(const GeoPoint *point, const tiny_millis_t time);
 
 /**
  * Called when we start a lap.  This sets the appropriate timers and starts recording
@@ -52,6 +80,33 @@ bool addGpsSample(const GpsSnapshot *gpsSnapshot);
  */
 tiny_millis_t getSplitAgainstFastLap(const GeoPoint *  point, tiny_millis_t time);
 
+/**
+ * Like #getSplitAgainstFastLap but against any of the references.  Each reference keeps its own
+ * place on its lap, so the cost of a call does not depend on how many references there are.
+ * @return The split, or 0 if there is no such reference.
+ */
+tiny_millis_t getSplitAgainstReference(const enum PredictiveRef ref, const GeoPoint *point,
+                                       tiny_millis_t time);
+
+/**
+ * @return true if there is a lap for the reference to predict against.
+ */
+bool isReferenceAvailable(const enum PredictiveRef ref);
+
+/**
+ * @return The lap time of the reference, 0 if there is none.
+ */
+tiny_millis_t getReferenceLapTime(const enum PredictiveRef ref);
+
+/**
+ * Makes the target lap a copy of another reference as it is now.  Safe to call from any task:
+ * the copy is made with the next GPS sample.
+ * @param source #PREDICTIVE_REF_BEST or #PREDICTIVE_REF_SESSION to copy, #PREDICTIVE_REF_TARGET
+ * to drop the target lap.
+ * @return true if the request was taken, false if there is no such lap or no target lap is kept.
+ */
+bool setTargetLap(const enum PredictiveRef source);
+
 /**
  * Figures out the predicted lap time.  Call as much as you like... it will only do
  * calculations when new data is actually available.  This minimizes inaccuracies and
@@ -68,6 +123,13 @@ tiny_millis_t getPredictedTime(const GeoPoint * point, tiny_millis_t time);
  */
 float getPredictedTimeInMinutes();
 
+/**
+ * The time behind a reference at the current position, in seconds, for logging.  Negative is
+ * ahead.  0 if there is no such reference.
+ * @param ref A #PredictiveRef.
+ */
+float getPredictedDeltaInSeconds(const int ref);
+
 /**
  * Tells the caller if a predictive time is ready to be had.
  * @return True if it is, false otherwise.
@@ -95,6 +157,27 @@ void resetPredictiveTimer();
  */
 float distPctBtwnTwoPoints(const GeoPoint *s, const GeoPoint *e, const GeoPoint *m);
 
+/**
+ * Writes the fast lap out in a compact binary form, for it to be loaded again after a power
+ * cycle with #loadFastLap.
+ * @param trackId The track the lap was driven on.
+ * @param trackHash A hash of the track definition, so that a fast lap of a track that has
+ * since been changed is not loaded.
+ * @param buf Where to write it.
+ * @param size The size of buf.  #FAST_LAP_SAVE_SIZE is always enough.
+ * @return The number of bytes written, 0 if there is no fast lap or it does not fit.
+ */
+size_t saveFastLap(const int32_t trackId, const uint32_t trackHash, uint8_t *buf,
+                   const size_t size);
+
+/**
+ * Makes a fast lap written by #saveFastLap our fast lap, unless we already have a faster one.
+ * A fast lap of another track, another format version or that is corrupt is not loaded.
+ * @return true if it was loaded, false otherwise.
+ */
+bool loadFastLap(const int32_t trackId, const uint32_t trackHash, const uint8_t *buf,
+                 const size_t len);
+
 
 /* #ifdef __cplusplus */
 /* } */
@@ -96,9 +96,17 @@ void put_bytes(Serial *serial, char *data, unsigned int length);
 
 void put_crlf(const Serial * serial);
 
-void read_line(Serial *serial, char *buffer, size_t bufferSize);
+/**
+ * Reads a line terminated by a carriage return.
+ * @return 1 if the whole line was read, 0 if the buffer filled up first.
+ */
+int read_line(Serial *serial, char *buffer, size_t bufferSize);
 
-void interactive_read_line(Serial *serial, char * buffer, size_t bufferSize);
+/**
+ * Like read_line but echoes the input back and handles backspace.
+ * @return 1 if the whole line was read, 0 if the buffer filled up first.
+ */
+int interactive_read_line(Serial *serial, char * buffer, size_t bufferSize);
 
 
 #endif /* SERIAL_H_ */
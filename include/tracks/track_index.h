@@ -0,0 +1,82 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRACK_INDEX_H_
+#define _TRACK_INDEX_H_
+
+#include "geopoint.h"
+#include "tracks.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A coarse spatial index over the points of the track database, so that
+ * finding the tracks near a fix takes a few comparisons instead of a pass
+ * over every track.  The start and sector points of every track go into
+ * grid cells of TRACK_INDEX_CELL fixed point units on a side, kept sorted
+ * by cell.  It is built again whenever the tracks are flashed.
+ *
+ * When there are more points than TRACK_INDEX_POINTS the start points
+ * are kept and the sector points that do not fit are left out.
+ */
+
+/* 0.01 degrees, about 1.1km of latitude */
+#define TRACK_INDEX_CELL	100000
+
+struct track_index_hit {
+        /* Index of the track in the track database */
+        uint8_t track;
+        /* Index of the point in allSectors.  0 is the start */
+        uint8_t point;
+};
+
+/**
+ * Builds the index from the given tracks.
+ */
+void track_index_build(const Tracks *tracks);
+
+/**
+ * @return true if the index has been built since power up.
+ */
+bool track_index_built(void);
+
+/**
+ * @return The number of points in the index.
+ */
+size_t track_index_size(void);
+
+/**
+ * Finds the indexed points that may be within the given radius of a
+ * point.  Every point within the radius is found.  Some further away
+ * may be found too, so callers must still check the distance.
+ * @param gp The point to search around.
+ * @param radius_m The radius in meters.
+ * @param hits Where the points found go.
+ * @param max The most hits that fit.
+ * @return The number of points found.  If more than max, only the first
+ * max of them were written.
+ */
+size_t track_index_near(const GeoPoint *gp, const float radius_m,
+                        struct track_index_hit *hits, const size_t max);
+
+#endif /* _TRACK_INDEX_H_ */
@@ -12,6 +12,7 @@
 
 #define TRACK_ADD_MODE_IN_PROGRESS	1
 #define TRACK_ADD_MODE_COMPLETE 	2
+#define TRACK_ADD_MODE_UPDATE 		3
 
 #define MAX_TRACK_COUNT				40
 #define SECTOR_COUNT				MAX_SECTORS
@@ -24,6 +25,7 @@
 { \
     DEFAULT_VERSION_INFO, \
     0, \
+    {}, \
     {} \
 }
 
@@ -53,14 +55,40 @@ typedef struct _Track {
     };
 } Track;
 
+/*
+ * Stored in flash as is.  The layout goes with the firmware version: a
+ * change here needs a new major or minor version so that the DB is
+ * replaced with the defaults rather than read as something it is not.
+ */
 typedef struct _Tracks {
     VersionInfo versionInfo;
     size_t count;
+    /*
+     * FNV-1a of each track.  Kept up front with the count so that both
+     * are written last when the DB is updated.
+     */
+    uint32_t crcs[MAX_TRACK_COUNT];
     Track tracks[MAX_TRACK_COUNT];
 } Tracks;
 
+/**
+ * Loads the track DB.  Drops the tracks from the first one that does not
+ * match its CRC onwards; that is what is left of an update that did not
+ * finish.
+ */
 void initialize_tracks();
 int flash_tracks(const Tracks *source, size_t rawSize);
+
+/**
+ * Writes a track to the DB.  Only the flash pages that change are written.
+ * @param track The track.
+ * @param index Where it goes.
+ * @param mode TRACK_ADD_MODE_IN_PROGRESS for all but the last track of a
+ * new DB and TRACK_ADD_MODE_COMPLETE for the last one; the DB then ends
+ * with that track.  TRACK_ADD_MODE_UPDATE replaces the track at index or
+ * adds one at the end, leaving the rest of the DB as it is.
+ * @return TRACK_ADD_RESULT_OK or TRACK_ADD_RESULT_FAIL.
+ */
 int add_track(const Track *track, size_t index, int mode);
 int flash_default_tracks(void);
 const Tracks * get_tracks();
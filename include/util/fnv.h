@@ -0,0 +1,45 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FNV_H_
+#define _FNV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 32 bit FNV-1a hash.  Cheap and good enough to tell if a block of
+ * memory changed.  Not for anything that needs to resist tampering.
+ */
+
+#define FNV1A_32_INIT	0x811c9dc5u
+
+/**
+ * Hashes a block of memory.
+ * @param hash FNV1A_32_INIT to start, or the result of a previous call to
+ * carry on hashing more data.
+ * @param data The data.
+ * @param len The length of data in bytes.
+ * @return The updated hash.
+ */
+uint32_t fnv1a_32(uint32_t hash, const void *data, size_t len);
+
+#endif /* _FNV_H_ */
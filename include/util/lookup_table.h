@@ -0,0 +1,67 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOOKUP_TABLE_H_
+#define _LOOKUP_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A sorted index over a constant table of named entries, giving
+ * O(log n) lookup by name.  The table itself is left untouched, which
+ * keeps it in flash and in its original (help display) order.  Each
+ * entry must be a struct whose first member is its `const char *`
+ * name.
+ */
+
+#define LOOKUP_TABLE_MAX_ENTRIES	255
+
+struct lookup_table {
+        const char *entries;
+        size_t entry_size;
+        size_t count;
+        uint8_t *index;
+};
+
+/**
+ * Builds the sorted index for a table.
+ * @param lt The lookup_table to initialize.
+ * @param entries The table of entries.
+ * @param entry_size sizeof one entry.
+ * @param count Number of entries, not including any NULL terminator.
+ * Only the first #LOOKUP_TABLE_MAX_ENTRIES are indexed; an error is
+ * logged if there are more.
+ * @param index Storage for the index.  Must hold count entries.
+ * @return The number of entries indexed.
+ */
+size_t lookup_table_init(struct lookup_table *lt, const void *entries,
+                         const size_t entry_size, size_t count,
+                         uint8_t *index);
+
+/**
+ * Finds an entry by name.
+ * @return Pointer to the entry, or NULL if there is no such entry.
+ */
+const void* lookup_table_find(const struct lookup_table *lt,
+                              const char *name);
+
+#endif /* _LOOKUP_TABLE_H_ */
@@ -18,19 +18,53 @@
 
 #include "api.h"
 #include "constants.h"
+#include "jsmn_stream.h"
 #include "printk.h"
 #include "mod_string.h"
+#include "lookup_table.h"
+
+#include <stdbool.h>
+#include <stdint.h>
 
 #define JSON_TOKENS 200
 
+/* Longest message and payload member names we track when streaming */
+#define STREAM_NAME_LENGTH 24
+
 static jsmn_parser g_jsonParser;
 static jsmntok_t g_json_tok[JSON_TOKENS];
 
 const api_t apis[] = SYSTEM_APIS;
 
+static const api_stream_t stream_apis[] = SYSTEM_STREAM_APIS;
+
+static struct {
+    struct jsmn_stream_parser parser;
+    Serial *serial;
+    const api_stream_t *api;
+    char name[STREAM_NAME_LENGTH];
+    char member[STREAM_NAME_LENGTH];
+    int index;
+    int result;
+    jsmnerr_t status;
+} g_stream;
+
+/* Don't count the NULL_API terminator */
+#define API_COUNT (sizeof(apis) / sizeof(apis[0]) - 1)
+
+static uint8_t g_api_index[API_COUNT];
+static struct lookup_table g_api_table;
+
 void initApi()
 {
     jsmn_init(&g_jsonParser);
+    lookup_table_init(&g_api_table, apis, sizeof(api_t), API_COUNT,
+                      g_api_index);
+}
+
+const api_t* find_api(const char *name)
+{
+    return (const api_t *) lookup_table_find(&g_api_table, name);
 }
 
 static void putQuotedStr(const Serial *serial, const char *str)
@@ -112,6 +146,13 @@ void json_float(Serial *serial, const char *name, float value, int precision, in
     putCommaIfNecessary(serial, more);
 }
 
+void json_double(Serial *serial, const char *name, double value, int precision, int more)
+{
+    putKeyAndColon(serial, name);
+    put_double(serial, value, precision);
+    putCommaIfNecessary(serial, more);
+}
+
 void json_objStartString(Serial *serial, const char *label)
 {
     putKeyAndColon(serial, label);
@@ -163,6 +204,12 @@ void json_arrayElementFloat(Serial *serial, float value, int precision, int more
     putCommaIfNecessary(serial, more);
 }
 
+void json_arrayElementDouble(Serial *serial, double value, int precision, int more)
+{
+    put_double(serial, value, precision);
+    putCommaIfNecessary(serial, more);
+}
+
 void json_arrayEnd(Serial *serial, int more)
 {
     serial->put_c(']');
@@ -181,18 +228,13 @@ void json_sendResult(Serial *serial, const char *messageName, int resultCode)
 static int dispatch_api(Serial *serial, const char * apiMsgName, const jsmntok_t *apiPayload)
 {
 
-    const api_t * api = apis;
-    int res = API_ERROR_UNSPECIFIED;
-    while (api->cmd != NULL) {
-        if (strcmp(api->cmd, apiMsgName) == 0) {
-            res = api->func(serial, apiPayload);
-            if (res != API_SUCCESS_NO_RETURN)
-                json_sendResult(serial, apiMsgName, res);
-            break;
-        }
-        api++;
-    }
-    if (NULL == api->cmd) {
+    const api_t * api = find_api(apiMsgName);
+    int res;
+    if (api) {
+        res = api->func(serial, apiPayload);
+        if (res != API_SUCCESS_NO_RETURN)
+            json_sendResult(serial, apiMsgName, res);
+    } else {
         res = API_ERROR_UNKNOWN_MSG;
         json_sendResult(serial, apiMsgName, res);
     }
@@ -230,3 +272,190 @@ int process_api(Serial *serial, char *buffer, size_t bufferSize)
         return API_ERROR_MALFORMED;
     }
 }
+
+static const api_stream_t* find_stream_api(const char *name)
+{
+    for (const api_stream_t *api = stream_apis; api->cmd; ++api) {
+        if (strcmp(api->cmd, name) == 0)
+            return api;
+    }
+    return NULL;
+}
+
+static int stream_value(const char *member, int index, const jsmntok_t *json,
+                        bool more)
+{
+    if (g_stream.result != API_SUCCESS)
+        return g_stream.result;
+
+    g_stream.result = g_stream.api->value(g_stream.serial, member, index,
+                                          json, more);
+    return g_stream.result;
+}
+
+/* Turns a streamed value into a token tree for the handler */
+static void stream_token(jsmntype_t type, char *data, size_t len, bool more)
+{
+    /* Like process_api.  Handlers scan for the zeroed token at the end */
+    memset(g_json_tok, 0, sizeof(g_json_tok));
+
+    if (JSMN_OBJECT == type || JSMN_ARRAY == type) {
+        jsmn_init(&g_jsonParser);
+        if (JSMN_SUCCESS != jsmn_parse(&g_jsonParser, data, g_json_tok,
+                                       JSON_TOKENS)) {
+            g_stream.result = API_ERROR_MALFORMED;
+            return;
+        }
+    } else {
+        g_json_tok[0].type = type;
+        g_json_tok[0].data = data;
+        g_json_tok[0].start = 0;
+        g_json_tok[0].end = len;
+        g_json_tok[0].size = 0;
+    }
+
+    stream_value(g_stream.member, g_stream.index, g_json_tok, more);
+}
+
+/*
+ * The message is {"name": {"member": value, "array": [element, ...]}}.
+ * Depth 1 is the message, depth 2 the payload and depth 3 a member array.
+ * Member objects and array elements are captured whole.
+ */
+static bool stream_event(struct jsmn_stream_parser *p,
+                         jsmn_stream_event_t event, jsmntype_t type,
+                         char *data, size_t len, void *ctx)
+{
+    switch (event) {
+    case JSMN_STREAM_OBJECT_START:
+        return p->depth > 2;
+    case JSMN_STREAM_ARRAY_START:
+        if (p->depth > 3)
+            return true;
+        if (3 == p->depth)
+            g_stream.index = 0;
+        break;
+    case JSMN_STREAM_KEY:
+        if (1 == p->depth) {
+            if (g_stream.name[0]) {
+                g_stream.result = API_ERROR_MALFORMED;
+                break;
+            }
+            strncpy(g_stream.name, data, STREAM_NAME_LENGTH - 1);
+            g_stream.api = find_stream_api(g_stream.name);
+            if (!g_stream.api) {
+                g_stream.result = API_ERROR_UNKNOWN_MSG;
+                break;
+            }
+            if (g_stream.api->begin)
+                g_stream.api->begin(g_stream.serial);
+        } else if (2 == p->depth) {
+            strncpy(g_stream.member, data, STREAM_NAME_LENGTH - 1);
+            g_stream.index = -1;
+        }
+        break;
+    case JSMN_STREAM_VALUE:
+    case JSMN_STREAM_VALUE_PART:
+        if (p->depth < 2 || !g_stream.api || g_stream.result != API_SUCCESS)
+            break;
+        stream_token(type, data, len, JSMN_STREAM_VALUE_PART == event);
+        if (3 == p->depth && JSMN_STREAM_VALUE == event)
+            ++g_stream.index;
+        break;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+void api_stream_begin(Serial *serial)
+{
+    memset(g_stream.name, 0, sizeof(g_stream.name));
+    memset(g_stream.member, 0, sizeof(g_stream.member));
+    g_stream.serial = serial;
+    g_stream.api = NULL;
+    g_stream.index = -1;
+    g_stream.result = API_SUCCESS;
+    g_stream.status = JSMN_ERROR_PART;
+    jsmn_stream_init(&g_stream.parser, stream_event, NULL);
+}
+
+bool api_stream_feed(const char *data, size_t len)
+{
+    if (g_stream.status == JSMN_ERROR_PART)
+        g_stream.status = jsmn_stream_parse(&g_stream.parser, data, len);
+
+    return g_stream.status != JSMN_ERROR_PART;
+}
+
+int api_stream_end(void)
+{
+    Serial *serial = g_stream.serial;
+    int res = g_stream.result;
+
+    if (g_stream.status != JSMN_SUCCESS) {
+        pr_warning_int_msg("API Error: ", g_stream.status);
+        if (API_SUCCESS == res)
+            res = API_ERROR_MALFORMED;
+    }
+
+    if (g_stream.api)
+        res = g_stream.api->end(serial, res);
+
+    /* Like process_api, no reply if we never found out what it was */
+    if (!g_stream.name[0])
+        return API_ERROR_MALFORMED;
+
+    if (res != API_SUCCESS_NO_RETURN)
+        json_sendResult(serial, g_stream.name, res);
+    put_crlf(serial);
+    return res;
+}
+
+/* Skips over a token and everything below it */
+static const jsmntok_t* skip_token(const jsmntok_t *tok)
+{
+    int children = tok->size;
+    for (++tok; children > 0; --children)
+        tok = skip_token(tok);
+    return tok;
+}
+
+int api_stream_payload(Serial *serial, const char *name,
+                       const jsmntok_t *payload)
+{
+    const api_stream_t *api = find_stream_api(name);
+    if (!api)
+        return API_ERROR_UNKNOWN_MSG;
+
+    g_stream.serial = serial;
+    g_stream.api = api;
+    g_stream.result = API_SUCCESS;
+    if (api->begin)
+        api->begin(serial);
+
+    if (payload->type != JSMN_OBJECT)
+        return api->end(serial, API_ERROR_MALFORMED);
+
+    const jsmntok_t *tok = payload + 1;
+    for (int i = 0; i < payload->size; i += 2) {
+        const jsmntok_t *member = tok;
+        const jsmntok_t *value = tok + 1;
+        tok = skip_token(value);
+
+        jsmn_trimData(member);
+        if (value->type != JSMN_ARRAY) {
+            stream_value(member->data, -1, value, false);
+            continue;
+        }
+
+        const jsmntok_t *element = value + 1;
+        for (int index = 0; index < value->size; ++index) {
+            stream_value(member->data, index, element, false);
+            element = skip_token(element);
+        }
+    }
+
+    return api->end(serial, g_stream.result);
+}
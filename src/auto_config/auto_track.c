@@ -21,28 +21,99 @@
 #include "loggerConfig.h"
 #include "printk.h"
 #include "tracks.h"
+#include "track_index.h"
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * Most indexed points we look at before giving up and checking every
+ * track.  Small, this runs on the GPS task stack.
+ */
+#define MAX_NEAR_POINTS 32
+
+struct trackMatch {
+    /* Squared distance to the nearest point of the track */
+    float distSq;
+    /* Squared distance to the nearest point other than the start */
+    float sectorDistSq;
+};
+
+static void addPoint(struct trackMatch *m, int point, float dSq)
+{
+    if (dSq < m->distSq)
+        m->distSq = dSq;
+    if (point > 0 && dSq < m->sectorDistSq)
+        m->sectorDistSq = dSq;
+}
+
+/*
+ * Layouts that share a start line are told apart by whichever has a sector
+ * point nearest to us.
+ */
+static int isBetterMatch(const struct trackMatch *a, const struct trackMatch *b)
+{
+    if (fabsf(sqrtf(a->distSq) - sqrtf(b->distSq)) < TRACK_AMBIGUOUS_DIST)
+        return a->sectorDistSq < b->sectorDistSq;
+
+    return a->distSq < b->distSq;
+}
 
 static const Track* findClosestTrack(const Tracks *tracks, const GeoPoint *location)
 {
-    float dist = MAX_DIST_FROM_SF;
-    const Track *best = NULL;
+    const float maxDistSq = (float) MAX_DIST_FROM_SF * MAX_DIST_FROM_SF;
+    /* Everything we compare against is within a kilometer of us */
+    struct gp_projection frame;
+    gp_projection_init(&frame, location);
+    struct track_index_hit hits[MAX_NEAR_POINTS];
+    uint8_t done[(MAX_TRACK_COUNT + 7) / 8] = {0};
+    struct trackMatch best = { maxDistSq, maxDistSq };
+    const Track *bestTrack = NULL;
+
+    if (!track_index_built())
+        track_index_build(tracks);
 
-    for (unsigned i = 0; i < tracks->count; ++i) {
-        const Track *track = &(tracks->tracks[i]);
+    size_t found = track_index_near(location, MAX_DIST_FROM_SF, hits, MAX_NEAR_POINTS);
 
-        // XXX: inaccurate but fast.  Good enough for now.
-        GeoPoint startPoint = getStartPoint(track);
-        float track_distance = distPythag(&startPoint, location);
+    /* Too many to hold.  Look at every point of every track instead */
+    const int linear = found > MAX_NEAR_POINTS;
+    if (linear)
+        found = (tracks->count < MAX_TRACK_COUNT ? tracks->count : MAX_TRACK_COUNT) * SECTOR_COUNT;
+
+    for (size_t i = 0; i < found; ++i) {
+        const unsigned trackIndex = linear ? i / SECTOR_COUNT : hits[i].track;
+        if (done[trackIndex / 8] & (1 << (trackIndex % 8)))
+            continue;
+        done[trackIndex / 8] |= 1 << (trackIndex % 8);
+
+        /* All the points of this track are here or further along */
+        const Track *track = &(tracks->tracks[trackIndex]);
+        struct trackMatch m = { maxDistSq, maxDistSq };
+        for (size_t j = i; j < found; ++j) {
+            const unsigned t = linear ? j / SECTOR_COUNT : hits[j].track;
+            if (t != trackIndex)
+                continue;
+
+            const int point = linear ? j % SECTOR_COUNT : hits[j].point;
+            const GeoPoint *gp = track->allSectors + point;
+            if (isValidPoint(gp))
+                addPoint(&m, point, gp_dist_sq(&frame, gp, location));
+        }
+
+        if (m.distSq >= maxDistSq)
+            continue;
 
-        if (track_distance >= dist)
+        /* Ties go to the track that comes first */
+        const int better = isBetterMatch(&m, &best);
+        const int tie = !better && !isBetterMatch(&best, &m);
+        if (bestTrack && !better && !(tie && track < bestTrack))
             continue;
 
-        // If here then we have a new best.  Set it accordingly
-        dist = track_distance;
-        best = track;
+        best = m;
+        bestTrack = track;
     }
 
-    return best;
+    return bestTrack;
 }
 
 const Track* auto_configure_track(const Track *defaultCfg, const GeoPoint *gp)
@@ -20,9 +20,18 @@
 #include "serial.h"
 #include "constants.h"
 #include "mod_string.h"
+#include "lookup_table.h"
+
+#include <stdint.h>
 
 const cmd_t commands[] = SYSTEM_COMMANDS;
 
+/* Don't count the NULL_COMMAND terminator */
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]) - 1)
+
+static uint8_t g_command_index[COMMAND_COUNT];
+static struct lookup_table g_command_table;
+
 const char cmdPrompt[] = COMMAND_PROMPT;
 const char welcomeMsg[] = WELCOME_MSG;
 static int menuPadding = 0;
@@ -121,18 +130,18 @@ static int execute_command(Serial *serial, char *buffer)
         argv[++argc] = strtok(NULL, " ");
     } while ((argc < 30) && (argv[argc] != NULL));
 
-    const cmd_t * cmd = commands;
+    if (NULL == argv[0])
+        return 0;
 
-    while (cmd->cmd != NULL) {
-        if (!strcmp(argv[0], cmd->cmd)) {
-            cmd->func(serial, argc, argv);
-            put_crlf(serial);
-            break;
-        }
-        cmd++;
-    }
+    const cmd_t * cmd = (const cmd_t *)
+            lookup_table_find(&g_command_table, argv[0]);
 
-    return (NULL != cmd->cmd);
+    if (NULL == cmd)
+        return 0;
+
+    cmd->func(serial, argc, argv);
+    put_crlf(serial);
+    return 1;
 }
 
 int process_command(Serial *serial, char * buffer, size_t bufferSize)
@@ -168,6 +177,8 @@ void put_commandError(Serial *serial, int result)
 
 void init_command(void)
 {
+    lookup_table_init(&g_command_table, commands, sizeof(cmd_t),
+                      COMMAND_COUNT, g_command_index);
     calculateMenuPadding();
 }
 
@@ -9,11 +9,14 @@
 #include "taskUtil.h"
 #include "LED.h"
 
+#include <stdbool.h>
+
 #define min(a,b) ((a)<(b)?(a):(b))
-#define NETWORK_CONNECT_MAX_TRIES 10
 #define MAX_SUBSCRIBER_NUMBER_LENGTH 15
 #define IMEI_NUMBER_LENGTH 16
 
+#define INIT_MAX_ATTEMPTS 3
+
 static cellmodem_status_t g_cellmodem_status = CELLMODEM_STATUS_NOT_INIT;
 static char g_subscriber_number[MAX_SUBSCRIBER_NUMBER_LENGTH];
 static char g_IMEI_number[IMEI_NUMBER_LENGTH];
@@ -23,6 +26,10 @@ static size_t g_bufferLen;
 static uint8_t g_cell_signal_strength;
 
 #define PAUSE_DELAY 500
+#define RETRY_DELAY 1000
+#define GUARD_DELAY 1100
+#define POWER_PRESS_DELAY 2000
+#define POWER_RELEASE_DELAY 3000
 
 #define READ_TIMEOUT 	1000
 #define SHORT_TIMEOUT 	4500
@@ -31,6 +38,76 @@ static uint8_t g_cell_signal_strength;
 
 #define NO_CELL_RESPONSE -99
 
+/* How long the modem may take to ask for the datagram, all told */
+#define SEND_PROMPT_TIMEOUT 500
+/* Most we will read waiting for the prompt */
+#define SEND_PROMPT_MAX_CHARS 64
+#define CTRL_Z 0x1a
+
+/*
+ * The bring-up states, in the order we normally go through them.  Each
+ * state sends its command once it is due and then waits for the answer.
+ */
+typedef enum {
+    CELL_STATE_IDLE = 0,
+    CELL_STATE_CLOSE_ESCAPE,
+    CELL_STATE_CLOSE,
+    CELL_STATE_POWER_CHECK,
+    CELL_STATE_POWER_PRESS,
+    CELL_STATE_POWER_RELEASE,
+    CELL_STATE_RESET,
+    CELL_STATE_ECHO_OFF,
+    CELL_STATE_SHUT,
+    CELL_STATE_REGISTRATION,
+    CELL_STATE_SIGNAL,
+    CELL_STATE_NUMBER,
+    CELL_STATE_IMEI,
+    CELL_STATE_DATA_READY,
+    CELL_STATE_MUX,
+    CELL_STATE_MODE,
+    CELL_STATE_APN,
+    CELL_STATE_BRING_UP,
+    CELL_STATE_IP,
+    CELL_STATE_DNS,
+    CELL_STATE_CONNECT,
+    CELL_STATE_CONNECTED,
+    CELL_STATE_FAILED
+} cell_state_t;
+
+typedef enum {
+    CELL_RSP_PENDING = 0,
+    /* The answer we were waiting for */
+    CELL_RSP_OK,
+    /* Some other line.  It is in g_cellBuffer */
+    CELL_RSP_LINE,
+    CELL_RSP_ERROR,
+    CELL_RSP_TIMEOUT
+} cell_rsp_t;
+
+static struct {
+    cell_state_t state;
+    cell_fail_t failure;
+    /* Bring-up attempts that failed so far */
+    size_t attempts;
+    /* Tries of the current command, and how many of them went unanswered */
+    size_t tries;
+    size_t silent_tries;
+    /* State specific: registered, attached, power down first */
+    bool flag;
+    /* Has the command of the current state gone out */
+    bool sent;
+    /* Before sending: hold off until then.  After: the response timeout */
+    size_t since;
+    size_t wait_ms;
+    size_t rx_count;
+    const char *apnHost;
+    const char *apnUser;
+    const char *apnPass;
+    const char *host;
+    const char *port;
+    int udpMode;
+} g_cell;
+
 cellmodem_status_t cellmodem_get_status( void )
 {
     return g_cellmodem_status;
@@ -109,256 +186,531 @@ static int sendCommandWait(Serial *serial, const char *cmd, const char *expected
     return res;
 }
 
-static int sendCommand(Serial *serial, const char * cmd, const char *expectedRsp)
+void putsCell(Serial *serial, const char *data)
 {
-    return sendCommandWait(serial, cmd, expectedRsp, READ_TIMEOUT);
+    LED_toggle(0);
+    serial->put_s(data);
+    pr_debug_str_msg("cellWrite: ", data);
 }
 
-static int sendCommandOK(Serial *serial, const char * cmd)
+void putUintCell(Serial *serial, uint32_t num)
 {
-    return sendCommand(serial, cmd, "OK");
+    char buf[10];
+    modp_uitoa10(num,buf);
+    putsCell(serial, buf);
 }
 
-static int sendCommandRetry(Serial *serial, const char * cmd, const char * expectedRsp, size_t maxAttempts, size_t maxNoResponseAttempts)
+void putIntCell(Serial *serial, int num)
 {
-    int result = 0;
-    size_t attempts = 0;
+    char buf[10];
+    modp_itoa10(num,buf);
+    putsCell(serial, buf);
+}
 
-    while (attempts++ < maxAttempts) {
-        result = sendCommand(serial, cmd, expectedRsp);
-        if (result == 1) break;
-        if (result == NO_CELL_RESPONSE && attempts > maxNoResponseAttempts) break;
-        delayMs(1000);
-    }
-    return result;
-}
-
-static int read_subscriber_number(Serial *serial)
-{
-    int res = sendCommand(serial, "AT+CNUM\r", "+CNUM:");
-    if (res != NO_CELL_RESPONSE) {
-        char *num_start = strstr(g_cellBuffer, ",\"");
-        if (num_start) {
-            num_start += 2;
-            char *num_end = strstr(num_start, "\"");
-            if (num_end) {
-                *num_end = '\0';
-                strncpy(g_subscriber_number, num_start, MAX_SUBSCRIBER_NUMBER_LENGTH);
-                pr_debug_str_msg("Cell: phone number: ", num_start);
-            }
-        }
-    }
-    return res;
+void putFloatCell(Serial *serial, float num, int precision)
+{
+    char buf[20];
+    modp_ftoa(num, buf, precision);
+    putsCell(serial, buf);
 }
 
-static int getSignalStrength(Serial *serial)
+void putQuotedStringCell(Serial *serial, char *s)
 {
-    int res = sendCommand(serial, "AT+CSQ\r", "+CSQ:");
-    if (res != NO_CELL_RESPONSE && strlen(g_cellBuffer) > 6) {
-        char *next_start = NULL;
-        char *rssi_string = strtok_r(g_cellBuffer + 6, ",", &next_start);
-        if (rssi_string != NULL) {
-            g_cell_signal_strength = modp_atoi(rssi_string);
-            pr_debug_int_msg("Cell: signal strength: ", g_cell_signal_strength);
+    putsCell(serial, "\"");
+    putsCell(serial, s);
+    putsCell(serial, "\"");
+}
+
+const char * cell_read_line(Serial *serial)
+{
+    char c;
+    while (serial->get_c_wait(&c, 0)) {
+        const bool full = g_cell.rx_count >= g_bufferLen - 1;
+        if (c != '\r' && c != '\n' && !full) {
+            g_cellBuffer[g_cell.rx_count++] = c;
+            continue;
+        }
+
+        g_cellBuffer[g_cell.rx_count] = '\0';
+        const size_t len = g_cell.rx_count;
+        g_cell.rx_count = 0;
+        if (len) {
+            pr_debug_str_msg("Cell: read ", g_cellBuffer);
+            return g_cellBuffer;
         }
     }
-    return res;
+    return NULL;
 }
 
-static int read_IMEI(Serial *serial)
+/* True if line starts with one of the '|' separated prefixes */
+static bool matchesResponse(const char *line, const char *prefixes)
 {
-    int res = sendCommand(serial, "AT+GSN\r", "");
-    if (res != NO_CELL_RESPONSE && strlen(g_cellBuffer) == 15) {
-        strncpy(g_IMEI_number, g_cellBuffer, IMEI_NUMBER_LENGTH);
-        pr_debug_str_msg("Cell: IMEI: ", g_IMEI_number);
+    while (*prefixes) {
+        const char *end = strchr(prefixes, '|');
+        const size_t len = end ? (size_t) (end - prefixes) : strlen(prefixes);
+        if (strncmp(line, prefixes, len) == 0)
+            return true;
+        if (!end)
+            break;
+        prefixes = end + 1;
     }
-    return res;
+    return false;
 }
 
-static int isNetworkConnected(Serial *serial, size_t maxRetries, size_t maxNoResponseRetries)
+static void enterState(cell_state_t state, size_t holdoff_ms)
 {
-    flushModem(serial);
-    return sendCommandRetry(serial, "AT+CREG?\r", "+CREG: 0,1|+CREG: 0,5", maxRetries, maxNoResponseRetries);
+    g_cell.state = state;
+    g_cell.tries = 0;
+    g_cell.silent_tries = 0;
+    g_cell.sent = false;
+    g_cell.since = getCurrentTicks();
+    g_cell.wait_ms = holdoff_ms;
+}
+
+/* Moves on to the next state.  The sim900 needs a pause between commands */
+static void nextState(cell_state_t state)
+{
+    enterState(state, PAUSE_DELAY);
 }
 
-static int isDataReady(Serial *serial, size_t maxRetries, size_t maxNoResponseRetries)
+/* True once the command of the current state is due to go out */
+static bool sendDue(Serial *serial)
 {
+    if (g_cell.sent || !isTimeoutMs(g_cell.since, g_cell.wait_ms))
+        return false;
+
     flushModem(serial);
-    return sendCommandRetry(serial, "AT+CGATT?\r", "+CGATT: 1", maxRetries, maxNoResponseRetries);
+    g_cell.rx_count = 0;
+    return true;
 }
 
-static int getIpAddress(Serial *serial)
+static void commandSent(size_t timeout_ms)
 {
-    putsCell(serial, "AT+CIFSR\r");
-    readModemWait(serial, MEDIUM_TIMEOUT);
-    readModemWait(serial, READ_TIMEOUT);
-    if (strlen(g_cellBuffer) == 0) return -1;
-    if (strncmp(g_cellBuffer, "ERROR", 5) == 0) return -2;
-    delayMs(PAUSE_DELAY);
-    return 0;
+    g_cell.sent = true;
+    g_cell.since = getCurrentTicks();
+    g_cell.wait_ms = timeout_ms;
 }
 
-void putsCell(Serial *serial, const char *data)
+static cell_rsp_t pollResponse(Serial *serial, const char *expectedRsp)
 {
-    LED_toggle(0);
-    serial->put_s(data);
-    pr_debug_str_msg("cellWrite: ", data);
+    const char *line = cell_read_line(serial);
+    if (!line)
+        return isTimeoutMs(g_cell.since, g_cell.wait_ms) ?
+               CELL_RSP_TIMEOUT : CELL_RSP_PENDING;
+
+    if (matchesResponse(line, "ERROR|+CME ERROR|CONNECT FAIL|FAIL|CLOSED"))
+        return CELL_RSP_ERROR;
+    if (!expectedRsp || matchesResponse(line, expectedRsp))
+        return CELL_RSP_OK;
+    return CELL_RSP_LINE;
 }
 
-void putUintCell(Serial *serial, uint32_t num)
+/**
+ * Sends the command of the current state once it is due, then waits for
+ * its answer.  Never blocks.
+ * @param expectedRsp '|' separated prefixes of the answer, NULL for any line.
+ */
+static cell_rsp_t command(Serial *serial, const char *cmd, const char *expectedRsp, size_t timeout_ms)
 {
-    char buf[10];
-    modp_uitoa10(num,buf);
-    putsCell(serial, buf);
+    if (sendDue(serial)) {
+        putsCell(serial, cmd);
+        commandSent(timeout_ms);
+        return CELL_RSP_PENDING;
+    }
+    return g_cell.sent ? pollResponse(serial, expectedRsp) : CELL_RSP_PENDING;
 }
 
-void putIntCell(Serial *serial, int num)
+static void fail(cell_fail_t failure)
 {
-    char buf[10];
-    modp_itoa10(num,buf);
-    putsCell(serial, buf);
+    g_cell.failure = failure;
+    enterState(CELL_STATE_FAILED, 0);
 }
 
-void putFloatCell(Serial *serial, float num, int precision)
+/* Start over from the top, power cycling the modem this time */
+static void failAttempt(void)
 {
-    char buf[20];
-    modp_ftoa(num, buf, precision);
-    putsCell(serial, buf);
+    if (++g_cell.attempts >= INIT_MAX_ATTEMPTS) {
+        g_cellmodem_status = CELLMODEM_STATUS_NO_NETWORK;
+        fail(CELL_FAIL_REGISTRATION);
+        return;
+    }
+    pr_debug("SIM900: power cycling\r\n");
+    enterState(CELL_STATE_CLOSE_ESCAPE, GUARD_DELAY);
 }
 
-void putQuotedStringCell(Serial *serial, char *s)
+/* Retries the command of the current state, or gives up on this attempt */
+static void retryCommand(cell_rsp_t rsp, size_t maxTries, size_t maxSilentTries)
 {
-    putsCell(serial, "\"");
-    putsCell(serial, s);
-    putsCell(serial, "\"");
+    const size_t tries = g_cell.tries + 1;
+    const size_t silent = g_cell.silent_tries + (CELL_RSP_TIMEOUT == rsp);
+    if (tries >= maxTries || silent >= maxSilentTries) {
+        failAttempt();
+        return;
+    }
+    enterState(g_cell.state, RETRY_DELAY);
+    g_cell.tries = tries;
+    g_cell.silent_tries = silent;
 }
 
-int configureNet(Serial *serial, const char *apnHost, const char *apnUser, const char *apnPass)
+static void readSubscriberNumber(char *line)
 {
-    if (!sendCommandOK(serial, "AT+CIPMUX=0\r")) return -1;  //TODO enable for SIM900
-    if (!sendCommandOK(serial, "AT+CIPMODE=1\r")) return -1;
+    char *num_start = strstr(line, ",\"");
+    if (num_start) {
+        num_start += 2;
+        char *num_end = strstr(num_start, "\"");
+        if (num_end) {
+            *num_end = '\0';
+            strncpy(g_subscriber_number, num_start, MAX_SUBSCRIBER_NUMBER_LENGTH);
+            pr_debug_str_msg("Cell: phone number: ", num_start);
+        }
+    }
+}
 
-    //if (!sendCommand("AT+CIPCCFG=3,2,256,1\r")) return -1;
+static void readSignalStrength(char *line)
+{
+    if (strlen(line) > 6) {
+        char *next_start = NULL;
+        char *rssi_string = strtok_r(line + 6, ",", &next_start);
+        if (rssi_string != NULL) {
+            g_cell_signal_strength = modp_atoi(rssi_string);
+            pr_debug_int_msg("Cell: signal strength: ", g_cell_signal_strength);
+        }
+    }
+}
 
-    flushModem(serial);
-    putsCell(serial, "AT+CSTT=\"");
-    putsCell(serial, apnHost);
-    putsCell(serial, "\",\"");
-    putsCell(serial, apnUser);
-    putsCell(serial, "\",\"");
-    putsCell(serial, apnPass);
-    putsCell(serial, "\"\r");
-    if (!waitCommandResponse(serial, "OK", READ_TIMEOUT)) {
-        return -2;
+static void readIMEI(const char *line)
+{
+    if (strlen(line) == 15) {
+        strncpy(g_IMEI_number, line, IMEI_NUMBER_LENGTH);
+        pr_debug_str_msg("Cell: IMEI: ", g_IMEI_number);
     }
+}
 
-//	if (!sendCommand("AT+CIPHEAD=1\r")) return -2;
+/* Hangs up any connection left over from before */
+static void stepClose(Serial *serial)
+{
+    switch (g_cell.state) {
+    case CELL_STATE_CLOSE_ESCAPE:
+        if (sendDue(serial)) {
+            putsCell(serial, "+++");
+            enterState(CELL_STATE_CLOSE, GUARD_DELAY);
+        }
+        break;
+    case CELL_STATE_CLOSE:
+    {
+        /* There may well be nothing to close.  Either way we move on */
+        const cell_rsp_t rsp = command(serial, "AT+CIPCLOSE\r", "OK", SHORT_TIMEOUT);
+        if (CELL_RSP_OK == rsp || rsp >= CELL_RSP_ERROR)
+            nextState(g_cell.attempts ? CELL_STATE_POWER_CHECK : CELL_STATE_RESET);
+        break;
+    }
+    default:
+        break;
+    }
+}
 
-    if (sendCommandWait(serial, "AT+CIICR\r", "OK", CONNECT_TIMEOUT) != 1) {
-        return -3;
+static void stepPower(Serial *serial)
+{
+    switch (g_cell.state) {
+    case CELL_STATE_POWER_CHECK: {
+        /* If the modem answers it is on, and the button turns it off */
+        const cell_rsp_t rsp = command(serial, "AT\r", "OK", READ_TIMEOUT);
+        if (rsp == CELL_RSP_PENDING || rsp == CELL_RSP_LINE)
+            break;
+        const bool on = CELL_RSP_OK == rsp;
+        if (on)
+            pr_debug("SIM900: powering down\r\n");
+        enterState(CELL_STATE_POWER_PRESS, 0);
+        g_cell.flag = on;
+        break;
+    }
+    case CELL_STATE_POWER_PRESS:
+        sim900_device_power_button(1);
+        enterState(CELL_STATE_POWER_RELEASE, POWER_PRESS_DELAY);
+        break;
+    case CELL_STATE_POWER_RELEASE: {
+        if (!isTimeoutMs(g_cell.since, g_cell.wait_ms))
+            break;
+        sim900_device_power_button(0);
+        /* If that powered it down, press again to bring it back up */
+        const bool again = g_cell.flag;
+        g_cell.flag = false;
+        enterState(again ? CELL_STATE_POWER_PRESS : CELL_STATE_RESET,
+                   POWER_RELEASE_DELAY);
+        break;
     }
+    default:
+        break;
+    }
+}
 
-    if (getIpAddress(serial) !=0 ) {
-        return -4;
+/* Reset, registration and GPRS attach.  What initCellModem used to do */
+static void stepProvision(Serial *serial)
+{
+    cell_rsp_t rsp;
+
+    switch (g_cell.state) {
+    case CELL_STATE_RESET:
+        rsp = command(serial, "ATZ\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_OK == rsp)
+            nextState(CELL_STATE_ECHO_OFF);
+        else if (rsp >= CELL_RSP_ERROR)
+            retryCommand(rsp, 2, 2);
+        break;
+    case CELL_STATE_ECHO_OFF:
+        rsp = command(serial, "ATE0\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_OK == rsp)
+            nextState(CELL_STATE_SHUT);
+        else if (rsp >= CELL_RSP_ERROR)
+            retryCommand(rsp, 2, 2);
+        break;
+    case CELL_STATE_SHUT:
+        /* Nothing to shut is fine too */
+        rsp = command(serial, "AT+CIPSHUT\r", "SHUT OK", READ_TIMEOUT);
+        if (CELL_RSP_OK == rsp || rsp >= CELL_RSP_ERROR) {
+            nextState(CELL_STATE_REGISTRATION);
+            g_cell.flag = false;
+        }
+        break;
+    case CELL_STATE_REGISTRATION:
+        rsp = command(serial, "AT+CREG?\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_LINE == rsp && matchesResponse(g_cellBuffer, "+CREG:"))
+            g_cell.flag = matchesResponse(g_cellBuffer, "+CREG: 0,1|+CREG: 0,5");
+        else if (CELL_RSP_OK == rsp && g_cell.flag)
+            nextState(CELL_STATE_SIGNAL);
+        else if (CELL_RSP_OK == rsp || rsp >= CELL_RSP_ERROR)
+            retryCommand(rsp, 60, 3);
+        break;
+    case CELL_STATE_SIGNAL:
+        rsp = command(serial, "AT+CSQ\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_LINE == rsp && matchesResponse(g_cellBuffer, "+CSQ:"))
+            readSignalStrength(g_cellBuffer);
+        else if (rsp != CELL_RSP_PENDING && rsp != CELL_RSP_LINE)
+            nextState(CELL_STATE_NUMBER);
+        break;
+    case CELL_STATE_NUMBER:
+        rsp = command(serial, "AT+CNUM\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_LINE == rsp && matchesResponse(g_cellBuffer, "+CNUM:"))
+            readSubscriberNumber(g_cellBuffer);
+        else if (rsp != CELL_RSP_PENDING && rsp != CELL_RSP_LINE)
+            nextState(CELL_STATE_IMEI);
+        break;
+    case CELL_STATE_IMEI:
+        rsp = command(serial, "AT+GSN\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_LINE == rsp) {
+            readIMEI(g_cellBuffer);
+        } else if (rsp != CELL_RSP_PENDING) {
+            nextState(CELL_STATE_DATA_READY);
+            g_cell.flag = false;
+        }
+        break;
+    case CELL_STATE_DATA_READY:
+        rsp = command(serial, "AT+CGATT?\r", "OK", READ_TIMEOUT);
+        if (CELL_RSP_LINE == rsp && matchesResponse(g_cellBuffer, "+CGATT:"))
+            g_cell.flag = matchesResponse(g_cellBuffer, "+CGATT: 1");
+        else if (CELL_RSP_OK == rsp && g_cell.flag) {
+            g_cellmodem_status = CELLMODEM_STATUS_PROVISIONED;
+            nextState(CELL_STATE_MUX);
+        } else if (CELL_RSP_OK == rsp || rsp >= CELL_RSP_ERROR) {
+            retryCommand(rsp, 30, 2);
+        }
+        break;
+    default:
+        break;
     }
+}
 
-    // Configure DNS to use Google DNS
-    const char dnsCmd[] = "AT+CDNSCFG=\"8.8.8.8\",\"8.8.4.4\"\r";
-    if (sendCommandWait(serial, dnsCmd, "OK", READ_TIMEOUT) != 1) {
-        return -5;
+/* APN and IP setup.  What configureNet used to do.  No retries here */
+static void stepConfigure(Serial *serial)
+{
+    cell_rsp_t rsp = CELL_RSP_PENDING;
+    cell_state_t next = CELL_STATE_FAILED;
+
+    switch (g_cell.state) {
+    case CELL_STATE_MUX:
+        rsp = command(serial, "AT+CIPMUX=0\r", "OK", READ_TIMEOUT);
+        next = CELL_STATE_MODE;
+        break;
+    case CELL_STATE_MODE:
+        /* Datagrams are sent one at a time, so no transparent mode for UDP */
+        rsp = command(serial, g_cell.udpMode ? "AT+CIPMODE=0\r" : "AT+CIPMODE=1\r",
+                      "OK", READ_TIMEOUT);
+        next = CELL_STATE_APN;
+        break;
+    case CELL_STATE_APN:
+        if (sendDue(serial)) {
+            putsCell(serial, "AT+CSTT=\"");
+            putsCell(serial, g_cell.apnHost);
+            putsCell(serial, "\",\"");
+            putsCell(serial, g_cell.apnUser);
+            putsCell(serial, "\",\"");
+            putsCell(serial, g_cell.apnPass);
+            putsCell(serial, "\"\r");
+            commandSent(READ_TIMEOUT);
+        } else if (g_cell.sent) {
+            rsp = pollResponse(serial, "OK");
+        }
+        next = CELL_STATE_BRING_UP;
+        break;
+    case CELL_STATE_BRING_UP:
+        rsp = command(serial, "AT+CIICR\r", "OK", CONNECT_TIMEOUT);
+        next = CELL_STATE_IP;
+        break;
+    case CELL_STATE_IP:
+        /* The answer is our address, not OK */
+        rsp = command(serial, "AT+CIFSR\r", NULL, MEDIUM_TIMEOUT);
+        next = CELL_STATE_DNS;
+        break;
+    case CELL_STATE_DNS:
+        // Configure DNS to use Google DNS
+        rsp = command(serial, "AT+CDNSCFG=\"8.8.8.8\",\"8.8.4.4\"\r", "OK", READ_TIMEOUT);
+        next = CELL_STATE_CONNECT;
+        break;
+    default:
+        break;
     }
 
-    return 0;
+    if (CELL_RSP_OK == rsp) {
+        if (CELL_STATE_CONNECT == next)
+            pr_info("cell: network configured\r\n");
+        nextState(next);
+    } else if (rsp >= CELL_RSP_ERROR) {
+        fail(CELL_FAIL_NET_CONFIG);
+    }
 }
 
-
-int connectNet(Serial *serial, const char *host, const char *port, int udpMode)
+/* Opens the connection to the server.  What connectNet used to do */
+static void stepConnect(Serial *serial)
 {
-    flushModem(serial);
-    strcpy(g_cellBuffer, "AT+CIPSTART=\"");
-    strcat(g_cellBuffer, udpMode ? "UDP" : "TCP");
-    strcat(g_cellBuffer, "\",\"");
-    strcat(g_cellBuffer, host);
-    strcat(g_cellBuffer, "\",\"");
-    strcat(g_cellBuffer, port);
-    strcat(g_cellBuffer, "\"\r");
-    putsCell(serial, g_cellBuffer);
-    int attempt = 0;
-    while (attempt++ < 5) {
-        readModemWait(serial, SHORT_TIMEOUT);
-        if (strncmp(g_cellBuffer,"CONNECT",7) == 0) return 0;
-        if (strncmp(g_cellBuffer,"ERROR",5) == 0) return -1;
-        if (strncmp(g_cellBuffer,"FAIL",4) == 0) return -1;
-        if (strncmp(g_cellBuffer,"CLOSED",6) == 0) return -1;
+    if (sendDue(serial)) {
+        putsCell(serial, "AT+CIPSTART=\"");
+        putsCell(serial, g_cell.udpMode ? "UDP" : "TCP");
+        putsCell(serial, "\",\"");
+        putsCell(serial, g_cell.host);
+        putsCell(serial, "\",\"");
+        putsCell(serial, g_cell.port);
+        putsCell(serial, "\"\r");
+        commandSent(5 * SHORT_TIMEOUT);
+        return;
+    }
+
+    if (!g_cell.sent)
+        return;
+
+    /* OK comes first, CONNECT once the server answers */
+    const cell_rsp_t rsp = pollResponse(serial, "CONNECT");
+    if (CELL_RSP_OK == rsp) {
+        pr_info("cell: server connected\r\n");
+        enterState(CELL_STATE_CONNECTED, 0);
+    } else if (rsp >= CELL_RSP_ERROR) {
+        fail(CELL_FAIL_CONNECT);
     }
-    return -1;
 }
 
-int closeNet(Serial *serial)
+void cell_modem_start(const char *apnHost, const char *apnUser, const char *apnPass,
+                      const char *host, const char *port, int udpMode)
 {
-    delayMs(1100);
-    putsCell(serial, "+++");
-    delayMs(1100);
-    return sendCommandWait(serial, "AT+CIPCLOSE\r", "OK", SHORT_TIMEOUT);
+    g_cell.apnHost = apnHost;
+    g_cell.apnUser = apnUser;
+    g_cell.apnPass = apnPass;
+    g_cell.host = host;
+    g_cell.port = port;
+    g_cell.udpMode = udpMode;
+    g_cell.attempts = 0;
+    g_cell.failure = CELL_FAIL_NONE;
+    g_cell.flag = false;
+    g_cell.rx_count = 0;
+    g_cellmodem_status = CELLMODEM_STATUS_NOT_INIT;
+
+    /* Whatever it was doing before, hang up first */
+    enterState(CELL_STATE_CLOSE_ESCAPE, GUARD_DELAY);
 }
 
-const char * readsCell(Serial *serial, size_t timeout)
+void cell_modem_stop(void)
 {
-    readModemWait(serial, timeout);
-    return g_cellBuffer;
+    enterState(CELL_STATE_IDLE, 0);
 }
 
-int isNetConnectionErrorOrClosed()
+cell_step_t cell_modem_step(Serial *serial)
 {
-    if (strncmp(g_cellBuffer,"CLOSED",6) == 0) return 1;
-    if (strncmp(g_cellBuffer,"ERROR", 5) == 0) return 1;
-    return 0;
-}
+    switch (g_cell.state) {
+    case CELL_STATE_IDLE:
+    case CELL_STATE_FAILED:
+        return CELL_STEP_FAILED;
+    case CELL_STATE_CONNECTED:
+        return CELL_STEP_CONNECTED;
+    case CELL_STATE_CLOSE_ESCAPE:
+    case CELL_STATE_CLOSE:
+        stepClose(serial);
+        break;
+    case CELL_STATE_POWER_CHECK:
+    case CELL_STATE_POWER_PRESS:
+    case CELL_STATE_POWER_RELEASE:
+        stepPower(serial);
+        break;
+    case CELL_STATE_CONNECT:
+        stepConnect(serial);
+        break;
+    default:
+        if (g_cell.state < CELL_STATE_MUX)
+            stepProvision(serial);
+        else
+            stepConfigure(serial);
+        break;
+    }
 
+    switch (g_cell.state) {
+    case CELL_STATE_CONNECTED:
+        return CELL_STEP_CONNECTED;
+    case CELL_STATE_FAILED:
+        return CELL_STEP_FAILED;
+    default:
+        return CELL_STEP_PENDING;
+    }
+}
 
-static void powerCycleCellModem(void)
+cell_fail_t cell_modem_failure(void)
 {
-
-    sim900_device_power_button(1);
-    delayMs(2000);
-    sim900_device_power_button(0);
-    delayMs(3000);
+    return g_cell.failure;
 }
 
-int initCellModem(Serial *serial)
+int cell_begin_datagram(Serial *serial)
 {
+    serial->put_s("AT+CIPSEND\r");
+
+    /* Chatter ahead of the prompt does not buy the modem more time */
+    const size_t start = getCurrentTicks();
+    const size_t timeout = msToTicks(SEND_PROMPT_TIMEOUT);
+    char c;
+    for (size_t i = 0; i < SEND_PROMPT_MAX_CHARS; ++i) {
+        const size_t waited = getCurrentTicks() - start;
+        if (waited >= timeout || !serial->get_c_wait(&c, timeout - waited))
+            break;
+        if ('>' == c)
+            return 0;
+    }
 
-    size_t success = 0;
-    size_t attempts = 0;
-    g_cellmodem_status = CELLMODEM_STATUS_NOT_INIT;
+    pr_warning("cell: no send prompt\r\n");
+    return -1;
+}
 
-    while (!success && attempts++ < 3) {
-        closeNet(serial);
+void cell_end_datagram(Serial *serial)
+{
+    serial->put_c(CTRL_Z);
+}
 
-        if (attempts > 1) {
-            pr_debug("SIM900: power cycling\r\n");
-            if (sendCommandOK(serial, "AT\r") == 1 && attempts > 1) {
-                pr_debug("SIM900: powering down\r\n");
-                powerCycleCellModem();
-            }
-            powerCycleCellModem();
-        }
+int closeNet(Serial *serial)
+{
+    cell_modem_stop();
+    delayMs(GUARD_DELAY);
+    putsCell(serial, "+++");
+    delayMs(GUARD_DELAY);
+    return sendCommandWait(serial, "AT+CIPCLOSE\r", "OK", SHORT_TIMEOUT);
+}
 
-        if (sendCommandRetry(serial, "ATZ\r", "OK", 2, 2) != 1) continue;
-        if (sendCommandRetry(serial, "ATE0\r", "OK", 2, 2) != 1) continue;
-        sendCommand(serial, "AT+CIPSHUT\r", "OK");
-        if (isNetworkConnected(serial, 60, 3) != 1) continue;
-        getSignalStrength(serial);
-        read_subscriber_number(serial);
-        read_IMEI(serial);
-        if (isDataReady(serial, 30, 2) != 1) continue;
-        success = 1;
-    }
-    if ( success ) {
-        g_cellmodem_status = CELLMODEM_STATUS_PROVISIONED;
-        return 0;
-    } else {
-        g_cellmodem_status = CELLMODEM_STATUS_NO_NETWORK;
-        return -1;
-    }
+int isNetConnectionErrorOrClosed()
+{
+    if (strncmp(g_cellBuffer,"CLOSED",6) == 0) return 1;
+    if (strncmp(g_cellBuffer,"ERROR", 5) == 0) return 1;
+    return 0;
 }
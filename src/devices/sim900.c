@@ -31,13 +31,30 @@ int32_t sim900_active_time()
     return 0;
 }
 
-static int writeAuthJSON(Serial *serial, const char *deviceId)
+/* Linefeeds we send at slow intervals to wake up the server end */
+#define AUTH_WAKE_COUNT     5
+#define AUTH_WAKE_DELAY     250
+#define AUTH_TIMEOUT        20000
+/* A UDP auth datagram may get lost.  Send it again after this long */
+#define AUTH_RESEND_DELAY   5000
+
+typedef enum {
+    SIM900_INIT_START = 0,
+    SIM900_INIT_MODEM,
+    SIM900_INIT_AUTH_WAKE,
+    SIM900_INIT_AUTH_WAIT
+} sim900_init_state_t;
+
+static struct {
+    sim900_init_state_t state;
+    int udpMode;
+    size_t wakes;
+    size_t since;
+    size_t auth_start;
+} g_init;
+
+static void writeAuthJSON(Serial *serial, const char *deviceId)
 {
-    //send linefeed at slow intervals until we have the auth packet ack from server
-    for (int i = 0; i < 5; i++) {
-        serial->put_s(" ");
-        delayMs(250);
-    }
     json_objStart(serial);
     json_objStartString(serial, "auth");
     json_string(serial, "deviceId", deviceId, 1);
@@ -50,61 +67,124 @@ static int writeAuthJSON(Serial *serial, const char *deviceId)
     serial->put_c('\n');
 
     pr_debug_str_msg("sending auth- deviceId: ", deviceId);
-
-    int attempts = 20;
-    while (attempts-- > 0) {
-        const char * data = readsCell(serial, 1000);
-        if (strncmp(data, "{\"status\":\"ok\"}",15) == 0) return 0;
-    }
-    return -1;
 }
 
 int sim900_disconnect(DeviceConfig *config)
 {
     setCellBuffer(config->buffer, config->length);
     g_connection_status = TELEMETRY_STATUS_IDLE;
+    g_init.state = SIM900_INIT_START;
     pr_info("cell: disconnected\r\n");
     return closeNet(config->serial);
 }
 
+static int modemFailed(void)
+{
+    switch (cell_modem_failure()) {
+    case CELL_FAIL_NET_CONFIG:
+        g_connection_status = TELEMETRY_STATUS_INTERNET_CONFIG_FAILED;
+        pr_error("Failed to configure network\r\n");
+        break;
+    case CELL_FAIL_CONNECT:
+        g_connection_status = TELEMETRY_STATUS_SERVER_CONNECTION_FAILED;
+        pr_error_str_msg("err: server connect ",
+                         getWorkingLoggerConfig()->ConnectivityConfigs.telemetryConfig.telemetryServerHost);
+        break;
+    default:
+        g_connection_status = TELEMETRY_STATUS_CELL_REGISTRATION_FAILED;
+        pr_warning("Failed to init cell connection\r\n");
+        break;
+    }
+    g_init.state = SIM900_INIT_START;
+    return DEVICE_INIT_FAIL;
+}
+
+/*
+ * Brings the connection up one step at a time, so the caller can get on
+ * with other work in between.  Returns DEVICE_INIT_PENDING until it is done.
+ */
 int sim900_init_connection(DeviceConfig *config)
 {
     LoggerConfig *loggerConfig = getWorkingLoggerConfig();
+    CellularConfig *cellCfg = &(loggerConfig->ConnectivityConfigs.cellularConfig);
+    TelemetryConfig *telemetryConfig = &(loggerConfig->ConnectivityConfigs.telemetryConfig);
     setCellBuffer(config->buffer, config->length);
     Serial *serial = config->serial;
 
-    pr_debug("init cell connection\r\n");
-    int initResult = DEVICE_INIT_FAIL;
-    g_active_since = 0;
-    if (0 == initCellModem(serial)) {
-        CellularConfig *cellCfg = &(loggerConfig->ConnectivityConfigs.cellularConfig);
-        TelemetryConfig *telemetryConfig = &(loggerConfig->ConnectivityConfigs.telemetryConfig);
-        if (0 == configureNet(serial, cellCfg->apnHost, cellCfg->apnUser, cellCfg->apnPass)) {
-            pr_info("cell: network configured\r\n");
-            if( 0 == connectNet(serial, telemetryConfig->telemetryServerHost, TELEMETRY_SERVER_PORT, 0)) {
-                pr_info("cell: server connected\r\n");
-                if (0 == writeAuthJSON(serial, telemetryConfig->telemetryDeviceId)) {
-                    pr_info("cell: server authenticated\r\n");
-                    initResult = DEVICE_INIT_SUCCESS;
-                    g_connection_status = TELEMETRY_STATUS_CONNECTED;
-                    g_active_since = getUptimeAsInt();
-                } else {
-                    g_connection_status = TELEMETRY_STATUS_REJECTED_DEVICE_ID;
-                    pr_error_str_msg("err: auth- token: ", telemetryConfig->telemetryDeviceId);
-                }
-            } else {
-                g_connection_status = TELEMETRY_STATUS_SERVER_CONNECTION_FAILED;
-                pr_error_str_msg("err: server connect ", telemetryConfig->telemetryServerHost);
-            }
-        } else {
-            g_connection_status = TELEMETRY_STATUS_INTERNET_CONFIG_FAILED;
-            pr_error("Failed to configure network\r\n");
+    switch (g_init.state) {
+    case SIM900_INIT_START:
+        pr_debug("init cell connection\r\n");
+        g_active_since = 0;
+        g_init.udpMode = telemetryConfig->udpMode;
+        cell_modem_start(cellCfg->apnHost, cellCfg->apnUser, cellCfg->apnPass,
+                         telemetryConfig->telemetryServerHost, TELEMETRY_SERVER_PORT,
+                         g_init.udpMode);
+        g_init.state = SIM900_INIT_MODEM;
+        break;
+    case SIM900_INIT_MODEM:
+        switch (cell_modem_step(serial)) {
+        case CELL_STEP_CONNECTED:
+            /* There is no session to wake up with UDP */
+            g_init.state = SIM900_INIT_AUTH_WAKE;
+            g_init.wakes = g_init.udpMode ? AUTH_WAKE_COUNT : 0;
+            g_init.since = getCurrentTicks();
+            g_init.auth_start = g_init.since;
+            break;
+        case CELL_STEP_FAILED:
+            return modemFailed();
+        default:
+            break;
         }
-    } else {
-        g_connection_status = TELEMETRY_STATUS_CELL_REGISTRATION_FAILED;
-        pr_warning("Failed to init cell connection\r\n");
+        break;
+    case SIM900_INIT_AUTH_WAKE:
+        if (!isTimeoutMs(g_init.since, g_init.wakes ? AUTH_WAKE_DELAY : 0))
+            break;
+        g_init.since = getCurrentTicks();
+        if (g_init.wakes++ < AUTH_WAKE_COUNT) {
+            serial->put_s(" ");
+            break;
+        }
+        /* Anything left over from the modem is not the server talking */
+        while (cell_read_line(serial));
+        if (g_init.udpMode && cell_begin_datagram(serial) != 0)
+            break;
+        writeAuthJSON(serial, telemetryConfig->telemetryDeviceId);
+        if (g_init.udpMode)
+            cell_end_datagram(serial);
+        g_init.state = SIM900_INIT_AUTH_WAIT;
+        break;
+    case SIM900_INIT_AUTH_WAIT: {
+        const char *data = cell_read_line(serial);
+        if (data && strncmp(data, "{\"status\":\"ok\"}", 15) == 0) {
+            pr_info("cell: server authenticated\r\n");
+            g_connection_status = TELEMETRY_STATUS_CONNECTED;
+            g_active_since = getUptimeAsInt();
+            g_init.state = SIM900_INIT_START;
+            config->datagram = g_init.udpMode;
+            return DEVICE_INIT_SUCCESS;
+        }
+        if (!data && isTimeoutMs(g_init.auth_start, AUTH_TIMEOUT)) {
+            g_connection_status = TELEMETRY_STATUS_REJECTED_DEVICE_ID;
+            pr_error_str_msg("err: auth- token: ", telemetryConfig->telemetryDeviceId);
+            g_init.state = SIM900_INIT_START;
+            return DEVICE_INIT_FAIL;
+        }
+        if (g_init.udpMode && isTimeoutMs(g_init.since, AUTH_RESEND_DELAY))
+            g_init.state = SIM900_INIT_AUTH_WAKE;
+        break;
+    }
     }
-    return initResult;
+    return DEVICE_INIT_PENDING;
+}
+
+int sim900_begin_datagram(DeviceConfig *config)
+{
+    return cell_begin_datagram(config->serial);
+}
+
+void sim900_end_datagram(DeviceConfig *config)
+{
+    cell_end_datagram(config->serial);
 }
 
 int sim900_check_connection_status(DeviceConfig *config)
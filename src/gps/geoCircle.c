@@ -28,14 +28,14 @@ struct GeoCircle gc_createGeoCircle(const GeoPoint gp, const float r)
 
     gc.point = gp;
     gc.radius = r;
+    gp_projection_init(&gc.proj, &gp);
 
     return gc;
 }
 
 bool gc_isPointInGeoCircle(const GeoPoint * point, const struct GeoCircle gc)
 {
-    float dist = distPythag(point, &(gc.point));
-    return  dist <= gc.radius;
+    return gp_dist_sq(&gc.proj, point, &gc.point) <= gc.radius * gc.radius;
 }
 
 bool gc_isValidGeoCircle(const struct GeoCircle gc)
@@ -8,34 +8,182 @@
 #include "geopoint.h"
 #include "gps.h"
 #include <math.h>
+#include <stdint.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+#define FULL_CIRCLE	((int64_t) 360 * GEO_POINT_SCALE)
+#define HALF_CIRCLE	((int64_t) 180 * GEO_POINT_SCALE)
+
+/*
+ * How far north or south of its origin a frame may be used.  At the edges
+ * the scale of longitude is off by about 0.2% at 60 degrees.
+ */
+#define PROJECTION_RANGE	((int64_t) GEO_POINT_SCALE / 20)
+
 /**
  * Converts a given value to radians.
- * @param val The provided value in non-radian form.
+ * @param val The provided value in fixed point degrees.
  * @return The radian value.
  */
-static float toRad(float val)
+static float toRad(int64_t val)
+{
+    return (float) val * (float) (M_PI / 180.0 / GEO_POINT_SCALE);
+}
+
+int64_t gp_lon_diff(const GeoPoint *a, const GeoPoint *b)
 {
-    return val * (M_PI / 180.0);
+    int64_t dLon = (int64_t) b->longitude - a->longitude;
+    if (dLon > HALF_CIRCLE)
+        dLon -= FULL_CIRCLE;
+    else if (dLon < -HALF_CIRCLE)
+        dLon += FULL_CIRCLE;
+
+    return dLon;
 }
 
 float distPythag(const GeoPoint *a, const GeoPoint *b)
 {
-    const float dLatRad = toRad(b->latitude - a->latitude);
-    const float dLonRad = toRad(b->longitude - a->longitude);
-    const float latARad = toRad(a->latitude);
-    const float latBRad = toRad(b->latitude);
+    /* The differences are exact.  Only they ever go to floating point */
+    const int64_t dLat = (int64_t) b->latitude - a->latitude;
+    const int64_t dLon = gp_lon_diff(a, b);
+
+    const float midLatRad = toRad(a->latitude + dLat / 2);
+    const float x = (float) dLon * cosf(midLatRad);
+    const float y = (float) dLat;
+
+    return sqrtf(x * x + y * y) * GP_METERS_PER_UNIT;
+}
+
+void gp_projection_init(struct gp_projection *proj, const GeoPoint *origin)
+{
+    proj->origin = *origin;
+    proj->lon_scale = GP_METERS_PER_UNIT * cosf(toRad(origin->latitude));
+}
+
+bool gp_projection_follow(struct gp_projection *proj, const GeoPoint *point)
+{
+    const int64_t dLat = (int64_t) point->latitude - proj->origin.latitude;
+    if (dLat <= PROJECTION_RANGE && dLat >= -PROJECTION_RANGE)
+        return false;
+
+    gp_projection_init(proj, point);
+    return true;
+}
+
+void gp_project(const struct gp_projection *proj, const GeoPoint *point,
+                float *x, float *y)
+{
+    *x = (float) gp_lon_diff(&proj->origin, point) * proj->lon_scale;
+    *y = (float) ((int64_t) point->latitude - proj->origin.latitude) *
+        GP_METERS_PER_UNIT;
+}
+
+float gp_dist_sq(const struct gp_projection *proj, const GeoPoint *a,
+                 const GeoPoint *b)
+{
+    const float x = (float) gp_lon_diff(a, b) * proj->lon_scale;
+    const float y = (float) ((int64_t) b->latitude - a->latitude) *
+        GP_METERS_PER_UNIT;
+
+    return x * x + y * y;
+}
+
+float gp_dist(const struct gp_projection *proj, const GeoPoint *a,
+              const GeoPoint *b)
+{
+    return sqrtf(gp_dist_sq(proj, a, b));
+}
 
-    const float tmp = dLonRad * cos((latARad + latBRad) / 2);
+float gp_fraction_along(const struct gp_projection *proj, const GeoPoint *s,
+                        const GeoPoint *e, const GeoPoint *m)
+{
+    const float ex = (float) gp_lon_diff(s, e) * proj->lon_scale;
+    const float ey = (float) ((int64_t) e->latitude - s->latitude) *
+        GP_METERS_PER_UNIT;
+    const float mx = (float) gp_lon_diff(s, m) * proj->lon_scale;
+    const float my = (float) ((int64_t) m->latitude - s->latitude) *
+        GP_METERS_PER_UNIT;
 
-    return sqrt(tmp * tmp + dLatRad * dLatRad) * GP_EARTH_RADIUS_M;
+    /* The projection of m on the line, over the length of the line */
+    return (mx * ex + my * ey) / (ex * ex + ey * ey);
 }
 
 int isValidPoint(const GeoPoint *p)
 {
-    return p->latitude != 0.0 || p->longitude != 0.0;
+    return p->latitude != 0 || p->longitude != 0;
+}
+
+int32_t gp_from_degrees(double degrees)
+{
+    const double v = degrees * GEO_POINT_SCALE;
+    return (int32_t) (v < 0 ? v - 0.5 : v + 0.5);
+}
+
+double gp_to_degrees(int32_t value)
+{
+    return (double) value / GEO_POINT_SCALE;
+}
+
+GeoPoint gp_create(double latitude, double longitude)
+{
+    GeoPoint p;
+    p.latitude = gp_from_degrees(latitude);
+    p.longitude = gp_from_degrees(longitude);
+    return p;
+}
+
+/*
+ * Parses an unsigned decimal number in units of 1e-7, rounding off any
+ * digits past that.
+ */
+static int64_t parse_fixed(const char *str)
+{
+    int64_t whole = 0;
+    for (; *str >= '0' && *str <= '9'; ++str)
+        whole = whole * 10 + *str - '0';
+
+    int64_t frac = 0;
+    int64_t scale = GEO_POINT_SCALE;
+    if ('.' == *str) {
+        for (++str; *str >= '0' && *str <= '9'; ++str) {
+            if (scale > 1) {
+                scale /= 10;
+                frac += (*str - '0') * scale;
+            } else {
+                /* Round on the first digit we can't keep */
+                if (*str >= '5')
+                    ++frac;
+                break;
+            }
+        }
+    }
+
+    return whole * GEO_POINT_SCALE + frac;
+}
+
+int32_t gp_parse_degrees(const char *str)
+{
+    while (' ' == *str)
+        ++str;
+
+    const bool negative = '-' == *str;
+    if ('-' == *str || '+' == *str)
+        ++str;
+
+    const int64_t value = parse_fixed(str);
+    return (int32_t) (negative ? -value : value);
+}
+
+int32_t gp_parse_nmea(const char *str, int degree_digits)
+{
+    int32_t degrees = 0;
+    for (; degree_digits && *str >= '0' && *str <= '9'; --degree_digits, ++str)
+        degrees = degrees * 10 + *str - '0';
+
+    /* Minutes in units of 1e-7.  60 of them to the degree */
+    const int64_t minutes = parse_fixed(str);
+    return degrees * GEO_POINT_SCALE + (int32_t) ((minutes + 30) / 60);
 }
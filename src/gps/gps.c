@@ -1,5 +1,6 @@
 #include "gps.h"
 #include "gps_device.h"
+#include "gps_fusion.h"
 #include "mod_string.h"
 #include "modp_atonum.h"
 
@@ -11,6 +12,7 @@ gps_status_t gps_status = GPS_STATUS_NOT_INIT;
 static int g_flashCount;
 static millis_t g_timeFirstFix;
 static tiny_millis_t g_uptimeAtSample;
+static GpsLatencyStats g_latencyStats;
 
 bool isGpsSignalUsable(enum GpsSignalQuality q)
 {
@@ -23,6 +25,8 @@ gps_status_t GPS_init(uint8_t targetSampleRate, Serial *serial)
     g_timeFirstFix = 0;
     g_flashCount = 0;
     g_uptimeAtSample = 0;
+    memset(&g_latencyStats, 0, sizeof(g_latencyStats));
+    gps_fusion_init();
     gps_status = GPS_device_init(targetSampleRate, serial);
     return gps_status;
 }
@@ -94,14 +98,25 @@ tiny_millis_t getUptimeAtSample()
     return g_uptimeAtSample;
 }
 
-float GPS_getLatitude()
+GpsLatencyStats GPS_getLatencyStats()
 {
-    return g_gpsSnapshot.sample.point.latitude;
+    return g_latencyStats;
 }
 
-float GPS_getLongitude()
+int GPS_getAverageLatency()
 {
-    return g_gpsSnapshot.sample.point.longitude;
+    const GpsLatencyStats *s = &g_latencyStats;
+    return s->count ? (int) (s->total / s->count) : 0;
+}
+
+double GPS_getLatitude()
+{
+    return gp_to_degrees(g_gpsSnapshot.sample.point.latitude);
+}
+
+double GPS_getLongitude()
+{
+    return gp_to_degrees(g_gpsSnapshot.sample.point.longitude);
 }
 
 float getAltitude()
@@ -159,9 +174,33 @@ GpsSnapshot getGpsSnapshot()
     return g_gpsSnapshot;
 }
 
+static void updateLatencyStats(const tiny_millis_t latency)
+{
+    GpsLatencyStats *s = &g_latencyStats;
+
+    if (s->count == 0 || latency < s->min) s->min = latency;
+    if (latency > s->max) s->max = latency;
+    s->last = latency;
+    s->total += latency;
+    s->count++;
+}
+
 static void updateFullDateTime(GpsSample *gpsSample)
 {
-    g_uptimeAtSample = getUptime();
+    const tiny_millis_t now = getUptime();
+
+    /*
+     * Anchor the fix at its first byte, not at now.  Otherwise the time
+     * it took to come in and be parsed, which changes with the length of
+     * the message, shows up as an error in everything we extrapolate
+     * from the fix.
+     */
+    if (gpsSample->uptime > 0 && gpsSample->uptime <= now) {
+        g_uptimeAtSample = gpsSample->uptime;
+        updateLatencyStats(now - gpsSample->uptime);
+    } else {
+        g_uptimeAtSample = now;
+    }
 
     if (g_timeFirstFix == 0) g_timeFirstFix = gpsSample->time;
 }
@@ -171,17 +210,24 @@ void GPS_sample_update(GpsSample *newSample)
     if (!isGpsSignalUsable(newSample->quality)) return;
 
     const GeoPoint prevPoint = g_gpsSnapshot.sample.point;
+    const tiny_millis_t prevDeltaFirstFix = g_gpsSnapshot.deltaFirstFix;
+    const float prevSpeed = g_gpsSnapshot.sample.speed;
 
     // Deep copy stuff.
     g_gpsSnapshot.sample = *newSample;
     updateFullDateTime(newSample);
     g_gpsSnapshot.deltaFirstFix = newSample->time - g_timeFirstFix;
     g_gpsSnapshot.previousPoint = prevPoint;
+    g_gpsSnapshot.previousDeltaFirstFix = prevDeltaFirstFix;
+    g_gpsSnapshot.previousSpeed = prevSpeed;
+
+    gps_fusion_add_fix(newSample, g_uptimeAtSample);
 }
 
 int GPS_processUpdate(Serial *serial)
 {
     GpsSample s;
+    memset(&s, 0, sizeof(s));
     const gps_msg_result_t result = GPS_device_get_update(&s, serial);
 
     flashGpsStatusLed(s.quality);
@@ -0,0 +1,317 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "dateTime.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "gps_fusion.h"
+#include "mod_string.h"
+#include "task.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define METERS_PER_DEGREE	((float) (GP_EARTH_RADIUS_M * M_PI / 180.0))
+#define KPH_PER_MPS		3.6f
+#define G_MPS2			9.80665f
+#define DEG_TO_RAD		((float) (M_PI / 180.0))
+/* Below this the direction of travel is mostly noise */
+#define MIN_HEADING_SPEED_MPS	2.0f
+/* Fixes further apart than this are not used to learn from */
+#define MAX_FIX_INTERVAL_MS	1000
+/* How fast the IMU models follow the GPS.  0 to 1 */
+#define MODEL_RATE		0.5f
+
+/*
+ * rate = gain * imu + offset, fitted with normalized LMS against the rate
+ * the GPS shows over each interval between fixes.
+ */
+struct rate_model {
+        float gain;
+        float offset;
+        /* IMU readings since the last fix */
+        float sum;
+        uint16_t count;
+};
+
+static struct {
+        bool pending;
+        GpsSample fix;
+        tiny_millis_t fix_uptime;
+} g_pending;
+
+static struct {
+        bool valid;
+        /* Where the last fix was, and where we are relative to it */
+        GeoPoint anchor;
+        /* Scale of longitude around here.  Follows us as we go */
+        struct gp_projection frame;
+        float north;
+        float east;
+        /* In m/s and radians clockwise from north */
+        float speed;
+        float heading;
+        tiny_millis_t fix_uptime;
+        tiny_millis_t last_update;
+
+        /* The last fix, to work out the rates the GPS shows */
+        GeoPoint prev_point;
+        float prev_speed;
+        millis_t prev_time;
+        float prev_course;
+        bool prev_course_valid;
+
+        struct rate_model accel_model;
+        struct rate_model yaw_model;
+} g_fusion;
+
+static float wrap_angle(float a)
+{
+        while (a > (float) M_PI)
+                a -= 2 * (float) M_PI;
+        while (a < (float) -M_PI)
+                a += 2 * (float) M_PI;
+        return a;
+}
+
+static void model_init(struct rate_model *m, const float gain)
+{
+        m->gain = gain;
+        m->offset = 0;
+        m->sum = 0;
+        m->count = 0;
+}
+
+static float model_rate(const struct rate_model *m, const float imu)
+{
+        return m->gain * imu + m->offset;
+}
+
+static void model_add(struct rate_model *m, const float imu)
+{
+        if (m->count < UINT16_MAX) {
+                m->sum += imu;
+                ++m->count;
+        }
+}
+
+static void model_learn(struct rate_model *m, const float gps_rate)
+{
+        const float imu = m->count ? m->sum / m->count : 0;
+        const float err = gps_rate - model_rate(m, imu);
+        const float step = MODEL_RATE * err / (1 + imu * imu);
+
+        m->gain += step * imu;
+        m->offset += step;
+}
+
+static void model_reset_interval(struct rate_model *m)
+{
+        m->sum = 0;
+        m->count = 0;
+}
+
+static void apply_fix(const GpsSample *s, const tiny_millis_t uptime)
+{
+        const float speed = s->speed / KPH_PER_MPS;
+        if (g_fusion.valid)
+                gp_projection_follow(&g_fusion.frame, &s->point);
+        else
+                gp_projection_init(&g_fusion.frame, &s->point);
+
+        float heading = g_fusion.heading;
+
+        const millis_t interval_ms = s->time - g_fusion.prev_time;
+        const bool learn = g_fusion.valid && interval_ms > 0 &&
+                interval_ms <= MAX_FIX_INTERVAL_MS;
+
+        bool course_valid = false;
+        float course = 0;
+        if (g_fusion.valid && speed >= MIN_HEADING_SPEED_MPS &&
+            g_fusion.prev_speed >= MIN_HEADING_SPEED_MPS) {
+                const float north = (float) ((int64_t) s->point.latitude -
+                                             g_fusion.prev_point.latitude) *
+                        GP_METERS_PER_UNIT;
+                const float east = (float) gp_lon_diff(&g_fusion.prev_point,
+                                                       &s->point) *
+                        g_fusion.frame.lon_scale;
+                course = atan2f(east, north);
+                course_valid = north != 0 || east != 0;
+        }
+
+        if (learn) {
+                const float dt = interval_ms / 1000.0f;
+                model_learn(&g_fusion.accel_model,
+                            (speed - g_fusion.prev_speed) / dt);
+
+                /*
+                 * The course between two fixes is the heading half way
+                 * between them.  Carry it forward by half an interval.
+                 */
+                if (course_valid && g_fusion.prev_course_valid) {
+                        const float yaw_rate =
+                                wrap_angle(course - g_fusion.prev_course) / dt;
+                        model_learn(&g_fusion.yaw_model, yaw_rate);
+                        heading = course + yaw_rate * dt / 2;
+                } else if (course_valid) {
+                        heading = course;
+                }
+        } else if (course_valid) {
+                heading = course;
+        }
+
+        model_reset_interval(&g_fusion.accel_model);
+        model_reset_interval(&g_fusion.yaw_model);
+
+        g_fusion.prev_point = s->point;
+        g_fusion.prev_speed = speed;
+        g_fusion.prev_time = s->time;
+        g_fusion.prev_course = course;
+        g_fusion.prev_course_valid = course_valid;
+
+        g_fusion.anchor = s->point;
+        g_fusion.north = 0;
+        g_fusion.east = 0;
+        g_fusion.speed = speed;
+        g_fusion.heading = wrap_angle(heading);
+        g_fusion.fix_uptime = uptime;
+        g_fusion.last_update = uptime;
+        g_fusion.valid = true;
+}
+
+void gps_fusion_init(void)
+{
+        taskENTER_CRITICAL();
+        g_pending.pending = false;
+        taskEXIT_CRITICAL();
+
+        memset(&g_fusion, 0, sizeof(g_fusion));
+        model_init(&g_fusion.accel_model, G_MPS2);
+        model_init(&g_fusion.yaw_model, 1);
+}
+
+void gps_fusion_add_fix(const GpsSample *s, const tiny_millis_t uptime)
+{
+        taskENTER_CRITICAL();
+        g_pending.fix = *s;
+        g_pending.fix_uptime = uptime;
+        g_pending.pending = true;
+        taskEXIT_CRITICAL();
+}
+
+void gps_fusion_update(const float accel_g, const float yaw_dps,
+                       const tiny_millis_t uptime)
+{
+        GpsSample fix;
+        tiny_millis_t fix_uptime = 0;
+        bool new_fix = false;
+
+        taskENTER_CRITICAL();
+        if (g_pending.pending) {
+                fix = g_pending.fix;
+                fix_uptime = g_pending.fix_uptime;
+                g_pending.pending = false;
+                new_fix = true;
+        }
+        taskEXIT_CRITICAL();
+
+        if (new_fix)
+                apply_fix(&fix, fix_uptime);
+
+        if (!g_fusion.valid || uptime == g_fusion.last_update)
+                return;
+
+        const float yaw_imu = yaw_dps * DEG_TO_RAD;
+        model_add(&g_fusion.accel_model, accel_g);
+        model_add(&g_fusion.yaw_model, yaw_imu);
+
+        tiny_millis_t until = g_fusion.fix_uptime +
+                GPS_FUSION_MAX_EXTRAPOLATION_MS;
+        if (uptime - until < 0)
+                until = uptime;
+
+        if (until - g_fusion.last_update <= 0)
+                return;
+
+        const float dt = (until - g_fusion.last_update) / 1000.0f;
+        g_fusion.last_update = until;
+
+        const float accel = model_rate(&g_fusion.accel_model, accel_g);
+        const float yaw_rate = model_rate(&g_fusion.yaw_model, yaw_imu);
+
+        /* Move along the arc at the mid point heading and speed */
+        const float heading = g_fusion.heading + yaw_rate * dt / 2;
+        float speed = g_fusion.speed + accel * dt / 2;
+        if (speed < 0)
+                speed = 0;
+
+        g_fusion.north += speed * dt * cosf(heading);
+        g_fusion.east += speed * dt * sinf(heading);
+        g_fusion.heading = wrap_angle(g_fusion.heading + yaw_rate * dt);
+        g_fusion.speed = speed + accel * dt / 2;
+        if (g_fusion.speed < 0)
+                g_fusion.speed = 0;
+}
+
+bool gps_fusion_valid(void)
+{
+        return g_fusion.valid;
+}
+
+double gps_fusion_get_latitude(void)
+{
+        return gp_to_degrees(g_fusion.anchor.latitude) +
+                (double) g_fusion.north / METERS_PER_DEGREE;
+}
+
+double gps_fusion_get_longitude(void)
+{
+        if (!g_fusion.valid)
+                return 0;
+
+        const double lon = gp_to_degrees(g_fusion.anchor.longitude) +
+                (double) g_fusion.east / g_fusion.frame.lon_scale /
+                GEO_POINT_SCALE;
+
+        /* We may have gone past the antimeridian since the anchor */
+        if (lon > 180)
+                return lon - 360;
+        if (lon < -180)
+                return lon + 360;
+        return lon;
+}
+
+float gps_fusion_get_speed(void)
+{
+        return g_fusion.speed * KPH_PER_MPS;
+}
+
+float gps_fusion_get_heading(void)
+{
+        const float degrees = g_fusion.heading / DEG_TO_RAD;
+        return degrees < 0 ? degrees + 360 : degrees;
+}
@@ -0,0 +1,304 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dateTime.h"
+#include "gps.h"
+#include "modp_atonum.h"
+#include "nmea.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define KNOTS_TO_KPH	1.852f
+
+enum state {
+        STATE_IDLE = 0,
+        STATE_BODY,
+        STATE_CHECKSUM_HI,
+        STATE_CHECKSUM_LO,
+};
+
+#define SENTENCE_ID(a, b, c)	(((uint32_t) (a) << 16) | ((b) << 8) | (c))
+
+static const struct {
+        uint32_t id;
+        enum nmea_sentence sentence;
+} sentence_ids[] = {
+        { SENTENCE_ID('G', 'G', 'A'), NMEA_GGA },
+        { SENTENCE_ID('G', 'L', 'L'), NMEA_GLL },
+        { SENTENCE_ID('G', 'S', 'A'), NMEA_GSA },
+        { SENTENCE_ID('G', 'S', 'V'), NMEA_GSV },
+        { SENTENCE_ID('R', 'M', 'C'), NMEA_RMC },
+        { SENTENCE_ID('V', 'T', 'G'), NMEA_VTG },
+        { SENTENCE_ID('Z', 'D', 'A'), NMEA_ZDA },
+};
+
+static int hex_value(const char c)
+{
+        if (c >= '0' && c <= '9')
+                return c - '0';
+        if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        return -1;
+}
+
+static enum nmea_sentence identify(const struct nmea_parser *p)
+{
+        /* Address is two talker characters and three of sentence type */
+        const char *addr = p->buffer;
+        if (strlen(addr) != 5)
+                return NMEA_UNKNOWN;
+
+        const uint32_t id = SENTENCE_ID(addr[2], addr[3], addr[4]);
+        for (size_t i = 0; i < sizeof(sentence_ids) / sizeof(sentence_ids[0]); ++i)
+                if (sentence_ids[i].id == id)
+                        return sentence_ids[i].sentence;
+
+        return NMEA_UNKNOWN;
+}
+
+static enum nmea_result drop(struct nmea_parser *p, uint32_t *counter)
+{
+        ++*counter;
+        p->state = STATE_IDLE;
+        return NMEA_ERROR;
+}
+
+static void start(struct nmea_parser *p)
+{
+        p->state = STATE_BODY;
+        p->len = 0;
+        p->fields[0] = 0;
+        p->field_count = 1;
+        p->checksum = 0;
+        p->sentence = NMEA_UNKNOWN;
+}
+
+void nmea_init(struct nmea_parser *p)
+{
+        memset(p, 0, sizeof(*p));
+}
+
+enum nmea_result nmea_feed(struct nmea_parser *p, const char c)
+{
+        /* Most bytes are plain field characters.  Get them out of the way */
+        if (STATE_BODY == p->state && c != ',' && c != '*' && c != '$' &&
+            c != '\r' && c != '\n' && p->len < NMEA_MAX_SENTENCE - 1) {
+                p->checksum ^= c;
+                p->buffer[p->len++] = c;
+                return NMEA_PENDING;
+        }
+
+        if ('$' == c) {
+                /* Whatever we had was cut short */
+                const bool cut = STATE_IDLE != p->state;
+                start(p);
+                if (cut) {
+                        ++p->stats.framing_errors;
+                        return NMEA_ERROR;
+                }
+                return NMEA_PENDING;
+        }
+
+        switch (p->state) {
+        case STATE_BODY:
+                /* Always leave room for the terminator */
+                if (p->len >= NMEA_MAX_SENTENCE - 1 || '\r' == c || '\n' == c)
+                        return drop(p, &p->stats.framing_errors);
+
+                p->buffer[p->len++] = '\0';
+                if ('*' == c) {
+                        p->fields[p->field_count] = p->len;
+                        p->state = STATE_CHECKSUM_HI;
+                        return NMEA_PENDING;
+                }
+
+                if (p->field_count >= NMEA_MAX_FIELDS - 1)
+                        return drop(p, &p->stats.framing_errors);
+
+                p->checksum ^= c;
+                p->fields[p->field_count++] = p->len;
+                return NMEA_PENDING;
+
+        case STATE_CHECKSUM_HI: {
+                const int v = hex_value(c);
+                if (v < 0)
+                        return drop(p, &p->stats.framing_errors);
+
+                p->rx_checksum = (uint8_t) (v << 4);
+                p->state = STATE_CHECKSUM_LO;
+                return NMEA_PENDING;
+        }
+        case STATE_CHECKSUM_LO: {
+                const int v = hex_value(c);
+                if (v < 0)
+                        return drop(p, &p->stats.framing_errors);
+
+                if ((p->rx_checksum | v) != p->checksum)
+                        return drop(p, &p->stats.checksum_errors);
+
+                p->state = STATE_IDLE;
+                p->sentence = identify(p);
+                ++p->stats.sentences;
+                return NMEA_READY;
+        }
+        default:
+                return NMEA_PENDING;
+        }
+}
+
+enum nmea_sentence nmea_sentence(const struct nmea_parser *p)
+{
+        return p->sentence;
+}
+
+size_t nmea_field_count(const struct nmea_parser *p)
+{
+        return p->field_count;
+}
+
+const char* nmea_field(const struct nmea_parser *p, const size_t i)
+{
+        return i < p->field_count ? p->buffer + p->fields[i] : "";
+}
+
+/* Reads exactly n digits.  Anything else counts as 0 */
+static int digits(const char *str, size_t n)
+{
+        int value = 0;
+        for (; n; --n, ++str) {
+                if (*str < '0' || *str > '9')
+                        return 0;
+                value = value * 10 + *str - '0';
+        }
+        return value;
+}
+
+/* Fraction of a second after the '.' in milliseconds */
+static int milliseconds(const char *str)
+{
+        if ('.' != *str)
+                return 0;
+
+        int value = 0;
+        int scale = 100;
+        for (++str; scale && *str >= '0' && *str <= '9'; ++str, scale /= 10)
+                value += (*str - '0') * scale;
+        return value;
+}
+
+static int32_t coordinate(const struct nmea_parser *p, const size_t i,
+                          const int degree_digits, const char negative)
+{
+        const int32_t value = gp_parse_nmea(nmea_field(p, i), degree_digits);
+        return negative == nmea_field(p, i + 1)[0] ? -value : value;
+}
+
+/*
+ * $GPGGA,034722.200,3745.1353,N,12224.6551,W,1,6,1.42,0.4,M,-25.3,M,,*61
+ * Time, latitude, N/S, longitude, E/W, fix indicator, satellites, HDOP,
+ * altitude, ...
+ */
+static void decode_gga(const struct nmea_parser *p, GpsSample *sample)
+{
+        enum GpsSignalQuality quality = GPS_QUALITY_NO_FIX;
+        switch (modp_atoi(nmea_field(p, 6))) {
+        case 1:
+                quality = GPS_QUALITY_2D;
+                break;
+        case 2:
+                quality = GPS_QUALITY_3D;
+                break;
+        default:
+                break;
+        }
+
+        sample->quality = quality;
+        sample->satellites = (uint8_t) modp_atoi(nmea_field(p, 7));
+        sample->DOP = modp_atof(nmea_field(p, 8));
+        sample->altitude = modp_atof(nmea_field(p, 9));
+}
+
+/*
+ * $GPRMC,053740.000,A,2503.6319,N,12136.0099,E,2.69,79.65,100106,,,A*53
+ * Time (hhmmss.sss), status, latitude (ddmm.mmmm), N/S, longitude
+ * (dddmm.mmmm), E/W, speed over ground in knots, course, date (ddmmyy),
+ * ...
+ */
+static void decode_rmc(struct nmea_parser *p, GpsSample *sample)
+{
+        const char *time = nmea_field(p, 1);
+        const char *date = nmea_field(p, 9);
+        DateTime dt = { 0 };
+
+        if (strlen(time) >= 6) {
+                dt.hour = (int8_t) digits(time, 2);
+                dt.minute = (int8_t) digits(time + 2, 2);
+                dt.second = (int8_t) digits(time + 4, 2);
+                dt.millisecond = (int16_t) milliseconds(time + 6);
+        }
+
+        if (strlen(date) >= 6) {
+                dt.day = (int8_t) digits(date, 2);
+                dt.month = (int8_t) digits(date + 2, 2);
+                dt.year = (int16_t) (digits(date + 4, 2) + 2000);
+        }
+
+        /*
+         * Working out the days since the epoch is the slow part and the
+         * date hardly ever changes, so only do it for a new date.
+         */
+        const int32_t date_key = (dt.year << 16) | (dt.month << 8) | dt.day;
+        if (date_key != p->date_key) {
+                DateTime midnight = dt;
+                midnight.hour = midnight.minute = midnight.second = 0;
+                midnight.millisecond = 0;
+                p->date_key = date_key;
+                p->midnight = getMillisecondsSinceUnixEpoch(midnight);
+        }
+
+        sample->point.latitude = coordinate(p, 3, 2, 'S');
+        sample->point.longitude = coordinate(p, 5, 3, 'W');
+        sample->speed = modp_atof(nmea_field(p, 7)) * KNOTS_TO_KPH;
+        sample->time = isValidDateTime(dt) && p->midnight ?
+                p->midnight + dt.millisecond + 1000 *
+                (dt.second + 60 * (dt.minute + 60 * (millis_t) dt.hour)) : 0;
+}
+
+enum nmea_sentence nmea_decode(struct nmea_parser *p, GpsSample *sample)
+{
+        switch (p->sentence) {
+        case NMEA_GGA:
+                decode_gga(p, sample);
+                break;
+        case NMEA_RMC:
+                decode_rmc(p, sample);
+                break;
+        default:
+                break;
+        }
+
+        return p->sentence;
+}
@@ -0,0 +1,236 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dateTime.h"
+#include "gps.h"
+#include "skytraq.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FRAME_OVERHEAD	7
+
+/* UNIX time (epoch 1/1/1970) at the start of GNSS epoch (1/6/1980) */
+#define GNSS_EPOCH_IN_UNIX_EPOCH	315964800
+#define SECONDS_PER_WEEK		(7 * 24 * 60 * 60)
+
+#define METERS_TO_FEET	3.28084f
+#define MPS_TO_KPH	3.6f
+
+/* Length of a navigation data message payload, ID included */
+#define NAVIGATION_DATA_LEN	59
+
+enum state {
+        STATE_IDLE = 0,
+        STATE_SYNC,
+        STATE_LEN_HI,
+        STATE_LEN_LO,
+        STATE_PAYLOAD,
+        STATE_CHECKSUM,
+};
+
+/*
+ * GPS time does not have leap seconds; UTC does.  When each offset came
+ * in, in GPS seconds.  Fixes from before the first one get its offset.
+ */
+static const struct {
+        uint32_t since;
+        uint8_t seconds;
+} leap_seconds[] = {
+        { 1167264018, 18 },     /* 2017-01-01 */
+        { 1119744017, 17 },     /* 2015-07-01 */
+        { 0, 16 },              /* 2012-07-01 */
+};
+
+static uint16_t get_u16(const uint8_t *b)
+{
+        return (uint16_t) ((b[0] << 8) | b[1]);
+}
+
+static uint32_t get_u32(const uint8_t *b)
+{
+        return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) |
+                ((uint32_t) b[2] << 8) | b[3];
+}
+
+static int32_t get_s32(const uint8_t *b)
+{
+        return (int32_t) get_u32(b);
+}
+
+static enum skytraq_result drop(struct skytraq_parser *p, uint32_t *counter)
+{
+        ++*counter;
+        p->state = STATE_IDLE;
+        return SKYTRAQ_ERROR;
+}
+
+void skytraq_init(struct skytraq_parser *p)
+{
+        memset(p, 0, sizeof(*p));
+}
+
+enum skytraq_result skytraq_feed(struct skytraq_parser *p, const uint8_t c)
+{
+        switch (p->state) {
+        case STATE_PAYLOAD:
+                p->payload[p->pos++] = c;
+                p->checksum ^= c;
+                if (p->pos == p->len)
+                        p->state = STATE_CHECKSUM;
+                return SKYTRAQ_PENDING;
+        case STATE_IDLE:
+                if (SKYTRAQ_SYNC_1 == c)
+                        p->state = STATE_SYNC;
+                return SKYTRAQ_PENDING;
+        case STATE_SYNC:
+                if (SKYTRAQ_SYNC_2 == c)
+                        p->state = STATE_LEN_HI;
+                else if (SKYTRAQ_SYNC_1 != c)
+                        p->state = STATE_IDLE;
+                return SKYTRAQ_PENDING;
+        case STATE_LEN_HI:
+                p->len = c << 8;
+                p->state = STATE_LEN_LO;
+                return SKYTRAQ_PENDING;
+        case STATE_LEN_LO:
+                p->len |= c;
+                if (0 == p->len || p->len > SKYTRAQ_MAX_PAYLOAD)
+                        return drop(p, &p->stats.framing_errors);
+
+                p->pos = 0;
+                p->checksum = 0;
+                p->state = STATE_PAYLOAD;
+                return SKYTRAQ_PENDING;
+        case STATE_CHECKSUM:
+                if (c != p->checksum)
+                        return drop(p, &p->stats.checksum_errors);
+
+                /* The CR LF that follows is skipped as noise */
+                p->state = STATE_IDLE;
+                ++p->stats.messages;
+                return SKYTRAQ_READY;
+        default:
+                p->state = STATE_IDLE;
+                return SKYTRAQ_PENDING;
+        }
+}
+
+uint8_t skytraq_message_id(const struct skytraq_parser *p)
+{
+        return p->payload[0];
+}
+
+size_t skytraq_payload_len(const struct skytraq_parser *p)
+{
+        return p->len;
+}
+
+const uint8_t* skytraq_payload(const struct skytraq_parser *p)
+{
+        return p->payload;
+}
+
+static uint8_t get_leap_seconds(const uint32_t gps_seconds)
+{
+        size_t i = 0;
+        while (gps_seconds < leap_seconds[i].since)
+                ++i;
+
+        return leap_seconds[i].seconds;
+}
+
+static enum GpsSignalQuality get_quality(const uint8_t fix_mode)
+{
+        switch (fix_mode) {
+        case 1:
+                return GPS_QUALITY_2D;
+        case 2:
+                return GPS_QUALITY_3D;
+        case 3:
+                return GPS_QUALITY_3D_DGNSS;
+        default:
+                return GPS_QUALITY_NO_FIX;
+        }
+}
+
+bool skytraq_decode_navigation(const struct skytraq_parser *p,
+                               GpsSample *sample)
+{
+        const uint8_t *b = p->payload;
+        if (SKYTRAQ_MSG_NAVIGATION_DATA != b[0] ||
+            p->len < NAVIGATION_DATA_LEN)
+                return false;
+
+        sample->quality = get_quality(b[1]);
+        sample->satellites = b[2];
+
+        /* Time of week is in 1/100 s */
+        const uint32_t week = get_u16(b + 3);
+        const uint32_t tow = get_u32(b + 5);
+        const uint32_t gps_seconds = week * SECONDS_PER_WEEK + tow / 100;
+        const millis_t gps_ms = (millis_t) week * SECONDS_PER_WEEK * 1000 +
+                (millis_t) tow * 10;
+        sample->time = gps_ms + ((millis_t) GNSS_EPOCH_IN_UNIX_EPOCH -
+                                 get_leap_seconds(gps_seconds)) * 1000;
+
+        /* Already in 1e-7 degrees, like GeoPoint */
+        sample->point.latitude = get_s32(b + 9);
+        sample->point.longitude = get_s32(b + 13);
+
+        /* Mean sea level altitude in cm.  We log feet */
+        sample->altitude = get_s32(b + 21) * 0.01f * METERS_TO_FEET;
+        sample->DOP = get_u16(b + 27) * 0.01f;
+
+        /* ECEF velocity in cm/s */
+        const float vx = get_s32(b + 47) * 0.01f;
+        const float vy = get_s32(b + 51) * 0.01f;
+        const float vz = get_s32(b + 55) * 0.01f;
+        sample->speed = sqrtf(vx * vx + vy * vy + vz * vz) * MPS_TO_KPH;
+
+        return true;
+}
+
+size_t skytraq_frame(uint8_t *buf, const size_t size, const uint8_t *payload,
+                     const size_t len)
+{
+        if (0 == len || len > SKYTRAQ_MAX_PAYLOAD ||
+            len + FRAME_OVERHEAD > size)
+                return 0;
+
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < len; ++i)
+                checksum ^= payload[i];
+
+        buf[0] = SKYTRAQ_SYNC_1;
+        buf[1] = SKYTRAQ_SYNC_2;
+        buf[2] = (uint8_t) (len >> 8);
+        buf[3] = (uint8_t) len;
+        memcpy(buf + 4, payload, len);
+        buf[len + 4] = checksum;
+        buf[len + 5] = '\r';
+        buf[len + 6] = '\n';
+
+        return len + FRAME_OVERHEAD;
+}
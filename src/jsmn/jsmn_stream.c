@@ -0,0 +1,308 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jsmn_stream.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Parser states.  Errors are stored as the (negative) jsmnerr_t */
+enum {
+        STATE_IDLE = 1,
+        STATE_STRING,
+        STATE_PRIMITIVE,
+        STATE_CAPTURE,
+        STATE_CAPTURE_STRING,
+        STATE_DONE,
+};
+
+static bool is_space(const char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool ends_primitive(const char c)
+{
+        return is_space(c) || c == ',' || c == ':' || c == ']' || c == '}';
+}
+
+static jsmntype_t top_type(const struct jsmn_stream_parser *p)
+{
+        return (jsmntype_t) p->stack[p->depth - 1];
+}
+
+static void emit(struct jsmn_stream_parser *p, const jsmn_stream_event_t event,
+                 const jsmntype_t type)
+{
+        p->buf[p->len] = '\0';
+        p->callback(p, event, type, p->buf, p->len, p->ctx);
+}
+
+/* A value just finished.  Work out what comes next */
+static void value_done(struct jsmn_stream_parser *p)
+{
+        p->key_next = false;
+        p->len = 0;
+        p->state = p->depth ? STATE_IDLE : STATE_DONE;
+}
+
+/* Appends to the buffer, returning false if it is full */
+static bool append(struct jsmn_stream_parser *p, const char c)
+{
+        if (p->len >= JSMN_STREAM_BUFFER_SIZE)
+                return false;
+
+        p->buf[p->len++] = c;
+        return true;
+}
+
+/*
+ * Hands off what we have of a long string value.  A trailing backslash
+ * stays behind so that escape sequences always arrive in one piece.
+ */
+static void flush_string(struct jsmn_stream_parser *p)
+{
+        const size_t n = p->escape ? p->len - 1 : p->len;
+        const char held = p->buf[n];
+
+        p->buf[n] = '\0';
+        p->callback(p, JSMN_STREAM_VALUE_PART, JSMN_STRING, p->buf, n, p->ctx);
+        p->buf[0] = held;
+        p->len -= n;
+}
+
+static void string_char(struct jsmn_stream_parser *p, const char c)
+{
+        if (p->len >= JSMN_STREAM_BUFFER_SIZE) {
+                if (p->key_next) {
+                        p->state = JSMN_ERROR_NOMEM;
+                        return;
+                }
+                flush_string(p);
+        }
+
+        if (p->escape) {
+                append(p, c);
+                p->escape = false;
+                return;
+        }
+
+        switch (c) {
+        case '"':
+                emit(p, p->key_next ? JSMN_STREAM_KEY : JSMN_STREAM_VALUE,
+                     JSMN_STRING);
+                value_done(p);
+                break;
+        case '\\':
+                p->escape = true;
+                /* Fall through */
+        default:
+                append(p, c);
+                break;
+        }
+}
+
+static void capture_char(struct jsmn_stream_parser *p, const char c)
+{
+        if (!append(p, c)) {
+                p->state = JSMN_ERROR_NOMEM;
+                return;
+        }
+
+        if (STATE_CAPTURE_STRING == p->state) {
+                if (p->escape)
+                        p->escape = false;
+                else if ('\\' == c)
+                        p->escape = true;
+                else if ('"' == c)
+                        p->state = STATE_CAPTURE;
+                return;
+        }
+
+        switch (c) {
+        case '"':
+                p->state = STATE_CAPTURE_STRING;
+                break;
+        case '{':
+        case '[':
+                if (!++p->capture_depth)
+                        p->state = JSMN_ERROR_NOMEM;
+                break;
+        case '}':
+        case ']':
+                if (--p->capture_depth)
+                        break;
+
+                emit(p, JSMN_STREAM_VALUE, p->capture_type);
+                value_done(p);
+                break;
+        }
+}
+
+static void open_container(struct jsmn_stream_parser *p, const jsmntype_t type)
+{
+        if (p->depth >= JSMN_STREAM_MAX_DEPTH) {
+                p->state = JSMN_ERROR_NOMEM;
+                return;
+        }
+
+        p->stack[p->depth++] = type;
+        const jsmn_stream_event_t event = JSMN_OBJECT == type ?
+                JSMN_STREAM_OBJECT_START : JSMN_STREAM_ARRAY_START;
+
+        if (!p->callback(p, event, type, NULL, 0, p->ctx)) {
+                p->key_next = JSMN_OBJECT == type;
+                return;
+        }
+
+        /* Consumer wants it whole */
+        --p->depth;
+        p->state = STATE_CAPTURE;
+        p->capture_type = type;
+        p->capture_depth = 1;
+        p->escape = false;
+        p->len = 0;
+        append(p, JSMN_OBJECT == type ? '{' : '[');
+}
+
+static void close_container(struct jsmn_stream_parser *p, const jsmntype_t type)
+{
+        if (!p->depth || top_type(p) != type) {
+                p->state = JSMN_ERROR_INVAL;
+                return;
+        }
+
+        --p->depth;
+        const jsmn_stream_event_t event = JSMN_OBJECT == type ?
+                JSMN_STREAM_OBJECT_END : JSMN_STREAM_ARRAY_END;
+        p->callback(p, event, type, NULL, 0, p->ctx);
+        value_done(p);
+}
+
+static void idle_char(struct jsmn_stream_parser *p, const char c)
+{
+        if (is_space(c))
+                return;
+
+        if (STATE_DONE == p->state) {
+                p->state = JSMN_ERROR_INVAL;
+                return;
+        }
+
+        /* Only a string or the end of the object may stand in for a key */
+        if (p->key_next && c != '"' && c != '}') {
+                p->state = JSMN_ERROR_INVAL;
+                return;
+        }
+
+        switch (c) {
+        case '{':
+                open_container(p, JSMN_OBJECT);
+                break;
+        case '[':
+                open_container(p, JSMN_ARRAY);
+                break;
+        case '}':
+                close_container(p, JSMN_OBJECT);
+                break;
+        case ']':
+                close_container(p, JSMN_ARRAY);
+                break;
+        case ',':
+                if (!p->depth) {
+                        p->state = JSMN_ERROR_INVAL;
+                        break;
+                }
+                p->key_next = JSMN_OBJECT == top_type(p);
+                break;
+        case ':':
+                if (!p->depth || JSMN_OBJECT != top_type(p))
+                        p->state = JSMN_ERROR_INVAL;
+                break;
+        case '"':
+                p->state = STATE_STRING;
+                p->escape = false;
+                p->len = 0;
+                break;
+        default:
+                p->state = STATE_PRIMITIVE;
+                p->len = 0;
+                append(p, c);
+                break;
+        }
+}
+
+static void primitive_char(struct jsmn_stream_parser *p, const char c)
+{
+        if (!ends_primitive(c)) {
+                if (!append(p, c))
+                        p->state = JSMN_ERROR_NOMEM;
+                return;
+        }
+
+        emit(p, JSMN_STREAM_VALUE, JSMN_PRIMITIVE);
+        value_done(p);
+
+        /* The delimiter still needs to be dealt with */
+        idle_char(p, c);
+}
+
+void jsmn_stream_init(struct jsmn_stream_parser *p,
+                      jsmn_stream_callback_t *callback, void *ctx)
+{
+        p->callback = callback;
+        p->ctx = ctx;
+        p->state = STATE_IDLE;
+        p->key_next = false;
+        p->escape = false;
+        p->depth = 0;
+        p->capture_depth = 0;
+        p->len = 0;
+}
+
+jsmnerr_t jsmn_stream_parse(struct jsmn_stream_parser *p, const char *data,
+                            size_t len)
+{
+        for (; len && p->state > 0; --len, ++data) {
+                const char c = *data;
+
+                switch (p->state) {
+                case STATE_STRING:
+                        string_char(p, c);
+                        break;
+                case STATE_PRIMITIVE:
+                        primitive_char(p, c);
+                        break;
+                case STATE_CAPTURE:
+                case STATE_CAPTURE_STRING:
+                        capture_char(p, c);
+                        break;
+                default:
+                        idle_char(p, c);
+                        break;
+                }
+        }
+
+        if (p->state < 0)
+                return (jsmnerr_t) p->state;
+
+        return STATE_DONE == p->state ? JSMN_SUCCESS : JSMN_ERROR_PART;
+}
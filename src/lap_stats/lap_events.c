@@ -0,0 +1,81 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "lap_events.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if (LAP_EVENT_QUEUE_SIZE & (LAP_EVENT_QUEUE_SIZE - 1))
+#error "LAP_EVENT_QUEUE_SIZE must be a power of 2"
+#endif
+
+static struct lap_event g_events[LAP_EVENT_QUEUE_SIZE];
+
+static struct {
+        /* Position of the oldest event */
+        uint32_t head;
+        /* Position the next event goes to */
+        uint32_t tail;
+} g_queue;
+
+void lap_events_reset(void)
+{
+        taskENTER_CRITICAL();
+        g_queue.head = g_queue.tail;
+        taskEXIT_CRITICAL();
+}
+
+void lap_events_push(const struct lap_event *e)
+{
+        taskENTER_CRITICAL();
+        g_events[g_queue.tail & (LAP_EVENT_QUEUE_SIZE - 1)] = *e;
+        if (++g_queue.tail - g_queue.head > LAP_EVENT_QUEUE_SIZE)
+                g_queue.head = g_queue.tail - LAP_EVENT_QUEUE_SIZE;
+        taskEXIT_CRITICAL();
+}
+
+uint32_t lap_events_position(void)
+{
+        taskENTER_CRITICAL();
+        const uint32_t pos = g_queue.tail;
+        taskEXIT_CRITICAL();
+
+        return pos;
+}
+
+bool lap_events_read(uint32_t *pos, struct lap_event *e)
+{
+        taskENTER_CRITICAL();
+
+        /* Fell behind, or the events were reset */
+        if (*pos - g_queue.head > g_queue.tail - g_queue.head)
+                *pos = g_queue.head;
+
+        const bool res = *pos != g_queue.tail;
+        if (res)
+                *e = g_events[(*pos)++ & (LAP_EVENT_QUEUE_SIZE - 1)];
+
+        taskEXIT_CRITICAL();
+        return res;
+}
@@ -1,9 +1,12 @@
 #include "lap_stats.h"
+#include "FreeRTOS.h"
 #include "dateTime.h"
+#include "fast_lap_store.h"
 #include "gps.h"
 #include "geopoint.h"
 #include "geoCircle.h"
 #include "geoTrigger.h"
+#include "lap_events.h"
 #include "loggerHardware.h"
 #include "loggerConfig.h"
 #include "modp_numtoa.h"
@@ -11,9 +14,13 @@
 #include "mod_string.h"
 #include "predictive_timer_2.h"
 #include "printk.h"
+#include "task.h"
+#include "track_map.h"
 #include "tracks.h"
 #include "test.h"
 
+#include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "auto_track.h"
@@ -21,6 +28,18 @@
 
 #define KMS_TO_MILES_CONSTANT (.621371)
 
+/*
+ * Below this GPS speed we are standing still and the change in position
+ * is only jitter.
+ */
+#define MIN_MOVING_SPEED_KPH 2.0f
+
+/*
+ * Above this DOP positions jump around too much to add up.  The distance
+ * comes from the speed instead.
+ */
+#define MAX_DISTANCE_DOP 5.0f
+
 // In Millis now.
 #define START_FINISH_TIME_THRESHOLD 10000
 
@@ -48,15 +67,64 @@ static tiny_millis_t g_lastSectorTime;
 
 static int g_lap;
 static int g_lapCount;
-static float g_distance;
+
+/*
+ * Distance driven in micrometers, counted since lapStats_init.  Whole
+ * numbers add up without the drift a float gets once it holds a few
+ * hundred km, and rounding each step to a micrometer is well below what
+ * a fix can tell us.  The lap and session distances are what it was at
+ * their start taken off it.  The GPS task counts and the logger task
+ * reads, and an int64 takes two stores, so both go through a critical
+ * section.
+ */
+static int64_t g_odometer;
+static int64_t g_lap_start_odometer;
+static int64_t g_session_start_odometer;
+
+/*
+ * Flat frame around the start of the active track for the distance math
+ * done on every fix.  It follows us if we drive off far enough.
+ */
+static struct gp_projection g_track_proj;
+
+/*
+ * Best time of each sector this session and the theoretical best lap they
+ * add up to.  A best of 0 means that sector has not been timed yet.
+ */
+static tiny_millis_t g_bestSectorTimes[SECTOR_COUNT];
+static int g_sectorCount;
+static int g_bestSectorsTimed;
+static tiny_millis_t g_optimalLapTime;
+
+// Sum of the best times of the sectors done so far this lap.
+static tiny_millis_t g_optimalSplit;
+static bool g_optimalSplitValid;
+
+static tiny_millis_t g_sectorDelta;
+static tiny_millis_t g_optimalDelta;
 
 // Our GeoTriggers so we don't unintentionally trigger on start/finish
 static struct GeoTrigger g_start_geo_trigger;
 static struct GeoTrigger g_finish_geo_trigger;
 
+/*
+ * Where and when we crossed a start/finish or sector line.  The line runs
+ * through the target point, square to our direction of travel.
+ */
+struct line_crossing {
+    GeoPoint point;
+    tiny_millis_t time;
+};
+
 TESTABLE_STATIC void set_active_track(const Track* track)
 {
+    GeoPoint origin = { 0, 0 };
+    if (track)
+        origin = getStartPoint(track);
+
     g_activeTrack = track;
+    gp_projection_init(&g_track_proj, &origin);
+    track_map_reset();
 }
 
 static float degrees_to_meters(float degrees)
@@ -95,26 +163,67 @@ static void start_lap_timing(const tiny_millis_t startTime)
 /**
  * Called when we finish a lap.  Handles timing information.
  */
-static void end_lap_timing(const GpsSnapshot *gpsSnapshot)
+static void end_lap_timing(const tiny_millis_t finishTime)
 {
-    g_lastLapTime = gpsSnapshot->deltaFirstFix - g_lapStartTimestamp;
+    g_lastLapTime = finishTime - g_lapStartTimestamp;
     g_lapStartTimestamp = -1;
 }
 
-static void update_distance(const GpsSnapshot *gpsSnapshot)
+TESTABLE_STATIC void update_distance(const GpsSnapshot *gpsSnapshot)
 {
+    const GpsSample *s = &gpsSnapshot->sample;
     const GeoPoint prev = gpsSnapshot->previousPoint;
-    const GeoPoint curr = gpsSnapshot->sample.point;
+    const GeoPoint curr = s->point;
 
     if (!isValidPoint(&prev) || !isValidPoint(&curr))
         return;
 
-    g_distance += distPythag(&prev, &curr) / 1000;
+    if (s->speed < MIN_MOVING_SPEED_KPH &&
+        gpsSnapshot->previousSpeed < MIN_MOVING_SPEED_KPH)
+        return;
+
+    float meters;
+    if (s->DOP > MAX_DISTANCE_DOP) {
+        const tiny_millis_t dt = gpsSnapshot->deltaFirstFix -
+            gpsSnapshot->previousDeltaFirstFix;
+        if (dt <= 0)
+            return;
+
+        // Average of the two speeds in kph, over dt ms.
+        meters = (s->speed + gpsSnapshot->previousSpeed) * dt / 7200;
+    } else {
+        gp_projection_follow(&g_track_proj, &curr);
+        meters = gp_dist(&g_track_proj, &prev, &curr);
+    }
+
+    const int64_t step = llroundf(meters * 1000000);
+
+    taskENTER_CRITICAL();
+    g_odometer += step;
+    taskEXIT_CRITICAL();
 }
 
+/* Distance from a start point to now, in km */
+static float odometer_since(const int64_t *start)
+{
+    taskENTER_CRITICAL();
+    const int64_t micrometers = g_odometer - *start;
+    taskEXIT_CRITICAL();
+
+    return micrometers / 1e9f;
+}
+
+/**
+ * Starts the lap distance.
+ * @param distance How far into the lap we already are, in km.
+ */
 static void set_distance(const float distance)
 {
-    g_distance = distance;
+    const int64_t into_lap = llroundf(distance * 1e9f);
+
+    taskENTER_CRITICAL();
+    g_lap_start_odometer = g_odometer - into_lap;
+    taskEXIT_CRITICAL();
 }
 
 void lapstats_reset_distance()
@@ -122,14 +231,31 @@ void lapstats_reset_distance()
     set_distance(0);
 }
 
+void lapstats_start_session()
+{
+    taskENTER_CRITICAL();
+    g_session_start_odometer = g_odometer;
+    taskEXIT_CRITICAL();
+}
+
 float getLapDistance()
 {
-    return g_distance;
+    return odometer_since(&g_lap_start_odometer);
 }
 
 float getLapDistanceInMiles()
 {
-    return KMS_TO_MILES_CONSTANT * g_distance;
+    return KMS_TO_MILES_CONSTANT * getLapDistance();
+}
+
+float lapstats_session_distance()
+{
+    return odometer_since(&g_session_start_odometer);
+}
+
+float lapstats_session_distance_miles()
+{
+    return KMS_TO_MILES_CONSTANT * lapstats_session_distance();
 }
 
 TESTABLE_STATIC void reset_current_lap()
@@ -194,6 +320,101 @@ float lapstats_elapsed_time_minutes()
     return tinyMillisToMinutes(lapstats_elapsed_time());
 }
 
+tiny_millis_t lapstats_optimal_lap_time()
+{
+    return g_sectorCount && g_bestSectorsTimed == g_sectorCount ?
+        g_optimalLapTime : 0;
+}
+
+float lapstats_optimal_lap_time_minutes()
+{
+    return tinyMillisToMinutes(lapstats_optimal_lap_time());
+}
+
+tiny_millis_t lapstats_sector_delta()
+{
+    return g_sectorDelta;
+}
+
+float lapstats_sector_delta_seconds()
+{
+    return tinyMillisToSeconds(lapstats_sector_delta());
+}
+
+tiny_millis_t lapstats_optimal_delta()
+{
+    return g_optimalDelta;
+}
+
+float lapstats_optimal_delta_seconds()
+{
+    return tinyMillisToSeconds(lapstats_optimal_delta());
+}
+
+/**
+ * Counts the sectors of a track.  The sector points run up to the first
+ * one that is not set and the finish line ends the last sector.
+ */
+static int count_sectors(const Track *track)
+{
+    const GeoPoint finish = getFinishPoint(track);
+    int count = 0;
+
+    while (count < SECTOR_COUNT - 1 &&
+           !areGeoPointsEqual(getSectorGeoPointAtIndex(track, count), finish))
+        ++count;
+
+    return count + 1;
+}
+
+static void reset_sector_bests(const int sectorCount)
+{
+    memset(g_bestSectorTimes, 0, sizeof(g_bestSectorTimes));
+    g_sectorCount = sectorCount;
+    g_bestSectorsTimed = 0;
+    g_optimalLapTime = 0;
+    g_optimalSplit = 0;
+    g_optimalSplitValid = false;
+    g_sectorDelta = 0;
+    g_optimalDelta = 0;
+}
+
+/**
+ * Compares a sector against the best so far, then keeps it if it is the new
+ * best.  The theoretical best lap follows along without adding it all up
+ * again.
+ * @param sector The sector just finished.
+ * @param sectorTime How long it took.
+ * @param lapTime How far into the lap we finished it.
+ */
+static void update_sector_bests(const int sector, const tiny_millis_t sectorTime,
+                                const tiny_millis_t lapTime)
+{
+    if (sector < 0 || sector >= g_sectorCount || sectorTime <= 0)
+        return;
+
+    tiny_millis_t *best = g_bestSectorTimes + sector;
+    if (*best) {
+        g_sectorDelta = sectorTime - *best;
+        g_optimalSplit += *best;
+    } else {
+        g_sectorDelta = 0;
+        g_optimalSplitValid = false;
+    }
+    g_optimalDelta = g_optimalSplitValid ? lapTime - g_optimalSplit : 0;
+
+    if (*best && sectorTime >= *best)
+        return;
+
+    if (*best)
+        g_optimalLapTime -= *best;
+    else
+        ++g_bestSectorsTimed;
+
+    g_optimalLapTime += sectorTime;
+    *best = sectorTime;
+}
+
 tiny_millis_t getLastSectorTime()
 {
     return g_lastSectorTime;
@@ -214,16 +435,112 @@ int getAtSector()
     return g_atTarget;
 }
 
+/**
+ * Works out what fraction of the time between the previous fix and the
+ * current one it took to cover the given fraction of the distance between
+ * them.  Speed is taken to change steadily between the fixes.
+ * @param fraction How much of the distance between the fixes was covered.
+ * @param v0 Speed at the previous fix.
+ * @param v1 Speed at the current fix.
+ * @return The fraction of the time between the fixes that this took.
+ */
+static float time_fraction(const float fraction, const float v0,
+                           const float v1)
+{
+    /*
+     * With constant acceleration the distance covered by time t is
+     * v0 * t + (v1 - v0) * t^2 / 2.  Solving for the time at which that is
+     * the given fraction of the whole gives us this.
+     */
+    const float den = v0 + sqrtf(v0 * v0 + fraction * (v1 * v1 - v0 * v0));
+    if (v0 < 0 || v1 < 0 || den <= 0)
+        return fraction;
+
+    return fraction * (v0 + v1) / den;
+}
+
+/**
+ * Checks whether we crossed the line through the target between the
+ * previous fix and the current one, and if so works out where and when.
+ * The line is square to our direction of travel, so it is the
+ * perpendicular bisector of the target circle for the path we take
+ * through it.  Where we cross it must be within the circle, but neither
+ * fix has to be.
+ * @param snap The GPS state of the current fix.
+ * @param target The point the line goes through.
+ * @param radius The radius of the target circle.
+ * @param crossing Where the point and time of the crossing go.
+ * @return true if we crossed the line, false otherwise.
+ */
+static bool get_line_crossing(const GpsSnapshot *snap, const GeoPoint *target,
+                              const float radius,
+                              struct line_crossing *crossing)
+{
+    const GeoPoint prev = snap->previousPoint;
+    const GeoPoint curr = snap->sample.point;
+    const float radiusSq = radius * radius;
+
+    crossing->point = curr;
+    crossing->time = snap->deltaFirstFix;
+    gp_projection_follow(&g_track_proj, target);
+
+    // Without a previous fix the best we can do is the current one.
+    if (!isValidPoint(&prev) || areGeoPointsEqual(prev, curr))
+        return gp_dist_sq(&g_track_proj, &curr, target) <= radiusSq;
+
+    // How far along from prev to curr we are level with the target.
+    const float pct = gp_fraction_along(&g_track_proj, &prev, &curr, target);
+    if (pct > 1)
+        return false;
+
+    // Already past the line at prev.  Only count it if we are at the target.
+    if (!(pct >= 0)) {
+        crossing->point = prev;
+        crossing->time = snap->previousDeltaFirstFix;
+        return gp_dist_sq(&g_track_proj, &curr, target) <= radiusSq;
+    }
+
+    crossing->point.latitude = prev.latitude + (int32_t)
+        lroundf(pct * (float) ((int64_t) curr.latitude - prev.latitude));
+    crossing->point.longitude = prev.longitude + (int32_t)
+        lroundf(pct * (float) ((int64_t) curr.longitude - prev.longitude));
+    if (gp_dist_sq(&g_track_proj, &crossing->point, target) > radiusSq)
+        return false;
+
+    const tiny_millis_t dt = snap->deltaFirstFix - snap->previousDeltaFirstFix;
+    if (dt <= 0)
+        return true;
+
+    /* Back from the current fix so that a crossing right on it is exact */
+    const float tPct = time_fraction(pct, snap->previousSpeed,
+                                     snap->sample.speed);
+    crossing->time -= (tiny_millis_t) lroundf((1 - tPct) * dt);
+
+    return true;
+}
+
 /**
  * Called whenever we finish a lap.
+ * @param point Where we crossed the finish line.
+ * @param time When we crossed the finish line.
  */
-TESTABLE_STATIC void lap_finished_event(const GpsSnapshot *gpsSnapshot)
+TESTABLE_STATIC void lap_finished_event(const GeoPoint *point,
+                                        const tiny_millis_t time)
 {
     pr_debug_int_msg("Finished Lap ", g_lapCount);
 
     ++g_lapCount;
-    end_lap_timing(gpsSnapshot);
-    finishLap(gpsSnapshot);
+    end_lap_timing(time);
+
+    const struct lap_event e = {
+        LAP_EVENT_LAP, g_lapCount, 0, g_lastLapTime, time,
+    };
+    lap_events_push(&e);
+
+    const bool fastLap = finishLap(point, time);
+    const bool mapped = track_map_finish_lap(point);
+    if (fastLap || mapped)
+        fast_lap_store_save(g_activeTrack);
 
     // If in Circuit Mode, don't set cool off after finish.
     if (g_activeTrack->track_type == TRACK_TYPE_CIRCUIT)
@@ -238,17 +555,20 @@ TESTABLE_STATIC void lap_finished_event(const GpsSnapshot *gpsSnapshot)
 }
 
 static void _lap_started_event(const tiny_millis_t time, const GeoPoint *sp,
-                               const float distance, const GpsSnapshot *gpsSnapshot)
+                               const float distance)
 {
     // Timing and predictive timing
     ++g_lap;
     start_lap_timing(time);
     startLap(sp, time);
+    track_map_start_lap(sp);
     reset_elapsed_time();
 
     // Reset the sector logic
     g_lastSectorTimestamp = time;
     g_sector = 0;
+    g_optimalSplit = 0;
+    g_optimalSplitValid = true;
 
     // Reset distance logic
     set_distance(distance);
@@ -262,13 +582,14 @@ static void _lap_started_event(const tiny_millis_t time, const GeoPoint *sp,
 
 /**
  * Called whenever we start a new lap the normal way (ie no launch control).
+ * @param point Where we crossed the start line.
+ * @param time When we crossed the start line.
  */
-TESTABLE_STATIC void lap_started_normal_event(const GpsSnapshot *gpsSnapshot)
+TESTABLE_STATIC void lap_started_normal_event(const GeoPoint *point,
+                                              const tiny_millis_t time)
 {
-    const tiny_millis_t time = gpsSnapshot->deltaFirstFix;
-    const GeoPoint gp = gpsSnapshot->sample.point;
     pr_debug_int_msg("Start Lap ", g_lapCount);
-    _lap_started_event(time, &gp, 0, gpsSnapshot);
+    _lap_started_event(time, point, 0);
 }
 
 /**
@@ -280,26 +601,48 @@ static void lap_started_launched_event(const GpsSnapshot *gpsSnapshot)
     const tiny_millis_t time = lc_getLaunchTime();
     const GeoPoint sp = getStartPoint(g_activeTrack);
     const GeoPoint gp = gpsSnapshot->sample.point;
-    const float distance = distPythag(&sp, &gp) / 1000;
+    const float distance = gp_dist(&g_track_proj, &sp, &gp) / 1000;
     pr_debug_int_msg("Start lap w/launch ", g_lapCount);
-    _lap_started_event(time, &sp, distance, gpsSnapshot);
+    _lap_started_event(time, &sp, distance);
 }
 
 /**
  * Called whenever we have hit a sector boundary.
+ * @param millis When we crossed the sector line.
  */
-static void sectorBoundaryEvent(const GpsSnapshot *gpsSnapshot)
+static void sectorBoundaryEvent(const tiny_millis_t millis)
 {
-    const tiny_millis_t millis = gpsSnapshot->deltaFirstFix;
-
     pr_debug_int_msg("Sector boundary ", g_sector);
 
     g_lastSectorTime = millis - g_lastSectorTimestamp;
     g_lastSectorTimestamp = millis;
+    update_sector_bests(g_sector, g_lastSectorTime, millis - g_lapStartTimestamp);
+
+    const struct lap_event e = {
+        LAP_EVENT_SECTOR, g_lap, g_sector, g_lastSectorTime, millis,
+    };
+    lap_events_push(&e);
+
     g_lastSector = g_sector;
     ++g_sector;
 }
 
+/**
+ * Sends out the predicted lap time as it stands at the current fix.
+ */
+static void publish_prediction(const GpsSnapshot *snap)
+{
+    if (!isPredictiveTimeAvailable())
+        return;
+
+    const struct lap_event e = {
+        LAP_EVENT_PREDICTED, g_lap, 0,
+        getPredictedTime(&snap->sample.point, snap->deltaFirstFix),
+        snap->deltaFirstFix,
+    };
+    lap_events_push(&e);
+}
+
 /**
  * All logic associated with determining if we are at the finish line.
  */
@@ -311,15 +654,13 @@ static void processFinishLogic(const GpsSnapshot *gpsSnapshot,
     if (!isGeoTriggerTripped(&g_finish_geo_trigger))
         return;
 
-    const GeoPoint point = gpsSnapshot->sample.point;
     const GeoPoint finishPoint = getFinishPoint(track);
-    const struct GeoCircle finishCircle = gc_createGeoCircle(finishPoint,
-                                          targetRadius);
-    if (!gc_isPointInGeoCircle(&point, finishCircle))
+    struct line_crossing crossing;
+    if (!get_line_crossing(gpsSnapshot, &finishPoint, targetRadius, &crossing))
         return;
 
     // If we get here, then we have completed a lap.
-    lap_finished_event(gpsSnapshot);
+    lap_finished_event(&crossing.point, crossing.time);
 }
 
 /**
@@ -339,7 +680,14 @@ static void processStartLogic(const GpsSnapshot *gpsSnapshot,
      * in reporting.
      */
     if (g_lapCount > 0 && track->track_type == TRACK_TYPE_CIRCUIT) {
-        lap_started_normal_event(gpsSnapshot);
+        /*
+         * We got here from the finish, which is the same line.  Start the
+         * lap where it finished so that no time falls between the two.
+         */
+        const GeoPoint startPoint = getStartPoint(track);
+        struct line_crossing crossing;
+        get_line_crossing(gpsSnapshot, &startPoint, targetRadius, &crossing);
+        lap_started_normal_event(&crossing.point, crossing.time);
         return;
     }
 
@@ -368,15 +716,15 @@ static void processSectorLogic(const GpsSnapshot *gpsSnapshot,
         return;
 
     const GeoPoint point = getSectorGeoPointAtIndex(track, g_sector);
-    const struct GeoCircle circle = gc_createGeoCircle(point, radius);
-    const GeoPoint curr = gpsSnapshot->sample.point;
+    struct line_crossing crossing;
 
-    g_atTarget = gc_isPointInGeoCircle(&curr, circle);
+    g_atTarget = get_line_crossing(gpsSnapshot, &point, radius, &crossing);
     if (!g_atTarget)
         return;
 
     // If we are here, then we are at a Sector boundary.
-    sectorBoundaryEvent(gpsSnapshot);
+    sectorBoundaryEvent(crossing.time);
+    publish_prediction(gpsSnapshot);
 }
 
 void lapstats_config_changed(void)
@@ -387,7 +735,10 @@ void lapstats_config_changed(void)
 
 void lapStats_init()
 {
+    g_odometer = 0;
     lapstats_reset_distance();
+    lapstats_start_session();
+    lap_events_reset();
     reset_elapsed_time();
     set_active_track(NULL);
     resetPredictiveTimer();
@@ -403,6 +754,7 @@ void lapStats_init()
     g_lapCount = 0;
     g_sector = -1;     // Indicates we haven't crossed start/finish yet.
     g_lastSector = -1; // Indicates no previous sector.
+    reset_sector_bests(0);
 }
 
 static int isStartFinishEnabled(const Track *track)
@@ -445,6 +797,7 @@ static void lapstats_location_updated(const GpsSnapshot *gps_snapshot)
     const float target_radius = degrees_to_meters(config->TrackConfigs.radius);
 
     update_distance(gps_snapshot);
+    fast_lap_store_apply();
 
     if (!g_start_finish_enabled)
         return;
@@ -466,6 +819,9 @@ static void lapstats_location_updated(const GpsSnapshot *gps_snapshot)
     }
     processFinishLogic(gps_snapshot, g_activeTrack, target_radius);
     processStartLogic(gps_snapshot, g_activeTrack, target_radius);
+
+    // After the lap events, so that the map is learned from start to finish.
+    track_map_update(gps_snapshot);
 }
 
 static void lapstats_setup(const GpsSnapshot *gps_snapshot)
@@ -487,9 +843,13 @@ static void lapstats_setup(const GpsSnapshot *gps_snapshot)
 
     if (!track) return;
 
+    // Pick up where we left off on this track before the last power cycle.
+    fast_lap_store_load(track);
+
     g_track_status = TRACK_STATUS_AUTO_DETECTED;
     g_start_finish_enabled = isStartFinishEnabled(track);
     g_sector_enabled = isSectorTrackingEnabled(track);
+    reset_sector_bests(g_sector_enabled ? count_sectors(track) : 0);
     lc_reset();
     lc_setup(track, target_radius);
     setupGeoTriggers(trackConfig, track);
@@ -0,0 +1,448 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fnv.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "mod_string.h"
+#include "track_map.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if TRACK_MAP_POINTS < 4
+#error "TRACK_MAP_POINTS must be at least 4"
+#endif
+
+#define KMS_TO_MILES	0.621371f
+
+/* Fixes held since the last point kept */
+#define WINDOW_SIZE	16
+
+/* A lap with fixes further apart than this, or a worse DOP, is not clean */
+#define MAX_GAP_MS	1000
+#define MAX_DOP		5.0f
+
+/* Shorter than this and what we drove was not a lap of a track */
+#define MIN_LAP_LENGTH	100.0f
+
+/* Segments searched past the last match, and before it */
+#define SEARCH_AHEAD	4
+#define SEARCH_BEHIND	1
+
+/* Further than this from the segments searched and we search them all */
+#define LOST_DISTANCE	30.0f
+
+#define MAGIC		0x50414d54
+#define HEADER_SIZE	20
+#define POINT_SIZE	12
+#define HASH_SIZE	4
+
+enum map_state {
+        MAP_NONE,
+        MAP_LEARNING,
+        /* Something went wrong with the lap.  We try again with the next */
+        MAP_FAILED,
+        MAP_READY,
+};
+
+static struct track_map_point g_points[TRACK_MAP_POINTS];
+
+static struct {
+        enum map_state state;
+        size_t count;
+        float tolerance;
+        struct gp_projection frame;
+
+        /* The fixes since the last point kept, while learning */
+        struct track_map_point window[WINDOW_SIZE];
+        size_t window_count;
+        struct track_map_point last;
+        tiny_millis_t last_time;
+
+        /* Where the last fix was placed on the outline */
+        bool matched;
+        size_t segment;
+        float distance;
+} g_map;
+
+void track_map_reset(void)
+{
+        memset(&g_map, 0, sizeof(g_map));
+        g_map.tolerance = TRACK_MAP_TOLERANCE;
+}
+
+/**
+ * The distance from a point to a segment, squared.
+ * @param along Where the closest point on the segment is, 0 at a and 1
+ * at b.
+ */
+static float segment_dist_sq(const GeoPoint *a, const GeoPoint *b,
+                             const GeoPoint *m, float *along)
+{
+        float ax, ay, bx, by, mx, my;
+        gp_project(&g_map.frame, a, &ax, &ay);
+        gp_project(&g_map.frame, b, &bx, &by);
+        gp_project(&g_map.frame, m, &mx, &my);
+
+        const float dx = bx - ax;
+        const float dy = by - ay;
+        const float len_sq = dx * dx + dy * dy;
+        float t = len_sq > 0 ? ((mx - ax) * dx + (my - ay) * dy) / len_sq : 0;
+        if (t < 0)
+                t = 0;
+        if (t > 1)
+                t = 1;
+
+        const float ex = ax + t * dx - mx;
+        const float ey = ay + t * dy - my;
+        if (along)
+                *along = t;
+        return ex * ex + ey * ey;
+}
+
+/**
+ * @return true if any of the points is further than the tolerance from
+ * the segment.
+ */
+static bool strays(const struct track_map_point *a,
+                   const struct track_map_point *b,
+                   const struct track_map_point *pts, const size_t count,
+                   const float tolerance)
+{
+        const float tol_sq = tolerance * tolerance;
+        for (size_t i = 0; i < count; ++i)
+                if (segment_dist_sq(&a->point, &b->point, &pts[i].point,
+                                    NULL) > tol_sq)
+                        return true;
+
+        return false;
+}
+
+/*
+ * Simplifies the points we have with the same opening window, in place.
+ * The first and last are always kept.
+ */
+static void simplify(const float tolerance)
+{
+        size_t out = 1;
+        size_t anchor = 0;
+
+        for (size_t i = 2; i < g_map.count; ++i) {
+                if (!strays(g_points + anchor, g_points + i,
+                            g_points + anchor + 1, i - anchor - 1, tolerance))
+                        continue;
+
+                g_points[out++] = g_points[i - 1];
+                anchor = i - 1;
+        }
+
+        g_points[out++] = g_points[g_map.count - 1];
+        g_map.count = out;
+}
+
+static void keep(const struct track_map_point *tp)
+{
+        while (g_map.count >= TRACK_MAP_POINTS) {
+                g_map.tolerance *= 2;
+                simplify(g_map.tolerance);
+        }
+
+        g_points[g_map.count++] = *tp;
+}
+
+static void learn(const GeoPoint *point, const float distance)
+{
+        const struct track_map_point tp = { *point, distance };
+        const struct track_map_point *anchor = g_points + g_map.count - 1;
+
+        if (strays(anchor, &tp, g_map.window, g_map.window_count,
+                   g_map.tolerance)) {
+                keep(g_map.window + g_map.window_count - 1);
+                g_map.window_count = 0;
+        }
+
+        /* A long straight.  Every other fix is plenty to test against */
+        if (WINDOW_SIZE == g_map.window_count) {
+                for (size_t i = 0; i < WINDOW_SIZE / 2; ++i)
+                        g_map.window[i] = g_map.window[2 * i + 1];
+                g_map.window_count = WINDOW_SIZE / 2;
+        }
+
+        g_map.window[g_map.window_count++] = tp;
+        g_map.last = tp;
+}
+
+void track_map_start_lap(const GeoPoint *start)
+{
+        if (MAP_READY == g_map.state)
+                return;
+
+        track_map_reset();
+        gp_projection_init(&g_map.frame, start);
+        g_map.state = MAP_LEARNING;
+
+        const struct track_map_point tp = { *start, 0 };
+        g_points[g_map.count++] = tp;
+        g_map.last = tp;
+        g_map.last_time = -1;
+}
+
+static void learn_fix(const GpsSnapshot *snap)
+{
+        const GeoPoint *point = &snap->sample.point;
+        const tiny_millis_t gap = snap->deltaFirstFix - g_map.last_time;
+
+        if (!isValidPoint(point) || snap->sample.DOP > MAX_DOP ||
+            (g_map.last_time >= 0 && gap > MAX_GAP_MS)) {
+                g_map.state = MAP_FAILED;
+                return;
+        }
+
+        gp_projection_follow(&g_map.frame, point);
+        learn(point, g_map.last.distance +
+              gp_dist(&g_map.frame, &g_map.last.point, point));
+        g_map.last_time = snap->deltaFirstFix;
+}
+
+bool track_map_finish_lap(const GeoPoint *finish)
+{
+        if (MAP_LEARNING != g_map.state)
+                return false;
+
+        learn(finish, g_map.last.distance +
+              gp_dist(&g_map.frame, &g_map.last.point, finish));
+        keep(g_map.window + g_map.window_count - 1);
+        g_map.window_count = 0;
+
+        if (g_map.count < 3 || g_points[g_map.count - 1].distance <
+            MIN_LAP_LENGTH) {
+                g_map.state = MAP_FAILED;
+                return false;
+        }
+
+        g_map.state = MAP_READY;
+        g_map.matched = false;
+        return true;
+}
+
+/**
+ * Finds the segment closest to a point, out of count of them from first
+ * on.
+ * @return The distance to it, squared.
+ */
+static float search(const GeoPoint *point, const size_t first,
+                    const size_t count, size_t *segment, float *along)
+{
+        const size_t segments = g_map.count - 1;
+        float best = INFINITY;
+
+        for (size_t i = 0; i < count; ++i) {
+                const size_t s = (first + i) % segments;
+                float t;
+                const float d = segment_dist_sq(&g_points[s].point,
+                                                &g_points[s + 1].point,
+                                                point, &t);
+                if (d < best) {
+                        best = d;
+                        *segment = s;
+                        *along = t;
+                }
+        }
+
+        return best;
+}
+
+static void place_fix(const GpsSnapshot *snap)
+{
+        const GeoPoint *point = &snap->sample.point;
+        if (!isValidPoint(point))
+                return;
+
+        gp_projection_follow(&g_map.frame, point);
+
+        const size_t segments = g_map.count - 1;
+        size_t segment = 0;
+        float along = 0;
+        float dist_sq = INFINITY;
+
+        if (g_map.matched) {
+                const size_t window = SEARCH_BEHIND + 1 + SEARCH_AHEAD;
+                dist_sq = search(point,
+                                 g_map.segment + segments - SEARCH_BEHIND,
+                                 window < segments ? window : segments,
+                                 &segment, &along);
+        }
+
+        if (dist_sq > LOST_DISTANCE * LOST_DISTANCE)
+                dist_sq = search(point, 0, segments, &segment, &along);
+
+        g_map.matched = dist_sq <= LOST_DISTANCE * LOST_DISTANCE;
+        g_map.segment = segment;
+
+        const float d0 = g_points[segment].distance;
+        const float d1 = g_points[segment + 1].distance;
+        g_map.distance = d0 + along * (d1 - d0);
+}
+
+void track_map_update(const GpsSnapshot *snap)
+{
+        switch (g_map.state) {
+        case MAP_LEARNING:
+                learn_fix(snap);
+                break;
+        case MAP_READY:
+                place_fix(snap);
+                break;
+        default:
+                break;
+        }
+}
+
+bool track_map_available(void)
+{
+        return MAP_READY == g_map.state;
+}
+
+size_t track_map_count(void)
+{
+        return g_map.count;
+}
+
+const struct track_map_point* track_map_points(void)
+{
+        return g_points;
+}
+
+float track_map_tolerance(void)
+{
+        return g_map.tolerance;
+}
+
+float track_map_distance(void)
+{
+        return track_map_available() ? g_map.distance : 0;
+}
+
+float track_map_distance_miles(void)
+{
+        return KMS_TO_MILES * track_map_distance() / 1000;
+}
+
+float track_map_lap_percent(void)
+{
+        if (!track_map_available())
+                return 0;
+
+        return 100 * g_map.distance / g_points[g_map.count - 1].distance;
+}
+
+static uint8_t* put_u32(uint8_t *b, const uint32_t v)
+{
+        for (int i = 0; i < 4; ++i)
+                *b++ = v >> (8 * i);
+        return b;
+}
+
+static uint32_t get_u32(const uint8_t *b)
+{
+        return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+static uint32_t float_bits(const float f)
+{
+        uint32_t v;
+        memcpy(&v, &f, sizeof(v));
+        return v;
+}
+
+static float bits_float(const uint32_t v)
+{
+        float f;
+        memcpy(&f, &v, sizeof(f));
+        return f;
+}
+
+size_t track_map_save(const int32_t track_id, const uint32_t track_hash,
+                      uint8_t *buf, const size_t size)
+{
+        const size_t len = HEADER_SIZE + g_map.count * POINT_SIZE + HASH_SIZE;
+        if (!track_map_available() || len > size)
+                return 0;
+
+        uint8_t *b = buf;
+        b = put_u32(b, MAGIC);
+        b = put_u32(b, TRACK_MAP_FORMAT_VERSION | g_map.count << 16);
+        b = put_u32(b, track_id);
+        b = put_u32(b, track_hash);
+        b = put_u32(b, float_bits(g_map.tolerance));
+
+        for (size_t i = 0; i < g_map.count; ++i) {
+                const struct track_map_point *tp = g_points + i;
+                b = put_u32(b, tp->point.latitude);
+                b = put_u32(b, tp->point.longitude);
+                /* In cm */
+                b = put_u32(b, (uint32_t) lroundf(tp->distance * 100));
+        }
+
+        b = put_u32(b, fnv1a_32(FNV1A_32_INIT, buf, b - buf));
+        return b - buf;
+}
+
+bool track_map_load(const int32_t track_id, const uint32_t track_hash,
+                    const uint8_t *buf, const size_t len)
+{
+        if (track_map_available())
+                return false;
+
+        if (len < HEADER_SIZE + HASH_SIZE || get_u32(buf) != MAGIC ||
+            (get_u32(buf + 4) & 0xffff) != TRACK_MAP_FORMAT_VERSION)
+                return false;
+
+        const size_t count = get_u32(buf + 4) >> 16;
+        if (count < 3 || count > TRACK_MAP_POINTS ||
+            len != HEADER_SIZE + count * POINT_SIZE + HASH_SIZE ||
+            get_u32(buf + len - HASH_SIZE) !=
+            fnv1a_32(FNV1A_32_INIT, buf, len - HASH_SIZE))
+                return false;
+
+        if ((int32_t) get_u32(buf + 8) != track_id ||
+            get_u32(buf + 12) != track_hash)
+                return false;
+
+        track_map_reset();
+        g_map.tolerance = bits_float(get_u32(buf + 16));
+
+        const uint8_t *b = buf + HEADER_SIZE;
+        for (size_t i = 0; i < count; ++i, b += POINT_SIZE) {
+                struct track_map_point *tp = g_points + i;
+                tp->point.latitude = (int32_t) get_u32(b);
+                tp->point.longitude = (int32_t) get_u32(b + 4);
+                tp->distance = get_u32(b + 8) / 100.0f;
+        }
+
+        g_map.count = count;
+        gp_projection_init(&g_map.frame, &g_points[0].point);
+        g_map.state = MAP_READY;
+        return true;
+}
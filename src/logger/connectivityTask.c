@@ -21,6 +21,11 @@
 #include "null_device.h"
 #include "bluetooth.h"
 #include "sim900.h"
+#include "loggerTaskEx.h"
+#include "lap_events.h"
+#include "telemetry_rate.h"
+#include "telemetry_subscription.h"
+#include "telemetry_datagram.h"
 
 
 #if (CONNECTIVITY_CHANNELS == 1)
@@ -36,12 +41,20 @@
 
 #define IDLE_TIMEOUT							configTICK_RATE_HZ / 10
 #define INIT_DELAY	 							600
+/* How often we step a connection that is still coming up */
+#define INIT_POLL_DELAY							(configTICK_RATE_HZ / 50)
 #define BUFFER_SIZE 							1025
 #define TELEMETRY_DISCONNECT_TIMEOUT            60000
 
 #define TELEMETRY_STACK_SIZE  					1000
 #define SAMPLE_RECORD_QUEUE_SIZE				10
 #define BAD_MESSAGE_THRESHOLD					10
+/* How long to wait for the rest of a message too big for the buffer */
+#define STREAM_TIMEOUT_MS						1000
+
+#define RX_NONE									0
+#define RX_MESSAGE								1
+#define RX_OVERFLOW								2
 
 #define METADATA_SAMPLE_INTERVAL				100
 
@@ -65,24 +78,39 @@ static int processRxBuffer(Serial *serial, char *buffer, size_t *rxCount)
     size_t count = serial->get_line_wait(buffer + *rxCount, BUFFER_SIZE - *rxCount, 0);
 
     *rxCount += count;
-    int processMsg = 0;
+    int processMsg = RX_NONE;
 
-    if (*rxCount >= BUFFER_SIZE - 1) {
-        buffer[BUFFER_SIZE - 1] = '\0';
-        *rxCount = BUFFER_SIZE - 1;
-        processMsg = 1;
-        pr_error_str_msg("Rx Buffer overflow:", buffer);
-    }
     if (*rxCount > 0) {
         char lastChar = buffer[*rxCount - 1];
         if ('\r' == lastChar || '\n' == lastChar) {
             *rxCount = trimBuffer(buffer, *rxCount);
-            processMsg = 1;
+            processMsg = RX_MESSAGE;
+        } else if (*rxCount >= BUFFER_SIZE - 1) {
+            buffer[BUFFER_SIZE - 1] = '\0';
+            *rxCount = BUFFER_SIZE - 1;
+            processMsg = RX_OVERFLOW;
         }
     }
     return processMsg;
 }
 
+/*
+ * The message is bigger than our buffer.  Hand what we have to the
+ * streaming parser and keep reading into the buffer until the line ends.
+ */
+static int streamRxBuffer(Serial *serial, char *buffer, size_t count)
+{
+    pr_debug("conn: streaming large message\r\n");
+    api_stream_begin(serial);
+    api_stream_feed(buffer, count);
+
+    while (count > 0 && buffer[count - 1] != '\n') {
+        count = serial->get_line_wait(buffer, BUFFER_SIZE, msToTicks(STREAM_TIMEOUT_MS));
+        api_stream_feed(buffer, count);
+    }
+    return api_stream_end();
+}
+
 void queueTelemetryRecord(const LoggerMessage *msg)
 {
     for (size_t i = 0; i < CONNECTIVITY_CHANNELS; i++)
@@ -109,6 +137,8 @@ static void createCombinedTelemetryTask(int16_t priority, xQueueHandle sampleQue
         params->sampleQueue = sampleQueue;
         params->connection_timeout = 0;
         params->always_streaming = false;
+        params->begin_datagram = NULL;
+        params->end_datagram = NULL;
 
         if (btEnabled) {
             params->check_connection_status = &bt_check_connection_status;
@@ -122,6 +152,8 @@ static void createCombinedTelemetryTask(int16_t priority, xQueueHandle sampleQue
             params->check_connection_status = &sim900_check_connection_status;
             params->init_connection = &sim900_init_connection;
             params->disconnect = &sim900_disconnect;
+            params->begin_datagram = &sim900_begin_datagram;
+            params->end_datagram = &sim900_end_datagram;
             params->always_streaming = false;
         }
         xTaskCreate(connectivityTask, (signed portCHAR *) "connTask", TELEMETRY_STACK_SIZE, params, priority, NULL );
@@ -138,6 +170,8 @@ static void createWirelessConnectionTask(int16_t priority, xQueueHandle sampleQu
     params->check_connection_status = &bt_check_connection_status;
     params->disconnect = &bt_disconnect;
     params->init_connection = &bt_init_connection;
+    params->begin_datagram = NULL;
+    params->end_datagram = NULL;
     params->serial = SERIAL_WIRELESS;
     params->sampleQueue = sampleQueue;
     params->always_streaming = true;
@@ -154,6 +188,8 @@ static void createTelemetryConnectionTask(int16_t priority, xQueueHandle sampleQ
     params->disconnect = &sim900_disconnect;
     params->check_connection_status = &sim900_check_connection_status;
     params->init_connection = &sim900_init_connection;
+    params->begin_datagram = &sim900_begin_datagram;
+    params->end_datagram = &sim900_end_datagram;
     params->serial = SERIAL_TELEMETRY;
     params->sampleQueue = sampleQueue;
     params->always_streaming = false;
@@ -203,6 +239,112 @@ void startConnectivityTask(int16_t priority)
         }
 }
 
+/* The rate we stream at before any backpressure */
+static int get_stream_rate(const struct telemetry_subscription *sub)
+{
+    return telemetry_subscription_get_rate(sub,
+                                           getTelemetrySampleRate(getWorkingLoggerConfig()));
+}
+
+/*
+ * Keeps up with the logger while we have no connection.  Samples have
+ * nowhere to go and are dropped so they don't back up the queue, but we
+ * follow logging starting and stopping.
+ * @return Whether logging is enabled.
+ */
+static bool wait_offline(xQueueHandle sampleQueue, bool logging_enabled, size_t ticks)
+{
+    const size_t start = getCurrentTicks();
+    LoggerMessage msg;
+    size_t elapsed;
+
+    while ((elapsed = getCurrentTicks() - start) < ticks) {
+        if (pdFALSE == receive_logger_message(sampleQueue, &msg, ticks - elapsed))
+            break;
+
+        switch(msg.type) {
+        case LoggerMessageType_Start:
+            logging_enabled = true;
+            break;
+        case LoggerMessageType_Stop:
+            logging_enabled = false;
+            break;
+        default:
+            break;
+        }
+    }
+    return logging_enabled;
+}
+
+/*
+ * Everything we send is a line of its own, or a datagram of its own if
+ * the connection works in datagrams.
+ * @return false if the datagram could not be started.
+ */
+static bool begin_message(const ConnParams *params, DeviceConfig *config)
+{
+    return !config->datagram || 0 == params->begin_datagram(config);
+}
+
+static void end_message(const ConnParams *params, DeviceConfig *config)
+{
+    if (config->datagram)
+        params->end_datagram(config);
+    else
+        put_crlf(config->serial);
+}
+
+/*
+ * Sends the sample as a datagram, after the channel meta in as many
+ * datagrams as it takes if that is due.
+ */
+static void send_datagram(const ConnParams *params, DeviceConfig *config,
+                          struct telemetry_datagram *td,
+                          const struct sample *sample, size_t tick,
+                          bool drop_low_priority,
+                          const struct telemetry_subscription *filter)
+{
+    Serial *serial = config->serial;
+    const uint32_t layout = telemetry_datagram_layout(td, filter);
+
+    if (telemetry_datagram_meta_due(td)) {
+        const size_t count = telemetry_subscription_channel_count(filter, sample);
+        for (size_t i = 0; i < count; i += TELEMETRY_DATAGRAM_META_CHANNELS) {
+            if (!begin_message(params, config))
+                return;
+            api_send_meta_datagram(serial, sample, telemetry_datagram_next_seq(td),
+                                   layout, i, TELEMETRY_DATAGRAM_META_CHANNELS,
+                                   filter);
+            end_message(params, config);
+        }
+        telemetry_datagram_meta_sent(td);
+    }
+
+    if (!begin_message(params, config))
+        return;
+    api_send_sample_datagram(serial, sample, telemetry_datagram_next_seq(td),
+                             tick, layout, drop_low_priority, filter);
+    end_message(params, config);
+}
+
+/*
+ * Sends the lap and sector events that came in since we last looked,
+ * whatever the telemetry rate is.  Those that come in while we are not
+ * streaming are passed over.
+ */
+static void send_lap_events(const ConnParams *params, DeviceConfig *config,
+                            uint32_t *pos, bool should_stream)
+{
+    struct lap_event e;
+    while (lap_events_read(pos, &e)) {
+        if (!should_stream || !begin_message(params, config))
+            continue;
+
+        api_send_lap_event(config->serial, &e);
+        end_message(params, config);
+    }
+}
+
 static void toggle_connectivity_indicator()
 {
     LED_toggle(0);
@@ -235,15 +377,32 @@ void connectivityTask(void *params)
     const LoggerConfig *logger_config = getWorkingLoggerConfig();
 
     bool logging_enabled = false;
+    struct telemetry_datagram datagram;
+    telemetry_datagram_init(&datagram);
+    struct telemetry_rate rate_ctl;
+    struct telemetry_subscription *sub = telemetry_subscription_get(serial);
 
     while (1) {
         bool should_stream = logging_enabled ||
                              logger_config->ConnectivityConfigs.telemetryConfig.backgroundStreaming ||
                              connParams->always_streaming;
 
-        while (should_stream && connParams->init_connection(&deviceConfig) != DEVICE_INIT_SUCCESS) {
-            pr_info("conn: not connected. retrying\r\n");
-            vTaskDelay(INIT_DELAY);
+        deviceConfig.datagram = false;
+        while (should_stream) {
+            const int init = connParams->init_connection(&deviceConfig);
+            if (DEVICE_INIT_SUCCESS == init)
+                break;
+
+            size_t wait = INIT_POLL_DELAY;
+            if (DEVICE_INIT_PENDING != init) {
+                pr_info("conn: not connected. retrying\r\n");
+                wait = INIT_DELAY;
+            }
+
+            logging_enabled = wait_offline(sampleQueue, logging_enabled, wait);
+            should_stream = logging_enabled ||
+                            logger_config->ConnectivityConfigs.telemetryConfig.backgroundStreaming ||
+                            connParams->always_streaming;
         }
 
         serial->flush();
@@ -252,6 +411,14 @@ void connectivityTask(void *params)
         size_t tick = 0;
         size_t last_message_time = getUptimeAsInt();
         bool should_reconnect = false;
+        bool meta_pending = false;
+        uint32_t lap_event_pos = lap_events_position();
+
+        /* A new connection starts out with everything */
+        if (sub)
+            telemetry_subscription_clear(sub);
+        size_t sub_generation = sub ? sub->generation : 0;
+        telemetry_rate_init(&rate_ctl, get_stream_rate(sub));
 
         while (1) {
             if ( should_reconnect )
@@ -271,18 +438,23 @@ void connectivityTask(void *params)
             if (pdFALSE != res) {
                 switch(msg.type) {
                 case LoggerMessageType_Start: {
-                    api_sendLogStart(serial);
-                    put_crlf(serial);
+                    if (begin_message(connParams, &deviceConfig)) {
+                        api_sendLogStart(serial);
+                        end_message(connParams, &deviceConfig);
+                    }
                     tick = 0;
                     logging_enabled = true;
+                    telemetry_rate_init(&rate_ctl, get_stream_rate(sub));
                     /* If we're not already streaming trigger a re-connect */
                     if (!should_stream)
                         should_reconnect = true;
                     break;
                 }
                 case LoggerMessageType_Stop: {
-                    api_sendLogEnd(serial);
-                    put_crlf(serial);
+                    if (begin_message(connParams, &deviceConfig)) {
+                        api_sendLogEnd(serial);
+                        end_message(connParams, &deviceConfig);
+                    }
                     if (! (logger_config->ConnectivityConfigs.telemetryConfig.backgroundStreaming ||
                            connParams->always_streaming))
                         should_reconnect = true;
@@ -293,16 +465,70 @@ void connectivityTask(void *params)
                         if (!should_stream)
                                 break;
 
-                        const int send_meta = tick == 0 ||
-                                (connParams->periodicMeta &&
-                                 (tick % METADATA_SAMPLE_INTERVAL == 0));
-                        api_send_sample_record(serial, msg.sample, tick, send_meta);
-
-                        if (connParams->isPrimary)
-                                toggle_connectivity_indicator();
-
-                        put_crlf(serial);
-                        tick++;
+                        if (telemetry_subscription_active(sub) &&
+                            !telemetry_subscription_matches(sub, msg.sample)) {
+                                pr_info("conn: channels changed. "
+                                        "dropping subscription\r\n");
+                                telemetry_subscription_clear(sub);
+                        }
+
+                        /* Client (re)subscribed.  New rate, new meta */
+                        if (sub && sub->generation != sub_generation) {
+                                sub_generation = sub->generation;
+                                telemetry_rate_init(&rate_ctl,
+                                                    get_stream_rate(sub));
+                                meta_pending = true;
+                                telemetry_datagram_layout_changed(&datagram);
+                        }
+
+                        const struct telemetry_subscription *filter =
+                                telemetry_subscription_active(sub) ? sub : NULL;
+
+                        /* A datagram carries the latest value of everything */
+                        const struct sample *datagram_sample = deviceConfig.datagram ?
+                                telemetry_datagram_update(&datagram, msg.sample) : NULL;
+
+                        size_t send_ticks = 0;
+                        if (telemetry_subscription_should_send(sub, msg.sample) &&
+                            telemetry_rate_should_send(&rate_ctl, msg.sample)) {
+                                const size_t send_start = getCurrentTicks();
+                                const bool drop_low_priority =
+                                        telemetry_rate_drop_low_priority(&rate_ctl);
+
+                                if (deviceConfig.datagram) {
+                                        if (datagram_sample)
+                                                send_datagram(connParams, &deviceConfig,
+                                                              &datagram, datagram_sample,
+                                                              tick, drop_low_priority,
+                                                              filter);
+                                } else {
+                                        const int send_meta = tick == 0 || meta_pending ||
+                                                (connParams->periodicMeta &&
+                                                 (tick % METADATA_SAMPLE_INTERVAL == 0));
+                                        api_send_sample_record(serial, msg.sample, tick,
+                                                               send_meta,
+                                                               drop_low_priority,
+                                                               filter);
+                                        put_crlf(serial);
+                                }
+                                meta_pending = false;
+
+                                if (connParams->isPrimary)
+                                        toggle_connectivity_indicator();
+
+                                tick++;
+                                send_ticks = getCurrentTicks() - send_start;
+                        }
+
+                        /*
+                         * A backed up queue or a slow write means the link
+                         * can't keep up.  Let the rate controller react.
+                         */
+                        telemetry_rate_update(&rate_ctl,
+                                              uxQueueMessagesWaiting(sampleQueue),
+                                              send_ticks);
+                        telemetry_rate_set_current(connParams->serial,
+                                                   telemetry_rate_get_rate(&rate_ctl));
                         break;
                 }
                 default:
@@ -310,6 +536,10 @@ void connectivityTask(void *params)
                 }
             }
 
+            /* Crossings go out right away, not at the next sample */
+            send_lap_events(connParams, &deviceConfig, &lap_event_pos,
+                            should_stream);
+
             /*//////////////////////////////////////////////////////////
             // Process incoming message, if available
             ////////////////////////////////////////////////////////////
@@ -320,12 +550,28 @@ void connectivityTask(void *params)
                 pr_info("conn: disconnected\r\n");
                 break;
             }
+            /*
+             * In datagram mode the modem tells us how each send went on
+             * the same line as the data.  Only JSON is for us.
+             */
+            if (msgReceived && deviceConfig.datagram && '{' != buffer[0]) {
+                msgReceived = RX_NONE;
+                rxCount = 0;
+            }
+
             /*now process a complete message if available*/
             if (msgReceived) {
                 last_message_time = getUptimeAsInt();
                 pr_debug(connParams->connectionName);
                 pr_debug_str_msg(": rx: ", buffer);
-                int msgRes = process_api(serial, buffer, BUFFER_SIZE);
+                int msgRes = API_ERROR_SEVERE;
+                if (begin_message(connParams, &deviceConfig)) {
+                    msgRes = RX_OVERFLOW == msgReceived ?
+                        streamRxBuffer(serial, buffer, rxCount) :
+                        process_api(serial, buffer, BUFFER_SIZE);
+                    if (deviceConfig.datagram)
+                        connParams->end_datagram(&deviceConfig);
+                }
 
                 int msgError = (msgRes == API_ERROR_MALFORMED);
                 if (msgError) {
@@ -352,6 +598,8 @@ void connectivityTask(void *params)
             }
         }
         clear_connectivity_indicator();
+        telemetry_rate_set_current(connParams->serial, SAMPLE_DISABLED);
+        telemetry_datagram_free(&datagram);
         connParams->disconnect(&deviceConfig);
     }
 }
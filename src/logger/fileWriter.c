@@ -20,6 +20,7 @@
  */
 
 #include "LED.h"
+#include "fast_lap_store.h"
 #include "fileWriter.h"
 #include "loggerHardware.h"
 #include "mem_mang.h"
@@ -425,6 +426,10 @@ static void fileWriterTask(void *params)
                 case LoggerMessageType_Stop:
                         rc = logging_stop(&ls);
                         break;
+                case LoggerMessageType_FastLap:
+                        rc = fast_lap_store_sync(WRITING_ACTIVE ==
+                                                 ls.writing_status);
+                        break;
                 default:
                         pr_warning(_RCP_BASE_FILE_ "Unsupported message "
                                    "type\r\n");
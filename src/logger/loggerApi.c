@@ -22,6 +22,7 @@
 #include "loggerApi.h"
 #include "loggerConfig.h"
 #include "modp_atonum.h"
+#include "modp_numtoa.h"
 #include "mod_string.h"
 #include "sampleRecord.h"
 #include "loggerSampleData.h"
@@ -53,10 +54,16 @@
 #include "sim900.h"
 #include "launch_control.h"
 #include "lap_stats.h"
+#include "telemetry_rate.h"
+#include "sample_history.h"
+#include "fnv.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Max number of PIDs that can be specified in the setOBD2Cfg message */
 #define MAX_OBD2_MESSAGE_PIDS 10
+/* Most history records sent in one reply */
+#define MAX_HISTORY_PAGE_RECORDS 50
 
 #define NAME_EQU(A, B) (strcmp(A, B) == 0)
 
@@ -259,10 +266,12 @@ int api_getStatus(Serial *serial, const jsmntok_t *json)
     json_objStartString(serial, "GPS");
     json_int(serial, "init", (int)GPS_getStatus(), 1);
     json_int(serial, "qual", GPS_getQuality(), 1);
-    json_float(serial, "lat", GPS_getLatitude(), DEFAULT_GPS_POSITION_PRECISION, 1);
-    json_float(serial, "lon", GPS_getLongitude(), DEFAULT_GPS_POSITION_PRECISION, 1);
+    json_double(serial, "lat", GPS_getLatitude(), DEFAULT_GPS_POSITION_PRECISION, 1);
+    json_double(serial, "lon", GPS_getLongitude(), DEFAULT_GPS_POSITION_PRECISION, 1);
     json_int(serial, "sats", GPS_getSatellitesUsedForPosition(), 1);
-    json_int(serial, "DOP", GPS_getDOP(), 0);
+    json_int(serial, "DOP", GPS_getDOP(), 1);
+    json_int(serial, "latency", GPS_getAverageLatency(), 1);
+    json_int(serial, "latencyMax", GPS_getLatencyStats().max, 0);
     json_objEnd(serial, 1);
 
     json_objStartString(serial, "cell");
@@ -290,7 +299,8 @@ int api_getStatus(Serial *serial, const jsmntok_t *json)
 
     json_objStartString(serial, "telemetry");
     json_int(serial, "status", (int)sim900_get_connection_status(), 1);
-    json_int(serial, "dur", sim900_active_time(), 0);
+    json_int(serial, "dur", sim900_active_time(), 1);
+    json_int(serial, "rate", telemetry_rate_get_current(SERIAL_TELEMETRY), 0);
     json_objEnd(serial, 0);
 
     json_objEnd(serial, 0);
@@ -326,7 +336,7 @@ int api_sampleData(Serial *serial, const jsmntok_t *json)
        return API_ERROR_SEVERE;
 
     populate_sample_buffer(&s, 0);
-    api_send_sample_record(serial, &s, 0, sendMeta);
+    api_send_sample_record(serial, &s, 0, sendMeta, false, NULL);
 
     free_sample_buffer(&s);
     return API_SUCCESS_NO_RETURN;
@@ -354,6 +364,32 @@ void api_sendLogEnd(Serial *serial)
     json_objEnd(serial, 0);
 }
 
+/* In the order of enum lap_event_type */
+static const char *lapEventNames[] = {
+    "lap",
+    "sector",
+    "pred",
+};
+
+/*
+ * {"lapEvt":{"type":"sector","lap":3,"sector":1,"ms":31250,"t":712030}}
+ * The sector is only there for sector events.  ms is the lap time, sector
+ * time or predicted lap time and t is when it happened, both in ms.
+ */
+void api_send_lap_event(Serial *serial, const struct lap_event *e)
+{
+    json_objStart(serial);
+    json_objStartString(serial, "lapEvt");
+    json_string(serial, "type", lapEventNames[e->type], 1);
+    json_int(serial, "lap", e->lap, 1);
+    if (LAP_EVENT_SECTOR == e->type)
+        json_int(serial, "sector", e->sector, 1);
+    json_int(serial, "ms", e->time, 1);
+    json_int(serial, "t", e->at, 0);
+    json_objEnd(serial, 0);
+    json_objEnd(serial, 0);
+}
+
 int api_log(Serial *serial, const jsmntok_t *json)
 {
     int doLogging = 0;
@@ -384,14 +420,20 @@ static void json_channelConfig(Serial *serial, ChannelConfig *cfg, int more)
     json_int(serial, "sr", decodeSampleRate(cfg->sampleRate), more);
 }
 
-static void write_sample_meta(Serial *serial, const struct sample *sample,
-                              int sampleRateLimit, int more)
+/* Writes the meta of the channels in [first, end) */
+static void write_sample_meta_range(Serial *serial, const struct sample *sample,
+                                    const struct telemetry_subscription *sub,
+                                    size_t first, size_t end, int more)
 {
         json_arrayStart(serial, "meta");
-        ChannelSample *channel_sample = sample->channel_samples;
-
-        for (size_t i = 0; i < sample->channel_count; ++i, ++channel_sample) {
-                if (0 < i)
+        const size_t count = telemetry_subscription_channel_count(sub, sample);
+        if (end > count)
+                end = count;
+
+        for (size_t i = first; i < end; ++i) {
+                const ChannelSample *channel_sample =
+                        telemetry_subscription_channel(sub, sample, i);
+                if (first < i)
                         serial->put_c(',');
 
                 serial->put_c('{');
@@ -402,6 +444,13 @@ static void write_sample_meta(Serial *serial, const struct sample *sample,
         json_arrayEnd(serial, more);
 }
 
+static void write_sample_meta(Serial *serial, const struct sample *sample,
+                              const struct telemetry_subscription *sub,
+                              int sampleRateLimit, int more)
+{
+        write_sample_meta_range(serial, sample, sub, 0, SIZE_MAX, more);
+}
+
 int api_getMeta(Serial *serial, const jsmntok_t *json)
 {
     json_objStart(serial);
@@ -418,7 +467,7 @@ int api_getMeta(Serial *serial, const jsmntok_t *json)
     if (!size)
        return API_ERROR_SEVERE;
 
-    write_sample_meta(serial, &s, getConnectivitySampleRateLimit(), 0);
+    write_sample_meta(serial, &s, NULL, getConnectivitySampleRateLimit(), 0);
 
     free_sample_buffer(&s);
     json_objEnd(serial, 0);
@@ -428,27 +477,24 @@ int api_getMeta(Serial *serial, const jsmntok_t *json)
 
 #define MAX_BITMAPS 10
 
-void api_send_sample_record(Serial *serial, struct sample *sample,
-                            unsigned int tick, int sendMeta)
+/*
+ * Writes the populated values of a sample followed by the channel bitmaps.
+ * Only the subscribed channels are written if sub is not NULL.
+ */
+static void write_sample_data(Serial *serial, const struct sample *sample,
+                              const struct telemetry_subscription *sub,
+                              bool drop_low_priority)
 {
-        json_objStart(serial);
-        json_objStartString(serial, "s");
-        json_uint(serial,"t", tick, 1);
-
-        if (sendMeta)
-                write_sample_meta(serial, sample,
-                                  getConnectivitySampleRateLimit(), 1);
-
         size_t channelBitmaskIndex = 0;
         unsigned int channelBitmask[MAX_BITMAPS];
         memset(channelBitmask, 0, sizeof(channelBitmask));
 
-        json_arrayStart(serial, "d");
-        ChannelSample *cs = sample->channel_samples;
+        const size_t count = telemetry_subscription_channel_count(sub, sample);
 
         size_t channelBitPosition = 0;
-        for (size_t i = 0; i < sample->channel_count;
-             i++, channelBitPosition++, cs++) {
+        for (size_t i = 0; i < count; i++, channelBitPosition++) {
+                const ChannelSample *cs =
+                        telemetry_subscription_channel(sub, sample, i);
 
                 if (channelBitPosition > 31) {
                         channelBitmaskIndex++;
@@ -457,7 +503,8 @@ void api_send_sample_record(Serial *serial, struct sample *sample,
                                 break;
                 }
 
-                if (cs->populated) {
+                if (cs->populated &&
+                    !(drop_low_priority && cs->low_priority)) {
                         channelBitmask[channelBitmaskIndex] =
                                 channelBitmask[channelBitmaskIndex] |
                                 (1 << channelBitPosition);
@@ -495,12 +542,256 @@ void api_send_sample_record(Serial *serial, struct sample *sample,
                 if (i < channelBitmaskCount - 1)
                         serial->put_c(',');
         }
+}
+
+void api_send_sample_record(Serial *serial, struct sample *sample,
+                            unsigned int tick, int sendMeta,
+                            bool drop_low_priority,
+                            const struct telemetry_subscription *sub)
+{
+        json_objStart(serial);
+        json_objStartString(serial, "s");
+        json_uint(serial,"t", tick, 1);
+
+        if (sendMeta)
+                write_sample_meta(serial, sample, sub,
+                                  getConnectivitySampleRateLimit(), 1);
+
+        json_arrayStart(serial, "d");
+        write_sample_data(serial, sample, sub, drop_low_priority);
+        json_arrayEnd(serial, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+}
 
+/*
+ * Telemetry datagrams.  Unlike api_send_sample_record every value is sent,
+ * not only those sampled this time, and nothing follows the closing brace
+ * since the datagram itself marks the end.  "l" is the layout the values
+ * follow, as announced by the meta datagrams.
+ */
+void api_send_sample_datagram(Serial *serial, const struct sample *sample,
+                              uint32_t seq, unsigned int tick, uint32_t layout,
+                              bool drop_low_priority,
+                              const struct telemetry_subscription *sub)
+{
+        json_objStart(serial);
+        json_objStartString(serial, "u");
+        json_uint(serial, "seq", seq, 1);
+        json_uint(serial, "t", tick, 1);
+        json_uint(serial, "l", layout, 1);
+        json_arrayStart(serial, "d");
+        write_sample_data(serial, sample, sub, drop_low_priority);
         json_arrayEnd(serial, 0);
         json_objEnd(serial, 0);
         json_objEnd(serial, 0);
 }
 
+/*
+ * One piece of the channel meta for the datagram layout: the channels
+ * from "i" on, out of "n" in all.
+ */
+void api_send_meta_datagram(Serial *serial, const struct sample *sample,
+                            uint32_t seq, uint32_t layout, size_t first,
+                            size_t count,
+                            const struct telemetry_subscription *sub)
+{
+        json_objStart(serial);
+        json_objStartString(serial, "um");
+        json_uint(serial, "seq", seq, 1);
+        json_uint(serial, "l", layout, 1);
+        json_uint(serial, "i", first, 1);
+        json_uint(serial, "n",
+                  telemetry_subscription_channel_count(sub, sample), 1);
+        write_sample_meta_range(serial, sample, sub, first, first + count, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+}
+
+/*
+ * Sample the history is read into.  It is only rebuilt when the channel
+ * layout changes so a client polling for history does not churn the heap.
+ * Connections take turns with it.
+ */
+static struct sample g_histSample;
+static size_t g_histLayout;
+static bool g_histBusy;
+
+static bool hist_sample_take(void)
+{
+    bool taken;
+
+    taskENTER_CRITICAL();
+    taken = !g_histBusy;
+    g_histBusy = true;
+    taskEXIT_CRITICAL();
+
+    return taken;
+}
+
+static void hist_sample_give(void)
+{
+    g_histBusy = false;
+}
+
+static bool hist_sample_prepare(void)
+{
+    const size_t layout = telemetry_subscription_layout();
+    LoggerConfig *config = getWorkingLoggerConfig();
+    const size_t channelCount = get_enabled_channel_count(config);
+
+    if (g_histSample.channel_samples && g_histLayout == layout &&
+        g_histSample.channel_count == channelCount)
+        return true;
+
+    free_sample_buffer(&g_histSample);
+    g_histLayout = layout;
+
+    return channelCount && init_sample_buffer(&g_histSample, channelCount);
+}
+
+/*
+ * Sends a page of the in RAM sample history, either the last "n" records
+ * or those newer than tick "since".  Each record is
+ * [ticks since the previous record, values..., bitmaps...] with the first
+ * one relative to "t".  Keep asking with since = "next" while "more" is
+ * set to get the rest.
+ */
+int api_getHistory(Serial *serial, const jsmntok_t *json)
+{
+    int since = 0;
+    int count = 0;
+    int max = MAX_HISTORY_PAGE_RECORDS;
+    uint32_t pos;
+
+    setIntValueIfExists(json, "max", &max);
+    if (max <= 0 || max > MAX_HISTORY_PAGE_RECORDS)
+        max = MAX_HISTORY_PAGE_RECORDS;
+
+    if (setIntValueIfExists(json, "since", &since)) {
+        pos = sample_history_since(since);
+    } else if (setIntValueIfExists(json, "n", &count) && count >= 0) {
+        pos = sample_history_last(count);
+    } else {
+        return API_ERROR_PARAMETER;
+    }
+
+    const bool any = sample_history_valid(pos);
+    if (any) {
+        if (!hist_sample_take())
+            return API_ERROR_SEVERE;
+
+        if (!hist_sample_prepare()) {
+            hist_sample_give();
+            return API_ERROR_SEVERE;
+        }
+    }
+
+    struct sample *s = &g_histSample;
+    bool have = any && sample_history_read(&pos, s);
+    size_t prev = have ? s->ticks : (size_t) since;
+    int sent = 0;
+
+    json_objStart(serial);
+    json_objStartString(serial, "hist");
+    json_uint(serial, "t", prev, 1);
+    json_arrayStart(serial, "d");
+
+    while (have) {
+        serial->put_c('[');
+        put_uint(serial, s->ticks - prev);
+        serial->put_c(',');
+        write_sample_data(serial, s, NULL, false);
+        serial->put_c(']');
+
+        prev = s->ticks;
+        if (++sent >= max)
+            break;
+
+        have = sample_history_read(&pos, s);
+        if (have)
+            serial->put_c(',');
+    }
+
+    json_arrayEnd(serial, 1);
+    json_uint(serial, "next", prev, 1);
+    json_int(serial, "more", sent >= max && sample_history_valid(pos), 0);
+    json_objEnd(serial, 0);
+    json_objEnd(serial, 0);
+
+    if (any)
+        hist_sample_give();
+
+    return API_SUCCESS_NO_RETURN;
+}
+
+/*
+ * Limits what the connection the message came in on streams to the
+ * channels named in "ch", in that order, at "sr" Hz.  Either may be left
+ * out to get all channels or the telemetry rate.  An empty message drops
+ * the subscription.
+ */
+int api_subscribe(Serial *serial, const jsmntok_t *json)
+{
+    struct telemetry_subscription *sub = telemetry_subscription_get(serial);
+    if (!sub)
+        return API_ERROR_SEVERE;
+
+    int rate = SAMPLE_DISABLED;
+    int sampleRate;
+    if (setIntValueIfExists(json, "sr", &sampleRate)) {
+        rate = encodeSampleRate(sampleRate);
+        if (SAMPLE_DISABLED == rate)
+            return API_ERROR_PARAMETER;
+    }
+
+    const jsmntok_t *channelsTok = findNode(json, "ch");
+    if (channelsTok && (++channelsTok)->type != JSMN_ARRAY)
+        return API_ERROR_PARAMETER;
+
+    const size_t count = channelsTok ? channelsTok->size : 0;
+    if (!count && SAMPLE_DISABLED == rate) {
+        telemetry_subscription_clear(sub);
+        return API_SUCCESS;
+    }
+
+    if (count > MAX_SUBSCRIPTION_CHANNELS)
+        return API_ERROR_PARAMETER;
+
+    /* Before the lookup, so a config change half way is not missed */
+    const size_t layout = telemetry_subscription_layout();
+    LoggerConfig *config = getWorkingLoggerConfig();
+    const size_t channelCount = get_enabled_channel_count(config);
+
+    struct sample s;
+    memset(&s, 0, sizeof(struct sample));
+    if (0 == channelCount || !init_sample_buffer(&s, channelCount))
+        return API_ERROR_SEVERE;
+
+    uint16_t index[MAX_SUBSCRIPTION_CHANNELS];
+    int res = API_SUCCESS;
+    for (size_t i = 0; i < count; ++i) {
+        const jsmntok_t *nameTok = channelsTok + 1 + i;
+        jsmn_trimData(nameTok);
+
+        const int found = nameTok->type == JSMN_STRING ?
+            telemetry_subscription_find_channel(&s, nameTok->data) : -1;
+        if (found < 0) {
+            pr_warning_str_msg("subscribe: unknown channel ", nameTok->data);
+            res = API_ERROR_PARAMETER;
+            break;
+        }
+        index[i] = found;
+    }
+
+    if (API_SUCCESS == res)
+        telemetry_subscription_set(sub, layout, channelCount, index, count,
+                                   rate);
+
+    free_sample_buffer(&s);
+    return res;
+}
+
 static const jsmntok_t * setChannelConfig(Serial *serial, const jsmntok_t *cfg,
         ChannelConfig *channelCfg,
         setExtField_func setExtField,
@@ -899,6 +1190,7 @@ static void setTelemetryConfig(const jsmntok_t *root)
         setStringValueIfExists(telemetryCfgNode, "deviceId", telemetryCfg->telemetryDeviceId, DEVICE_ID_LENGTH);
         setStringValueIfExists(telemetryCfgNode, "host", telemetryCfg->telemetryServerHost, TELEMETRY_SERVER_HOST_LENGTH);
         setUnsignedCharValueIfExists(telemetryCfgNode, "bgStream", &telemetryCfg->backgroundStreaming, filterBgStreamingMode);
+        setUnsignedCharValueIfExists(telemetryCfgNode, "udp", &telemetryCfg->udpMode, filterUdpMode);
     }
 }
 
@@ -933,7 +1225,8 @@ int api_getConnectivityConfig(Serial *serial, const jsmntok_t *json)
     json_objStartString(serial, "telCfg");
     json_int(serial, "bgStream", cfg->telemetryConfig.backgroundStreaming, 1);
     json_string(serial, "deviceId", cfg->telemetryConfig.telemetryDeviceId, 1);
-    json_string(serial, "host", cfg->telemetryConfig.telemetryServerHost, 0);
+    json_string(serial, "host", cfg->telemetryConfig.telemetryServerHost, 1);
+    json_int(serial, "udp", cfg->telemetryConfig.udpMode, 0);
     json_objEnd(serial, 0);
 
     json_objEnd(serial, 0);
@@ -1181,7 +1474,8 @@ int api_getGpsConfig(Serial *serial, const jsmntok_t *json)
     json_int(serial, "alt", gpsCfg->altitude.sampleRate != SAMPLE_DISABLED, 1);
     json_int(serial, "sats", gpsCfg->satellites.sampleRate != SAMPLE_DISABLED, 1);
     json_int(serial, "qual", gpsCfg->quality.sampleRate != SAMPLE_DISABLED, 1);
-    json_int(serial, "dop", gpsCfg->DOP.sampleRate != SAMPLE_DISABLED, 0);
+    json_int(serial, "dop", gpsCfg->DOP.sampleRate != SAMPLE_DISABLED, 1);
+    json_int(serial, "fusedSr", decodeSampleRate(gpsCfg->fusedLatitude.sampleRate), 0);
 
     json_objEnd(serial, 0);
     json_objEnd(serial, 0);
@@ -1215,6 +1509,15 @@ int api_setGpsConfig(Serial *serial, const jsmntok_t *json)
     gpsConfigTestAndSet(json, &(gpsCfg->quality), "qual", sr);
     gpsConfigTestAndSet(json, &(gpsCfg->DOP), "dop", sr);
 
+    /* The fused channels run at their own, usually higher, rate */
+    if (setIntValueIfExists(json, "fusedSr", &tmp)) {
+        const unsigned short fusedSr = encodeSampleRate(tmp);
+        gpsCfg->fusedLatitude.sampleRate = fusedSr;
+        gpsCfg->fusedLongitude.sampleRate = fusedSr;
+        gpsCfg->fusedSpeed.sampleRate = fusedSr;
+        gpsCfg->heading.sampleRate = fusedSr;
+    }
+
     configChanged();
     return API_SUCCESS;
 }
@@ -1245,34 +1548,50 @@ int api_setCanConfig(Serial *serial, const jsmntok_t *json)
 
     const jsmntok_t *baudTok = findNode(json, "baud");
     if (baudTok != NULL && (++baudTok)->type == JSMN_ARRAY) {
-        size_t arrSize = json->size;
+        size_t arrSize = baudTok->size;
         if (arrSize > CONFIG_CAN_CHANNELS)
             arrSize = CONFIG_CAN_CHANNELS;
         size_t can_index = 0;
         for (baudTok++; can_index < arrSize; can_index++, baudTok++) {
+            jsmn_trimData(baudTok);
             canCfg->baud[can_index] = modp_atoi(baudTok->data);
         }
     }
     return API_SUCCESS;
 }
 
+/*
+ * Sends all enabled PIDs, or just the one at index in the same form
+ * setObd2Cfg takes it.  There are no PIDs past the last enabled one.
+ */
 int api_getObd2Config(Serial *serial, const jsmntok_t *json)
 {
+    OBD2Config *obd2Cfg = &(getWorkingLoggerConfig()->OBD2Configs);
+
+    int startIndex = 0;
+    int endIndex = obd2Cfg->enabledPids;
+    if (json->type == JSMN_PRIMITIVE && !jsmn_isNull(json)) {
+        jsmn_trimData(json);
+        startIndex = modp_atoi(json->data);
+        if (startIndex < 0 || startIndex >= OBD2_CHANNELS)
+            return API_ERROR_PARAMETER;
+        endIndex = startIndex < endIndex ? startIndex + 1 : startIndex;
+    }
+
     json_objStart(serial);
     json_objStartString(serial, "obd2Cfg");
 
-    OBD2Config *obd2Cfg = &(getWorkingLoggerConfig()->OBD2Configs);
-
-    int enabledPids = obd2Cfg->enabledPids;
     json_int(serial,"en", obd2Cfg->enabled, 1);
+    if (startIndex)
+        json_int(serial, "index", startIndex, 1);
     json_arrayStart(serial, "pids");
 
-    for (int i = 0; i < enabledPids; i++) {
+    for (int i = startIndex; i < endIndex; i++) {
         PidConfig *pidCfg = &obd2Cfg->pids[i];
         json_objStart(serial);
         json_channelConfig(serial, &(pidCfg->cfg), 1);
         json_int(serial,"pid",pidCfg->pid, 0);
-        json_objEnd(serial, i < enabledPids - 1);
+        json_objEnd(serial, i < endIndex - 1);
     }
 
     json_arrayEnd(serial, 0);
@@ -1328,91 +1647,134 @@ int api_setObd2Config(Serial *serial, const jsmntok_t *json)
     return API_SUCCESS;
 }
 
-int api_setLapConfig(Serial *serial, const jsmntok_t *json)
-{
-    LapConfig *lapCfg = &(getWorkingLoggerConfig()->LapConfigs);
+/*
+ * Streamed form of setObd2Cfg.  The PID count is only limited by the
+ * number of channels, not by MAX_OBD2_MESSAGE_PIDS.  "index" must come
+ * before "pids".
+ */
+static size_t g_obd2StreamPid;
 
-    const jsmntok_t *lapCount = findNode(json, "lapCount");
-    if (lapCount != NULL)
-        setChannelConfig(serial, lapCount + 1, &lapCfg->lapCountCfg, NULL, NULL);
+void api_setObd2ConfigBegin(Serial *serial)
+{
+    g_obd2StreamPid = 0;
+}
 
-    const jsmntok_t *lapTime = findNode(json, "lapTime");
-    if (lapTime != NULL)
-        setChannelConfig(serial, lapTime + 1, &lapCfg->lapTimeCfg, NULL, NULL);
+int api_setObd2ConfigValue(Serial *serial, const char *member, int index,
+                           const jsmntok_t *json, bool more)
+{
+    OBD2Config *obd2Cfg = &(getWorkingLoggerConfig()->OBD2Configs);
 
-    const jsmntok_t *predTime = findNode(json, "predTime");
-    if (predTime != NULL)
-        setChannelConfig(serial, predTime + 1, &lapCfg->predTimeCfg, NULL, NULL);
+    if (NAME_EQU("pids", member) && index >= 0) {
+        if (g_obd2StreamPid >= OBD2_CHANNELS)
+            return API_ERROR_PARAMETER;
 
-    const jsmntok_t *sector = findNode(json, "sector");
-    if (sector != NULL)
-        setChannelConfig(serial, sector + 1, &lapCfg->sectorCfg, NULL, NULL);
+        PidConfig *pidCfg = obd2Cfg->pids + g_obd2StreamPid++;
+        setChannelConfig(serial, json, &(pidCfg->cfg), setPidExtendedField, pidCfg);
+        return API_SUCCESS;
+    }
 
-    const jsmntok_t *sectorTime = findNode(json, "sectorTime");
-    if (sectorTime != NULL)
-        setChannelConfig(serial, sectorTime + 1, &lapCfg->sectorTimeCfg, NULL, NULL);
+    if (json->type != JSMN_PRIMITIVE)
+        return API_SUCCESS;
 
-    const jsmntok_t *elapsed = findNode(json, "elapsedTime");
-    if (elapsed != NULL)
-        setChannelConfig(serial, elapsed + 1,
-                         &lapCfg->elapsed_time_cfg,
-                         NULL, NULL);
+    jsmn_trimData(json);
+    if (NAME_EQU("index", member)) {
+        g_obd2StreamPid = modp_atoi(json->data);
+        if (g_obd2StreamPid >= OBD2_CHANNELS)
+            return API_ERROR_PARAMETER;
+    } else if (NAME_EQU("en", member)) {
+        obd2Cfg->enabled = (unsigned char) modp_atoi(json->data);
+    }
+    return API_SUCCESS;
+}
 
-    const jsmntok_t *current_lap = findNode(json, "currentLap");
-    if (current_lap != NULL)
-        setChannelConfig(serial, current_lap + 1,
-                         &lapCfg->current_lap_cfg,
-                         NULL, NULL);
+int api_setObd2ConfigEnd(Serial *serial, int result)
+{
+    if (result != API_SUCCESS)
+        return result;
 
+    getWorkingLoggerConfig()->OBD2Configs.enabledPids = g_obd2StreamPid;
     configChanged();
     return API_SUCCESS;
 }
 
-int api_getLapConfig(Serial *serial, const jsmntok_t *json)
-{
-    LapConfig *lapCfg = &(getWorkingLoggerConfig()->LapConfigs);
+/* The lap channels in the order getLapCfg sends them */
+static const struct {
+    const char *name;
+    size_t offset;
+} lapChannels[] = {
+    {"lapCount", offsetof(LapConfig, lapCountCfg)},
+    {"lapTime", offsetof(LapConfig, lapTimeCfg)},
+    {"predTime", offsetof(LapConfig, predTimeCfg)},
+    {"sector", offsetof(LapConfig, sectorCfg)},
+    {"sectorTime", offsetof(LapConfig, sectorTimeCfg)},
+    {"elapsed", offsetof(LapConfig, elapsed_time_cfg)},
+    {"currentLap", offsetof(LapConfig, current_lap_cfg)},
+    {"optTime", offsetof(LapConfig, optimal_time_cfg)},
+    {"sectorDelta", offsetof(LapConfig, sector_delta_cfg)},
+    {"optDelta", offsetof(LapConfig, optimal_delta_cfg)},
+    {"predDelta", offsetof(LapConfig, pred_delta_cfg)},
+    {"sessDelta", offsetof(LapConfig, session_delta_cfg)},
+    {"targetDelta", offsetof(LapConfig, target_delta_cfg)},
+    {"sessDist", offsetof(LapConfig, session_distance_cfg)},
+    {"trackDist", offsetof(LapConfig, track_distance_cfg)},
+    {"lapPct", offsetof(LapConfig, lap_percent_cfg)},
+};
+
+#define LAP_CHANNEL_COUNT (sizeof(lapChannels) / sizeof(lapChannels[0]))
 
-    json_objStart(serial);
-    json_objStartString(serial, "lapCfg");
+int api_setLapConfig(Serial *serial, const jsmntok_t *json)
+{
+    char *lapCfg = (char *) &(getWorkingLoggerConfig()->LapConfigs);
 
-    json_objStartString(serial, "lapCount");
-    json_channelConfig(serial, &lapCfg->lapCountCfg, 0);
-    json_objEnd(serial, 1);
+    for (size_t i = 0; i < LAP_CHANNEL_COUNT; i++) {
+        const jsmntok_t *node = NULL;
 
-    json_objStartString(serial, "lapTime");
-    json_channelConfig(serial, &lapCfg->lapTimeCfg, 0);
-    json_objEnd(serial, 1);
+        /* getLapCfg has always called it elapsed, set took elapsedTime */
+        if (lapChannels[i].offset == offsetof(LapConfig, elapsed_time_cfg))
+            node = findNode(json, "elapsedTime");
+        if (node == NULL)
+            node = findNode(json, lapChannels[i].name);
 
-    json_objStartString(serial, "predTime");
-    json_channelConfig(serial, &lapCfg->predTimeCfg, 0);
-    json_objEnd(serial, 1);
+        if (node != NULL)
+            setChannelConfig(serial, node + 1,
+                             (ChannelConfig *) (lapCfg + lapChannels[i].offset),
+                             NULL, NULL);
+    }
 
-    json_objStartString(serial, "sector");
-    json_channelConfig(serial, &lapCfg->sectorCfg, 0);
-    json_objEnd(serial, 1);
+    configChanged();
+    return API_SUCCESS;
+}
 
-    json_objStartString(serial, "sectorTime");
-    json_channelConfig(serial, &lapCfg->sectorTimeCfg, 0);
-    json_objEnd(serial, 1);
+static void sendLapConfig(Serial *serial, size_t startIndex, size_t endIndex)
+{
+    char *lapCfg = (char *) &(getWorkingLoggerConfig()->LapConfigs);
 
-    json_objStartString(serial, "elapsed");
-    json_channelConfig(serial, &lapCfg->elapsed_time_cfg, 0);
-    json_objEnd(serial, 1);
+    json_objStart(serial);
+    json_objStartString(serial, "lapCfg");
 
-    json_objStartString(serial, "currentLap");
-    json_channelConfig(serial, &lapCfg->current_lap_cfg, 0);
-    json_objEnd(serial, 0);
+    for (size_t i = startIndex; i <= endIndex; i++) {
+        json_objStartString(serial, lapChannels[i].name);
+        json_channelConfig(serial, (ChannelConfig *) (lapCfg + lapChannels[i].offset), 0);
+        json_objEnd(serial, i != endIndex);
+    }
 
     json_objEnd(serial, 0);
     json_objEnd(serial, 0);
+}
+
+int api_getLapConfig(Serial *serial, const jsmntok_t *json)
+{
+    sendLapConfig(serial, 0, LAP_CHANNEL_COUNT - 1);
     return API_SUCCESS_NO_RETURN;
 }
 
 static void json_geoPointArray(Serial *serial, const char *name, const GeoPoint *point, int more)
 {
     json_arrayStart(serial, name);
-    json_arrayElementFloat(serial, point->latitude, DEFAULT_GPS_POSITION_PRECISION, 1);
-    json_arrayElementFloat(serial, point->longitude, DEFAULT_GPS_POSITION_PRECISION, 0);
+    json_arrayElementDouble(serial, gp_to_degrees(point->latitude),
+                            DEFAULT_GPS_POSITION_PRECISION, 1);
+    json_arrayElementDouble(serial, gp_to_degrees(point->longitude),
+                            DEFAULT_GPS_POSITION_PRECISION, 0);
     json_arrayEnd(serial, more);
 }
 
@@ -1466,10 +1828,10 @@ static int setGeoPointIfExists(const jsmntok_t *root, const char * name, GeoPoin
         if (geoPointNode && geoPointNode->type == JSMN_ARRAY && geoPointNode->size == 2) {
             geoPointNode += 1;
             jsmn_trimData(geoPointNode);
-            geoPoint->latitude = modp_atof(geoPointNode->data);
+            geoPoint->latitude = gp_parse_degrees(geoPointNode->data);
             geoPointNode += 1;
             jsmn_trimData(geoPointNode);
-            geoPoint->longitude = modp_atof(geoPointNode->data);
+            geoPoint->longitude = gp_parse_degrees(geoPointNode->data);
             success = 1;
         }
     }
@@ -1504,8 +1866,8 @@ static void setTrack(const jsmntok_t *trackNode, Track *track)
                     const jsmntok_t *lon = sectors + 2;
                     jsmn_trimData(lat);
                     jsmn_trimData(lon);
-                    sector->latitude = modp_atof(lat->data);
-                    sector->longitude = modp_atof(lon->data);
+                    sector->latitude = gp_parse_degrees(lat->data);
+                    sector->longitude = gp_parse_degrees(lon->data);
                     sectorIndex++;
                     sectors +=3;
                 }
@@ -1559,6 +1921,9 @@ int api_addTrackDb(Serial *serial, const jsmntok_t *json)
     unsigned char mode = 0;
     int index = 0;
 
+    if (findNode(json, "tracks") != NULL)
+        return api_stream_payload(serial, "addTrackDb", json);
+
     if (setUnsignedCharValueIfExists(json, "mode", &mode, NULL) && setIntValueIfExists(json, "index", &index)) {
         Track track;
         const jsmntok_t *trackNode = findNode(json, "track");
@@ -1566,7 +1931,8 @@ int api_addTrackDb(Serial *serial, const jsmntok_t *json)
             setTrack(trackNode + 1, &track);
         int result = add_track(&track, index, mode);
         if (result == TRACK_ADD_RESULT_OK) {
-            if (mode == TRACK_ADD_MODE_COMPLETE) {
+            /* Both commit to flash.  The active track may have moved */
+            if (mode == TRACK_ADD_MODE_COMPLETE || mode == TRACK_ADD_MODE_UPDATE) {
                 lapstats_config_changed();
             }
             return API_SUCCESS;
@@ -1577,6 +1943,56 @@ int api_addTrackDb(Serial *serial, const jsmntok_t *json)
     return API_ERROR_MALFORMED;
 }
 
+/*
+ * Whole track DB in one message: {"tracks":[{track}, ...]}.  We hold on to
+ * the latest track and only hand it over once we know if it's the last.
+ */
+static struct {
+    Track track;
+    size_t count;
+} g_trackStream;
+
+void api_addTrackDbBegin(Serial *serial)
+{
+    g_trackStream.count = 0;
+}
+
+int api_addTrackDbValue(Serial *serial, const char *member, int index,
+                        const jsmntok_t *json, bool more)
+{
+    if (!NAME_EQU("tracks", member) || index < 0)
+        return API_SUCCESS;
+
+    if (json->type != JSMN_OBJECT || index >= MAX_TRACK_COUNT)
+        return API_ERROR_PARAMETER;
+
+    if (g_trackStream.count &&
+        add_track(&g_trackStream.track, g_trackStream.count - 1,
+                  TRACK_ADD_MODE_IN_PROGRESS) != TRACK_ADD_RESULT_OK)
+        return API_ERROR_SEVERE;
+
+    memset(&g_trackStream.track, 0, sizeof(Track));
+    setTrack(json, &g_trackStream.track);
+    g_trackStream.count++;
+    return API_SUCCESS;
+}
+
+int api_addTrackDbEnd(Serial *serial, int result)
+{
+    if (result != API_SUCCESS)
+        return result;
+
+    if (!g_trackStream.count)
+        return API_ERROR_MALFORMED;
+
+    if (add_track(&g_trackStream.track, g_trackStream.count - 1,
+                  TRACK_ADD_MODE_COMPLETE) != TRACK_ADD_RESULT_OK)
+        return API_ERROR_SEVERE;
+
+    lapstats_config_changed();
+    return API_SUCCESS;
+}
+
 int api_getTrackDb(Serial *serial, const jsmntok_t *json)
 {
     const Tracks * tracks = get_tracks();
@@ -1622,6 +2038,10 @@ int api_setScript(Serial *serial, const jsmntok_t *json)
     const jsmntok_t *pageTok = findNode(json, "page");
     const jsmntok_t *modeTok = findNode(json, "mode");
 
+    /* Whole script, no paging */
+    if (dataTok != NULL && pageTok == NULL && modeTok == NULL)
+        return api_stream_payload(serial, "setScriptCfg", json);
+
     if (dataTok != NULL && pageTok != NULL && modeTok !=NULL) {
         dataTok++;
         pageTok++;
@@ -1649,8 +2069,293 @@ int api_setScript(Serial *serial, const jsmntok_t *json)
     return rc;
 }
 
+/*
+ * Whole script in one message: {"data":"..."}.  The script is cut into
+ * pages as it arrives.  A page is only flashed once we know if it's the
+ * last.
+ */
+static struct {
+    size_t page;
+    size_t length;
+    size_t total;
+    bool has_data;
+    char data[SCRIPT_PAGE_SIZE + 1];
+} g_scriptStream;
+
+void api_setScriptBegin(Serial *serial)
+{
+    g_scriptStream.page = 0;
+    g_scriptStream.length = 0;
+    g_scriptStream.total = 0;
+    g_scriptStream.has_data = false;
+}
+
+int api_setScriptValue(Serial *serial, const char *member, int index,
+                       const jsmntok_t *json, bool more)
+{
+    /* Paged uploads must go through the regular setScriptCfg */
+    if (NAME_EQU("page", member) || NAME_EQU("mode", member))
+        return API_ERROR_PARAMETER;
+
+    if (!NAME_EQU("data", member))
+        return API_SUCCESS;
+
+    if (json->type != JSMN_STRING)
+        return API_ERROR_PARAMETER;
+
+    g_scriptStream.has_data = true;
+    jsmn_trimData(json);
+    unescapeScript(json->data);
+
+    for (const char *c = json->data; *c; ++c) {
+        /* Leave room for the terminator */
+        if (g_scriptStream.total >= sizeof(((ScriptConfig *) NULL)->script) - 1)
+            return API_ERROR_PARAMETER;
+
+        if (g_scriptStream.length == SCRIPT_PAGE_SIZE) {
+            g_scriptStream.data[SCRIPT_PAGE_SIZE] = '\0';
+            if (flashScriptPage(g_scriptStream.page, g_scriptStream.data,
+                                SCRIPT_ADD_MODE_IN_PROGRESS) != SCRIPT_ADD_RESULT_OK)
+                return API_ERROR_SEVERE;
+            g_scriptStream.page++;
+            g_scriptStream.length = 0;
+        }
+
+        g_scriptStream.data[g_scriptStream.length++] = *c;
+        g_scriptStream.total++;
+    }
+    return API_SUCCESS;
+}
+
+int api_setScriptEnd(Serial *serial, int result)
+{
+    if (result != API_SUCCESS)
+        return result;
+
+    if (!g_scriptStream.has_data)
+        return API_ERROR_PARAMETER;
+
+    g_scriptStream.data[g_scriptStream.length] = '\0';
+    if (flashScriptPage(g_scriptStream.page, g_scriptStream.data,
+                        SCRIPT_ADD_MODE_COMPLETE) != SCRIPT_ADD_RESULT_OK)
+        return API_ERROR_SEVERE;
+
+    setShouldReloadScript(1);
+    return API_SUCCESS;
+}
+
 int api_runScript(Serial *serial, const jsmntok_t *json)
 {
     setShouldReloadScript(1);
     return API_SUCCESS;
 }
+
+/*
+ * The configuration sections a client can sync.  Each one is hashed
+ * straight from the working LoggerConfig so the client can tell which
+ * ones changed without fetching them.  Sections with channels are sent
+ * one channel at a time by getAllCfg so that every piece stays small
+ * enough to be streamed back in with setAllCfg.
+ */
+typedef struct _config_section_t {
+    const char *name;
+    size_t offset;
+    size_t size;
+    /* Number of pieces the section is sent in, NULL for one */
+    size_t (*pieces)(void);
+    int (*get)(Serial *serial, const jsmntok_t *json);
+    int (*set)(Serial *serial, const jsmntok_t *json);
+} config_section_t;
+
+#define CONFIG_SECTION(name, field, pieces, get, set) \
+    {name, offsetof(LoggerConfig, field), sizeof(((LoggerConfig *) 0)->field), \
+     pieces, get, set}
+
+static size_t analogPieces(void)
+{
+    return CONFIG_ADC_CHANNELS;
+}
+
+static size_t imuPieces(void)
+{
+    return CONFIG_IMU_CHANNELS;
+}
+
+static size_t pwmPieces(void)
+{
+    return CONFIG_PWM_CHANNELS;
+}
+
+static size_t gpioPieces(void)
+{
+    return CONFIG_GPIO_CHANNELS;
+}
+
+static size_t timerPieces(void)
+{
+    return CONFIG_TIMER_CHANNELS;
+}
+
+static size_t lapPieces(void)
+{
+    return LAP_CHANNEL_COUNT;
+}
+
+/*
+ * getLapCfg always sends every channel, so getAllCfg sends lapCfg one
+ * channel at a time through here.  setLapCfg takes any of them alone.
+ */
+static int getLapConfigPiece(Serial *serial, const jsmntok_t *json)
+{
+    jsmn_trimData(json);
+    const size_t index = modp_atoi(json->data);
+    if (index >= LAP_CHANNEL_COUNT)
+        return API_ERROR_PARAMETER;
+
+    sendLapConfig(serial, index, index);
+    return API_SUCCESS_NO_RETURN;
+}
+
+static size_t obd2Pieces(void)
+{
+    const size_t enabledPids = getWorkingLoggerConfig()->OBD2Configs.enabledPids;
+    return enabledPids ? enabledPids : 1;
+}
+
+static const config_section_t configSections[] = {
+    CONFIG_SECTION("analogCfg", ADCConfigs, analogPieces, api_getAnalogConfig, api_setAnalogConfig),
+    CONFIG_SECTION("imuCfg", ImuConfigs, imuPieces, api_getImuConfig, api_setImuConfig),
+    CONFIG_SECTION("pwmCfg", PWMConfigs, pwmPieces, api_getPwmConfig, api_setPwmConfig),
+    CONFIG_SECTION("gpioCfg", GPIOConfigs, gpioPieces, api_getGpioConfig, api_setGpioConfig),
+    CONFIG_SECTION("timerCfg", TimerConfigs, timerPieces, api_getTimerConfig, api_setTimerConfig),
+    CONFIG_SECTION("canCfg", CanConfig, NULL, api_getCanConfig, api_setCanConfig),
+    CONFIG_SECTION("obd2Cfg", OBD2Configs, obd2Pieces, api_getObd2Config, api_setObd2Config),
+    CONFIG_SECTION("gpsCfg", GPSConfigs, NULL, api_getGpsConfig, api_setGpsConfig),
+    CONFIG_SECTION("lapCfg", LapConfigs, lapPieces, getLapConfigPiece, api_setLapConfig),
+    CONFIG_SECTION("trackCfg", TrackConfigs, NULL, api_getTrackConfig, api_setTrackConfig),
+    CONFIG_SECTION("connCfg", ConnectivityConfigs, NULL, api_getConnectivityConfig, api_setConnectivityConfig),
+};
+
+#define CONFIG_SECTION_COUNT (sizeof(configSections) / sizeof(configSections[0]))
+
+static const config_section_t* findConfigSection(const char *name)
+{
+    for (size_t i = 0; i < CONFIG_SECTION_COUNT; i++) {
+        if (NAME_EQU(name, configSections[i].name))
+            return configSections + i;
+    }
+    return NULL;
+}
+
+static uint32_t getConfigSectionHash(const config_section_t *section)
+{
+    const char *base = (const char *) getWorkingLoggerConfig();
+    return fnv1a_32(FNV1A_32_INIT, base + section->offset, section->size);
+}
+
+static void writeConfigHashes(Serial *serial, int more)
+{
+    json_objStartString(serial, "hash");
+    for (size_t i = 0; i < CONFIG_SECTION_COUNT; i++)
+        json_uint(serial, configSections[i].name,
+                  getConfigSectionHash(configSections + i), 1);
+
+    /* The script lives outside of LoggerConfig.  Synced with getScriptCfg */
+    const char *script = getScript();
+    json_uint(serial, "scriptCfg",
+              fnv1a_32(FNV1A_32_INIT, script, strlen(script)), 0);
+    json_objEnd(serial, more);
+}
+
+int api_getConfigHash(Serial *serial, const jsmntok_t *json)
+{
+    json_objStart(serial);
+    json_objStartString(serial, "cfgHash");
+    writeConfigHashes(serial, 0);
+    json_objEnd(serial, 0);
+    json_objEnd(serial, 0);
+    return API_SUCCESS_NO_RETURN;
+}
+
+/*
+ * Sends every section as a list of pieces, each piece being exactly what
+ * the section's get message returns: {"analogCfg":{"0":{...}}}.  Hashes
+ * come first so the client can store them along with the config.
+ */
+int api_getAllConfig(Serial *serial, const jsmntok_t *json)
+{
+    json_objStart(serial);
+    json_objStartString(serial, "allCfg");
+    writeConfigHashes(serial, 1);
+    json_arrayStart(serial, "cfg");
+
+    for (size_t i = 0; i < CONFIG_SECTION_COUNT; i++) {
+        const config_section_t *section = configSections + i;
+        const size_t pieces = section->pieces ? section->pieces() : 1;
+
+        for (size_t piece = 0; piece < pieces; piece++) {
+            char index[12];
+            jsmntok_t indexTok;
+            indexTok.type = JSMN_PRIMITIVE;
+            indexTok.data = index;
+            indexTok.start = 0;
+            indexTok.size = 0;
+            if (section->pieces) {
+                modp_itoa10(piece, index);
+            } else {
+                strcpy(index, "null");
+            }
+            indexTok.end = strlen(index);
+
+            section->get(serial, &indexTok);
+            if (i < CONFIG_SECTION_COUNT - 1 || piece < pieces - 1)
+                serial->put_c(',');
+        }
+    }
+
+    json_arrayEnd(serial, 0);
+    json_objEnd(serial, 0);
+    json_objEnd(serial, 0);
+    return API_SUCCESS_NO_RETURN;
+}
+
+/*
+ * Takes what getAllCfg sends: {"cfg":[{"analogCfg":{...}}, ...]}.  Each
+ * piece is handed to the section's set message in turn.  Anything else in
+ * the payload, such as the hashes, is ignored.
+ */
+int api_setAllConfig(Serial *serial, const jsmntok_t *json)
+{
+    return api_stream_payload(serial, "setAllCfg", json);
+}
+
+void api_setAllConfigBegin(Serial *serial)
+{
+}
+
+int api_setAllConfigValue(Serial *serial, const char *member, int index,
+                          const jsmntok_t *json, bool more)
+{
+    if (!NAME_EQU("cfg", member) || index < 0)
+        return API_SUCCESS;
+
+    if (json->type != JSMN_OBJECT || json->size != 2)
+        return API_ERROR_PARAMETER;
+
+    const jsmntok_t *nameTok = json + 1;
+    jsmn_trimData(nameTok);
+    const config_section_t *section = findConfigSection(nameTok->data);
+    if (!section) {
+        pr_warning_str_msg("setAllCfg: unknown section ", nameTok->data);
+        return API_ERROR_PARAMETER;
+    }
+
+    const int res = section->set(serial, json + 2);
+    return res == API_SUCCESS || res == API_SUCCESS_NO_RETURN ?
+        API_SUCCESS : res;
+}
+
+int api_setAllConfigEnd(Serial *serial, int result)
+{
+    return result;
+}
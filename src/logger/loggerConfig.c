@@ -161,6 +161,7 @@ static void resetTelemetryConfig(TelemetryConfig *cfg)
 {
     memset(cfg, 0, sizeof(TelemetryConfig));
     cfg->backgroundStreaming = BACKGROUND_STREAMING_ENABLED;
+    cfg->udpMode = TELEMETRY_UDP_DISABLED;
     strcpy(cfg->telemetryServerHost, DEFAULT_TELEMETRY_SERVER_HOST);
 }
 
@@ -322,6 +323,11 @@ unsigned char filterBgStreamingMode(unsigned char mode)
     return mode == 0 ? 0 : 1;
 }
 
+unsigned char filterUdpMode(unsigned char mode)
+{
+    return mode == TELEMETRY_UDP_DISABLED ? TELEMETRY_UDP_DISABLED : TELEMETRY_UDP_ENABLED;
+}
+
 unsigned char filterSdLoggingMode(unsigned char mode)
 {
     switch (mode) {
@@ -565,6 +571,18 @@ unsigned int getHighestSampleRate(LoggerConfig *config)
     sr = gpsConfig->DOP.sampleRate;
     s = getHigherSampleRate(sr, s);
 
+    sr = gpsConfig->fusedLatitude.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = gpsConfig->fusedLongitude.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = gpsConfig->fusedSpeed.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = gpsConfig->heading.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
     LapConfig *trackCfg = &(config->LapConfigs);
     sr = trackCfg->lapCountCfg.sampleRate;
     s = getHigherSampleRate(sr, s);
@@ -587,6 +605,33 @@ unsigned int getHighestSampleRate(LoggerConfig *config)
     sr = trackCfg->current_lap_cfg.sampleRate;
     s = getHigherSampleRate(sr, s);
 
+    sr = trackCfg->optimal_time_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->sector_delta_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->optimal_delta_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->pred_delta_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->session_delta_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->target_delta_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->session_distance_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->track_distance_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
+    sr = trackCfg->lap_percent_cfg.sampleRate;
+    s = getHigherSampleRate(sr, s);
+
     return s;
 }
 
@@ -633,6 +678,10 @@ size_t get_enabled_channel_count(LoggerConfig *loggerConfig)
     if (gpsConfigs->satellites.sampleRate != SAMPLE_DISABLED) channels++;
     if (gpsConfigs->quality.sampleRate != SAMPLE_DISABLED) channels++;
     if (gpsConfigs->DOP.sampleRate != SAMPLE_DISABLED) channels++;
+    if (gpsConfigs->fusedLatitude.sampleRate != SAMPLE_DISABLED) channels++;
+    if (gpsConfigs->fusedLongitude.sampleRate != SAMPLE_DISABLED) channels++;
+    if (gpsConfigs->fusedSpeed.sampleRate != SAMPLE_DISABLED) channels++;
+    if (gpsConfigs->heading.sampleRate != SAMPLE_DISABLED) channels++;
 
     LapConfig *lapConfig = &loggerConfig->LapConfigs;
     if (lapConfig->lapCountCfg.sampleRate != SAMPLE_DISABLED) channels++;
@@ -642,6 +691,15 @@ size_t get_enabled_channel_count(LoggerConfig *loggerConfig)
     if (lapConfig->predTimeCfg.sampleRate != SAMPLE_DISABLED) channels++;
     if (lapConfig->elapsed_time_cfg.sampleRate != SAMPLE_DISABLED) channels++;
     if (lapConfig->current_lap_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->optimal_time_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->sector_delta_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->optimal_delta_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->pred_delta_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->session_delta_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->target_delta_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->session_distance_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->track_distance_cfg.sampleRate != SAMPLE_DISABLED) channels++;
+    if (lapConfig->lap_percent_cfg.sampleRate != SAMPLE_DISABLED) channels++;
 
     channels += get_virtual_channel_count();
     return channels;
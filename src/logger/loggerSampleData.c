@@ -14,9 +14,11 @@
 #include "OBD2.h"
 #include "sampleRecord.h"
 #include "gps.h"
+#include "gps_fusion.h"
 #include "lap_stats.h"
 #include "geopoint.h"
 #include "predictive_timer_2.h"
+#include "track_map.h"
 #include "linear_interpolate.h"
 #include "printk.h"
 #include "FreeRTOS.h"
@@ -70,6 +72,20 @@ static ChannelSample* processChannelSampleWithFloatGetterNoarg(ChannelSample *s,
     return ++s;
 }
 
+static ChannelSample* processChannelSampleWithDoubleGetterNoarg(ChannelSample *s,
+        ChannelConfig *cfg,
+        double (*getter)())
+{
+    if (cfg->sampleRate == SAMPLE_DISABLED )
+        return s;
+
+    s->cfg = cfg;
+    s->sampleData = SampleData_Double_Noarg;
+    s->get_double_sample_noarg = getter;
+
+    return ++s;
+}
+
 static ChannelSample* processChannelSampleWithIntGetterNoarg(ChannelSample *s,
         ChannelConfig *cfg,
         int (*getter)())
@@ -209,6 +225,45 @@ float get_imu_sample(int channelId)
     return value;
 }
 
+/* Brings the fused GPS up to now.  Does nothing if it already is */
+static void update_gps_fusion()
+{
+    gps_fusion_update(get_imu_sample(IMU_CHANNEL_Y),
+                      get_imu_sample(IMU_CHANNEL_YAW), getUptime());
+}
+
+static double get_fused_latitude()
+{
+    update_gps_fusion();
+    return gps_fusion_get_latitude();
+}
+
+static double get_fused_longitude()
+{
+    update_gps_fusion();
+    return gps_fusion_get_longitude();
+}
+
+static float get_fused_speed_mph()
+{
+    update_gps_fusion();
+    return gps_fusion_get_speed() * 0.621371192; //convert to MPH
+}
+
+static float get_heading()
+{
+    update_gps_fusion();
+    return gps_fusion_get_heading();
+}
+
+static void set_channel_priority(ChannelSample *start,
+                                 const ChannelSample *end,
+                                 const bool low_priority)
+{
+        for (; start < end; ++start)
+                start->low_priority = low_priority;
+}
+
 void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
 {
         buff->ticks = 0;
@@ -231,6 +286,11 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
     chanCfg->flags = ALWAYS_SAMPLED; // Set always sampled flag here so we always take samples
     sample = processChannelSampleWithLongLongGetterNoarg(sample, chanCfg, getMillisSinceEpochAsLongLong);
 
+    /*
+     * Sensor channels are the first to go when telemetry has to shed load.
+     * Time, GPS and lap stats are what the pit wall needs to follow the car.
+     */
+    ChannelSample * const sensor_samples = sample;
 
     for (int i=0; i < CONFIG_ADC_CHANNELS; i++) {
         ADCConfig *config = &(loggerConfig->ADCConfigs[i]);
@@ -275,11 +335,13 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
         sample = processChannelSampleWithFloatGetter(sample, chanCfg, i, get_virtual_channel_value);
     }
 
+    ChannelSample * const position_samples = sample;
+
     GPSConfig *gpsConfig = &(loggerConfig->GPSConfigs);
     chanCfg = &(gpsConfig->latitude);
-    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, GPS_getLatitude);
+    sample = processChannelSampleWithDoubleGetterNoarg(sample, chanCfg, GPS_getLatitude);
     chanCfg = &(gpsConfig->longitude);
-    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, GPS_getLongitude);
+    sample = processChannelSampleWithDoubleGetterNoarg(sample, chanCfg, GPS_getLongitude);
     chanCfg = &(gpsConfig->speed);
     sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, getGpsSpeedInMph);
     chanCfg = &(gpsConfig->distance);
@@ -292,6 +354,14 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
     sample = processChannelSampleWithIntGetterNoarg(sample, chanCfg, GPS_getQuality);
     chanCfg = &(gpsConfig->DOP);
     sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, GPS_getDOP);
+    chanCfg = &(gpsConfig->fusedLatitude);
+    sample = processChannelSampleWithDoubleGetterNoarg(sample, chanCfg, get_fused_latitude);
+    chanCfg = &(gpsConfig->fusedLongitude);
+    sample = processChannelSampleWithDoubleGetterNoarg(sample, chanCfg, get_fused_longitude);
+    chanCfg = &(gpsConfig->fusedSpeed);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, get_fused_speed_mph);
+    chanCfg = &(gpsConfig->heading);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg, get_heading);
 
 
     LapConfig *trackConfig = &(loggerConfig->LapConfigs);
@@ -312,6 +382,38 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
     chanCfg = &(trackConfig->current_lap_cfg);
     sample = processChannelSampleWithIntGetterNoarg(sample, chanCfg,
              lapstats_current_lap);
+    chanCfg = &(trackConfig->optimal_time_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             lapstats_optimal_lap_time_minutes);
+    chanCfg = &(trackConfig->sector_delta_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             lapstats_sector_delta_seconds);
+    chanCfg = &(trackConfig->optimal_delta_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             lapstats_optimal_delta_seconds);
+
+    chanCfg = &(trackConfig->pred_delta_cfg);
+    sample = processChannelSampleWithFloatGetter(sample, chanCfg,
+             PREDICTIVE_REF_BEST, getPredictedDeltaInSeconds);
+    chanCfg = &(trackConfig->session_delta_cfg);
+    sample = processChannelSampleWithFloatGetter(sample, chanCfg,
+             PREDICTIVE_REF_SESSION, getPredictedDeltaInSeconds);
+    chanCfg = &(trackConfig->target_delta_cfg);
+    sample = processChannelSampleWithFloatGetter(sample, chanCfg,
+             PREDICTIVE_REF_TARGET, getPredictedDeltaInSeconds);
+    chanCfg = &(trackConfig->session_distance_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             lapstats_session_distance_miles);
+    chanCfg = &(trackConfig->track_distance_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             track_map_distance_miles);
+    chanCfg = &(trackConfig->lap_percent_cfg);
+    sample = processChannelSampleWithFloatGetterNoarg(sample, chanCfg,
+             track_map_lap_percent);
+
+    set_channel_priority(buff->channel_samples, sensor_samples, false);
+    set_channel_priority(sensor_samples, position_samples, true);
+    set_channel_priority(position_samples, sample, false);
 }
 
 static void populate_channel_sample(ChannelSample *sample)
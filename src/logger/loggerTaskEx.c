@@ -36,6 +36,8 @@
 #include "gps.h"
 #include "lap_stats.h"
 #include "printk.h"
+#include "sample_history.h"
+#include "telemetry_subscription.h"
 
 #define LOGGER_TASK_PRIORITY	( tskIDLE_PRIORITY + 4 )
 #define LOGGER_STACK_SIZE	200
@@ -73,6 +75,7 @@ void vApplicationTickHook(void)
 
 void configChanged()
 {
+    telemetry_subscription_layout_changed();
     g_configChanged = 1;
 }
 
@@ -89,6 +92,7 @@ void stopLogging()
 static void logging_started()
 {
     logging_set_logging_start(getUptimeAsInt());
+    lapstats_start_session();
     LED_disable(3);
     pr_info("Logging started\r\n");
 }
@@ -132,6 +136,11 @@ static int calcTelemetrySampleRate(LoggerConfig *config, int desiredSampleRate)
     return isHigherSampleRate(desiredSampleRate, maxRate) ? maxRate : desiredSampleRate;
 }
 
+int getTelemetrySampleRate(LoggerConfig *config)
+{
+    return calcTelemetrySampleRate(config, getHighestSampleRate(config));
+}
+
 void updateSampleRates(LoggerConfig *loggerConfig, int *loggingSampleRate,
                        int *telemetrySampleRate, int *timebaseSampleRate)
 {
@@ -184,6 +193,7 @@ void loggerTaskEx(void *params)
                         }
 
                         LED_disable(3);
+                        sample_history_reset(get_enabled_channel_count(loggerConfig));
 
                         updateSampleRates(loggerConfig, &loggingSampleRate,
                                           &telemetrySampleRate,
@@ -242,10 +252,15 @@ void loggerTaskEx(void *params)
                         logging_set_status(ls);
                 }
 
-                /* send the sample on to the telemetry task(s) */
+                /*
+                 * send the sample on to the telemetry task(s), and keep it
+                 * around for clients that connect later.
+                 */
                 if (sampledRate >= telemetrySampleRate ||
-                    currentTicks % telemetrySampleRate == 0)
+                    currentTicks % telemetrySampleRate == 0) {
                         queueTelemetryRecord(&msg);
+                        sample_history_add(sample);
+                }
 
                 ++bufferIndex;
                 bufferIndex %= buffer_size;
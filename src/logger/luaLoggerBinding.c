@@ -8,6 +8,7 @@
 #include "loggerData.h"
 #include "gps.h"
 #include "lap_stats.h"
+#include "predictive_timer_2.h"
 #include "imu.h"
 #include "ADC.h"
 #include "timer.h"
@@ -103,6 +104,7 @@ void registerLuaLoggerBindings(lua_State *L)
     lua_registerlight(L,"getGpsDist", Lua_GetGPSDistance);
 
     lua_registerlight(L, "getLapCount", Lua_GetLapCount);
+    lua_registerlight(L, "setTargetLap", Lua_SetTargetLap);
     lua_registerlight(L, "getLapTime", Lua_GetLapTime);
     lua_registerlight(L, "getGpsSec", Lua_GetGpsSecondsSinceFirstFix);
     lua_registerlight(L, "getAtStartFinish",Lua_GetGPSAtStartFinish);
@@ -536,6 +538,31 @@ int Lua_GetLapCount(lua_State *L)
     return 1;
 }
 
+/*
+ * setTargetLap(0) targets the best lap, setTargetLap(1) the session best
+ * and setTargetLap() drops the target.
+ */
+int Lua_SetTargetLap(lua_State *L)
+{
+    enum PredictiveRef source = PREDICTIVE_REF_TARGET;
+    if (lua_gettop(L) >= 1) {
+        switch (lua_tointeger(L, 1)) {
+        case 0:
+            source = PREDICTIVE_REF_BEST;
+            break;
+        case 1:
+            source = PREDICTIVE_REF_SESSION;
+            break;
+        default:
+            lua_pushboolean(L, 0);
+            return 1;
+        }
+    }
+
+    lua_pushboolean(L, setTargetLap(source));
+    return 1;
+}
+
 int Lua_GetGpsSecondsSinceFirstFix(lua_State *L)
 {
     const tiny_millis_t millis = getMillisSinceFirstFix();
@@ -0,0 +1,264 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "capabilities.h"
+#include "sample_history.h"
+#include "sampleRecord.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if (SAMPLE_HISTORY_SIZE & (SAMPLE_HISTORY_SIZE - 1))
+#error "SAMPLE_HISTORY_SIZE must be a power of 2"
+#endif
+
+/* Record header: uint16_t length, uint32_t ticks */
+#define HEADER_SIZE	6
+
+/* A size of 0 turns the history off: no record ever fits */
+static uint8_t g_history[SAMPLE_HISTORY_SIZE ? SAMPLE_HISTORY_SIZE : 1];
+
+static struct {
+        size_t channel_count;
+        size_t count;
+        /* Position of the oldest record */
+        uint32_t head;
+        /* Position the next record goes to */
+        uint32_t tail;
+} g_hist;
+
+static void hist_put(uint32_t *pos, const void *src, size_t len)
+{
+        const uint8_t *b = (const uint8_t *) src;
+        for (; len; --len, ++*pos)
+                g_history[*pos & (SAMPLE_HISTORY_SIZE - 1)] = *b++;
+}
+
+static void hist_get(uint32_t *pos, void *dst, size_t len)
+{
+        uint8_t *b = (uint8_t *) dst;
+        for (; len; --len, ++*pos)
+                *b++ = g_history[*pos & (SAMPLE_HISTORY_SIZE - 1)];
+}
+
+static uint16_t record_length(uint32_t pos)
+{
+        uint16_t len;
+        hist_get(&pos, &len, sizeof(len));
+        return len;
+}
+
+static uint32_t record_ticks(uint32_t pos)
+{
+        uint32_t ticks;
+        pos += sizeof(uint16_t);
+        hist_get(&pos, &ticks, sizeof(ticks));
+        return ticks;
+}
+
+static size_t bitmap_size(void)
+{
+        return (g_hist.channel_count + 7) / 8;
+}
+
+static size_t value_size(const ChannelSample *cs)
+{
+        switch (cs->sampleData) {
+        case SampleData_LongLong:
+        case SampleData_LongLong_Noarg:
+                return sizeof(cs->valueLongLong);
+        case SampleData_Double:
+        case SampleData_Double_Noarg:
+                return sizeof(cs->valueDouble);
+        case SampleData_Float:
+        case SampleData_Float_Noarg:
+                return sizeof(cs->valueFloat);
+        default:
+                return sizeof(cs->valueInt);
+        }
+}
+
+/* Must be called with interrupts off */
+static bool valid(const uint32_t pos)
+{
+        return pos - g_hist.head < g_hist.tail - g_hist.head;
+}
+
+void sample_history_reset(const size_t channel_count)
+{
+        taskENTER_CRITICAL();
+        /* Positions keep growing so that old ones stay invalid */
+        g_hist.head = g_hist.tail;
+        g_hist.count = 0;
+        g_hist.channel_count = channel_count;
+        taskEXIT_CRITICAL();
+}
+
+void sample_history_add(const struct sample *s)
+{
+        if (s->channel_count != g_hist.channel_count)
+                return;
+
+        const ChannelSample *cs = s->channel_samples;
+        const ChannelSample * const end = cs + s->channel_count;
+        size_t len = HEADER_SIZE + bitmap_size();
+
+        for (; cs < end; ++cs)
+                if (cs->populated)
+                        len += value_size(cs);
+
+        if (len > SAMPLE_HISTORY_RECORD_MAX || len > SAMPLE_HISTORY_SIZE)
+                return;
+
+        taskENTER_CRITICAL();
+
+        while (g_hist.tail - g_hist.head + len > SAMPLE_HISTORY_SIZE) {
+                g_hist.head += record_length(g_hist.head);
+                --g_hist.count;
+        }
+
+        uint32_t pos = g_hist.tail;
+        const uint16_t len16 = len;
+        const uint32_t ticks = s->ticks;
+        hist_put(&pos, &len16, sizeof(len16));
+        hist_put(&pos, &ticks, sizeof(ticks));
+
+        uint8_t bits = 0;
+        size_t i = 0;
+        for (cs = s->channel_samples; cs < end; ++cs) {
+                if (cs->populated)
+                        bits |= 1 << (i % 8);
+
+                if (++i % 8 == 0 || cs + 1 == end) {
+                        hist_put(&pos, &bits, 1);
+                        bits = 0;
+                }
+        }
+
+        for (cs = s->channel_samples; cs < end; ++cs)
+                if (cs->populated)
+                        hist_put(&pos, &cs->valueLongLong, value_size(cs));
+
+        g_hist.tail = pos;
+        ++g_hist.count;
+
+        taskEXIT_CRITICAL();
+}
+
+size_t sample_history_count(void)
+{
+        return g_hist.count;
+}
+
+uint32_t sample_history_last(const size_t n)
+{
+        taskENTER_CRITICAL();
+        uint32_t pos = g_hist.head;
+        size_t skip = g_hist.count > n ? g_hist.count - n : 0;
+        taskEXIT_CRITICAL();
+
+        /*
+         * Step along one record at a time so that the logger is never held
+         * up for long.  If we fall off the back we start over.
+         */
+        while (skip) {
+                taskENTER_CRITICAL();
+                if (valid(pos)) {
+                        pos += record_length(pos);
+                        --skip;
+                } else {
+                        pos = g_hist.head;
+                        skip = g_hist.count > n ? g_hist.count - n : 0;
+                }
+                taskEXIT_CRITICAL();
+        }
+
+        return pos;
+}
+
+uint32_t sample_history_since(const size_t ticks)
+{
+        taskENTER_CRITICAL();
+        uint32_t pos = g_hist.head;
+        taskEXIT_CRITICAL();
+
+        for (bool found = false; !found;) {
+                taskENTER_CRITICAL();
+                /* The logger overtook us.  Start over */
+                if (!valid(pos) && pos != g_hist.tail)
+                        pos = g_hist.head;
+
+                found = !valid(pos) ||
+                        (int32_t) (record_ticks(pos) - ticks) > 0;
+                if (!found)
+                        pos += record_length(pos);
+                taskEXIT_CRITICAL();
+        }
+
+        return pos;
+}
+
+bool sample_history_valid(const uint32_t pos)
+{
+        taskENTER_CRITICAL();
+        const bool res = valid(pos);
+        taskEXIT_CRITICAL();
+
+        return res;
+}
+
+bool sample_history_read(uint32_t *pos, struct sample *s)
+{
+        taskENTER_CRITICAL();
+
+        if (!valid(*pos) || s->channel_count != g_hist.channel_count) {
+                taskEXIT_CRITICAL();
+                return false;
+        }
+
+        uint32_t p = *pos;
+        uint16_t len;
+        uint32_t ticks;
+        hist_get(&p, &len, sizeof(len));
+        hist_get(&p, &ticks, sizeof(ticks));
+        s->ticks = ticks;
+
+        uint32_t values = p + bitmap_size();
+        uint8_t bits = 0;
+        ChannelSample *cs = s->channel_samples;
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs) {
+                if (i % 8 == 0)
+                        hist_get(&p, &bits, 1);
+
+                cs->populated = bits & (1 << (i % 8));
+                if (cs->populated)
+                        hist_get(&values, &cs->valueLongLong,
+                                  value_size(cs));
+        }
+
+        *pos += len;
+
+        taskEXIT_CRITICAL();
+        return true;
+}
@@ -0,0 +1,132 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fnv.h"
+#include "loggerConfig.h"
+#include "mem_mang.h"
+#include "mod_string.h"
+#include "telemetry_datagram.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void telemetry_datagram_init(struct telemetry_datagram *td)
+{
+        td->seq = 0;
+        td->layout = 0;
+        td->meta_layout = 0;
+        td->since_meta = 0;
+        td->held.ticks = 0;
+        td->held.channel_count = 0;
+        td->held.channel_samples = NULL;
+}
+
+void telemetry_datagram_free(struct telemetry_datagram *td)
+{
+        portFree(td->held.channel_samples);
+        telemetry_datagram_init(td);
+}
+
+/* New channel layout.  Start over with nothing held */
+static bool reset_held(struct telemetry_datagram *td, const struct sample *s)
+{
+        const size_t count = s->channel_count;
+
+        portFree(td->held.channel_samples);
+        td->held.channel_count = 0;
+        td->held.channel_samples =
+                (ChannelSample *) portMalloc(count * sizeof(ChannelSample));
+        if (!td->held.channel_samples)
+                return false;
+
+        memcpy(td->held.channel_samples, s->channel_samples,
+               count * sizeof(ChannelSample));
+        for (size_t i = 0; i < count; ++i)
+                td->held.channel_samples[i].populated = false;
+
+        td->held.channel_count = count;
+        telemetry_datagram_layout_changed(td);
+        return true;
+}
+
+const struct sample* telemetry_datagram_update(struct telemetry_datagram *td,
+                                               const struct sample *s)
+{
+        if (s->channel_count != td->held.channel_count &&
+            !reset_held(td, s))
+                return NULL;
+
+        const ChannelSample *cs = s->channel_samples;
+        ChannelSample *held = td->held.channel_samples;
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs, ++held) {
+                if (cs->cfg != held->cfg) {
+                        *held = *cs;
+                        telemetry_datagram_layout_changed(td);
+                } else if (cs->populated) {
+                        *held = *cs;
+                }
+        }
+
+        td->held.ticks = s->ticks;
+        return &td->held;
+}
+
+void telemetry_datagram_layout_changed(struct telemetry_datagram *td)
+{
+        td->layout = 0;
+}
+
+uint32_t telemetry_datagram_layout(struct telemetry_datagram *td,
+                                   const struct telemetry_subscription *sub)
+{
+        if (td->layout)
+                return td->layout;
+
+        uint32_t hash = FNV1A_32_INIT;
+        const size_t count = telemetry_subscription_channel_count(sub, &td->held);
+        for (size_t i = 0; i < count; ++i) {
+                const ChannelSample *cs =
+                        telemetry_subscription_channel(sub, &td->held, i);
+                hash = fnv1a_32(hash, cs->cfg, sizeof(ChannelConfig));
+        }
+
+        td->layout = hash;
+        return hash;
+}
+
+bool telemetry_datagram_meta_due(const struct telemetry_datagram *td)
+{
+        return td->layout != td->meta_layout ||
+                td->since_meta >= TELEMETRY_DATAGRAM_META_INTERVAL;
+}
+
+void telemetry_datagram_meta_sent(struct telemetry_datagram *td)
+{
+        td->meta_layout = td->layout;
+        td->since_meta = 0;
+}
+
+uint32_t telemetry_datagram_next_seq(struct telemetry_datagram *td)
+{
+        ++td->since_meta;
+        return td->seq++;
+}
@@ -0,0 +1,190 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loggerConfig.h"
+#include "printk.h"
+#include "sampleRecord.h"
+#include "serial.h"
+#include "telemetry_rate.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Level at which low priority channels are shed */
+#define LEVEL_SHED	1
+/* First level at which the rate itself is reduced */
+#define LEVEL_DECIMATE	2
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof(a[0]))
+
+/* The rates we will step down through, fastest to slowest */
+static const int rate_ladder[] = {
+        SAMPLE_50Hz,
+        SAMPLE_25Hz,
+        SAMPLE_10Hz,
+        SAMPLE_5Hz,
+        SAMPLE_1Hz,
+};
+
+static int g_current_rate[SERIAL_COUNT];
+
+/* Index of the first ladder rate that is slower than the given rate */
+static size_t first_slower_rate(const int rate)
+{
+        size_t i = 0;
+        while (i < ARRAY_LEN(rate_ladder) &&
+               !isHigherSampleRate(rate, rate_ladder[i]))
+                ++i;
+
+        return i;
+}
+
+static void set_level(struct telemetry_rate *tr, const size_t level)
+{
+        tr->level = level;
+        tr->rate = level < LEVEL_DECIMATE ? tr->base_rate :
+                rate_ladder[first_slower_rate(tr->base_rate) +
+                            level - LEVEL_DECIMATE];
+
+        /* Let the first sample at the new rate straight through */
+        tr->credit = tr->rate;
+
+        pr_info_int_msg("telemetry: rate level ", level);
+}
+
+void telemetry_rate_init(struct telemetry_rate *tr, const int base_rate)
+{
+        tr->base_rate = base_rate;
+        tr->max_level = SAMPLE_DISABLED == base_rate ? 0 :
+                LEVEL_SHED + ARRAY_LEN(rate_ladder) -
+                first_slower_rate(base_rate);
+        tr->level = 0;
+        tr->rate = base_rate;
+        tr->settle_count = 0;
+        tr->clear_count = 0;
+        tr->credit = base_rate;
+        tr->last_ticks = 0;
+}
+
+void telemetry_rate_update(struct telemetry_rate *tr, const size_t backlog,
+                           const size_t send_ticks)
+{
+        /* Sample period at our current rate, in ticks */
+        const size_t period = tr->rate;
+        const bool congested = backlog >= TELEMETRY_RATE_BACKLOG_HIGH ||
+                send_ticks > period;
+        const bool clear = 0 == backlog && send_ticks <= period / 2;
+
+        if (tr->settle_count)
+                --tr->settle_count;
+
+        if (congested) {
+                tr->clear_count = 0;
+                if (tr->settle_count || tr->level >= tr->max_level)
+                        return;
+
+                set_level(tr, tr->level + 1);
+                tr->settle_count = TELEMETRY_RATE_SETTLE_UPDATES;
+                return;
+        }
+
+        if (!clear) {
+                tr->clear_count = 0;
+                return;
+        }
+
+        if (0 == tr->level ||
+            ++tr->clear_count < TELEMETRY_RATE_RECOVER_UPDATES)
+                return;
+
+        set_level(tr, tr->level - 1);
+        tr->clear_count = 0;
+}
+
+bool telemetry_rate_should_send(struct telemetry_rate *tr,
+                                const struct sample *s)
+{
+        const size_t elapsed = s->ticks - tr->last_ticks;
+        tr->last_ticks = s->ticks;
+
+        if (tr->level < LEVEL_SHED)
+                return true;
+
+        const bool drop = telemetry_rate_drop_low_priority(tr);
+        const bool decimate = tr->level >= LEVEL_DECIMATE;
+        bool has_data = false;
+        const ChannelSample *cs = s->channel_samples;
+
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs) {
+                if (!cs->populated || (cs->cfg->flags & ALWAYS_SAMPLED))
+                        continue;
+
+                if (drop && cs->low_priority)
+                        continue;
+
+                /* Slow channels are already below our rate.  Let them by */
+                if (decimate &&
+                    isHigherSampleRate(tr->rate, cs->cfg->sampleRate))
+                        return true;
+
+                has_data = true;
+        }
+
+        if (!has_data)
+                return false;
+
+        if (!decimate)
+                return true;
+
+        /* Never bank more than one sample worth of time.  No bursts */
+        const size_t rate = tr->rate;
+        tr->credit += elapsed;
+        if (tr->credit > rate)
+                tr->credit = rate;
+
+        if (tr->credit < rate)
+                return false;
+
+        tr->credit -= rate;
+        return true;
+}
+
+bool telemetry_rate_drop_low_priority(const struct telemetry_rate *tr)
+{
+        return tr->level >= LEVEL_SHED;
+}
+
+int telemetry_rate_get_rate(const struct telemetry_rate *tr)
+{
+        return tr->rate;
+}
+
+void telemetry_rate_set_current(const serial_id_t port, const int rate)
+{
+        if (port < SERIAL_COUNT)
+                g_current_rate[port] = rate;
+}
+
+int telemetry_rate_get_current(const serial_id_t port)
+{
+        return port < SERIAL_COUNT ?
+                decodeSampleRate(g_current_rate[port]) : 0;
+}
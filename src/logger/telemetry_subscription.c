@@ -0,0 +1,192 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loggerConfig.h"
+#include "mod_string.h"
+#include "telemetry_subscription.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+static struct telemetry_subscription g_subscriptions[SERIAL_COUNT];
+static volatile size_t g_layout;
+
+static void reset(struct telemetry_subscription *sub)
+{
+        ++sub->generation;
+        sub->rate = SAMPLE_DISABLED;
+        sub->channel_count = 0;
+        sub->count = 0;
+        sub->credit = 0;
+        sub->last_ticks = 0;
+}
+
+struct telemetry_subscription* telemetry_subscription_get(const Serial *serial)
+{
+        struct telemetry_subscription *free_sub = NULL;
+
+        for (size_t i = 0; i < SERIAL_COUNT; ++i) {
+                struct telemetry_subscription *sub = g_subscriptions + i;
+                if (sub->serial == serial)
+                        return sub;
+
+                if (NULL == sub->serial && NULL == free_sub)
+                        free_sub = sub;
+        }
+
+        if (free_sub) {
+                free_sub->serial = serial;
+                reset(free_sub);
+        }
+
+        return free_sub;
+}
+
+void telemetry_subscription_clear(struct telemetry_subscription *sub)
+{
+        reset(sub);
+}
+
+void telemetry_subscription_layout_changed(void)
+{
+        ++g_layout;
+}
+
+size_t telemetry_subscription_layout(void)
+{
+        return g_layout;
+}
+
+bool telemetry_subscription_set(struct telemetry_subscription *sub,
+                                const size_t layout,
+                                const size_t channel_count,
+                                const uint16_t *index, const size_t count,
+                                const int rate)
+{
+        if (count > MAX_SUBSCRIPTION_CHANNELS)
+                return false;
+
+        reset(sub);
+        sub->layout = layout;
+        sub->channel_count = channel_count;
+        sub->rate = rate;
+        sub->count = count;
+        for (size_t i = 0; i < count; ++i)
+                sub->index[i] = index[i];
+
+        /* Let the first sample straight through */
+        sub->credit = rate;
+
+        return true;
+}
+
+int telemetry_subscription_find_channel(const struct sample *s,
+                                        const char *name)
+{
+        const ChannelSample *cs = s->channel_samples;
+
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs)
+                if (0 == strcmp(name, cs->cfg->label))
+                        return i;
+
+        return -1;
+}
+
+bool telemetry_subscription_active(const struct telemetry_subscription *sub)
+{
+        return sub && 0 != sub->channel_count;
+}
+
+bool telemetry_subscription_matches(const struct telemetry_subscription *sub,
+                                    const struct sample *s)
+{
+        return sub->layout == g_layout &&
+                sub->channel_count == s->channel_count;
+}
+
+int telemetry_subscription_get_rate(const struct telemetry_subscription *sub,
+                                    const int telemetry_rate)
+{
+        if (!telemetry_subscription_active(sub))
+                return telemetry_rate;
+
+        return isHigherSampleRate(telemetry_rate, sub->rate) ?
+                sub->rate : telemetry_rate;
+}
+
+bool telemetry_subscription_should_send(struct telemetry_subscription *sub,
+                                        const struct sample *s)
+{
+        if (!telemetry_subscription_active(sub))
+                return true;
+
+        const size_t elapsed = s->ticks - sub->last_ticks;
+        sub->last_ticks = s->ticks;
+
+        const int rate = sub->rate;
+        const size_t count = telemetry_subscription_channel_count(sub, s);
+        bool has_data = false;
+
+        for (size_t i = 0; i < count; ++i) {
+                const ChannelSample *cs =
+                        telemetry_subscription_channel(sub, s, i);
+                if (!cs->populated || (cs->cfg->flags & ALWAYS_SAMPLED))
+                        continue;
+
+                /* Slow channels are already below our rate.  Let them by */
+                if (SAMPLE_DISABLED != rate &&
+                    isHigherSampleRate(rate, cs->cfg->sampleRate))
+                        return true;
+
+                has_data = true;
+        }
+
+        if (!has_data)
+                return false;
+
+        if (SAMPLE_DISABLED == rate)
+                return true;
+
+        /* Same scheme as the rate controller.  No bursts */
+        sub->credit += elapsed;
+        if (sub->credit > (size_t) rate)
+                sub->credit = rate;
+
+        if (sub->credit < (size_t) rate)
+                return false;
+
+        sub->credit -= rate;
+        return true;
+}
+
+size_t telemetry_subscription_channel_count(const struct telemetry_subscription *sub,
+                                            const struct sample *s)
+{
+        return sub && sub->count ? sub->count : s->channel_count;
+}
+
+const ChannelSample*
+telemetry_subscription_channel(const struct telemetry_subscription *sub,
+                               const struct sample *s, const size_t i)
+{
+        return s->channel_samples + (sub && sub->count ? sub->index[i] : i);
+}
@@ -17,21 +17,42 @@ void initMessaging()
     initApi();
 }
 
+/*
+ * Hands an API message to the parser.  Messages too big for the buffer
+ * are streamed through, reading the rest of the line a buffer at a time.
+ */
+static void process_api_msg(Serial *serial, char *buffer, size_t bufferSize,
+                            int complete)
+{
+    if (complete) {
+        process_api(serial, buffer, bufferSize);
+        return;
+    }
+
+    api_stream_begin(serial);
+    api_stream_feed(buffer, strlen(buffer));
+    while (!complete) {
+        complete = read_line(serial, buffer, bufferSize);
+        api_stream_feed(buffer, strlen(buffer));
+    }
+    api_stream_end();
+}
+
 void process_msg(Serial *serial, char * buffer, size_t bufferSize)
 {
     if (lockedApiMode) {
-        read_line(serial, buffer, bufferSize);
+        int complete = read_line(serial, buffer, bufferSize);
         if (buffer[0] =='\0') {
             lockedApiMode = 0;
             show_command_prompt(serial);
         } else {
-            process_api(serial, buffer, bufferSize);
+            process_api_msg(serial, buffer, bufferSize, complete);
         }
     } else {
-        interactive_read_line(serial, buffer, bufferSize);
+        int complete = interactive_read_line(serial, buffer, bufferSize);
         if (buffer[0] == '{') {
             lockedApiMode = 1;
-            process_api(serial, buffer, bufferSize);
+            process_api_msg(serial, buffer, bufferSize, complete);
         } else {
             if (strlen(buffer) == 0) {
                 show_welcome(serial);
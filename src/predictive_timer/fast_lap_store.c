@@ -0,0 +1,310 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "fast_lap_store.h"
+#include "ff.h"
+#include "fileWriter.h"
+#include "fnv.h"
+#include "mem_mang.h"
+#include "mod_string.h"
+#include "predictive_timer_2.h"
+#include "printk.h"
+#include "sampleRecord.h"
+#include "sdcard.h"
+#include "task.h"
+#include "track_map.h"
+#include "tracks.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum store_state {
+        STORE_IDLE,
+        /* The file writer owns the data while these are set */
+        STORE_SAVE,
+        STORE_LOAD,
+        /* Read, waiting for the GPS task to apply it */
+        STORE_LOADED,
+};
+
+/* Fast lap then outline.  Only held while a request is out */
+#define STORE_BUF_SIZE	(FAST_LAP_SAVE_SIZE + TRACK_MAP_SAVE_SIZE)
+
+static struct {
+        volatile enum store_state state;
+        int32_t track_id;
+        uint32_t track_hash;
+        char name[FILENAME_LEN];
+        size_t len;
+        char map_name[FILENAME_LEN];
+        size_t map_len;
+        uint8_t *buf;
+} g_store;
+
+static uint8_t * store_data(void)
+{
+        return g_store.buf;
+}
+
+static uint8_t * store_map(void)
+{
+        return g_store.buf + FAST_LAP_SAVE_SIZE;
+}
+
+/* Call before going back to STORE_IDLE, while nobody else touches it */
+static void store_free(void)
+{
+        vPortFree(g_store.buf);
+        g_store.buf = NULL;
+}
+
+static uint32_t track_hash(const Track *track)
+{
+        const uint32_t type = track->track_type;
+        const uint32_t hash = fnv1a_32(FNV1A_32_INIT, &type, sizeof(type));
+        return fnv1a_32(hash, track->allSectors, sizeof(track->allSectors));
+}
+
+static void make_file_name(const Track *track, const char *ext, char *name)
+{
+        static const char hex[] = "0123456789ABCDEF";
+
+        /* Tracks defined on the unit have no id.  Go by their shape */
+        const uint32_t key = track->trackId ? (uint32_t) track->trackId :
+                track_hash(track);
+        for (int i = 0; i < 8; ++i)
+                name[i] = hex[(key >> (28 - 4 * i)) & 0xf];
+        strcpy(name + 8, ext);
+}
+
+const char * fast_lap_store_file_name(const Track *track)
+{
+        static char name[FILENAME_LEN];
+        make_file_name(track, ".LAP", name);
+        return name;
+}
+
+const char * fast_lap_store_map_file_name(const Track *track)
+{
+        static char name[FILENAME_LEN];
+        make_file_name(track, ".MAP", name);
+        return name;
+}
+
+static bool pending(void)
+{
+        const enum store_state state = g_store.state;
+        return STORE_SAVE == state || STORE_LOAD == state;
+}
+
+/* Gets the file writer to look at us.  If this fails the next request will */
+static void kick(void)
+{
+        const LoggerMessage msg =
+                create_logger_message(LoggerMessageType_FastLap, NULL);
+        queue_logfile_record(&msg);
+}
+
+static bool request(const Track *track, const enum store_state state)
+{
+        if (pending()) {
+                kick();
+                return false;
+        }
+
+        if (NULL == g_store.buf)
+                g_store.buf = (uint8_t *) pvPortMalloc(STORE_BUF_SIZE);
+        if (NULL == g_store.buf) {
+                g_store.state = STORE_IDLE;
+                return false;
+        }
+
+        g_store.track_id = track->trackId;
+        g_store.track_hash = track_hash(track);
+        make_file_name(track, ".LAP", g_store.name);
+        make_file_name(track, ".MAP", g_store.map_name);
+
+        if (STORE_SAVE == state) {
+                g_store.len = saveFastLap(g_store.track_id, g_store.track_hash,
+                                          store_data(), FAST_LAP_SAVE_SIZE);
+                g_store.map_len = track_map_save(g_store.track_id,
+                                                 g_store.track_hash,
+                                                 store_map(),
+                                                 TRACK_MAP_SAVE_SIZE);
+                if (!g_store.len && !g_store.map_len) {
+                        store_free();
+                        g_store.state = STORE_IDLE;
+                        return false;
+                }
+        }
+
+        taskENTER_CRITICAL();
+        g_store.state = state;
+        taskEXIT_CRITICAL();
+
+        kick();
+        return true;
+}
+
+bool fast_lap_store_save(const Track *track)
+{
+        return request(track, STORE_SAVE);
+}
+
+bool fast_lap_store_load(const Track *track)
+{
+        return request(track, STORE_LOAD);
+}
+
+bool fast_lap_store_apply(void)
+{
+        if (STORE_LOADED != g_store.state)
+                return false;
+
+        bool loaded = false;
+        if (g_store.len) {
+                loaded = loadFastLap(g_store.track_id, g_store.track_hash,
+                                     store_data(), g_store.len);
+                if (!loaded)
+                        pr_info_str_msg("fast lap: not using ", g_store.name);
+        }
+
+        if (g_store.map_len) {
+                const bool mapped = track_map_load(g_store.track_id,
+                                                   g_store.track_hash,
+                                                   store_map(),
+                                                   g_store.map_len);
+                if (!mapped)
+                        pr_info_str_msg("fast lap: not using ",
+                                        g_store.map_name);
+                loaded = loaded || mapped;
+        }
+
+        store_free();
+        g_store.state = STORE_IDLE;
+        return loaded;
+}
+
+static int write_file(FIL *f, const char *name, const uint8_t *data,
+                      const size_t len)
+{
+        /* Keep what was saved before rather than have nothing */
+        if (!len)
+                return 0;
+
+        int rc = f_open(f, name, FA_WRITE | FA_CREATE_ALWAYS);
+        if (FR_OK != rc)
+                return rc;
+
+        UINT bw = 0;
+        rc = f_write(f, data, len, &bw);
+        const int close_rc = f_close(f);
+
+        if (FR_OK == rc && bw != len)
+                rc = FR_DISK_ERR;
+
+        return FR_OK == rc ? close_rc : rc;
+}
+
+static int read_file(FIL *f, const char *name, uint8_t *data,
+                     const size_t size, size_t *len)
+{
+        *len = 0;
+
+        int rc = f_open(f, name, FA_READ);
+        /* Nothing saved for this track yet */
+        if (FR_NO_FILE == rc)
+                return 0;
+        if (FR_OK != rc)
+                return rc;
+
+        UINT br = 0;
+        rc = f_read(f, data, size, &br);
+        f_close(f);
+        *len = br;
+
+        return rc;
+}
+
+static int write_files(FIL *f)
+{
+        const int rc = write_file(f, g_store.name, store_data(), g_store.len);
+        return rc ? rc : write_file(f, g_store.map_name, store_map(),
+                                    g_store.map_len);
+}
+
+static int read_files(FIL *f)
+{
+        const int rc = read_file(f, g_store.name, store_data(),
+                                 FAST_LAP_SAVE_SIZE, &g_store.len);
+        return rc ? rc : read_file(f, g_store.map_name, store_map(),
+                                   TRACK_MAP_SAVE_SIZE, &g_store.map_len);
+}
+
+int fast_lap_store_sync(const bool mounted)
+{
+        const enum store_state state = g_store.state;
+        if (STORE_SAVE != state && STORE_LOAD != state)
+                return 0;
+
+        /*
+         * Most likely there is no card in.  Running without one is fine, so
+         * this is not worth the error LED.  The drivers do not all tell a
+         * missing card from a bad one.
+         */
+        if (!mounted && 0 != InitFS()) {
+                pr_info_str_msg("fast lap: no SD card for ", g_store.name);
+                UnmountFS();
+                store_free();
+
+                taskENTER_CRITICAL();
+                g_store.state = STORE_IDLE;
+                taskEXIT_CRITICAL();
+
+                return 0;
+        }
+
+        FIL *f = (FIL *) pvPortMalloc(sizeof(FIL));
+        int rc = f ? 0 : -1;
+        if (0 == rc)
+                rc = STORE_SAVE == state ? write_files(f) : read_files(f);
+
+        if (f)
+                vPortFree(f);
+        if (!mounted)
+                UnmountFS();
+
+        if (rc)
+                pr_warning_str_msg("fast lap: SD error on ", g_store.name);
+
+        const bool loaded = STORE_LOAD == state && 0 == rc &&
+                (g_store.len || g_store.map_len);
+        if (!loaded)
+                store_free();
+
+        taskENTER_CRITICAL();
+        g_store.state = loaded ? STORE_LOADED : STORE_IDLE;
+        taskEXIT_CRITICAL();
+
+        return rc;
+}
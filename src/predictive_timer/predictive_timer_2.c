@@ -5,28 +5,52 @@
  *      Author: stieg
  */
 
+#include "capabilities.h"
 #include "dateTime.h"
 #include "debug.h"
+#include "fnv.h"
 #include "geopoint.h"
 #include "gps.h"
 #include "mod_string.h"
 #include "predictive_timer_2.h"
 
+#include <math.h>
+#include <stdint.h>
+
 /**
  * These settings control critical values that will affect performance.  Understand these values
  * before altering them.  All time values are in milliseconds since epoch.  All time deltas are
- * in milliseconds.
+ * in milliseconds.  All distances are in meters.
+ */
+/**
+ * # of reference points per lap.  Each point is 16 bytes.  A lap is kept for each reference and
+ * one more for the lap in progress.  References that are the same lap share it.
+ */
+#define MAX_TIMELOC_SAMPLES PREDICTIVE_TIMER_SAMPLES
+
+/**
+ * How far apart the reference points are on the first lap.  After that the spacing is set from
+ * the length of the last lap so that a lap fills ~90% of the buffer.
+ */
+#define INITIAL_SAMPLE_SPACING 10.0f
+
+/**
+ * The closest the reference points get.  Below this we would only be recording GPS noise.
  */
+#define MIN_SAMPLE_SPACING 2.0f
+
 /**
- * # of slots per buffer.  Each slot is 12 bytes.
+ * How many segments of a reference lap behind and ahead of the last match are searched.  The car
+ * does not go backwards and a few fixes never cover more than a handful of segments.
  */
-#define MAX_TIMELOC_SAMPLES 96
+#define SEARCH_BEHIND 2
+#define SEARCH_AHEAD 16
 
 /**
- * How frequently to initially take in GPS data.  To small and we overflow.  To large and we don't
- * update very frequently.
+ * If the car is further than this from a reference lap around where we last matched it, we have lost
+ * track of it (a gap in the fixes, the pits) and search the whole lap.
  */
-#define INITIAL_POLL_INTERVAL 5000
+#define MAX_MATCH_DISTANCE 30.0f
 
 /**
  * The absolute minimum predicted time.  This fixes issues related to predictive timing around the
@@ -34,43 +58,75 @@
  */
 #define MIN_PREDICTED_TIME 10000
 
-// A smaller TimeLoc value for space savings
-struct PtTimeLoc {
-    GeoPoint point;
-    tiny_millis_t time;
+/**
+ * The saved fast lap: a header, then each point after the first as the change in x and y in
+ * decimeters (int16) and in time in ms (uint16), then an FNV-1a hash of all that.  Little endian.
+ */
+#define FAST_LAP_MAGIC 0x50414c46 // "FLAP"
+#define FAST_LAP_HEADER_SIZE 28
+#define FAST_LAP_POINT_SIZE 6
+#define FAST_LAP_HASH_SIZE 4
+#define FAST_LAP_POS_SCALE 10.0f
+
+/**
+ * A point of a reference lap.  Positions are in a flat frame local to the lap, so that no trig is
+ * needed to compare them.
+ */
+struct RefPoint {
+    float x;            // Meters east of the lap origin.
+    float y;            // Meters north of the lap origin.
+    float dist;         // Meters driven since the start of the lap.
+    tiny_millis_t time; // Time since the start of the lap.
 };
 
-static struct PtTimeLoc buff1[MAX_TIMELOC_SAMPLES];
-static struct PtTimeLoc buff2[MAX_TIMELOC_SAMPLES];
+/**
+ * A lap as a polyline parameterized by the distance driven.  The origin is where the lap started.
+ */
+struct RefLap {
+    struct RefPoint points[MAX_TIMELOC_SAMPLES];
+    int count;
+    struct gp_projection frame;
+};
 
-// Our pointers that maintain the fast lap and current lap buffers.
-static struct PtTimeLoc *currLap = buff1;
-static struct PtTimeLoc *fastLap = buff2;
+/**
+ * A lap we predict against.  Each one follows the car along its own lap.
+ */
+struct Reference {
+    struct RefLap *lap; // NULL until there is one.
+    tiny_millis_t lapTime;
+    // The segment of the lap that the last lookup matched.  Where the next search starts.
+    int matchIndex;
+    // The last split.  Used for when we don't have good data to give yet.
+    tiny_millis_t lastSplit;
+};
 
-// Index to track current slot in buffer
-static int buffIndex;
+static struct RefLap laps[PREDICTIVE_TIMER_REFS + 1];
+static struct Reference refs[PREDICTIVE_TIMER_REFS];
 
-// Index to track high slot in fastLapTimer.  Its points to the next open slot there.
-static int fastLapIndex;
+// The lap being recorded.  Never one a reference uses.
+static struct RefLap *currLap = laps;
 
-// Time of the fast lap.
-static tiny_millis_t fastLapTime;
+// Where #setTargetLap wants the target lap from.  Taken up by the GPS task.
+#define NO_TARGET_REQUEST -1
+static volatile int targetRequest = NO_TARGET_REQUEST;
 
 // Time current lap started.
 static tiny_millis_t currLapStartTime;
 
+// Meters driven in the current lap, and where the last fix was in its frame.
+static float currLapDist;
+static float lastX;
+static float lastY;
+
 // Holds the lastPredictedTime.  Used for when we don't have good data to give yet.
 static tiny_millis_t lastPredictedTime;
 
-// Holds the last predicted Delta.  Used like lastPredictedTime.
-static tiny_millis_t lastPredictedDelta;
-
-// Interval between polls in milliseconds.
-static tiny_millis_t pollInterval = INITIAL_POLL_INTERVAL;
+// Distance between reference points in meters.
+static float sampleSpacing = INITIAL_SAMPLE_SPACING;
 
 // Indicates the current status of the recording code.  DISABLED until we start the first lap.
 static enum Status {
-    DISABLED, RECORDING, FULL,
+    DISABLED, RECORDING,
 } status = DISABLED;
 
 /**
@@ -84,106 +140,174 @@ static tiny_millis_t getCurrentLapTime(tiny_millis_t time)
 }
 
 /**
- * Creates a timeLoc sample and places it in the currBuff.  Increments counter as needed.
- * @return true if the insert succeeded, false otherwise.
+ * Drops every other point of the current lap, keeping the first, and doubles the spacing.  This
+ * is how a lap longer than the buffer still gets recorded from end to end.
  */
-static bool insertTimeLocSample(const GeoPoint * point, tiny_millis_t time)
+static void decimateCurrLap()
 {
-    if (buffIndex >= MAX_TIMELOC_SAMPLES)
-        return false;
+    int j = 0;
+    for (int i = 0; i < currLap->count; i += 2)
+        currLap->points[j++] = currLap->points[i];
 
-    struct PtTimeLoc *timeLoc = currLap + buffIndex;
-    timeLoc->point = *point;
-    timeLoc->time = getCurrentLapTime(time);
+    currLap->count = j;
+    sampleSpacing *= 2;
+    DEBUG("Buffer full.  Sample spacing now %f\n", sampleSpacing);
+}
 
-    if (++buffIndex >= MAX_TIMELOC_SAMPLES)
-        DEBUG("Buffer now Full!\n");
+/**
+ * Appends a reference point to the current lap, making room for it if needed.
+ */
+static void insertRefPoint(float x, float y, float dist, tiny_millis_t time)
+{
+    if (currLap->count >= MAX_TIMELOC_SAMPLES)
+        decimateCurrLap();
+
+    struct RefPoint *rp = currLap->points + currLap->count++;
+    rp->x = x;
+    rp->y = y;
+    rp->dist = dist;
+    rp->time = time;
+}
 
-    return true;
+/**
+ * @return The number of references that use the lap.
+ */
+static int lapUsers(const struct RefLap *lap)
+{
+    int users = 0;
+    for (int i = 0; i < PREDICTIVE_TIMER_REFS; ++i)
+        users += refs[i].lap == lap;
+
+    return users;
 }
 
 /**
- * Handles all the work done if a new hot Lap is set.
- * @param lapTime The time it took to complete the lap.
+ * @return A lap that neither a reference nor the lap in progress uses.  There is always one,
+ * as there is one more lap than there are references.
  */
-static void setNewFastLap(tiny_millis_t lapTime)
+static struct RefLap * freeLap()
 {
-    DEBUG("Setting new fast lap time to %f\n", lapTime);
-    fastLapTime = lapTime;
+    for (int i = 0; i < PREDICTIVE_TIMER_REFS; ++i)
+        if (laps + i != currLap && !lapUsers(laps + i))
+            return laps + i;
 
-    // Swap out our buffers.
-    fastLapIndex = buffIndex;
-    fastLap = currLap;
-    currLap = currLap == buff1 ? buff2 : buff1;
+    return laps + PREDICTIVE_TIMER_REFS;
 }
 
-bool isPredictiveTimeAvailable()
+static void setReference(const enum PredictiveRef ref, struct RefLap *lap,
+                         const tiny_millis_t lapTime)
 {
-    return fastLapIndex != 0;
+    DEBUG("Setting reference %d lap time to %f\n", ref, lapTime);
+    refs[ref].lap = lap;
+    refs[ref].lapTime = lapTime;
+    refs[ref].matchIndex = 0;
 }
 
 /**
- * Adjusts the poll interval so that we can effectively use our buffer.  The more full it
- * gets the better timing accuracy we can give.
+ * Takes up a request of #setTargetLap.  Only ever done by the GPS task, so that the laps do not
+ * change under it.
  */
-static tiny_millis_t adjustPollInterval(tiny_millis_t lapTime)
+static void takeTargetRequest()
 {
-    // If no hotLap is set there no data to work with.
-    if (!isPredictiveTimeAvailable())
-        return pollInterval;
+    const int source = targetRequest;
+    if (source == NO_TARGET_REQUEST || PREDICTIVE_REF_TARGET >= PREDICTIVE_TIMER_REFS)
+        return;
+
+    targetRequest = NO_TARGET_REQUEST;
+    struct Reference *target = refs + PREDICTIVE_REF_TARGET;
+    if (source == PREDICTIVE_REF_TARGET) {
+        target->lap = NULL;
+        target->lapTime = 0;
+    } else {
+        // Laps are never written to while a reference uses them, so sharing one is a copy.
+        *target = refs[source];
+    }
+}
 
-    // Target 90% buffer use +- 10%.
-    const float slots = (float) MAX_TIMELOC_SAMPLES;
-    const float percentUsed = ((float) buffIndex) / slots;
-    DEBUG("Recorded %d samples.  Targeting ~ %f samples.\n", buffIndex, slots * 0.9);
+bool isReferenceAvailable(const enum PredictiveRef ref)
+{
+    return (size_t) ref < PREDICTIVE_TIMER_REFS && refs[ref].lap && refs[ref].lap->count != 0;
+}
 
-    if (percentUsed > 0.8 && status != FULL) {
-        DEBUG("Within target range.  Not adjusting sample rate.\n");
-        return pollInterval;
-    }
+tiny_millis_t getReferenceLapTime(const enum PredictiveRef ref)
+{
+    return isReferenceAvailable(ref) ? refs[ref].lapTime : 0;
+}
 
-    // Careful here of gotchas with tiny_millis_t and floats.
-    pollInterval = lapTime / (slots / 0.9);
-    DEBUG("Setting poll interval to %ull\n", pollInterval);
+bool setTargetLap(const enum PredictiveRef source)
+{
+    if (PREDICTIVE_REF_TARGET >= PREDICTIVE_TIMER_REFS)
+        return false;
+
+    if (source != PREDICTIVE_REF_TARGET && !isReferenceAvailable(source))
+        return false;
 
-    return pollInterval;
+    targetRequest = source;
+    return true;
+}
+
+bool isPredictiveTimeAvailable()
+{
+    return isReferenceAvailable(PREDICTIVE_REF_BEST);
 }
 
 /**
- * @param time The time the sample was taken
- * @return The difference in seconds between our most recent sample a this new one.
+ * Adjusts the sample spacing so that we can effectively use our buffer.  The more full it
+ * gets the better timing accuracy we can give.
+ * @param lapDist The length of the lap just finished.
  */
-static tiny_millis_t getTimeSinceLastSample(tiny_millis_t time)
+static float adjustSampleSpacing(float lapDist)
 {
-    return time - currLapStartTime - currLap[buffIndex - 1].time;
+    // Target 90% buffer use.
+    sampleSpacing = lapDist / (MAX_TIMELOC_SAMPLES * 0.9f);
+    if (sampleSpacing < MIN_SAMPLE_SPACING)
+        sampleSpacing = MIN_SAMPLE_SPACING;
+
+    DEBUG("Setting sample spacing to %f\n", sampleSpacing);
+    return sampleSpacing;
 }
 
 /**
  * Handles adding a sample at the end of the lap.  This is needed so we always
  * get an accurate reading, even if we run out of buffer space.
  */
-void finishLap(const GpsSnapshot *gpsSnapshot)
+bool finishLap(const GeoPoint *point, const tiny_millis_t time)
 {
-    if (status == DISABLED) return;
+    if (status == DISABLED) return false;
 
-    const tiny_millis_t time = gpsSnapshot->deltaFirstFix;
-    const GeoPoint *point = &gpsSnapshot->sample.point;
+    const tiny_millis_t lapTime = getCurrentLapTime(time);
 
-    // Drop last entry if necessary to record end of lap.
-    if (buffIndex >= MAX_TIMELOC_SAMPLES)
-        buffIndex = MAX_TIMELOC_SAMPLES - 1;
+    // The fix that took us over the line may already be in.  It comes after the finish.
+    while (currLap->count > 1 && currLap->points[currLap->count - 1].time >= lapTime)
+        --currLap->count;
 
-    insertTimeLocSample(point, time);
+    const struct RefPoint *last = currLap->points + currLap->count - 1;
+    float x, y;
+    gp_project(&currLap->frame, point, &x, &y);
+    const float dx = x - last->x;
+    const float dy = y - last->y;
+    const float lapDist = last->dist + sqrtf(dx * dx + dy * dy);
+    insertRefPoint(x, y, lapDist, lapTime);
 
-    tiny_millis_t lapTime = getCurrentLapTime(time);
     INFO("Last lap time was %f seconds\n", lapTime);
 
-    if (fastLapTime <= 0.0 || lapTime <= fastLapTime) {
-        setNewFastLap(lapTime);
+    const tiny_millis_t bestTime = refs[PREDICTIVE_REF_BEST].lapTime;
+    const bool fast = bestTime <= 0 || lapTime <= bestTime;
+    if (fast)
+        setReference(PREDICTIVE_REF_BEST, currLap, lapTime);
+
+    if (PREDICTIVE_REF_SESSION < PREDICTIVE_TIMER_REFS) {
+        const tiny_millis_t sessionTime = refs[PREDICTIVE_REF_SESSION].lapTime;
+        if (sessionTime <= 0 || lapTime <= sessionTime)
+            setReference(PREDICTIVE_REF_SESSION, currLap, lapTime);
     }
 
-    adjustPollInterval(lapTime);
+    if (lapUsers(currLap))
+        currLap = freeLap();
+
+    adjustSampleSpacing(lapDist);
     status = DISABLED;
+    return fast;
 }
 
 /**
@@ -193,16 +317,25 @@ void startLap(const GeoPoint *point, const tiny_millis_t time)
 {
     if (status != DISABLED) return;
 
+    takeTargetRequest();
+
     status = RECORDING;
     currLapStartTime = time;
-    lastPredictedDelta = 0;
     lastPredictedTime = 0;
-    buffIndex = 0;
+    for (int i = 0; i < PREDICTIVE_TIMER_REFS; ++i) {
+        refs[i].matchIndex = 0;
+        refs[i].lastSplit = 0;
+    }
+
+    currLap->count = 0;
+    gp_projection_init(&currLap->frame, point);
+    currLapDist = 0;
+    lastX = 0;
+    lastY = 0;
 
-    DEBUG("Starting new lap.  Status %d, buffIndex = %d, startTime = %ull\n",
-          status, buffIndex, time);
+    DEBUG("Starting new lap.  Status %d, startTime = %ull\n", status, time);
 
-    insertTimeLocSample(point, time);
+    insertRefPoint(0, 0, 0, 0);
 }
 
 /**
@@ -212,139 +345,175 @@ void startLap(const GeoPoint *point, const tiny_millis_t time)
  */
 bool addGpsSample(const GpsSnapshot *gpsSnapshot)
 {
-    const tiny_millis_t time = gpsSnapshot->deltaFirstFix;
+    const tiny_millis_t time = getCurrentLapTime(gpsSnapshot->deltaFirstFix);
     const GeoPoint *point = &gpsSnapshot->sample.point;
 
     DEVEL("Add GPS Sample called\n");
 
+    takeTargetRequest();
+
     if (status != RECORDING) {
         DEVEL("DROPPING - State is %d\n", status);
         return false;
     }
 
-    // Check if enough time has elapsed between sample periods.
-    if (getTimeSinceLastSample(time) < pollInterval) {
-        DEVEL("DROPPING - elapsed < pollInterval\n");
+    float x, y;
+    gp_project(&currLap->frame, point, &x, &y);
+    const float dx = x - lastX;
+    const float dy = y - lastY;
+    currLapDist += sqrtf(dx * dx + dy * dy);
+    lastX = x;
+    lastY = y;
+
+    // Check if we have gone far enough since the last sample.
+    const struct RefPoint *last = currLap->points + currLap->count - 1;
+    if (currLapDist - last->dist < sampleSpacing || time <= last->time) {
+        DEVEL("DROPPING - distance < sampleSpacing\n");
         return false;
     }
 
-    if (!insertTimeLocSample(point, time)) {
-        status = FULL;
-        DEVEL("DROPPING - Buffer full\n");
-        return false;
-    }
+    insertRefPoint(x, y, currLapDist, time);
 
-    DEBUG("Added sample  %f/%f @ %f\n", point.latitude, point.longitude, time);
+    DEBUG("Added sample  %f/%f @ %f\n", gp_to_degrees(point->latitude),
+          gp_to_degrees(point->longitude), time);
     return true;
 }
 
 float distPctBtwnTwoPoints(const GeoPoint *s, const GeoPoint *e, const GeoPoint *m)
 {
-    const float distSM = distPythag(s, m); // A
-    const float distME = distPythag(m, e); // B
-    const float distSE = distPythag(s, e); // C
-
-    // projDist = (A^2 + C^2 - B^2) / 2 * C
-    const float projDistFromS = ((distSM * distSM) + (distSE * distSE)
-                                 - (distME * distME)) / (2 * distSE);
-
-    DEVEL("distSE = %f, distSM = %f, distME = %f, projDist = %f\n", distSE,
-          distSM, distME, projDistFromS);
-
-    return projDistFromS / distSE;
+    struct gp_projection frame;
+    gp_projection_init(&frame, s);
+    return gp_fraction_along(&frame, s, e, m);
 }
 
-static bool inBounds(float v)
+/**
+ * Finds the point of segment i of a lap closest to x,y.
+ * @param u Where that point is along the segment, 0 - 1.
+ * @return The distance to that point, squared.
+ */
+static float segmentDistSq(const struct RefLap *lap, int i, float x, float y, float *u)
 {
-    return v >= 0 && v <= 1;
+    const struct RefPoint *a = lap->points + i;
+    const struct RefPoint *b = a + 1;
+    const float dx = b->x - a->x;
+    const float dy = b->y - a->y;
+    const float lenSq = dx * dx + dy * dy;
+
+    float t = lenSq > 0 ? ((x - a->x) * dx + (y - a->y) * dy) / lenSq : 0;
+    if (t < 0)
+        t = 0;
+    else if (t > 1)
+        t = 1;
+
+    const float ex = a->x + t * dx - x;
+    const float ey = a->y + t * dy - y;
+    *u = t;
+    return ex * ex + ey * ey;
 }
 
 /**
- * Finds the  closest point to the given point in the fastLap buffer.  Orders the output buffer
- * such that the lower time is always first.
- * @param currPoint The current point of measurement.
- * @return The index of the closest point in the fastLap buffer to the current point, or -1 if
- * no closest point is available.
+ * Finds the segment of a lap closest to x,y among segments first - last.
+ * @return The distance to it, squared.
  */
-static int findClosestPt(const GeoPoint *currPoint)
+static float searchSegments(const struct RefLap *lap, int first, int last, float x, float y,
+                            int *best, float *u)
 {
-    if (!isPredictiveTimeAvailable())
-        return -1;
-
-    // First find the closest point.  Start with index 0 as your best.
-    int bestIndex = 0;
-    GeoPoint *fastLapPoint = &(fastLap[bestIndex].point);
-    float lowestDistance = distPythag(currPoint, fastLapPoint);
+    float bestDistSq = -1;
 
-    for (int i = 1; i < fastLapIndex; ++i) {
-        fastLapPoint = &(fastLap[i].point);
-        float distance = distPythag(currPoint, fastLapPoint);
+    for (int i = first; i <= last; ++i) {
+        float t;
+        const float distSq = segmentDistSq(lap, i, x, y, &t);
 
-        if (distance < lowestDistance) {
-            lowestDistance = distance;
-            bestIndex = i;
+        if (bestDistSq < 0 || distSq < bestDistSq) {
+            bestDistSq = distSq;
+            *best = i;
+            *u = t;
         }
     }
 
-    DEVEL("Smallest distance is %f from point %d\n", lowestDistance, bestIndex);
-    return bestIndex;
+    return bestDistSq;
 }
 
 /**
- * Finds the two points closest to the given point in the fastLap buffer.  Orders the output buffer
- * such that the lower time is always first.
- * @param currPoint The current point of measurement.
- * @param tlPts Output buffer where the two closest points will go.  Lower time point first.
- * Undefined values if method returns false.
- * @return true if a fast lap is set and the points are next to each other in the fastLap buffer
- * and the given point is between the two points, false otherwise.
+ * Finds where on the lap of a reference the given point is.  Only the segments around the last
+ * match are searched, so the cost does not grow with the size of the buffer.  The whole lap is
+ * searched only if that fails.
+ * @param ref The reference.  Its cursor moves to the match.
+ * @param point The current point of measurement.
+ * @param index Output: the segment of the lap the point is on.
+ * @param u Output: how far along the segment the point is, 0 - 1.
+ * @return true if the point is on the lap, false otherwise.
  */
-static bool findTwoClosestPts(const GeoPoint *currPoint, struct PtTimeLoc *tlPts[])
+static bool matchReference(struct Reference *ref, const GeoPoint *point, int *index, float *u)
 {
-    if (!isPredictiveTimeAvailable())
-        return false;
-
-    int bestIndex = findClosestPt(currPoint);
-    if (bestIndex < 0)
+    const struct RefLap *lap = ref->lap;
+    const int lastSegment = lap->count - 2;
+    if (lastSegment < 0)
         return false;
 
-    /*
-     * Next we have two neighboring points.  We want to choose the point such that point s is before
-     * our current point which is before point e.  The current point we have may be s or e, we don't
-     * know.  So how do we find this point?  Use our distPctBtwnTwoPoints method.  Values between
-     * 0 - 1 indicate a point between the two points.
-     */
-    GeoPoint *gpBest = &(fastLap[bestIndex].point);
+    float x, y;
+    gp_project(&lap->frame, point, &x, &y);
+
+    const int matchIndex = ref->matchIndex;
+    const int first = matchIndex > SEARCH_BEHIND ? matchIndex - SEARCH_BEHIND : 0;
+    int last = matchIndex + SEARCH_AHEAD < lastSegment ? matchIndex + SEARCH_AHEAD : lastSegment;
+    int best = first;
+    float t = 0;
+    float distSq = searchSegments(lap, first, last, x, y, &best, &t);
+
+    // Best at the edge of the window.  Follow the lap for as long as it gets closer.
+    while (best == last && last < lastSegment) {
+        float nextT;
+        const float nextDistSq = segmentDistSq(lap, ++last, x, y, &nextT);
+        if (nextDistSq > distSq)
+            break;
+
+        distSq = nextDistSq;
+        best = last;
+        t = nextT;
+    }
 
-    int upIdx = bestIndex + 1;
-    int dnIdx = bestIndex - 1;
+    if (distSq > MAX_MATCH_DISTANCE * MAX_MATCH_DISTANCE) {
+        DEVEL("Lost our place on the reference lap.  Searching all of it\n");
+        distSq = searchSegments(lap, 0, lastSegment, x, y, &best, &t);
+        if (distSq > MAX_MATCH_DISTANCE * MAX_MATCH_DISTANCE) {
+            DEBUG("Not on the reference lap.  Off by %f\n", sqrtf(distSq));
+            return false;
+        }
+    }
 
-    GeoPoint *gpUp = upIdx >= fastLapIndex ? NULL : &(fastLap[upIdx].point);
-    GeoPoint *gpDn = dnIdx < 0 ? NULL : &(fastLap[dnIdx].point);
+    DEVEL("Matched segment %d at %f\n", best, t);
+    ref->matchIndex = best;
+    *index = best;
+    *u = t;
+    return true;
+}
 
-    float distUp = gpUp == NULL ? -1 : distPctBtwnTwoPoints(gpBest, gpUp, currPoint);
-    float distDn = gpDn == NULL ? -1 : distPctBtwnTwoPoints(gpBest, gpDn, currPoint);
+tiny_millis_t getSplitAgainstReference(const enum PredictiveRef ref, const GeoPoint *point,
+                                       tiny_millis_t currentTime)
+{
+    if ((size_t) ref >= PREDICTIVE_TIMER_REFS)
+        return 0;
 
-    if (!inBounds(distUp) && !inBounds(distDn)) {
-        DEBUG("Both points not in bounds (up: %f, dn: %f).  Close to Start/Finish?\n",
-              distUp, distDn);
-        return false;
+    struct Reference *r = refs + ref;
+    if (!isReferenceAvailable(ref)) {
+        DEBUG("No predicted time - No reference %d Set\n", ref);
+        return r->lastSplit;
     }
 
-    int secondaryIndex = inBounds(distUp) ? upIdx : dnIdx;
-
-    tlPts[0] = &(fastLap[bestIndex]);
-    tlPts[1] = &(fastLap[secondaryIndex]);
+    int index;
+    float percentage;
+    if (!matchReference(r, point, &index, &percentage))
+        return r->lastSplit;
 
-    // Swap the buffers so the lower time is always first.  Just use
-    if (tlPts[1]->time < tlPts[0]->time) {
-        DEVEL("Swapping buffers: %f < %f\n", tlPts[1]->time, tlPts[0]->time);
-        struct PtTimeLoc *tmp = tlPts[0];
-        tlPts[0] = tlPts[1];
-        tlPts[1] = tmp;
-    }
+    const struct RefPoint *rp = r->lap->points + index;
+    const tiny_millis_t timeDeltaBtwnPoints = rp[1].time - rp->time;
+    const tiny_millis_t estRefTime = rp->time + timeDeltaBtwnPoints * percentage;
+    DEBUG("Estimated reference time at this point is %f\n", estRefTime);
 
-    return true;
+    r->lastSplit = estRefTime - getCurrentLapTime(currentTime);
+    DEBUG("Time Delta is %ull\n", r->lastSplit);
+    return r->lastSplit;
 }
 
 /**
@@ -356,37 +525,7 @@ static bool findTwoClosestPts(const GeoPoint *currPoint, struct PtTimeLoc *tlPts
  */
 tiny_millis_t getSplitAgainstFastLap(const GeoPoint * point, tiny_millis_t currentTime)
 {
-    if (!isPredictiveTimeAvailable()) {
-        DEBUG("No predicted time - No fast lap Set\n");
-        return lastPredictedDelta;
-    }
-
-    /*
-     * Figure out the two closest points.  Order of closestPts is with lower time first.  If this
-     * fails then we can't continue.
-     */
-    struct PtTimeLoc *closestPts[2];
-    if (!findTwoClosestPts(point, closestPts))
-        // TODO: Perhaps return false here?  Make this better for the caller.
-        return lastPredictedDelta;
-
-    const GeoPoint *pointA = &(closestPts[0]->point);
-    const GeoPoint *pointB = &(closestPts[1]->point);
-    float percentage = distPctBtwnTwoPoints(pointA, pointB, point);
-    DEVEL("Percentage value is 0 < %f < 1\n", percentage);
-
-    if (!inBounds(percentage)) {
-        DEVEL("Current Point is not between the two closest points.\n");
-        return lastPredictedDelta;
-    }
-
-    const tiny_millis_t timeDeltaBtwnPoints = closestPts[1]->time - closestPts[0]->time;
-    const tiny_millis_t estFastTime = closestPts[0]->time + timeDeltaBtwnPoints  * percentage;
-    DEBUG("Estimated fast lap time at this point is %f\n", estFastTime);
-
-    lastPredictedDelta = estFastTime - getCurrentLapTime(currentTime);
-    DEBUG("Time Delta is %ull\n", lastPredictedDelta);
-    return lastPredictedDelta;
+    return getSplitAgainstReference(PREDICTIVE_REF_BEST, point, currentTime);
 }
 
 /**
@@ -402,7 +541,7 @@ tiny_millis_t getPredictedTime(const GeoPoint * point, tiny_millis_t time)
 {
 
     tiny_millis_t timeDelta = getSplitAgainstFastLap(point, time);
-    tiny_millis_t newPredictedTime = fastLapTime - timeDelta;
+    tiny_millis_t newPredictedTime = refs[PREDICTIVE_REF_BEST].lapTime - timeDelta;
 
     // Check for a minimum predicted time to deal with start/finish errors.
     if (newPredictedTime < MIN_PREDICTED_TIME)
@@ -418,13 +557,18 @@ void resetPredictiveTimer()
 {
     DEBUG("Resetting predictive timer\n");
     status = DISABLED;
-    buffIndex = 0;
-    fastLapIndex = 0;
-    fastLapTime = 0;
+    for (int i = 0; i < PREDICTIVE_TIMER_REFS; ++i) {
+        refs[i].lap = NULL;
+        refs[i].lapTime = 0;
+        refs[i].matchIndex = 0;
+        refs[i].lastSplit = 0;
+    }
+    currLap = laps;
+    currLap->count = 0;
+    targetRequest = NO_TARGET_REQUEST;
     lastPredictedTime = 0;
-    lastPredictedDelta = 0;
     currLapStartTime = 0;
-    pollInterval = INITIAL_POLL_INTERVAL;
+    sampleSpacing = INITIAL_SAMPLE_SPACING;
 }
 
 float getPredictedTimeInMinutes()
@@ -433,3 +577,181 @@ float getPredictedTimeInMinutes()
     const tiny_millis_t millis = getMillisSinceFirstFix();
     return tinyMillisToMinutes(getPredictedTime(&gp, millis));
 }
+
+float getPredictedDeltaInSeconds(const int index)
+{
+    const enum PredictiveRef ref = (enum PredictiveRef) index;
+    if (!isReferenceAvailable(ref))
+        return 0;
+
+    const GeoPoint gp = getGeoPoint();
+    const tiny_millis_t millis = getMillisSinceFirstFix();
+    return tinyMillisToSeconds(-getSplitAgainstReference(ref, &gp, millis));
+}
+
+static uint8_t * putU16(uint8_t *b, const uint16_t v)
+{
+    b[0] = v;
+    b[1] = v >> 8;
+    return b + 2;
+}
+
+static uint8_t * putU32(uint8_t *b, const uint32_t v)
+{
+    return putU16(putU16(b, v), v >> 16);
+}
+
+static uint16_t getU16(const uint8_t *b)
+{
+    return b[0] | b[1] << 8;
+}
+
+static uint32_t getU32(const uint8_t *b)
+{
+    return getU16(b) | (uint32_t) getU16(b + 2) << 16;
+}
+
+static int32_t toSavedPos(const float meters)
+{
+    return (int32_t) floorf(meters * FAST_LAP_POS_SCALE + 0.5f);
+}
+
+size_t saveFastLap(const int32_t trackId, const uint32_t trackHash, uint8_t *buf,
+                   const size_t size)
+{
+    if (!isPredictiveTimeAvailable())
+        return 0;
+
+    const struct Reference *best = refs + PREDICTIVE_REF_BEST;
+    const struct RefLap *fastLap = best->lap;
+    const int count = fastLap->count;
+    const size_t len = FAST_LAP_HEADER_SIZE + (count - 1) * FAST_LAP_POINT_SIZE +
+        FAST_LAP_HASH_SIZE;
+    if (count < 2 || len > size)
+        return 0;
+
+    uint8_t *b = buf;
+    b = putU32(b, FAST_LAP_MAGIC);
+    b = putU16(b, FAST_LAP_FORMAT_VERSION);
+    b = putU16(b, count);
+    b = putU32(b, trackId);
+    b = putU32(b, trackHash);
+    b = putU32(b, best->lapTime);
+    b = putU32(b, fastLap->frame.origin.latitude);
+    b = putU32(b, fastLap->frame.origin.longitude);
+
+    // The first point is the origin.  Each one after is relative to the last as it will be read
+    // back, so that rounding does not add up.
+    int32_t x = 0;
+    int32_t y = 0;
+    tiny_millis_t t = 0;
+    for (int i = 1; i < count; ++i) {
+        const struct RefPoint *rp = fastLap->points + i;
+        const int32_t px = toSavedPos(rp->x);
+        const int32_t py = toSavedPos(rp->y);
+        const int32_t dx = px - x;
+        const int32_t dy = py - y;
+        const tiny_millis_t dt = rp->time - t;
+
+        if (dx < INT16_MIN || dx > INT16_MAX || dy < INT16_MIN || dy > INT16_MAX ||
+            dt < 0 || dt > UINT16_MAX) {
+            DEBUG("Fast lap point %d does not fit the saved format\n", i);
+            return 0;
+        }
+
+        b = putU16(b, (uint16_t) dx);
+        b = putU16(b, (uint16_t) dy);
+        b = putU16(b, (uint16_t) dt);
+        x = px;
+        y = py;
+        t = rp->time;
+    }
+
+    b = putU32(b, fnv1a_32(FNV1A_32_INIT, buf, b - buf));
+    return b - buf;
+}
+
+bool loadFastLap(const int32_t trackId, const uint32_t trackHash, const uint8_t *buf,
+                 const size_t len)
+{
+    if (len < FAST_LAP_HEADER_SIZE + FAST_LAP_HASH_SIZE ||
+        getU32(buf) != FAST_LAP_MAGIC || getU16(buf + 4) != FAST_LAP_FORMAT_VERSION) {
+        DEBUG("Not a fast lap of this version\n");
+        return false;
+    }
+
+    const int count = getU16(buf + 6);
+    if (count < 2 || len != FAST_LAP_HEADER_SIZE + (count - 1) * FAST_LAP_POINT_SIZE +
+        FAST_LAP_HASH_SIZE || getU32(buf + len - FAST_LAP_HASH_SIZE) !=
+        fnv1a_32(FNV1A_32_INIT, buf, len - FAST_LAP_HASH_SIZE)) {
+        DEBUG("Fast lap is corrupt\n");
+        return false;
+    }
+
+    if ((int32_t) getU32(buf + 8) != trackId || getU32(buf + 12) != trackHash) {
+        DEBUG("Fast lap is of another track\n");
+        return false;
+    }
+
+    // A faster lap of our own beats it.
+    const tiny_millis_t lapTime = (tiny_millis_t) getU32(buf + 16);
+    const tiny_millis_t bestTime = refs[PREDICTIVE_REF_BEST].lapTime;
+    if (lapTime <= 0 || (bestTime > 0 && bestTime <= lapTime))
+        return false;
+
+    // The lap of the best we have goes, unless another reference still uses it.
+    struct RefLap *fastLap = refs[PREDICTIVE_REF_BEST].lap;
+    if (!fastLap || lapUsers(fastLap) > 1)
+        fastLap = freeLap();
+
+    GeoPoint origin;
+    origin.latitude = (int32_t) getU32(buf + 20);
+    origin.longitude = (int32_t) getU32(buf + 24);
+
+    fastLap->count = 0;
+    gp_projection_init(&fastLap->frame, &origin);
+
+    // Saved by a unit with more room than ours.  Keep every step-th point and the last.
+    const int step = (count - 1 + MAX_TIMELOC_SAMPLES - 2) / (MAX_TIMELOC_SAMPLES - 1);
+    const uint8_t *b = buf + FAST_LAP_HEADER_SIZE;
+    int32_t x = 0;
+    int32_t y = 0;
+    float lastPx = 0;
+    float lastPy = 0;
+    tiny_millis_t t = 0;
+    float dist = 0;
+    struct RefPoint *rp = fastLap->points;
+    rp->x = rp->y = rp->dist = 0;
+    rp->time = 0;
+
+    for (int i = 1; i < count; ++i, b += FAST_LAP_POINT_SIZE) {
+        x += (int16_t) getU16(b);
+        y += (int16_t) getU16(b + 2);
+        t += getU16(b + 4);
+
+        const float px = x / FAST_LAP_POS_SCALE;
+        const float py = y / FAST_LAP_POS_SCALE;
+        // Along every saved point, not just the ones kept.
+        const float dx = px - lastPx;
+        const float dy = py - lastPy;
+        dist += sqrtf(dx * dx + dy * dy);
+        lastPx = px;
+        lastPy = py;
+
+        if (i % step && i != count - 1)
+            continue;
+
+        ++rp;
+        rp->x = px;
+        rp->y = py;
+        rp->dist = dist;
+        rp->time = t;
+    }
+
+    fastLap->count = rp - fastLap->points + 1;
+    setReference(PREDICTIVE_REF_BEST, fastLap, lapTime);
+    adjustSampleSpacing(dist);
+
+    INFO("Loaded fast lap of %d points, %f seconds\n", fastLap->count, lapTime);
+    return true;
+}
@@ -301,14 +301,16 @@ void put_crlf(const Serial *serial)
     serial->put_s("\r\n");
 }
 
-void read_line(Serial *serial, char *buffer, size_t bufferSize)
+int read_line(Serial *serial, char *buffer, size_t bufferSize)
 {
     size_t bufIndex = 0;
+    int complete = 0;
     char c;
     while(bufIndex < bufferSize - 1) {
         c = serial->get_c();
         if (c) {
             if ('\r' == c) {
+                complete = 1;
                 break;
             } else {
                 buffer[bufIndex++] = c;
@@ -316,16 +318,19 @@ void read_line(Serial *serial, char *buffer, size_t bufferSize)
         }
     }
     buffer[bufIndex]='\0';
+    return complete;
 }
 
-void interactive_read_line(Serial *serial, char * buffer, size_t bufferSize)
+int interactive_read_line(Serial *serial, char * buffer, size_t bufferSize)
 {
     size_t bufIndex = 0;
+    int complete = 0;
     char c;
     while(bufIndex < bufferSize - 1) {
         c = serial->get_c();
         if (c) {
             if ('\r' == c) {
+                complete = 1;
                 break;
             } else if ('\b' == c) {
                 if (bufIndex > 0) {
@@ -340,4 +345,5 @@ void interactive_read_line(Serial *serial, char * buffer, size_t bufferSize)
     }
     serial->put_s("\r\n");
     buffer[bufIndex]='\0';
+    return complete;
 }
@@ -0,0 +1,206 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capabilities.h"
+#include "geopoint.h"
+#include "track_index.h"
+#include "tracks.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Meters along a meridian per cell */
+#define CELL_METERS	((float) (GP_EARTH_RADIUS_M * M_PI / 180.0 / \
+                                  GEO_POINT_SCALE * TRACK_INDEX_CELL))
+
+#define LAT_CELL_MAX	((int32_t) (90LL * GEO_POINT_SCALE / TRACK_INDEX_CELL))
+#define LON_CELLS	((int32_t) (360LL * GEO_POINT_SCALE / TRACK_INDEX_CELL))
+#define LON_CELL_MIN	(-LON_CELLS / 2)
+#define LON_CELL_MAX	(LON_CELLS / 2 - 1)
+
+/* Sorted by key.  Kept apart so that no space goes to padding */
+static uint32_t g_keys[TRACK_INDEX_POINTS];
+static uint8_t g_track[TRACK_INDEX_POINTS];
+static uint8_t g_point[TRACK_INDEX_POINTS];
+
+static struct {
+        size_t count;
+        bool built;
+} g_index;
+
+static int32_t cell_of(const int32_t v)
+{
+        /* Rounds toward minus infinity so that cells don't double up at 0 */
+        return v >= 0 ? v / TRACK_INDEX_CELL :
+                (int32_t) -((-(int64_t) v + TRACK_INDEX_CELL - 1) /
+                            TRACK_INDEX_CELL);
+}
+
+static int32_t lon_cell_of(const int32_t lon)
+{
+        int32_t cell = cell_of(lon);
+        if (cell > LON_CELL_MAX)
+                cell -= LON_CELLS;
+
+        return cell;
+}
+
+static uint32_t key_of(const int32_t row, const int32_t col)
+{
+        return ((uint32_t) (row + 32768) << 16) | (uint16_t) (col + 32768);
+}
+
+static void insert(const GeoPoint *gp, const size_t track, const size_t point)
+{
+        const uint32_t key = key_of(cell_of(gp->latitude),
+                                    lon_cell_of(gp->longitude));
+
+        size_t i = g_index.count++;
+        for (; i && g_keys[i - 1] > key; --i) {
+                g_keys[i] = g_keys[i - 1];
+                g_track[i] = g_track[i - 1];
+                g_point[i] = g_point[i - 1];
+        }
+
+        g_keys[i] = key;
+        g_track[i] = track;
+        g_point[i] = point;
+}
+
+void track_index_build(const Tracks *tracks)
+{
+        g_index.count = 0;
+        g_index.built = true;
+
+        const size_t count = tracks->count < MAX_TRACK_COUNT ?
+                tracks->count : MAX_TRACK_COUNT;
+
+        /* Start points first, so that they are the ones that always fit */
+        for (size_t j = 0; j < SECTOR_COUNT; ++j) {
+                for (size_t i = 0; i < count; ++i) {
+                        const GeoPoint *gp = tracks->tracks[i].allSectors + j;
+                        if (!isValidPoint(gp))
+                                continue;
+
+                        if (g_index.count == TRACK_INDEX_POINTS)
+                                return;
+
+                        insert(gp, i, j);
+                }
+        }
+}
+
+bool track_index_built(void)
+{
+        return g_index.built;
+}
+
+size_t track_index_size(void)
+{
+        return g_index.count;
+}
+
+static size_t lower_bound(const uint32_t key)
+{
+        size_t lo = 0;
+        size_t hi = g_index.count;
+        while (lo < hi) {
+                const size_t mid = (lo + hi) / 2;
+                if (g_keys[mid] < key)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        return lo;
+}
+
+static size_t scan(const int32_t row, const int32_t lo, const int32_t hi,
+                   struct track_index_hit *hits, const size_t max,
+                   size_t found)
+{
+        const uint32_t last = key_of(row, hi);
+        for (size_t i = lower_bound(key_of(row, lo));
+             i < g_index.count && g_keys[i] <= last; ++i, ++found) {
+                if (found < max) {
+                        hits[found].track = g_track[i];
+                        hits[found].point = g_point[i];
+                }
+        }
+
+        return found;
+}
+
+size_t track_index_near(const GeoPoint *gp, const float radius_m,
+                        struct track_index_hit *hits, const size_t max)
+{
+        if (!g_index.count)
+                return 0;
+
+        const int32_t row0 = cell_of(gp->latitude);
+        const int32_t col0 = lon_cell_of(gp->longitude);
+        const int32_t rows = (int32_t) ceilf(radius_m / CELL_METERS);
+
+        /*
+         * Cells narrow toward the poles, so take the width at the edge of
+         * the search that is nearest to one.
+         */
+        float lat = fabsf((float) gp->latitude / GEO_POINT_SCALE) +
+                radius_m / CELL_METERS * TRACK_INDEX_CELL / GEO_POINT_SCALE;
+        if (lat > 90)
+                lat = 90;
+        const float cell_width = CELL_METERS * cosf(lat * (float) M_PI / 180);
+        const float cols_f = cell_width > 0 ? ceilf(radius_m / cell_width) :
+                LON_CELLS;
+        const int32_t cols = cols_f < LON_CELLS ? (int32_t) cols_f : LON_CELLS;
+
+        size_t found = 0;
+        for (int32_t row = row0 - rows; row <= row0 + rows; ++row) {
+                if (row < -LAT_CELL_MAX || row > LAT_CELL_MAX)
+                        continue;
+
+                const int32_t lo = col0 - cols;
+                const int32_t hi = col0 + cols;
+                if (2 * cols + 1 >= LON_CELLS) {
+                        found = scan(row, LON_CELL_MIN, LON_CELL_MAX, hits,
+                                     max, found);
+                } else if (lo < LON_CELL_MIN) {
+                        /* Across the antimeridian */
+                        found = scan(row, LON_CELL_MIN, hi, hits, max, found);
+                        found = scan(row, lo + LON_CELLS, LON_CELL_MAX, hits,
+                                     max, found);
+                } else if (hi > LON_CELL_MAX) {
+                        found = scan(row, LON_CELL_MIN, hi - LON_CELLS, hits,
+                                     max, found);
+                        found = scan(row, lo, LON_CELL_MAX, hits, max, found);
+                } else {
+                        found = scan(row, lo, hi, hits, max, found);
+                }
+        }
+
+        return found;
+}
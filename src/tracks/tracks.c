@@ -1,8 +1,12 @@
 #include "tracks.h"
+#include "fnv.h"
 #include "mod_string.h"
 #include "printk.h"
 #include "memory.h"
 #include "mem_mang.h"
+#include "track_index.h"
+
+#include <stdbool.h>
 
 #ifndef RCP_TESTING
 #include "memory.h"
@@ -13,13 +17,190 @@ static Tracks g_tracks = DEFAULT_TRACKS;
 
 static const Tracks g_defaultTracks = DEFAULT_TRACKS;
 
-static Tracks *g_tracksBuffer = NULL;
+#if TRACKS_FLASH_PAGE_SIZE
+#define PAGE_SIZE	TRACKS_FLASH_PAGE_SIZE
+#else
+/* The region can only be erased as a whole, so it is all one page */
+#define PAGE_SIZE	sizeof(Tracks)
+#endif
+
+#define NO_PAGE		((size_t) -1)
+
+/*
+ * An update of the DB.  Tracks go straight through to flash a page at a
+ * time: the page a track falls in is read into the staging buffer,
+ * patched and flashed once we move on to another page.  Pages that end up
+ * the same are not flashed.
+ *
+ * The CRCs and the count sit in the first page and are written last, so
+ * they act as the commit.  A track whose pages were written but not its
+ * CRC fails its check on the next start.
+ */
+static struct track_update {
+    uint8_t page[PAGE_SIZE];
+    size_t page_index;
+    bool dirty;
+    int result;
+    uint32_t crcs[MAX_TRACK_COUNT];
+    size_t count;
+} *g_update = NULL;
+
+static uint8_t * region(void)
+{
+    return (uint8_t *)&g_tracks;
+}
+
+static uint32_t track_crc(const Track *t)
+{
+    return fnv1a_32(FNV1A_32_INIT, t, sizeof(Track));
+}
+
+static bool same_bytes(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    while (len--) {
+        if (*a++ != *b++)
+            return false;
+    }
+    return true;
+}
+
+static size_t page_length(size_t page_index)
+{
+    const size_t left = sizeof(Tracks) - page_index * PAGE_SIZE;
+    return left < PAGE_SIZE ? left : PAGE_SIZE;
+}
+
+static void flush_page(struct track_update *u)
+{
+    if (!u->dirty)
+        return;
+
+    u->dirty = false;
+    const size_t offset = u->page_index * PAGE_SIZE;
+    if (memory_flash_region(region() + offset, u->page,
+                            page_length(u->page_index)) != MEMORY_FLASH_SUCCESS)
+        u->result = MEMORY_FLASH_WRITE_ERROR;
+}
+
+static void write_bytes(struct track_update *u, size_t offset,
+                        const void *data, size_t len)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (len) {
+        const size_t page_index = offset / PAGE_SIZE;
+        const size_t at = offset % PAGE_SIZE;
+        const size_t n = len < PAGE_SIZE - at ? len : PAGE_SIZE - at;
+
+        if (page_index != u->page_index) {
+            /* Nothing to do for a page that already has it */
+            if (same_bytes(region() + offset, src, n)) {
+                offset += n;
+                src += n;
+                len -= n;
+                continue;
+            }
+
+            flush_page(u);
+            const size_t page_len = page_length(page_index);
+            memcpy(u->page, region() + page_index * PAGE_SIZE, page_len);
+            memset(u->page + page_len, 0, PAGE_SIZE - page_len);
+            u->page_index = page_index;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (u->page[at + i] != src[i]) {
+                u->page[at + i] = src[i];
+                u->dirty = true;
+            }
+        }
+        offset += n;
+        src += n;
+        len -= n;
+    }
+}
+
+static struct track_update * begin_update(void)
+{
+    if (g_update == NULL) {
+        g_update = (struct track_update *)portMalloc(sizeof(struct track_update));
+        if (g_update == NULL)
+            return NULL;
+    }
+
+    const Tracks *tracks = get_tracks();
+    g_update->page_index = NO_PAGE;
+    g_update->dirty = false;
+    g_update->result = MEMORY_FLASH_SUCCESS;
+    memcpy(g_update->crcs, tracks->crcs, sizeof(g_update->crcs));
+    g_update->count = tracks->count;
+    return g_update;
+}
+
+static void update_track(struct track_update *u, const Track *track,
+                         size_t index)
+{
+    write_bytes(u, offsetof(Tracks, tracks) + index * sizeof(Track),
+                track, sizeof(Track));
+    u->crcs[index] = track_crc(track);
+}
+
+static int commit_update(struct track_update *u)
+{
+    write_bytes(u, offsetof(Tracks, crcs), u->crcs, sizeof(u->crcs));
+    write_bytes(u, offsetof(Tracks, count), &u->count, sizeof(u->count));
+    flush_page(u);
+
+    const int result = u->result;
+    portFree(u);
+    g_update = NULL;
+
+    track_index_build(get_tracks());
+    if (result == MEMORY_FLASH_SUCCESS) pr_info("win\r\n");
+    else pr_info("fail\r\n");
+    return result;
+}
+
+/* The number of tracks from the start that match their CRC */
+static size_t checked_count(const Tracks *tracks)
+{
+    const size_t count = tracks->count < MAX_TRACK_COUNT ?
+        tracks->count : MAX_TRACK_COUNT;
+
+    for (size_t i = 0; i < count; i++) {
+        if (track_crc(tracks->tracks + i) != tracks->crcs[i])
+            return i;
+    }
+    return count;
+}
 
 void initialize_tracks()
 {
     if (versionChanged(&g_tracks.versionInfo)) {
         flash_default_tracks();
+        return;
+    }
+
+    const Tracks *tracks = get_tracks();
+    const size_t count = checked_count(tracks);
+    if (count == tracks->count) {
+        track_index_build(tracks);
+        return;
+    }
+
+    /*
+     * An update that did not finish.  A DB of another layout never gets
+     * here: that comes with a new version and was replaced above.
+     */
+    pr_error_int_msg("tracks: CRC mismatch at track ", count);
+    pr_error("tracks: dropping it and those after it: ");
+    struct track_update *u = begin_update();
+    if (u == NULL) {
+        pr_error("could not allocate buffer for tracks\r\n");
+        return;
     }
+    u->count = count;
+    commit_update(u);
 }
 
 int flash_default_tracks(void)
@@ -30,10 +211,21 @@ int flash_default_tracks(void)
 
 int flash_tracks(const Tracks *source, size_t rawSize)
 {
-    int result = memory_flash_region((void *)&g_tracks, (void *)source, rawSize);
-    if (result == 0) pr_info("win\r\n");
-    else pr_info("fail\r\n");
-    return result;
+    struct track_update *u = begin_update();
+    if (u == NULL) {
+        pr_error("could not allocate buffer for tracks\r\n");
+        return MEMORY_FLASH_WRITE_ERROR;
+    }
+
+    const size_t count = source->count < MAX_TRACK_COUNT ?
+        source->count : MAX_TRACK_COUNT;
+    write_bytes(u, offsetof(Tracks, versionInfo), &source->versionInfo,
+                sizeof(source->versionInfo));
+    for (size_t i = 0; i < count; i++)
+        update_track(u, source->tracks + i, i);
+
+    u->count = count;
+    return commit_update(u);
 }
 
 const Tracks * get_tracks()
@@ -41,45 +233,45 @@ const Tracks * get_tracks()
     return (Tracks *)&g_tracks;
 }
 
-
 int add_track(const Track *track, size_t index, int mode)
 {
-    int result = TRACK_ADD_RESULT_OK;
+    if (index >= MAX_TRACK_COUNT) {
+        pr_error("invalid track index\r\n");
+        return TRACK_ADD_RESULT_FAIL;
+    }
 
-    if (index < MAX_TRACK_COUNT) {
-        if (mode == TRACK_ADD_MODE_IN_PROGRESS || mode == TRACK_ADD_MODE_COMPLETE) {
-            if (g_tracksBuffer == NULL) {
-                pr_info("allocating new tracks buffer\r\n");
-                g_tracksBuffer = (Tracks *)portMalloc(sizeof(Tracks));
-                memcpy((void *)g_tracksBuffer, (void *)&g_tracks, sizeof(Tracks));
-            }
+    if (mode != TRACK_ADD_MODE_IN_PROGRESS &&
+        mode != TRACK_ADD_MODE_COMPLETE &&
+        mode != TRACK_ADD_MODE_UPDATE)
+        return TRACK_ADD_RESULT_OK;
 
-            if (g_tracksBuffer != NULL) {
-                Track *trackToAdd = g_tracksBuffer->tracks + index;
-                memcpy(trackToAdd, track, sizeof(Track));
-                g_tracksBuffer->count = index + 1;
-
-                if (mode == TRACK_ADD_MODE_COMPLETE) {
-                    pr_info("completed updating tracks, flashing: ");
-                    if (flash_tracks(g_tracksBuffer, sizeof(Tracks)) == 0) {
-                        pr_info("win\r\n");
-                    } else {
-                        pr_error("fail\r\n");
-                        result = TRACK_ADD_RESULT_FAIL;
-                    }
-                    portFree(g_tracksBuffer);
-                    g_tracksBuffer = NULL;
-                }
-            } else {
-                pr_error("could not allocate buffer for tracks\r\n");
-                result = TRACK_ADD_RESULT_FAIL;
-            }
-        }
-    } else {
+    /* No gaps: the tracks in between would be whatever was there */
+    const size_t count = g_update != NULL ? g_update->count : get_tracks()->count;
+    if (mode == TRACK_ADD_MODE_UPDATE && index > count) {
         pr_error("invalid track index\r\n");
-        result = TRACK_ADD_RESULT_FAIL;
+        return TRACK_ADD_RESULT_FAIL;
     }
-    return result;
+
+    struct track_update *u = g_update != NULL ? g_update : begin_update();
+    if (u == NULL) {
+        pr_error("could not allocate buffer for tracks\r\n");
+        return TRACK_ADD_RESULT_FAIL;
+    }
+
+    if (mode != TRACK_ADD_MODE_UPDATE)
+        u->count = index + 1;
+    else if (index == u->count)
+        u->count++;
+    update_track(u, track, index);
+
+    if (mode == TRACK_ADD_MODE_IN_PROGRESS) {
+        return u->result == MEMORY_FLASH_SUCCESS ?
+            TRACK_ADD_RESULT_OK : TRACK_ADD_RESULT_FAIL;
+    }
+
+    pr_info("completed updating tracks, flashing: ");
+    return commit_update(u) == MEMORY_FLASH_SUCCESS ?
+        TRACK_ADD_RESULT_OK : TRACK_ADD_RESULT_FAIL;
 }
 
 static int isStage(const Track *t)
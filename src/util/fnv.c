@@ -0,0 +1,39 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fnv.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV1A_32_PRIME	0x01000193u
+
+uint32_t fnv1a_32(uint32_t hash, const void *data, size_t len)
+{
+        const uint8_t *b = (const uint8_t *) data;
+
+        for (; len; --len, ++b) {
+                hash ^= *b;
+                hash *= FNV1A_32_PRIME;
+        }
+
+        return hash;
+}
@@ -0,0 +1,90 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lookup_table.h"
+#include "mod_string.h"
+#include "printk.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const char* entry_name(const struct lookup_table *lt, const size_t i)
+{
+        return *(const char * const *) (lt->entries + i * lt->entry_size);
+}
+
+size_t lookup_table_init(struct lookup_table *lt, const void *entries,
+                         const size_t entry_size, size_t count,
+                         uint8_t *index)
+{
+        if (count > LOOKUP_TABLE_MAX_ENTRIES) {
+                /* Those past the limit would never be found */
+                pr_error_int_msg("lookup table: too many entries, "
+                                 "not indexing: ",
+                                 count - LOOKUP_TABLE_MAX_ENTRIES);
+                count = LOOKUP_TABLE_MAX_ENTRIES;
+        }
+
+        lt->entries = (const char *) entries;
+        lt->entry_size = entry_size;
+        lt->count = count;
+        lt->index = index;
+
+        /*
+         * Insertion sort.  Tables are small and this only runs once at
+         * startup, so there is no need for anything fancier.
+         */
+        for (size_t i = 0; i < count; ++i) {
+                const char *name = entry_name(lt, i);
+                size_t j = i;
+
+                for (; j > 0 && strcmp(entry_name(lt, index[j - 1]), name) > 0; --j)
+                        index[j] = index[j - 1];
+
+                index[j] = (uint8_t) i;
+        }
+
+        return count;
+}
+
+const void* lookup_table_find(const struct lookup_table *lt,
+                              const char *name)
+{
+        size_t low = 0;
+        size_t high = lt->count;
+
+        while (low < high) {
+                const size_t mid = low + (high - low) / 2;
+                const size_t i = lt->index[mid];
+                const int cmp = strcmp(name, entry_name(lt, i));
+
+                if (0 == cmp)
+                        return lt->entries + i * lt->entry_size;
+
+                if (cmp < 0) {
+                        high = mid;
+                } else {
+                        low = mid + 1;
+                }
+        }
+
+        return NULL;
+}
@@ -52,6 +52,7 @@ APP_SRC = 	$(APP_PATH)/main.c \
 			$(RCP_SRC)/OBD2/OBD2_task.c \
 			$(RCP_SRC)/OBD2/OBD2.c \
 			$(RCP_SRC)/jsmn/jsmn.c \
+			$(RCP_SRC)/jsmn/jsmn_stream.c \
 			$(RCP_SRC)/serial/serial.c \
 			$(RCP_SRC)/usart/usart.c \
 			$(RCP_SRC)/cpu/cpu.c \
@@ -63,13 +64,19 @@ APP_SRC = 	$(APP_PATH)/main.c \
 			$(RCP_SRC)/GPIO/gpioTasks.c \
 			$(RCP_SRC)/watchdog/watchdog.c \
 			$(RCP_SRC)/launch_control.c \
+			$(RCP_SRC)/lap_stats/lap_events.c \
 			$(RCP_SRC)/lap_stats/lap_stats.c \
+			$(RCP_SRC)/lap_stats/track_map.c \
 			$(RCP_SRC)/gps/gps.c \
 			$(RCP_SRC)/gps/dateTime.c \
 			$(RCP_SRC)/gps/geopoint.c \
+			$(RCP_SRC)/gps/gps_fusion.c \
+			$(RCP_SRC)/gps/nmea.c \
+			$(RCP_SRC)/gps/skytraq.c \
 			$(RCP_SRC)/gps/geoCircle.c \
 			$(RCP_SRC)/gps/geoTrigger.c \
 			$(RCP_SRC)/gps/gpsTask.c \
+			$(RCP_SRC)/predictive_timer/fast_lap_store.c \
 			$(RCP_SRC)/predictive_timer/predictive_timer_2.c \
 			$(RCP_SRC)/filter/filter.c \
 			$(RCP_SRC)/lua/luaBaseBinding.c \
@@ -88,6 +95,10 @@ APP_SRC = 	$(APP_PATH)/main.c \
 			$(RCP_SRC)/logger/loggerTaskEx.c \
 			$(RCP_SRC)/logger/logger.c \
 			$(RCP_SRC)/logger/connectivityTask.c \
+			$(RCP_SRC)/logger/telemetry_rate.c \
+			$(RCP_SRC)/logger/sample_history.c \
+			$(RCP_SRC)/logger/telemetry_subscription.c \
+			$(RCP_SRC)/logger/telemetry_datagram.c \
 			$(RCP_SRC)/logger/luaLoggerBinding.c \
 			$(RCP_SRC)/logger/sampleRecord.c \
 			$(RCP_SRC)/devices/bluetooth.c \
@@ -95,12 +106,15 @@ APP_SRC = 	$(APP_PATH)/main.c \
 			$(RCP_SRC)/devices/null_device.c \
 			$(RCP_SRC)/devices/sim900.c \
 			$(RCP_SRC)/tracks/tracks.c \
+			$(RCP_SRC)/tracks/track_index.c \
 			$(RCP_SRC)/auto_config/auto_track.c \
 			$(RCP_SRC)/messaging/messaging.c \
 			$(RCP_SRC)/LED/LED.c \
 			$(RCP_SRC)/PWM/PWM.c \
 			$(RCP_SRC)/logging/printk.c \
 			$(RCP_SRC)/util/ring_buffer.c \
+			$(RCP_SRC)/util/lookup_table.c \
+			$(RCP_SRC)/util/fnv.c \
 			$(RCP_SRC)/virtual_channel/virtual_channel.c \
 			$(RCP_SRC)/memory/memory.c \
 			$(RCP_SRC)/util/linear_interpolate.c \
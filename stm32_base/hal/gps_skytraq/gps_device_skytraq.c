@@ -1,17 +1,14 @@
 #include "gps_device.h"
-#include "byteswap.h"
 #include <stdint.h>
 #include <stddef.h>
 #include "printk.h"
 #include "mem_mang.h"
+#include "mod_string.h"
+#include "skytraq.h"
 #include "taskUtil.h"
 #include "printk.h"
 #include "FreeRTOS.h"
 #include "task.h"
-#include <math.h>
-
-/* UNIX time (epoch 1/1/1970) at the start of GNSS epoch (1/6/1980) */
-#define GNSS_EPOCH_IN_UNIX_EPOCH 315964800
 
 #define GNSS_NAVIGATION_MODE_AUTOMATIC  0
 #define GNSS_NAVIGATION_MODE_PEDESTRIAN 1
@@ -21,7 +18,7 @@
 #define GNSS_NAVIGATION_MODE_AIRBORNE   5
 
 #define MAX_PROVISIONING_ATTEMPTS	10
-#define MAX_PAYLOAD_LEN			256
+#define MAX_PAYLOAD_LEN			SKYTRAQ_MAX_PAYLOAD
 #define GPS_MSG_RX_WAIT_MS		2000
 #define GPS_MESSAGE_BUFFER_LEN		1024
 #define TARGET_BAUD_RATE 		921600
@@ -44,8 +41,8 @@ typedef struct _BaudRateCodes {
 #define UPDATE_RATES 		{1, 2, 4, 5, 8, 10, 20, 25, 40, 50}
 
 #define MSG_ID_QUERY_GPS_SW_VER					0x02
-#define MSG_ID_ACK						0x83
-#define MSG_ID_NACK 						0x84
+#define MSG_ID_ACK						SKYTRAQ_MSG_ACK
+#define MSG_ID_NACK 						SKYTRAQ_MSG_NACK
 #define MSG_ID_QUERY_SW_VERSION 				0x02
 #define MSG_ID_SET_FACTORY_DEFAULTS				0x04
 #define MSG_ID_SW_VERSION					0x80
@@ -58,15 +55,8 @@ typedef struct _BaudRateCodes {
 #define MSG_ID_CONFIGURE_NMEA_MESSAGE				0x08
 #define MSG_ID_CONFIGURE_MESSAGE_TYPE				0x09
 #define MSG_ID_CONFIGURE_NAVIGATION_DATA_MESSAGE_INTERVAL	0x11
-#define MSG_ID_NAVIGATION_DATA_MESSAGE				0xA8
-
-#define GGA_INTERVAL				100
-#define GSA_INTERVAL				0
-#define GSV_INTERVAL				0
-#define GLL_INTERVAL				0
-#define RMC_INTERVAL				1
-#define VTG_INTERVAL				0
-#define ZDA_INTERVAL				0
+#define MSG_ID_NAVIGATION_DATA_MESSAGE				SKYTRAQ_MSG_NAVIGATION_DATA
+
 #define NAVIGATION_DATA_MESSAGE_INTERVAL	1
 
 typedef enum {
@@ -148,29 +138,6 @@ typedef struct _ConfigureNavigationDataMessageInterval {
     uint8_t attributes;
 } ConfigureNavigationDataMessageInterval;
 
-typedef struct _NavigationDataMessage {
-    uint8_t messageId;
-    uint8_t fixMode;
-    uint8_t satellitesInFix;
-    uint16_t GNSS_week;
-    uint32_t GNSS_timeOfWeek;
-    int32_t latitude;
-    int32_t longitude;
-    uint32_t ellipsoid_altitidue;
-    uint32_t mean_sea_level_altitude;
-    uint16_t GDOP;
-    uint16_t PDOP;
-    uint16_t HDOP;
-    uint16_t VDOP;
-    uint16_t TDOP;
-    int32_t ECEF_x;
-    int32_t ECEF_y;
-    int32_t ECEF_z;
-    int32_t ECEF_vx;
-    int32_t ECEF_vy;
-    int32_t ECEF_vz;
-} __attribute__((__packed__)) NavigationDataMessage;
-
 typedef struct _GpsMessage {
     uint16_t payloadLength;
     union {
@@ -188,8 +155,6 @@ typedef struct _GpsMessage {
         ConfigureGNSSNavigationMode configureGnssNavigationMode;
         ConfigureMessageType configureMessageType;
         ConfigureNavigationDataMessageInterval configureNavigationDataMessageInterval;
-        NavigationDataMessage navigationDataMessage;
-
     };
     uint8_t checksum;
 }  __attribute__((__packed__)) GpsMessage;
@@ -234,77 +199,55 @@ static void txGpsMessage(GpsMessage * msg, Serial * serial)
     serial->put_c(0x0A);
 }
 
-/* TODO: Comment this epic blob-o-code */
-static gps_msg_result_t rxGpsMessage(GpsMessage * msg, Serial * serial,
-                                     uint8_t expectedMessageId)
-{
+static struct skytraq_parser g_parser;
+
+/* Uptime when the first byte of the message in g_parser came in */
+static tiny_millis_t g_messageStart;
 
-    gps_msg_result_t result = GPS_MSG_NONE;
+/**
+ * Reads until a message with the given ID comes in.  Anything else,
+ * including what is left of NMEA output, is skipped.  The message is left
+ * in g_parser.
+ */
+static gps_msg_result_t rxMessage(Serial * serial, uint8_t expectedMessageId)
+{
     size_t timeoutLen = msToTicks(GPS_MSG_RX_WAIT_MS);
     size_t timeoutStart = xTaskGetTickCount();
+    tiny_millis_t start = 0;
 
-    while (result == GPS_MSG_NONE) {
-        uint8_t som1 = 0, som2 = 0;
-        if (serial_read_byte(serial, &som1, timeoutLen)
-            && serial_read_byte(serial, &som2, timeoutLen)) {
-            if (som1 == 0xA0 && som2 == 0xA1) {
-                uint8_t len_h = 0, len_l = 0;
-                size_t len_hb =
-                    serial_read_byte(serial, &len_h,
-                                     timeoutLen);
-                size_t len_lb =
-                    serial_read_byte(serial, &len_l,
-                                     timeoutLen);
-                if (!(len_hb && len_lb)) {
-                    result = GPS_MSG_TIMEOUT;
-                    break;
-                }
-                uint16_t len = (len_h << 8) + len_l;
-
-                if (len <= MAX_PAYLOAD_LEN) {
-                    msg->payloadLength = len;
-                    uint8_t c = 0;
-                    for (size_t i = 0; i < len; i++) {
-                        if (!serial_read_byte
-                            (serial, &c, timeoutLen)) {
-                            result =
-                                GPS_MSG_TIMEOUT;
-                            break;
-                        }
-                        msg->payload[i] = c;
-                    }
-                }
-                uint8_t checksum = 0;
-                if (!serial_read_byte
-                    (serial, &checksum, timeoutLen)) {
-                    result = GPS_MSG_TIMEOUT;
-                    break;
-                }
-                uint8_t calculatedChecksum =
-                    calculateChecksum(msg);
-                if (calculatedChecksum == checksum) {
-                    uint8_t eos1 = 0, eos2 = 0;
-                    if (!
-                        (serial_read_byte
-                         (serial, &eos1, timeoutLen)
-                         && serial_read_byte(serial, &eos2,
-                                             timeoutLen))) {
-                        result = GPS_MSG_TIMEOUT;
-                        break;
-                    }
-                    if (eos1 == 0x0D && eos2 == 0x0A
-                        && msg->messageId ==
-                        expectedMessageId) {
-                        result = GPS_MSG_SUCCESS;
-                    } else {
-                        pr_trace_int_msg("Unexpected Id: ", msg->messageId);
-                    }
-                }
-            }
-        }
-        if (isTimeoutMs(timeoutStart, GPS_MSG_RX_WAIT_MS)) {
-            result = GPS_MSG_TIMEOUT;
-        }
+    while (!isTimeoutMs(timeoutStart, GPS_MSG_RX_WAIT_MS)) {
+        uint8_t c = 0;
+        if (!serial_read_byte(serial, &c, timeoutLen))
+            return GPS_MSG_TIMEOUT;
+
+        if (!start && c == SKYTRAQ_SYNC_1)
+            start = getUptime();
+
+        const enum skytraq_result res = skytraq_feed(&g_parser, c);
+        if (res == SKYTRAQ_PENDING)
+            continue;
+
+        g_messageStart = start;
+        start = 0;
+        if (res == SKYTRAQ_ERROR)
+            continue;
+
+        const uint8_t messageId = skytraq_message_id(&g_parser);
+        if (messageId == expectedMessageId)
+            return GPS_MSG_SUCCESS;
+
+        pr_trace_int_msg("Unexpected Id: ", messageId);
+    }
+    return GPS_MSG_TIMEOUT;
+}
+
+static gps_msg_result_t rxGpsMessage(GpsMessage * msg, Serial * serial,
+                                     uint8_t expectedMessageId)
+{
+    gps_msg_result_t result = rxMessage(serial, expectedMessageId);
+    if (result == GPS_MSG_SUCCESS) {
+        msg->payloadLength = skytraq_payload_len(&g_parser);
+        memcpy(msg->payload, skytraq_payload(&g_parser), msg->payloadLength);
     }
     return result;
 }
@@ -362,22 +305,6 @@ static void sendDisableNmea(GpsMessage *gpsMsg, Serial *serial)
     txGpsMessage(gpsMsg, serial);
 }
 
-static void sendConfigureNmea(GpsMessage *gpsMsg, Serial *serial)
-{
-    gpsMsg->messageId = MSG_ID_CONFIGURE_NMEA_MESSAGE;
-    gpsMsg->configureNmeaMessage.GGA_interval = GGA_INTERVAL;
-    gpsMsg->configureNmeaMessage.GSA_interval = GSA_INTERVAL;
-    gpsMsg->configureNmeaMessage.GSV_interval = GSV_INTERVAL;
-    gpsMsg->configureNmeaMessage.GLL_interval = GLL_INTERVAL;
-    gpsMsg->configureNmeaMessage.RMC_interval = RMC_INTERVAL;
-    gpsMsg->configureNmeaMessage.VTG_interval = VTG_INTERVAL;
-    gpsMsg->configureNmeaMessage.ZDA_interval = ZDA_INTERVAL;
-    gpsMsg->configureSerialPort.attributes = ATTRIBUTE_UPDATE_TO_SRAM;
-    gpsMsg->payloadLength = sizeof(ConfigureNmeaMessage);
-    gpsMsg->checksum = calculateChecksum(gpsMsg);
-    txGpsMessage(gpsMsg, serial);
-}
-
 static void sendConfigureGnssNavigationMode(GpsMessage *gpsMsg, Serial *serial, uint8_t navigationMode)
 {
     gpsMsg->messageId = MSG_ID_CONFIGURE_GNSS_NAVIGATION_MODE;
@@ -484,25 +411,6 @@ static gps_cmd_result_t configureBaudRate(GpsMessage * gpsMsg, Serial * serial,
     return result;
 }
 
-static gps_cmd_result_t configureNmeaMessages(GpsMessage * gpsMsg,
-        Serial * serial)
-{
-    pr_info("GPS: Configuring NMEA messages: ");
-
-    gps_cmd_result_t result = GPS_COMMAND_FAIL;
-    sendConfigureNmea(gpsMsg, serial);
-
-    if (rxGpsMessage(gpsMsg, serial, MSG_ID_ACK) == GPS_MSG_SUCCESS) {
-        result =
-            (gpsMsg->ackMsg.ackId ==
-             MSG_ID_CONFIGURE_NMEA_MESSAGE) ? GPS_COMMAND_SUCCESS :
-            GPS_COMMAND_FAIL;
-    }
-
-    pr_info(result == GPS_COMMAND_SUCCESS ? "win\r\n" : "fail\r\n");
-    return result;
-}
-
 static gps_cmd_result_t configureGnssNavigationMode(GpsMessage *gpsMsg, Serial *serial)
 {
     pr_info("GPS: Configuring Gnss Navigation Mode: ");
@@ -608,6 +516,7 @@ gps_status_t GPS_device_init(uint8_t sampleRate, Serial *serial)
     size_t attempts = MAX_PROVISIONING_ATTEMPTS;
     size_t gps_init_status = GPS_STATUS_NOT_INIT;
 
+    skytraq_init(&g_parser);
     vTaskDelay(msToTicks(500));
     while(attempts-- && gps_init_status == GPS_STATUS_NOT_INIT) {
         while(1) {
@@ -636,11 +545,6 @@ gps_status_t GPS_device_init(uint8_t sampleRate, Serial *serial)
                     break;
                 }
 
-                if (configureNmeaMessages(&gpsMsg, serial) == GPS_COMMAND_FAIL) {
-                    pr_error("GPS: Error: could not configure NMEA messages\r\n");
-                    break;
-                }
-
                 if (configureMessageType(&gpsMsg, serial) == GPS_COMMAND_FAIL) {
                     pr_error("GPS: Error: could not set binary message mode\r\n");
                     break;
@@ -680,37 +584,13 @@ gps_status_t GPS_device_init(uint8_t sampleRate, Serial *serial)
 
 gps_msg_result_t GPS_device_get_update(GpsSample *gpsSample, Serial *serial)
 {
-    gps_msg_result_t result = rxGpsMessage(&gpsMsg, serial, MSG_ID_NAVIGATION_DATA_MESSAGE);
+    gps_msg_result_t result = rxMessage(serial, MSG_ID_NAVIGATION_DATA_MESSAGE);
 
     if (result != GPS_MSG_SUCCESS) return result;
 
-    gpsSample->quality = gpsMsg.navigationDataMessage.fixMode;
-    gpsSample->satellites = gpsMsg.navigationDataMessage.satellitesInFix;
-    gpsSample->DOP = ((float)swap_uint16(gpsMsg.navigationDataMessage.PDOP)) * 0.01;
-    int32_t latitude_raw = swap_int32(gpsMsg.navigationDataMessage.latitude);
-    int32_t longitude_raw = swap_int32(gpsMsg.navigationDataMessage.longitude);
-    gpsSample->point.latitude = ((float)latitude_raw) * 0.0000001f;
-    gpsSample->point.longitude = ((float)longitude_raw) * 0.0000001f;
-    //gpsSample->altitude =((float)gpsMsg.navigationDataMessage.ellipsoid_altitidue) * 0.01;
-
-    float ecef_x_velocity = ((float)swap_int32(gpsMsg.navigationDataMessage.ECEF_vx)) * 0.01;
-    float ecef_y_velocity = ((float)swap_int32(gpsMsg.navigationDataMessage.ECEF_vy)) * 0.01;
-    float ecef_z_velocity = ((float)swap_int32(gpsMsg.navigationDataMessage.ECEF_vz)) * 0.01;
-
-    float velocity = sqrt((ecef_x_velocity * ecef_x_velocity)
-                          + (ecef_y_velocity * ecef_y_velocity)
-                          + (ecef_z_velocity * ecef_z_velocity));
-    //convert m/sec to km/hour
-    gpsSample->speed = velocity * 3.6;
-    gpsSample->altitude = (((float)swap_uint32(gpsMsg.navigationDataMessage.mean_sea_level_altitude)) * 0.01) * 3.28084;
-
-    //convert GNSS_week to milliseconds and add time of week converted to milliseconds
-    uint16_t GNSS_week = swap_uint16(gpsMsg.navigationDataMessage.GNSS_week);
-    uint32_t timeOfWeekMillis = swap_uint32(gpsMsg.navigationDataMessage.GNSS_timeOfWeek) * 10;
-    millis_t time = (((uint64_t)GNSS_week * 60 * 60 * 24 * 7) * 1000) + timeOfWeekMillis;
-    //adjust for Jan 6 1980 GNSS epoch
-    time += (uint64_t)GNSS_EPOCH_IN_UNIX_EPOCH * 1000;
-    gpsSample->time = time;
+    /* Decoded in place from the parser buffer */
+    skytraq_decode_navigation(&g_parser, gpsSample);
+    gpsSample->uptime = g_messageStart;
 
     return GPS_MSG_SUCCESS;
 }
@@ -20,6 +20,45 @@
 
 #include "ff.h"
 
+#include <string.h>
+
+/*
+ * Just enough of a file system for what gets read back: files are kept in
+ * memory by name.  Writes always succeed, as they always did here.
+ */
+#define STUB_FILES	8
+#define STUB_FILE_NAME	13
+#define STUB_FILE_SIZE	32768
+
+static struct {
+        char name[STUB_FILE_NAME];
+        BYTE data[STUB_FILE_SIZE];
+        DWORD size;
+} files[STUB_FILES];
+
+static int find_file(const TCHAR *path)
+{
+        for (int i = 0; i < STUB_FILES; ++i)
+                if (files[i].name[0] && !strcmp(files[i].name, path))
+                        return i;
+
+        return -1;
+}
+
+static int create_file(const TCHAR *path)
+{
+        int i = find_file(path);
+        for (int j = 0; i < 0 && j < STUB_FILES; ++j)
+                if (!files[j].name[0])
+                        i = j;
+        if (i < 0)
+                return -1;
+
+        strncpy(files[i].name, path, STUB_FILE_NAME - 1);
+        files[i].size = 0;
+        return i;
+}
+
 
 FRESULT f_sync (FIL* fp)
 {
@@ -35,6 +74,47 @@ FRESULT f_open(FIL* fp,
                const TCHAR* path,
                BYTE mode)
 {
+        int i = find_file(path);
+
+        if (mode & FA_CREATE_ALWAYS || (i < 0 && mode & FA_WRITE))
+                i = create_file(path);
+        else if (i < 0)
+                return FR_NO_FILE;
+
+        fp->fptr = 0;
+        /* Which file, plus one so that 0 is none */
+        fp->sclust = i + 1;
+        fp->fsize = i < 0 ? 0 : files[i].size;
+        return FR_OK;
+}
+
+FRESULT f_read (
+    FIL* fp,
+    void* buff,
+    UINT btr,
+    UINT* br
+)
+{
+        *br = 0;
+        if (!fp->sclust)
+                return FR_INVALID_OBJECT;
+
+        const DWORD size = files[fp->sclust - 1].size;
+        if (fp->fptr < size)
+                *br = size - fp->fptr < btr ? size - fp->fptr : btr;
+
+        memcpy(buff, files[fp->sclust - 1].data + fp->fptr, *br);
+        fp->fptr += *br;
+        return FR_OK;
+}
+
+FRESULT f_unlink (const TCHAR* path)
+{
+        const int i = find_file(path);
+        if (i < 0)
+                return FR_NO_FILE;
+
+        files[i].name[0] = 0;
         return FR_OK;
 }
 
@@ -51,6 +131,18 @@ FRESULT f_write (
     UINT* bw			/* Pointer to number of bytes written */
 )
 {
+        *bw = btw;
+        if (!fp->sclust)
+                return FR_OK;
+
+        BYTE *data = files[fp->sclust - 1].data;
+        const DWORD room = fp->fptr < STUB_FILE_SIZE ?
+                STUB_FILE_SIZE - fp->fptr : 0;
+        memcpy(data + fp->fptr, buff, btw < room ? btw : room);
+        fp->fptr += btw;
+        if (fp->fptr > files[fp->sclust - 1].size)
+                files[fp->sclust - 1].size = fp->fptr < STUB_FILE_SIZE ?
+                        fp->fptr : STUB_FILE_SIZE;
         return FR_OK;
 }
 
@@ -59,5 +151,6 @@ FRESULT f_lseek (
     DWORD ofs		/* File pointer from top of file */
 )
 {
+        fp->fptr = ofs;
         return FR_OK;
 }
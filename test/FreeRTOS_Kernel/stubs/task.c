@@ -57,3 +57,11 @@ signed portBASE_TYPE xTaskGenericCreate(
 {
         return 0;
 }
+
+void vPortEnterCritical(void)
+{
+}
+
+void vPortExitCritical(void)
+{
+}
@@ -0,0 +1,250 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GpsLogReader.h"
+#include "dateTime.h"
+#include "geopoint.h"
+#include "mod_string.h"
+#include "modp_atonum.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <vector>
+
+using std::ifstream;
+using std::string;
+using std::vector;
+
+#define MPH_TO_KPH	1.609344f
+
+/* 2014-05-03, the day the Time column of the older logs is on */
+#define TIME_COLUMN_DATE	1399075200000LL
+
+GpsLogReader::GpsLogReader(string fName)
+{
+        ifstream f(fName.c_str(), std::ios::binary);
+        if (!f.is_open())
+                f.open(("test/" + fName).c_str(), std::ios::binary);
+        if (!f.is_open())
+                throw ("Can not find file " + fName);
+
+        std::stringstream ss;
+        ss << f.rdbuf();
+        data = ss.str();
+
+        if (!data.empty() && (uint8_t) data[0] == SKYTRAQ_SYNC_1)
+                fmt = FORMAT_SKYTRAQ;
+        else if (data.find("$GP") != string::npos ||
+                 data.find("$GN") != string::npos)
+                fmt = FORMAT_NMEA;
+        else
+                fmt = FORMAT_CSV;
+
+        rewind();
+}
+
+void GpsLogReader::rewind()
+{
+        pos = 0;
+        nmea_init(&nmea);
+        memset(&nmeaSample, 0, sizeof(nmeaSample));
+        skytraq_init(&skytraq);
+
+        if (fmt == FORMAT_CSV)
+                readCsvHeader();
+}
+
+enum GpsLogReader::Format GpsLogReader::format() const
+{
+        return fmt;
+}
+
+size_t GpsLogReader::size() const
+{
+        return data.size();
+}
+
+bool GpsLogReader::next(GpsSample *sample)
+{
+        switch (fmt) {
+        case FORMAT_NMEA:
+                return nextNmea(sample);
+        case FORMAT_SKYTRAQ:
+                return nextSkytraq(sample);
+        default:
+                return nextCsv(sample);
+        }
+}
+
+/* Splits the line at pos into fields and moves pos to the next line */
+static void splitLine(const string &data, size_t *pos, vector<string> *fields)
+{
+        size_t end = data.find('\n', *pos);
+        if (end == string::npos)
+                end = data.size();
+
+        fields->clear();
+        size_t start = *pos;
+        for (size_t i = start; i <= end; ++i) {
+                if (i == end || data[i] == ',') {
+                        size_t len = i - start;
+                        if (len && data[start + len - 1] == '\r')
+                                --len;
+                        fields->push_back(data.substr(start, len));
+                        start = i + 1;
+                }
+        }
+
+        *pos = end + 1;
+}
+
+/* "Latitude"|"Deg"|10 -> Latitude and Deg */
+static void parseHeaderField(const string &field, string *name, string *units)
+{
+        string parts[2];
+        size_t part = 0;
+        for (size_t i = 0; i < field.size() && part < 2; ++i) {
+                const char c = field[i];
+                if (c == '|')
+                        ++part;
+                else if (c != '"' && c != '#')
+                        parts[part] += c;
+        }
+
+        *name = parts[0];
+        *units = parts[1];
+}
+
+void GpsLogReader::readCsvHeader()
+{
+        latColumn = lonColumn = speedColumn = timeColumn = utcColumn = -1;
+        speedScale = 1;
+
+        vector<string> fields;
+        splitLine(data, &pos, &fields);
+
+        for (size_t i = 0; i < fields.size(); ++i) {
+                string name, units;
+                parseHeaderField(fields[i], &name, &units);
+
+                if (name == "Latitude") {
+                        latColumn = i;
+                } else if (name == "Longitude") {
+                        lonColumn = i;
+                } else if (name == "Speed") {
+                        speedColumn = i;
+                        speedScale = units == "MPH" ? MPH_TO_KPH : 1;
+                } else if (name == "Time") {
+                        timeColumn = i;
+                } else if (name == "Utc") {
+                        utcColumn = i;
+                }
+        }
+}
+
+/* hhmmss.sss, with or without the leading zero */
+static millis_t parseTimeColumn(const string &s)
+{
+        const size_t dot = s.find('.');
+        const long hhmmss = strtol(s.substr(0, dot).c_str(), NULL, 10);
+
+        int ms = 0;
+        if (dot != string::npos) {
+                const string frac = (s.substr(dot + 1) + "000").substr(0, 3);
+                ms = strtol(frac.c_str(), NULL, 10);
+        }
+
+        const long seconds = (hhmmss / 10000) * 3600 +
+                (hhmmss / 100 % 100) * 60 + hhmmss % 100;
+        return TIME_COLUMN_DATE + (millis_t) seconds * 1000 + ms;
+}
+
+static const string * field(const vector<string> &fields, const int column)
+{
+        if (column < 0 || (size_t) column >= fields.size() ||
+            fields[column].empty())
+                return NULL;
+
+        return &fields[column];
+}
+
+bool GpsLogReader::nextCsv(GpsSample *sample)
+{
+        vector<string> fields;
+
+        while (pos < data.size()) {
+                splitLine(data, &pos, &fields);
+
+                const string *lat = field(fields, latColumn);
+                const string *lon = field(fields, lonColumn);
+                const string *speed = field(fields, speedColumn);
+                const string *time = field(fields, timeColumn);
+                const string *utc = field(fields, utcColumn);
+                if (!lat || !lon || !speed || !(time || utc))
+                        continue;
+
+                memset(sample, 0, sizeof(*sample));
+                sample->quality = GPS_QUALITY_3D;
+                sample->satellites = 8;
+                sample->point.latitude = gp_parse_degrees(lat->c_str());
+                sample->point.longitude = gp_parse_degrees(lon->c_str());
+                sample->speed = modp_atof(speed->c_str()) * speedScale;
+                sample->time = utc ? strtoll(utc->c_str(), NULL, 10) :
+                        parseTimeColumn(*time);
+                return true;
+        }
+
+        return false;
+}
+
+bool GpsLogReader::nextNmea(GpsSample *sample)
+{
+        while (pos < data.size()) {
+                if (NMEA_READY != nmea_feed(&nmea, data[pos++]))
+                        continue;
+
+                /*
+                 * RMC has everything lap timing needs and every receiver
+                 * sends it.  The GGA before it has filled in the rest.
+                 */
+                if (NMEA_RMC == nmea_decode(&nmea, &nmeaSample)) {
+                        *sample = nmeaSample;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+bool GpsLogReader::nextSkytraq(GpsSample *sample)
+{
+        while (pos < data.size()) {
+                if (SKYTRAQ_READY != skytraq_feed(&skytraq, data[pos++]))
+                        continue;
+
+                memset(sample, 0, sizeof(*sample));
+                if (skytraq_decode_navigation(&skytraq, sample))
+                        return true;
+        }
+
+        return false;
+}
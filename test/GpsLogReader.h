@@ -1,18 +1,105 @@
 /*
- * GpsLogReader.h
+ * Race Capture Pro Firmware
  *
- *  Created on: Feb 3, 2014
- *      Author: stieg
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
  */
 
 #ifndef GPSLOGREADER_H_
 #define GPSLOGREADER_H_
 
+#include "gps.h"
+#include "nmea.h"
+#include "skytraq.h"
+
+#include <stddef.h>
+#include <string>
+
+/*
+ * Reads the fixes out of a recorded GPS log, one at a time.  The whole
+ * file is loaded up front and parsed as the fixes are asked for, so that
+ * the parse can be timed along with everything that uses the fixes.
+ *
+ * Three formats are understood, told apart by their content:
+ *
+ * - RaceCapture CSV logs.  The Latitude, Longitude and Speed columns are
+ *   found by name in the header.  Time comes from the Utc column, or else
+ *   from a Time column of hhmmss.sss on 2014-05-03, which is what the
+ *   older logs here have.
+ * - NMEA 0183, through the firmware's own parser.  A fix is complete at
+ *   its RMC sentence.
+ * - Skytraq binary navigation data messages, through the firmware's own
+ *   parser.
+ */
 class GpsLogReader
 {
 public:
-    GpsLogReader(string fName);
+        enum Format {
+                FORMAT_CSV,
+                FORMAT_NMEA,
+                FORMAT_SKYTRAQ,
+        };
+
+        /**
+         * Loads a log.  If fName can not be opened, test/fName is tried.
+         * Throws a string if neither can.
+         */
+        GpsLogReader(std::string fName);
+
+        /**
+         * Reads the next fix.
+         * @return false once there are no more.
+         */
+        bool next(GpsSample *sample);
+
+        /**
+         * Goes back to the first fix.
+         */
+        void rewind();
+
+        enum Format format() const;
+
+        /**
+         * @return The size of the log in bytes.
+         */
+        size_t size() const;
+
+private:
+        bool nextCsv(GpsSample *sample);
+        bool nextNmea(GpsSample *sample);
+        bool nextSkytraq(GpsSample *sample);
+        void readCsvHeader();
+
+        std::string data;
+        size_t pos;
+        enum Format fmt;
+
+        /* Column numbers of the CSV fields we need.  -1 if not there */
+        int latColumn;
+        int lonColumn;
+        int speedColumn;
+        int timeColumn;
+        int utcColumn;
+        /* What gets the speed column to KPH */
+        float speedScale;
 
+        struct nmea_parser nmea;
+        GpsSample nmeaSample;
+        struct skytraq_parser skytraq;
 };
 
 #endif /* GPSLOGREADER_H_ */
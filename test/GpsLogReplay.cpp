@@ -0,0 +1,255 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GpsLogReader.h"
+#include "GpsLogReplay.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "gps.testing.h"
+#include "lap_stats.h"
+#include "loggerConfig.h"
+#include "mod_string.h"
+#include "predictive_timer_2.h"
+#include "serial.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using std::ifstream;
+using std::ofstream;
+using std::string;
+using std::vector;
+
+GpsLogReplay::GpsLogReplay(string fName) :
+        path(fName), radius(DEFAULT_TRACK_TARGET_RADIUS), recordedLaps(false)
+{
+        ifstream f(path.c_str());
+        if (!f.is_open()) {
+                path = "test/" + fName;
+                f.open(path.c_str());
+        }
+        if (!f.is_open())
+                throw ("Can not find file " + fName);
+
+        memset(&track, 0, sizeof(track));
+        recorded.predictedErrorAvg = recorded.predictedErrorMax = 0;
+        recorded.predictions = recorded.updates = 0;
+        recorded.usPerUpdate = 0;
+
+        GeoPoint *sector = track.circuit.sectors;
+        GeoPoint *sectorsEnd = sector + CIRCUIT_SECTOR_COUNT;
+
+        for (string line; getline(f, line);) {
+                std::istringstream ss(line);
+                string key;
+                ss >> key;
+
+                if (key == "lap") {
+                        ReplayLap lap;
+                        lap.startFix = lap.endFix = 0;
+                        ss >> lap.time;
+                        for (tiny_millis_t t; ss >> t;)
+                                lap.sectors.push_back(t);
+                        recorded.laps.push_back(lap);
+                        recordedLaps = true;
+                        continue;
+                }
+
+                if (key == "predicted") {
+                        ss >> recorded.predictedErrorAvg >>
+                                recorded.predictedErrorMax;
+                        recordedLaps = true;
+                        continue;
+                }
+
+                config.push_back(line);
+
+                double lat = 0, lon = 0;
+                if (key == "log") {
+                        ss >> log;
+                        const size_t slash = path.rfind('/');
+                        if (log[0] != '/' && slash != string::npos)
+                                log = path.substr(0, slash + 1) + log;
+                } else if (key == "radius") {
+                        ss >> radius;
+                } else if (key == "start_finish" && ss >> lat >> lon) {
+                        track.track_type = TRACK_TYPE_CIRCUIT;
+                        track.circuit.startFinish.latitude =
+                                gp_from_degrees(lat);
+                        track.circuit.startFinish.longitude =
+                                gp_from_degrees(lon);
+                } else if (key == "start" && ss >> lat >> lon) {
+                        track.track_type = TRACK_TYPE_STAGE;
+                        sector = track.stage.sectors;
+                        sectorsEnd = sector + STAGE_SECTOR_COUNT;
+                        track.stage.start.latitude = gp_from_degrees(lat);
+                        track.stage.start.longitude = gp_from_degrees(lon);
+                } else if (key == "finish" && ss >> lat >> lon) {
+                        track.stage.finish.latitude = gp_from_degrees(lat);
+                        track.stage.finish.longitude = gp_from_degrees(lon);
+                } else if (key == "sector" && ss >> lat >> lon &&
+                           sector < sectorsEnd) {
+                        sector->latitude = gp_from_degrees(lat);
+                        sector->longitude = gp_from_degrees(lon);
+                        ++sector;
+                }
+        }
+
+        if (log.empty())
+                throw ("No log in " + fName);
+}
+
+bool GpsLogReplay::hasGolden() const
+{
+        return recordedLaps;
+}
+
+const ReplayResult & GpsLogReplay::golden() const
+{
+        return recorded;
+}
+
+const string & GpsLogReplay::logName() const
+{
+        return log;
+}
+
+ReplayResult GpsLogReplay::run() const
+{
+        GpsLogReader reader(log);
+
+        GPS_init(10, get_serial(SERIAL_GPS));
+        lapStats_init();
+        LoggerConfig *lc = getWorkingLoggerConfig();
+        TrackConfig *tc = &lc->TrackConfigs;
+        memcpy(&tc->track, &track, sizeof(track));
+        tc->auto_detect = 0;
+        tc->radius = radius;
+        /* Sectors are only timed if their channel is logged */
+        if (lc->LapConfigs.sectorTimeCfg.sampleRate == SAMPLE_DISABLED)
+                lc->LapConfigs.sectorTimeCfg.sampleRate = SAMPLE_10Hz;
+
+        ReplayResult r;
+        r.predictions = 0;
+        r.updates = 0;
+
+        ReplayLap lap;
+        int lapCount = 0;
+        int sector = -1;
+        bool inProgress = false;
+        size_t lapStart = 0;
+        /* Predictions made during the lap in progress */
+        vector<tiny_millis_t> predictions;
+        double errorSum = 0;
+        tiny_millis_t errorMax = 0;
+
+        GpsSample sample;
+        const clock_t start = clock();
+
+        while (reader.next(&sample)) {
+                ++r.updates;
+                GPS_sample_update(&sample);
+                const GpsSnapshot snap = getGpsSnapshot();
+                lapstats_processUpdate(&snap);
+                const size_t fix = r.updates - 1;
+
+                if (getSector() != sector) {
+                        /* Not for the first time over the start */
+                        if (sector >= 0)
+                                lap.sectors.push_back(getLastSectorTime());
+                        sector = getSector();
+                }
+
+                if (getLapCount() != lapCount) {
+                        lapCount = getLapCount();
+                        lap.time = getLastLapTime();
+                        lap.startFix = lapStart;
+                        lap.endFix = fix;
+                        r.laps.push_back(lap);
+                        lapStart = fix;
+                        lap.sectors.clear();
+
+                        for (size_t i = 0; i < predictions.size(); ++i) {
+                                const tiny_millis_t err =
+                                        abs(predictions[i] - lap.time);
+                                errorSum += err;
+                                errorMax = err > errorMax ? err : errorMax;
+                        }
+                        r.predictions += predictions.size();
+                        predictions.clear();
+                }
+
+                if (!inProgress && lapstats_lap_in_progress())
+                        lapStart = fix;
+                inProgress = lapstats_lap_in_progress();
+
+                if (lapstats_lap_in_progress() && isPredictiveTimeAvailable()) {
+                        const tiny_millis_t p =
+                                getPredictedTime(&snap.sample.point,
+                                                 snap.deltaFirstFix);
+                        if (p > 0)
+                                predictions.push_back(p);
+                }
+        }
+
+        const double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        r.usPerUpdate = r.updates ? seconds * 1e6 / r.updates : 0;
+        r.predictedErrorAvg = r.predictions ?
+                (tiny_millis_t) (errorSum / r.predictions + 0.5) : 0;
+        r.predictedErrorMax = errorMax;
+
+        return r;
+}
+
+bool GpsLogReplay::record(const ReplayResult &result) const
+{
+        ofstream f(path.c_str());
+        if (!f.is_open())
+                return false;
+
+        for (size_t i = 0; i < config.size(); ++i)
+                f << config[i] << "\n";
+
+        for (size_t i = 0; i < result.laps.size(); ++i) {
+                const ReplayLap &lap = result.laps[i];
+                f << "lap " << lap.time;
+                for (size_t s = 0; s < lap.sectors.size(); ++s)
+                        f << " " << lap.sectors[s];
+                f << "\n";
+        }
+
+        f << "predicted " << result.predictedErrorAvg << " " <<
+                result.predictedErrorMax << "\n";
+
+        return f.good();
+}
+
+string replayFormatTime(const tiny_millis_t t)
+{
+        char buf[32];
+        const tiny_millis_t a = abs(t);
+        snprintf(buf, sizeof(buf), "%s%d:%02d.%03d", t < 0 ? "-" : "",
+                 a / 60000, a / 1000 % 60, a % 1000);
+        return buf;
+}
@@ -0,0 +1,131 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GPSLOGREPLAY_H_
+#define GPSLOGREPLAY_H_
+
+#include "dateTime.h"
+#include "tracks.h"
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * Replays a recorded GPS log through the same chain the GPS task runs:
+ * the parse, GPS_sample_update, lapstats_processUpdate and the predictive
+ * timer.  It runs as fast as it can.
+ *
+ * What to replay is described by a replay file, one item per line:
+ *
+ *   # A comment
+ *   log predictive_time_test_lap.log   The log, relative to this file
+ *   radius 0.0001                      Target radius in degrees
+ *   start_finish 47.806934 -122.341150 A circuit, or for a stage:
+ *   start 47.806934 -122.341150
+ *   finish 47.806875 -122.335818
+ *   sector 47.79974 -122.335704        As many as there are
+ *
+ * Once recorded, the file also holds the results the replay has to keep
+ * giving, which makes it a golden regression test:
+ *
+ *   lap 97241 18540 20120 19874 21013 17694   Lap time, then sector times
+ *   predicted 812 2473                        Average and worst error
+ */
+
+struct ReplayLap {
+        tiny_millis_t time;
+        std::vector<tiny_millis_t> sectors;
+        /*
+         * The fixes the lap started and finished at, counted from 0.  Both
+         * are the first fix past the line.
+         */
+        size_t startFix;
+        size_t endFix;
+};
+
+struct ReplayResult {
+        std::vector<ReplayLap> laps;
+        /*
+         * How far the predicted lap times were from the lap times that
+         * followed, over the laps that were finished.
+         */
+        tiny_millis_t predictedErrorAvg;
+        tiny_millis_t predictedErrorMax;
+        size_t predictions;
+        /* Fixes fed in and how long each took, parse included */
+        size_t updates;
+        double usPerUpdate;
+};
+
+class GpsLogReplay
+{
+public:
+        /**
+         * Loads a replay file.  If fName can not be opened, test/fName is
+         * tried.  Throws a string if it can not be read.
+         */
+        GpsLogReplay(std::string fName);
+
+        /**
+         * Runs the replay.  Resets GPS, lap stats and the track config.
+         */
+        ReplayResult run() const;
+
+        /**
+         * @return true if the file holds recorded results.
+         */
+        bool hasGolden() const;
+
+        /**
+         * @return The recorded results.  Only the laps and the predicted
+         * error are recorded.
+         */
+        const ReplayResult & golden() const;
+
+        /**
+         * Writes the replay file back with the given results recorded.
+         * @return true on success.
+         */
+        bool record(const ReplayResult &result) const;
+
+        /**
+         * @return The path of the log being replayed.
+         */
+        const std::string & logName() const;
+
+private:
+        std::string path;
+        std::string log;
+        /* The lines that describe the replay, kept for record */
+        std::vector<std::string> config;
+        Track track;
+        float radius;
+        ReplayResult recorded;
+        bool recordedLaps;
+};
+
+/**
+ * Formats a lap or sector time as m:ss.sss.
+ */
+std::string replayFormatTime(tiny_millis_t t);
+
+#endif /* GPSLOGREPLAY_H_ */
@@ -94,9 +94,9 @@ string PredictiveTimeTest2::readFile(string filename) {
 }
 
 void PredictiveTimeTest2::testProjectedDistance() {
-  GeoPoint s = { .latitude = 2.0, .longitude = 0.0 }; // start
-  GeoPoint m = { .latitude = 2.0, .longitude = 1.0 }; // middle
-  GeoPoint e = { .latitude = 2.0, .longitude = 2.0 }; // end
+  GeoPoint s = { .latitude = GP_DEGREES(2.0), .longitude = GP_DEGREES(0.0) }; // start
+  GeoPoint m = { .latitude = GP_DEGREES(2.0), .longitude = GP_DEGREES(1.0) }; // middle
+  GeoPoint e = { .latitude = GP_DEGREES(2.0), .longitude = GP_DEGREES(2.0) }; // end
 
   const float expected = 0.5;
   const float actual = distPctBtwnTwoPoints(&s, &e, &m);
@@ -110,8 +110,8 @@ void PredictiveTimeTest2::testPredictedTimeGpsFeed() {
 
 
 	TrackConfig *trackCfg  = &(getWorkingLoggerConfig()->TrackConfigs);
-	trackCfg->track.circuit.startFinish.latitude = 47.806934;
-	trackCfg->track.circuit.startFinish.longitude = -122.341150;
+	trackCfg->track.circuit.startFinish.latitude = GP_DEGREES(47.806934);
+	trackCfg->track.circuit.startFinish.longitude = GP_DEGREES(-122.341150);
 	trackCfg->radius = 0.0004;
 
 	int lineNo = 0;
@@ -132,8 +132,8 @@ void PredictiveTimeTest2::testPredictedTimeGpsFeed() {
               || timeRaw.size() <= 0) continue;
 
           //printf("%s", line.c_str());
-          float lat = modp_atof(latitudeRaw.c_str());
-          float lon = modp_atof(longitudeRaw.c_str());
+          const int32_t lat = gp_parse_degrees(latitudeRaw.c_str());
+          const int32_t lon = gp_parse_degrees(longitudeRaw.c_str());
           float speed = modp_atof(speedRaw.c_str());
 
           const char *utcTimeStr = timeRaw.c_str();
@@ -147,6 +147,7 @@ void PredictiveTimeTest2::testPredictedTimeGpsFeed() {
           dt.millisecond = (int16_t) atoiOffsetLenSafe(utcTimeStr, 7, 3);
 
           GpsSample sample;
+          memset(&sample, 0, sizeof(sample));
           sample.quality = GPS_QUALITY_3D;
           sample.point.latitude = lat;
           sample.point.longitude = lon;
@@ -0,0 +1,174 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.h"
+#include "api_dispatch_test.h"
+#include "constants.h"
+#include "lookup_table.h"
+#include "mock_serial.h"
+#include "printk.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ApiDispatchTest );
+
+#define BENCHMARK_ROUNDS 20000
+
+/* The full message set, in the same order the firmware declares it */
+static const api_t test_apis[] = SYSTEM_APIS;
+static const size_t test_api_count =
+        sizeof(test_apis) / sizeof(test_apis[0]) - 1;
+
+/* The dispatch we used to do, kept here as the benchmark baseline */
+static const api_t* linear_find_api(const char *name)
+{
+        for (const api_t *api = test_apis; api->cmd; ++api)
+                if (0 == strcmp(api->cmd, name))
+                        return api;
+
+        return NULL;
+}
+
+static double elapsed_ns_per_lookup(const clock_t start, const clock_t end)
+{
+        const double lookups = (double) BENCHMARK_ROUNDS * test_api_count;
+        return (double) (end - start) * 1e9 / CLOCKS_PER_SEC / lookups;
+}
+
+void ApiDispatchTest::setUp()
+{
+        initApi();
+}
+
+void ApiDispatchTest::tearDown() {}
+
+void ApiDispatchTest::lookupTableSortTest()
+{
+        struct entry {
+                const char *name;
+                int value;
+        };
+        const struct entry entries[] = {
+                {"s", 1}, {"hb", 2}, {"getVer", 3}, {"a", 4}, {"zz", 5},
+        };
+        uint8_t index[5];
+        struct lookup_table lt;
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 5,
+                             lookup_table_init(&lt, entries, sizeof(entry),
+                                               5, index));
+
+        /* Index must be in strcmp order */
+        for (size_t i = 1; i < 5; ++i)
+                CPPUNIT_ASSERT(strcmp(entries[index[i - 1]].name,
+                                      entries[index[i]].name) < 0);
+
+        for (size_t i = 0; i < 5; ++i) {
+                const struct entry *e = (const struct entry *)
+                        lookup_table_find(&lt, entries[i].name);
+                CPPUNIT_ASSERT(e != NULL);
+                CPPUNIT_ASSERT_EQUAL(entries[i].value, e->value);
+        }
+
+        CPPUNIT_ASSERT(NULL == lookup_table_find(&lt, "b"));
+        CPPUNIT_ASSERT(NULL == lookup_table_find(&lt, ""));
+        CPPUNIT_ASSERT(NULL == lookup_table_find(&lt, "zzz"));
+}
+
+void ApiDispatchTest::lookupTableFullTest()
+{
+        struct entry {
+                const char *name;
+                int value;
+        };
+        const size_t count = LOOKUP_TABLE_MAX_ENTRIES + 10;
+        static char names[LOOKUP_TABLE_MAX_ENTRIES + 10][8];
+        static struct entry entries[LOOKUP_TABLE_MAX_ENTRIES + 10];
+        uint8_t index[LOOKUP_TABLE_MAX_ENTRIES + 10];
+        struct lookup_table lt;
+
+        for (size_t i = 0; i < count; ++i) {
+                snprintf(names[i], sizeof(names[i]), "e%03u", (unsigned) i);
+                entries[i].name = names[i];
+                entries[i].value = (int) i;
+        }
+
+        Serial *serial = getMockSerial();
+        read_log_to_serial(serial, 0);
+        mock_resetTxBuffer();
+
+        /* Those past the limit are left out, and it says so */
+        CPPUNIT_ASSERT_EQUAL((size_t) LOOKUP_TABLE_MAX_ENTRIES,
+                             lookup_table_init(&lt, entries, sizeof(entry),
+                                               count, index));
+        CPPUNIT_ASSERT(lookup_table_find(&lt, names[0]) != NULL);
+        CPPUNIT_ASSERT(NULL == lookup_table_find(&lt, names[count - 1]));
+
+        read_log_to_serial(serial, 0);
+        CPPUNIT_ASSERT(strstr(mock_getTxBuffer(),
+                              "lookup table: too many entries, "
+                              "not indexing: 10") != NULL);
+}
+
+void ApiDispatchTest::findAllApisTest()
+{
+        for (size_t i = 0; i < test_api_count; ++i) {
+                const api_t *api = find_api(test_apis[i].cmd);
+                CPPUNIT_ASSERT(api != NULL);
+                CPPUNIT_ASSERT(0 == strcmp(test_apis[i].cmd, api->cmd));
+                CPPUNIT_ASSERT(test_apis[i].func == api->func);
+        }
+}
+
+void ApiDispatchTest::unknownApiTest()
+{
+        CPPUNIT_ASSERT(NULL == find_api("bogus"));
+        CPPUNIT_ASSERT(NULL == find_api(""));
+        CPPUNIT_ASSERT(NULL == find_api("getVe"));
+        CPPUNIT_ASSERT(NULL == find_api("getVerX"));
+}
+
+void ApiDispatchTest::dispatchBenchmark()
+{
+        volatile size_t found = 0;
+
+        clock_t start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r)
+                for (size_t i = 0; i < test_api_count; ++i)
+                        found += NULL != linear_find_api(test_apis[i].cmd);
+        const double linear_ns = elapsed_ns_per_lookup(start, clock());
+
+        start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r)
+                for (size_t i = 0; i < test_api_count; ++i)
+                        found += NULL != find_api(test_apis[i].cmd);
+        const double indexed_ns = elapsed_ns_per_lookup(start, clock());
+
+        printf("\r\nAPI dispatch (%u messages): linear %.1fns, "
+               "indexed %.1fns per lookup\r\n",
+               (unsigned) test_api_count, linear_ns, indexed_ns);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 2 * BENCHMARK_ROUNDS * test_api_count,
+                             (size_t) found);
+}
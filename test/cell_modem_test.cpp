@@ -0,0 +1,321 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cellModem.h"
+#include "cell_modem_test.h"
+#include "devices_common.h"
+#include "fake_modem.h"
+#include "loggerConfig.h"
+#include "sim900.h"
+#include "sim900_mock.h"
+#include "task_testing.h"
+#include "taskUtil.h"
+
+#include <string.h>
+#include <vector>
+
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CellModemTest );
+
+/* How often the connectivity task steps the bring-up */
+#define STEP_MS		10
+#define BUFFER_SIZE	1025
+
+static char buffer[BUFFER_SIZE];
+static DeviceConfig device;
+static ConnectivityConfig saved_config;
+static size_t now_ms;
+static size_t steps;
+
+static const struct fake_modem_line hang_up[] = {
+        {"+++", NULL, 0},
+        {"AT+CIPCLOSE", "\r\nERROR\r\n", 100},
+};
+
+static const struct fake_modem_line provision[] = {
+        {"ATZ", "\r\nOK\r\n", 100},
+        /* Echo is still on for this one */
+        {"ATE0", "ATE0\r\r\nOK\r\n", 100},
+        {"AT+CIPSHUT", "\r\nSHUT OK\r\n", 300},
+        /* Still searching.  Ask again */
+        {"AT+CREG?", "\r\n+CREG: 0,2\r\n\r\nOK\r\n", 100},
+        {"AT+CREG?", "\r\n+CREG: 0,1\r\n\r\nOK\r\n", 100},
+        {"AT+CSQ", "\r\n+CSQ: 17,0\r\n\r\nOK\r\n", 100},
+        {"AT+CNUM", "\r\n+CNUM: \"\",\"15551234567\",129,7,4\r\n\r\nOK\r\n", 100},
+        {"AT+GSN", "\r\n013949004580931\r\n\r\nOK\r\n", 100},
+        {"AT+CGATT?", "\r\n+CGATT: 1\r\n\r\nOK\r\n", 100},
+        {"AT+CIPMUX=0", "\r\nOK\r\n", 100},
+        {"AT+CIPMODE=1", "\r\nOK\r\n", 100},
+        {"AT+CSTT=\"apn.example.com\",\"user\",\"secret\"", "\r\nOK\r\n", 100},
+        {"AT+CIICR", "\r\nOK\r\n", 3000},
+        {"AT+CIFSR", "\r\n10.64.1.2\r\n", 200},
+        {"AT+CDNSCFG=\"8.8.8.8\",\"8.8.4.4\"", "\r\nOK\r\n", 100},
+        {"AT+CIPSTART=\"TCP\",\"telemetry.example.com\",\"8080\"", "\r\nOK\r\n", 100},
+        {NULL, "\r\nCONNECT\r\n", 2000},
+};
+
+static const struct fake_modem_line auth_ok[] = {
+        {"{\"auth\":*", "{\"status\":\"ok\"}\r\n", 500},
+};
+
+static vector<struct fake_modem_line> script;
+
+static void add(const struct fake_modem_line *lines, size_t count)
+{
+        script.insert(script.end(), lines, lines + count);
+}
+
+#define ADD(lines) add(lines, sizeof(lines) / sizeof(lines[0]))
+
+/* Swaps the line for the given command for another */
+static void replace(const char *cmd, const struct fake_modem_line &line)
+{
+        for (size_t i = 0; i < script.size(); ++i)
+                if (script[i].cmd && 0 == strcmp(cmd, script[i].cmd))
+                        script[i] = line;
+}
+
+static void start_script(void)
+{
+        fake_modem_init(script.data(), script.size());
+}
+
+/*
+ * Steps the connection like the connectivity task would, moving the
+ * clock along in between, until it is up or gives up.
+ */
+static int run(const size_t max_ms)
+{
+        const size_t end = now_ms + max_ms;
+        steps = 0;
+
+        for (; now_ms < end; now_ms += STEP_MS) {
+                set_ticks(msToTicks(now_ms));
+                ++steps;
+                const int res = sim900_init_connection(&device);
+                if (DEVICE_INIT_PENDING != res)
+                        return res;
+        }
+        return DEVICE_INIT_PENDING;
+}
+
+static void assert_script_played(void)
+{
+        const char *error = fake_modem_error();
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(error ? error : "", (const char *) NULL, error);
+        CPPUNIT_ASSERT(fake_modem_done());
+}
+
+void CellModemTest::setUp()
+{
+        ConnectivityConfig *cc = &getWorkingLoggerConfig()->ConnectivityConfigs;
+        saved_config = *cc;
+        strcpy(cc->cellularConfig.apnHost, "apn.example.com");
+        strcpy(cc->cellularConfig.apnUser, "user");
+        strcpy(cc->cellularConfig.apnPass, "secret");
+        strcpy(cc->telemetryConfig.telemetryServerHost, "telemetry.example.com");
+        strcpy(cc->telemetryConfig.telemetryDeviceId, "abc123");
+
+        script.clear();
+        fake_modem_init(NULL, 0);
+        device.serial = fake_modem_get_serial();
+        device.buffer = buffer;
+        device.length = BUFFER_SIZE;
+        now_ms = 0;
+        set_ticks(0);
+}
+
+void CellModemTest::tearDown()
+{
+        getWorkingLoggerConfig()->ConnectivityConfigs = saved_config;
+        reset_ticks();
+}
+
+void CellModemTest::connectTest()
+{
+        ADD(hang_up);
+        ADD(provision);
+        ADD(auth_ok);
+        start_script();
+
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_SUCCESS, run(60000));
+        assert_script_played();
+        CPPUNIT_ASSERT_EQUAL(TELEMETRY_STATUS_CONNECTED,
+                             sim900_get_connection_status());
+        CPPUNIT_ASSERT_EQUAL(CELLMODEM_STATUS_PROVISIONED,
+                             cellmodem_get_status());
+        CPPUNIT_ASSERT_EQUAL(17, cell_get_signal_strength());
+        CPPUNIT_ASSERT_EQUAL(std::string("15551234567"),
+                             std::string(cell_get_subscriber_number()));
+        CPPUNIT_ASSERT_EQUAL(std::string("013949004580931"),
+                             std::string(cell_get_IMEI()));
+
+        /*
+         * The bring-up took many seconds of modem time, but came to us in
+         * small steps that never waited.  The guard times, the pauses
+         * between commands and the registration retry are all honoured.
+         */
+        CPPUNIT_ASSERT(steps > 1000);
+        CPPUNIT_ASSERT(now_ms > 2 * 1100 + 18 * 500 + 1000 + 3000 + 2000);
+        CPPUNIT_ASSERT(now_ms < 30000);
+
+        /* The server woke up to our linefeeds before it got the auth */
+        const char *sent = fake_modem_sent();
+        CPPUNIT_ASSERT(strstr(sent, "\r     {\"auth\":{\"deviceId\":\"abc123\"") != NULL);
+}
+
+void CellModemTest::powerCycleTest()
+{
+        /* The modem is on, but refuses to reset.  Turn it off and on */
+        static const struct fake_modem_line refuse[] = {
+                {"ATZ", "\r\nERROR\r\n", 100},
+                {"ATZ", "\r\nERROR\r\n", 100},
+                {"+++", NULL, 0},
+                {"AT+CIPCLOSE", "\r\nERROR\r\n", 100},
+                {"AT", "\r\nOK\r\n", 100},
+        };
+        ADD(hang_up);
+        ADD(refuse);
+        ADD(provision);
+        ADD(auth_ok);
+        start_script();
+
+        const unsigned int presses = sim900_mock_power_presses();
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_SUCCESS, run(60000));
+        assert_script_played();
+        CPPUNIT_ASSERT_EQUAL(presses + 2, sim900_mock_power_presses());
+}
+
+void CellModemTest::poweredOffTest()
+{
+        /* Nobody home.  One press turns it on */
+        static const struct fake_modem_line silent[] = {
+                {"ATZ", NULL, 0},
+                {"ATZ", NULL, 0},
+                {"+++", NULL, 0},
+                {"AT+CIPCLOSE", NULL, 0},
+                {"AT", NULL, 0},
+        };
+        ADD(hang_up);
+        ADD(silent);
+        ADD(provision);
+        ADD(auth_ok);
+        start_script();
+
+        const unsigned int presses = sim900_mock_power_presses();
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_SUCCESS, run(60000));
+        assert_script_played();
+        CPPUNIT_ASSERT_EQUAL(presses + 1, sim900_mock_power_presses());
+}
+
+void CellModemTest::connectFailTest()
+{
+        /* Everything but the server is fine */
+        ADD(hang_up);
+        add(provision, sizeof(provision) / sizeof(provision[0]) - 1);
+        static const struct fake_modem_line refused[] = {
+                {NULL, "\r\nCONNECT FAIL\r\n", 3000},
+        };
+        ADD(refused);
+        /* The next try starts over from the top */
+        ADD(hang_up);
+        /* Until we give up on it */
+        static const struct fake_modem_line disconnect[] = {
+                {"+++", NULL, 0},
+                {"AT+CIPCLOSE", "\r\nOK\r\n", 0},
+        };
+        ADD(disconnect);
+        start_script();
+
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_FAIL, run(60000));
+        CPPUNIT_ASSERT_EQUAL(TELEMETRY_STATUS_SERVER_CONNECTION_FAILED,
+                             sim900_get_connection_status());
+
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_PENDING, run(2500));
+        sim900_disconnect(&device);
+        assert_script_played();
+        CPPUNIT_ASSERT_EQUAL(TELEMETRY_STATUS_IDLE,
+                             sim900_get_connection_status());
+}
+
+void CellModemTest::authTimeoutTest()
+{
+        ADD(hang_up);
+        ADD(provision);
+        static const struct fake_modem_line no_auth[] = {
+                {"{\"auth\":*", NULL, 0},
+        };
+        ADD(no_auth);
+        start_script();
+
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_FAIL, run(60000));
+        assert_script_played();
+        CPPUNIT_ASSERT_EQUAL(TELEMETRY_STATUS_REJECTED_DEVICE_ID,
+                             sim900_get_connection_status());
+}
+
+void CellModemTest::udpConnectTest()
+{
+        getWorkingLoggerConfig()->ConnectivityConfigs.telemetryConfig.udpMode =
+                TELEMETRY_UDP_ENABLED;
+
+        ADD(hang_up);
+        ADD(provision);
+        /* One send at a time, to a UDP "connection" */
+        const struct fake_modem_line mode = {"AT+CIPMODE=0", "\r\nOK\r\n", 100};
+        replace("AT+CIPMODE=1", mode);
+        const struct fake_modem_line start = {
+                "AT+CIPSTART=\"UDP\",\"telemetry.example.com\",\"8080\"",
+                "\r\nOK\r\n", 100};
+        replace("AT+CIPSTART=\"TCP\",\"telemetry.example.com\",\"8080\"", start);
+        script.back().rsp = "\r\nCONNECT OK\r\n";
+        /* The first auth gets lost.  The second one makes it */
+        static const struct fake_modem_line auth[] = {
+                {"AT+CIPSEND", "> ", 0},
+                {"{\"auth\":*", "\r\nSEND OK\r\n", 100},
+                {"AT+CIPSEND", "> ", 0},
+                {"{\"auth\":*", "\r\nSEND OK\r\n{\"status\":\"ok\"}\r\n", 500},
+        };
+        ADD(auth);
+        start_script();
+
+        device.datagram = false;
+        CPPUNIT_ASSERT_EQUAL(DEVICE_INIT_SUCCESS, run(60000));
+        assert_script_played();
+        CPPUNIT_ASSERT(device.datagram);
+
+        /* No wake up spaces, and each auth is a datagram of its own */
+        const char *sent = fake_modem_sent();
+        CPPUNIT_ASSERT(strstr(sent, "AT+CIPSEND\r{\"auth\":") != NULL);
+        CPPUNIT_ASSERT(strstr(sent, "}}\n\x1a") != NULL);
+
+        /* Telemetry goes out the same way */
+        static const struct fake_modem_line sample[] = {
+                {"AT+CIPSEND", "> ", 0},
+                {"{\"u\":{\"seq\":0}}", NULL, 0},
+        };
+        fake_modem_init(sample, 2);
+        CPPUNIT_ASSERT_EQUAL(0, sim900_begin_datagram(&device));
+        device.serial->put_s("{\"u\":{\"seq\":0}}");
+        sim900_end_datagram(&device);
+        assert_script_played();
+}
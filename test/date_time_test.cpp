@@ -24,6 +24,7 @@
 #include "date_time_test.h"
 #include "gps.h"
 #include "gps.testing.h"
+#include "mod_string.h"
 #include "task.h"
 #include "task_testing.h"
 #include "serial.h"
@@ -234,6 +235,7 @@ void DateTimeTest::testMillisSinceEpoch() {
   const DateTime d448366080000 = {0, 0, 8, 10, 17, 3, 1984};
 
   GpsSample sample;
+  memset(&sample, 0, sizeof(sample));
   sample.quality = GPS_QUALITY_3D;
   sample.time = getMillisecondsSinceUnixEpoch(d448366080000);
   GPS_sample_update(&sample);
@@ -246,6 +248,47 @@ void DateTimeTest::testMillisSinceEpoch() {
   CPPUNIT_ASSERT_EQUAL( (millis_t) 448366080000ll + 1 * MS_PER_TICK, getMillisSinceEpoch());
 }
 
+void DateTimeTest::testMillisSinceEpochLatency() {
+  const millis_t fixTime = 448366080000ll;
+  GpsSample sample;
+  memset(&sample, 0, sizeof(sample));
+  sample.quality = GPS_QUALITY_3D;
+
+  // The first byte of the fix came in 2 ticks before we got to process it.
+  set_ticks(10);
+  sample.time = fixTime;
+  sample.uptime = 8 * MS_PER_TICK;
+  GPS_sample_update(&sample);
+
+  CPPUNIT_ASSERT_EQUAL(8 * MS_PER_TICK, (int) getUptimeAtSample());
+  CPPUNIT_ASSERT_EQUAL(fixTime + 2 * MS_PER_TICK, getMillisSinceEpoch());
+
+  set_ticks(20);
+  sample.time = fixTime + 10 * MS_PER_TICK;
+  sample.uptime = 19 * MS_PER_TICK;
+  GPS_sample_update(&sample);
+  CPPUNIT_ASSERT_EQUAL(fixTime + 11 * MS_PER_TICK, getMillisSinceEpoch());
+
+  GpsLatencyStats stats = GPS_getLatencyStats();
+  CPPUNIT_ASSERT_EQUAL(2, (int) stats.count);
+  CPPUNIT_ASSERT_EQUAL(1 * MS_PER_TICK, (int) stats.last);
+  CPPUNIT_ASSERT_EQUAL(1 * MS_PER_TICK, (int) stats.min);
+  CPPUNIT_ASSERT_EQUAL(2 * MS_PER_TICK, (int) stats.max);
+  CPPUNIT_ASSERT_EQUAL(3 * MS_PER_TICK / 2, GPS_getAverageLatency());
+
+  // A driver that does not know.  Anchored at processing, as before.
+  set_ticks(30);
+  sample.time = fixTime + 20 * MS_PER_TICK;
+  sample.uptime = 0;
+  GPS_sample_update(&sample);
+  CPPUNIT_ASSERT_EQUAL(fixTime + 20 * MS_PER_TICK, getMillisSinceEpoch());
+  CPPUNIT_ASSERT_EQUAL(2, (int) GPS_getLatencyStats().count);
+
+  GPS_init(10, get_serial(SERIAL_GPS));
+  CPPUNIT_ASSERT_EQUAL(0, (int) GPS_getLatencyStats().count);
+  CPPUNIT_ASSERT_EQUAL(0, GPS_getAverageLatency());
+}
+
 void DateTimeTest::testDateTimeFromEpochMillis(){
     DateTime dt;
 
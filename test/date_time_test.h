@@ -37,6 +37,7 @@ class DateTimeTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testGetDeltaInMillis );
     CPPUNIT_TEST( testUptime );
     CPPUNIT_TEST( testMillisSinceEpoch );
+    CPPUNIT_TEST( testMillisSinceEpochLatency );
     CPPUNIT_TEST( testDateTimeFromEpochMillis );
     CPPUNIT_TEST_SUITE_END();
 
@@ -54,6 +55,7 @@ public:
     void testTinyMillisToSeconds();
     void testUptime();
     void testMillisSinceEpoch();
+    void testMillisSinceEpochLatency();
     void testDateTimeFromEpochMillis();
 };
 
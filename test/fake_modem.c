@@ -0,0 +1,225 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "fake_modem.h"
+#include "serial.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CMD_SIZE	256
+#define SENT_SIZE	16384
+#define ERROR_SIZE	512
+#define CTRL_Z		0x1a
+
+static Serial g_serial;
+
+static struct {
+        const struct fake_modem_line *script;
+        size_t count;
+        /* Next line of the script */
+        size_t pos;
+        char cmd[CMD_SIZE];
+        size_t cmd_len;
+        char sent[SENT_SIZE];
+        size_t sent_len;
+        /* The answer on its way, if any */
+        const char *rsp;
+        portTickType rsp_due;
+        char error[ERROR_SIZE];
+} g_modem;
+
+static portTickType due_in(const size_t ms)
+{
+        return xTaskGetTickCount() + ms / portTICK_RATE_MS;
+}
+
+static void set_error(const char *expected, const char *got)
+{
+        if (g_modem.error[0])
+                return;
+
+        snprintf(g_modem.error, sizeof(g_modem.error),
+                 "line %u: expected '%s' got '%s'", (unsigned) g_modem.pos,
+                 expected ? expected : "nothing", got);
+}
+
+/* Lines the modem says on its own go out after the previous answer */
+static void pump(void)
+{
+        if (g_modem.rsp || g_modem.error[0] || g_modem.pos >= g_modem.count)
+                return;
+
+        const struct fake_modem_line *line = g_modem.script + g_modem.pos;
+        if (line->cmd)
+                return;
+
+        g_modem.rsp = line->rsp;
+        g_modem.rsp_due = due_in(line->delay_ms);
+        ++g_modem.pos;
+}
+
+static bool matches(const char *expected, const char *cmd)
+{
+        const size_t len = strlen(expected);
+        if (len && '*' == expected[len - 1])
+                return 0 == strncmp(expected, cmd, len - 1);
+
+        return 0 == strcmp(expected, cmd);
+}
+
+static void command_done(void)
+{
+        g_modem.cmd[g_modem.cmd_len] = '\0';
+        g_modem.cmd_len = 0;
+
+        if (g_modem.error[0])
+                return;
+
+        const struct fake_modem_line *line = g_modem.pos < g_modem.count ?
+                g_modem.script + g_modem.pos : NULL;
+        if (!line || !line->cmd || !matches(line->cmd, g_modem.cmd)) {
+                set_error(line ? line->cmd : NULL, g_modem.cmd);
+                return;
+        }
+
+        /* A new command.  Whatever was not read of the last answer is gone */
+        g_modem.rsp = line->rsp;
+        g_modem.rsp_due = due_in(line->delay_ms);
+        ++g_modem.pos;
+}
+
+static void fake_put_c(char c)
+{
+        if (g_modem.sent_len < SENT_SIZE - 1) {
+                g_modem.sent[g_modem.sent_len++] = c;
+                g_modem.sent[g_modem.sent_len] = '\0';
+        }
+
+        if ('\r' == c || '\n' == c || CTRL_Z == c) {
+                if (g_modem.cmd_len)
+                        command_done();
+                return;
+        }
+
+        if (' ' == c && !g_modem.cmd_len)
+                return;
+
+        if (g_modem.cmd_len < CMD_SIZE - 1)
+                g_modem.cmd[g_modem.cmd_len++] = c;
+
+        if (3 == g_modem.cmd_len && 0 == strncmp(g_modem.cmd, "+++", 3))
+                command_done();
+}
+
+static void fake_put_s(const char *s)
+{
+        while (*s)
+                fake_put_c(*s++);
+}
+
+static int fake_get_c_wait(char *c, size_t delay)
+{
+        pump();
+        if (!g_modem.rsp || xTaskGetTickCount() < g_modem.rsp_due)
+                return 0;
+
+        *c = *g_modem.rsp++;
+        if (!*g_modem.rsp) {
+                g_modem.rsp = NULL;
+                pump();
+        }
+        return 1;
+}
+
+static char fake_get_c(void)
+{
+        char c = 0;
+        fake_get_c_wait(&c, 0);
+        return c;
+}
+
+static int fake_get_line_wait(char *s, int len, size_t delay)
+{
+        int count = 0;
+        char c;
+        while (count < len - 1 && fake_get_c_wait(&c, delay)) {
+                s[count++] = c;
+                if ('\n' == c)
+                        break;
+        }
+        s[count] = '\0';
+        return count;
+}
+
+static int fake_get_line(char *s, int len)
+{
+        return fake_get_line_wait(s, len, 0);
+}
+
+/* Drops what has arrived.  What is still on its way will arrive */
+static void fake_flush(void)
+{
+        if (g_modem.rsp && xTaskGetTickCount() >= g_modem.rsp_due)
+                g_modem.rsp = NULL;
+}
+
+void fake_modem_init(const struct fake_modem_line *script, size_t count)
+{
+        memset(&g_modem, 0, sizeof(g_modem));
+        g_modem.script = script;
+        g_modem.count = count;
+
+        g_serial.get_c_wait = fake_get_c_wait;
+        g_serial.get_c = fake_get_c;
+        g_serial.get_line = fake_get_line;
+        g_serial.get_line_wait = fake_get_line_wait;
+        g_serial.put_c = fake_put_c;
+        g_serial.put_s = fake_put_s;
+        g_serial.flush = fake_flush;
+}
+
+Serial * fake_modem_get_serial(void)
+{
+        return &g_serial;
+}
+
+bool fake_modem_done(void)
+{
+        pump();
+        /* The line end after the last answer may not have been read yet */
+        return g_modem.pos >= g_modem.count &&
+                (!g_modem.rsp || !g_modem.rsp[strspn(g_modem.rsp, "\r\n")]);
+}
+
+const char * fake_modem_error(void)
+{
+        return g_modem.error[0] ? g_modem.error : NULL;
+}
+
+const char * fake_modem_sent(void)
+{
+        return g_modem.sent;
+}
@@ -0,0 +1,80 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FAKE_MODEM_H_
+#define _FAKE_MODEM_H_
+
+#include "serial.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A scripted modem on the other end of a Serial.  It plays back an AT
+ * transcript: it checks that each command the device sends is the one the
+ * script expects next and answers it the way the script says, once the
+ * given delay has passed.  Time is the FreeRTOS tick count, which the
+ * test moves along with set_ticks.
+ *
+ * Commands end at a CR or LF, the Ctrl-Z that ends the data of a send,
+ * or with "+++".  Spaces and line ends between commands are ignored.
+ */
+
+struct fake_modem_line {
+        /*
+         * The command the device must send next, without the CR.  A
+         * trailing '*' matches anything.  NULL for something the modem
+         * says on its own after the previous answer.
+         */
+        const char *cmd;
+        /* The answer, or NULL for none */
+        const char *rsp;
+        /* How long the modem takes to answer, in ms */
+        size_t delay_ms;
+};
+
+/**
+ * Loads a script and resets the modem.  The script must stay around.
+ */
+void fake_modem_init(const struct fake_modem_line *script, size_t count);
+
+/**
+ * @return The Serial the device talks to the modem through.
+ */
+Serial * fake_modem_get_serial(void);
+
+/**
+ * @return true once every line of the script has been played.
+ */
+bool fake_modem_done(void);
+
+/**
+ * @return A description of the first thing the device did that the
+ * script did not expect, or NULL if there was none.
+ */
+const char * fake_modem_error(void);
+
+/**
+ * @return Everything the device sent since fake_modem_init.
+ */
+const char * fake_modem_sent(void);
+
+#endif /* _FAKE_MODEM_H_ */
@@ -0,0 +1,332 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fast_lap_store.h"
+#include "fast_lap_store_test.h"
+#include "ff.h"
+#include "fnv.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "mod_string.h"
+#include "predictive_timer_2.h"
+#include "track_map.h"
+#include "tracks.h"
+
+#include <math.h>
+#include <vector>
+
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( FastLapStoreTest );
+
+#define TRACK_ID	1234
+#define TRACK_HASH	0xfeedbeef
+#define LAP_RADIUS_M	300.0
+#define LAP_FIXES	630
+#define FIX_INTERVAL_MS	100
+
+static const double center_lat = 47.8;
+static const double center_lon = -122.34;
+
+/* Round and round a circle, a bit slower at the top */
+static GeoPoint lap_point(const double angle)
+{
+        const double m_per_deg = GP_EARTH_RADIUS_M * M_PI / 180;
+        const double lat = center_lat + LAP_RADIUS_M * sin(angle) / m_per_deg;
+        const double lon = center_lon + LAP_RADIUS_M * cos(angle) /
+                (m_per_deg * cos(center_lat * M_PI / 180));
+        const GeoPoint gp = { GP_DEGREES(lat), GP_DEGREES(lon) };
+        return gp;
+}
+
+static double lap_angle(const int fix)
+{
+        const double a = 2 * M_PI * fix / LAP_FIXES;
+        return a + 0.2 * sin(a);
+}
+
+/* Drives one lap with the timer, ending at the given time */
+static bool drive_lap(const tiny_millis_t lap_time)
+{
+        const GeoPoint start = lap_point(0);
+        startLap(&start, 0);
+
+        for (int i = 1; i < LAP_FIXES; ++i) {
+                GpsSnapshot snap;
+                memset(&snap, 0, sizeof(snap));
+                snap.sample.point = lap_point(lap_angle(i));
+                snap.deltaFirstFix = (tiny_millis_t) i * lap_time / LAP_FIXES;
+                addGpsSample(&snap);
+        }
+
+        return finishLap(&start, lap_time);
+}
+
+/* The predicted times a quarter of the way round the next lap */
+static vector<tiny_millis_t> predictions(void)
+{
+        vector<tiny_millis_t> p;
+        const GeoPoint start = lap_point(0);
+        startLap(&start, 0);
+
+        for (int i = 1; i < LAP_FIXES / 4; ++i) {
+                const GeoPoint gp = lap_point(lap_angle(i));
+                p.push_back(getPredictedTime(&gp, i * FIX_INTERVAL_MS));
+        }
+
+        return p;
+}
+
+void FastLapStoreTest::setUp()
+{
+        /* Lap stats asks for a load whenever it picks a track */
+        fast_lap_store_sync(false);
+        fast_lap_store_apply();
+        resetPredictiveTimer();
+        track_map_reset();
+}
+
+void FastLapStoreTest::roundTripTest()
+{
+        uint8_t buf[FAST_LAP_SAVE_SIZE];
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, saveFastLap(TRACK_ID, TRACK_HASH, buf,
+                                                     sizeof(buf)));
+
+        CPPUNIT_ASSERT(drive_lap(LAP_FIXES * FIX_INTERVAL_MS));
+        CPPUNIT_ASSERT(drive_lap(LAP_FIXES * FIX_INTERVAL_MS));
+        const size_t len = saveFastLap(TRACK_ID, TRACK_HASH, buf, sizeof(buf));
+        CPPUNIT_ASSERT(len > 0);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, saveFastLap(TRACK_ID, TRACK_HASH, buf,
+                                                     len - 1));
+        const vector<tiny_millis_t> before = predictions();
+
+        /* A power cycle */
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(!isPredictiveTimeAvailable());
+        CPPUNIT_ASSERT(loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+        CPPUNIT_ASSERT(isPredictiveTimeAvailable());
+
+        const vector<tiny_millis_t> after = predictions();
+        CPPUNIT_ASSERT_EQUAL(before.size(), after.size());
+        for (size_t i = 0; i < before.size(); ++i)
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(before[i], after[i], 5);
+}
+
+void FastLapStoreTest::staleTest()
+{
+        uint8_t buf[FAST_LAP_SAVE_SIZE];
+        drive_lap(LAP_FIXES * FIX_INTERVAL_MS);
+        const size_t len = saveFastLap(TRACK_ID, TRACK_HASH, buf, sizeof(buf));
+        resetPredictiveTimer();
+
+        /* Another track, or the same one since changed */
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID + 1, TRACK_HASH, buf, len));
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID, TRACK_HASH + 1, buf, len));
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID, TRACK_HASH, buf, len - 1));
+
+        /* Another version */
+        ++buf[4];
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+        --buf[4];
+
+        /* Corrupt */
+        buf[len / 2] ^= 1;
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+        buf[len / 2] ^= 1;
+
+        CPPUNIT_ASSERT(!isPredictiveTimeAvailable());
+        CPPUNIT_ASSERT(loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+}
+
+void FastLapStoreTest::slowerTest()
+{
+        uint8_t buf[FAST_LAP_SAVE_SIZE];
+        drive_lap(LAP_FIXES * FIX_INTERVAL_MS);
+        const size_t len = saveFastLap(TRACK_ID, TRACK_HASH, buf, sizeof(buf));
+
+        /* Today's lap is faster than the one saved */
+        resetPredictiveTimer();
+        drive_lap(LAP_FIXES * FIX_INTERVAL_MS - 1000);
+        CPPUNIT_ASSERT(!loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+
+        /* And slower */
+        resetPredictiveTimer();
+        drive_lap(LAP_FIXES * FIX_INTERVAL_MS + 1000);
+        CPPUNIT_ASSERT(loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+}
+
+static uint16_t get_u16(const uint8_t *b)
+{
+        return b[0] | b[1] << 8;
+}
+
+static void put_u16(vector<uint8_t> &v, const uint16_t val)
+{
+        v.push_back(val & 0xff);
+        v.push_back(val >> 8);
+}
+
+/* Splits each step of a saved lap, as if a unit with more room saved it */
+static vector<uint8_t> split_points(const uint8_t *buf, const size_t len,
+                                    const int parts)
+{
+        const size_t header = 28;
+        const uint16_t count = (get_u16(buf + 6) - 1) * parts + 1;
+        vector<uint8_t> v(buf, buf + header);
+        v[6] = count & 0xff;
+        v[7] = count >> 8;
+
+        for (const uint8_t *b = buf + header; b < buf + len - 4; b += 6) {
+                for (int p = 0; p < parts; ++p) {
+                        for (int i = 0; i < 3; ++i) {
+                                const int d = (int16_t) get_u16(b + 2 * i);
+                                put_u16(v, (uint16_t) (d * (p + 1) / parts -
+                                                       d * p / parts));
+                        }
+                }
+        }
+
+        const uint32_t hash = fnv1a_32(FNV1A_32_INIT, &v[0], v.size());
+        for (int i = 0; i < 4; ++i)
+                v.push_back(hash >> 8 * i);
+
+        return v;
+}
+
+/* Points in the lap saved after loading buf and driving a faster one */
+static int points_after_load(const uint8_t *buf, const size_t len)
+{
+        uint8_t next[FAST_LAP_SAVE_SIZE];
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(loadFastLap(TRACK_ID, TRACK_HASH, buf, len));
+        CPPUNIT_ASSERT(drive_lap(LAP_FIXES * FIX_INTERVAL_MS - 1000));
+        CPPUNIT_ASSERT(saveFastLap(TRACK_ID, TRACK_HASH, next, sizeof(next)));
+        return get_u16(next + 6);
+}
+
+void FastLapStoreTest::morePointsTest()
+{
+        uint8_t buf[FAST_LAP_SAVE_SIZE];
+        CPPUNIT_ASSERT(drive_lap(LAP_FIXES * FIX_INTERVAL_MS));
+        CPPUNIT_ASSERT(drive_lap(LAP_FIXES * FIX_INTERVAL_MS));
+        const size_t len = saveFastLap(TRACK_ID, TRACK_HASH, buf, sizeof(buf));
+        CPPUNIT_ASSERT(len > 0);
+        const vector<tiny_millis_t> before = predictions();
+
+        /* Far more than we keep.  Only some of the points are loaded */
+        const int steps = (len - 32) / 6;
+        vector<uint8_t> more = split_points(buf, len, UINT16_MAX / steps);
+        CPPUNIT_ASSERT(more.size() > (size_t) FAST_LAP_SAVE_SIZE);
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(loadFastLap(TRACK_ID, TRACK_HASH, &more[0],
+                                   more.size()));
+
+        const vector<tiny_millis_t> after = predictions();
+        CPPUNIT_ASSERT_EQUAL(before.size(), after.size());
+        for (size_t i = 0; i < before.size(); ++i)
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(before[i], after[i], 5);
+
+        /* The lap is as long either way, so the next is sampled as often */
+        const int points = points_after_load(buf, len);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(points,
+                                     points_after_load(&more[0], more.size()), 2);
+}
+
+void FastLapStoreTest::storeTest()
+{
+        Track track;
+        memset(&track, 0, sizeof(track));
+        track.trackId = 0x1234abcd;
+        track.track_type = TRACK_TYPE_CIRCUIT;
+        track.circuit.startFinish = lap_point(0);
+        const char *name = fast_lap_store_file_name(&track);
+        CPPUNIT_ASSERT_EQUAL(std::string("1234ABCD.LAP"), std::string(name));
+        f_unlink(name);
+
+        /* Nothing saved yet */
+        CPPUNIT_ASSERT(fast_lap_store_load(&track));
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(false));
+        CPPUNIT_ASSERT(!fast_lap_store_apply());
+
+        drive_lap(LAP_FIXES * FIX_INTERVAL_MS);
+        CPPUNIT_ASSERT(fast_lap_store_save(&track));
+        /* Only one request at a time */
+        CPPUNIT_ASSERT(!fast_lap_store_load(&track));
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(false));
+
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(fast_lap_store_load(&track));
+        CPPUNIT_ASSERT(!fast_lap_store_apply());
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(true));
+        CPPUNIT_ASSERT(fast_lap_store_apply());
+        CPPUNIT_ASSERT(isPredictiveTimeAvailable());
+
+        /* The start line moved.  What was saved is of no use */
+        resetPredictiveTimer();
+        track.circuit.startFinish.latitude += 100;
+        CPPUNIT_ASSERT(fast_lap_store_load(&track));
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(false));
+        CPPUNIT_ASSERT(!fast_lap_store_apply());
+        CPPUNIT_ASSERT(!isPredictiveTimeAvailable());
+
+        f_unlink(name);
+}
+
+/* The track outline goes along with the fast lap */
+void FastLapStoreTest::mapStoreTest()
+{
+        Track track;
+        memset(&track, 0, sizeof(track));
+        track.trackId = 0x1234abce;
+        track.track_type = TRACK_TYPE_CIRCUIT;
+        track.circuit.startFinish = lap_point(0);
+        const char *map_name = fast_lap_store_map_file_name(&track);
+        CPPUNIT_ASSERT_EQUAL(std::string("1234ABCE.MAP"),
+                             std::string(map_name));
+        f_unlink(map_name);
+        f_unlink(fast_lap_store_file_name(&track));
+
+        const GeoPoint start = lap_point(0);
+        track_map_start_lap(&start);
+        for (int i = 1; i < LAP_FIXES; ++i) {
+                GpsSnapshot snap;
+                memset(&snap, 0, sizeof(snap));
+                snap.sample.point = lap_point(lap_angle(i));
+                snap.deltaFirstFix = i * FIX_INTERVAL_MS;
+                track_map_update(&snap);
+        }
+        CPPUNIT_ASSERT(track_map_finish_lap(&start));
+        const size_t count = track_map_count();
+
+        /* No fast lap to go with it.  The outline is saved on its own */
+        CPPUNIT_ASSERT(fast_lap_store_save(&track));
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(false));
+
+        track_map_reset();
+        CPPUNIT_ASSERT(fast_lap_store_load(&track));
+        CPPUNIT_ASSERT_EQUAL(0, fast_lap_store_sync(false));
+        CPPUNIT_ASSERT(fast_lap_store_apply());
+        CPPUNIT_ASSERT(track_map_available());
+        CPPUNIT_ASSERT(!isPredictiveTimeAvailable());
+        CPPUNIT_ASSERT_EQUAL(count, track_map_count());
+
+        f_unlink(map_name);
+}
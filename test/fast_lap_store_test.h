@@ -0,0 +1,48 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FAST_LAP_STORE_TEST_H_
+#define _FAST_LAP_STORE_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class FastLapStoreTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( FastLapStoreTest );
+        CPPUNIT_TEST( roundTripTest );
+        CPPUNIT_TEST( staleTest );
+        CPPUNIT_TEST( slowerTest );
+        CPPUNIT_TEST( morePointsTest );
+        CPPUNIT_TEST( storeTest );
+        CPPUNIT_TEST( mapStoreTest );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void roundTripTest();
+        void staleTest();
+        void slowerTest();
+        void morePointsTest();
+        void storeTest();
+        void mapStoreTest();
+};
+
+#endif /* _FAST_LAP_STORE_TEST_H_ */
@@ -31,39 +31,39 @@ void GeoTriggerTest::setUp() {}
 void GeoTriggerTest::tearDown() {}
 
 void GeoTriggerTest::testShouldTrigger() {
-        const GeoPoint gp = { 43.074859, -89.386336 }; // 100 State
+        const GeoPoint gp = { GP_DEGREES(43.074859), GP_DEGREES(-89.386336) }; // 100 State
         const struct GeoCircle gc = gc_createGeoCircle(gp, 10);
         struct GeoTrigger gt = createGeoTrigger(&gc);
 
         CPPUNIT_ASSERT(!isGeoTriggerTripped(&gt));
 
-        const GeoPoint gp2 = { 43.075255, -89.385590 }; // > 10 M from 100 State
+        const GeoPoint gp2 = { GP_DEGREES(43.075255), GP_DEGREES(-89.385590) }; // > 10 M from 100 State
         const bool status = updateGeoTrigger(&gt, &gp2);
         CPPUNIT_ASSERT(status);
         CPPUNIT_ASSERT(isGeoTriggerTripped(&gt));
 }
 
 void GeoTriggerTest::testNoTrigger() {
-        const GeoPoint gp = { 43.074897, -89.386077 }; // 100 State
+        const GeoPoint gp = { GP_DEGREES(43.074897), GP_DEGREES(-89.386077) }; // 100 State
         const struct GeoCircle gc = gc_createGeoCircle(gp, 15);
         struct GeoTrigger gt = createGeoTrigger(&gc);
 
         CPPUNIT_ASSERT(!isGeoTriggerTripped(&gt));
 
-        const GeoPoint gp2 = { 43.074918, -89.386037 }; // < 10 M from 100 State
+        const GeoPoint gp2 = { GP_DEGREES(43.074918), GP_DEGREES(-89.386037) }; // < 10 M from 100 State
         const bool status = updateGeoTrigger(&gt, &gp2);
         CPPUNIT_ASSERT(!status);
         CPPUNIT_ASSERT(!isGeoTriggerTripped(&gt));
 }
 
 void GeoTriggerTest::testReset() {
-        const GeoPoint gp = { 43.074859, -89.386336 }; // 100 State
+        const GeoPoint gp = { GP_DEGREES(43.074859), GP_DEGREES(-89.386336) }; // 100 State
         const struct GeoCircle gc = gc_createGeoCircle(gp, 10);
         struct GeoTrigger gt = createGeoTrigger(&gc);
 
         CPPUNIT_ASSERT(!isGeoTriggerTripped(&gt));
 
-        const GeoPoint gp2 = { 43.075255, -89.385590 }; // > 10 M from 100 State
+        const GeoPoint gp2 = { GP_DEGREES(43.075255), GP_DEGREES(-89.385590) }; // > 10 M from 100 State
         const bool status = updateGeoTrigger(&gt, &gp2);
         CPPUNIT_ASSERT(status);
         CPPUNIT_ASSERT(isGeoTriggerTripped(&gt));
@@ -0,0 +1,244 @@
+/**
+ * Race Capture Pro Firmware
+ *
+ * Copyright Autosport Labs Inc.
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geopoint_test.h"
+#include "geopoint.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Registers the fixture into the 'registry'
+CPPUNIT_TEST_SUITE_REGISTRATION( GeoPointTest );
+
+
+void GeoPointTest::setUp() {}
+
+void GeoPointTest::tearDown() {}
+
+void GeoPointTest::testParseDegrees() {
+        CPPUNIT_ASSERT_EQUAL((int32_t) 478069345, gp_parse_degrees("47.8069345"));
+        CPPUNIT_ASSERT_EQUAL((int32_t) -1223714733, gp_parse_degrees("-122.3714733"));
+        CPPUNIT_ASSERT_EQUAL((int32_t) 10000000, gp_parse_degrees(" 1"));
+        CPPUNIT_ASSERT_EQUAL((int32_t) 11000000, gp_parse_degrees("+1.1"));
+
+        // Digits past 1e-7 round
+        CPPUNIT_ASSERT_EQUAL((int32_t) 478069346, gp_parse_degrees("47.80693455"));
+        CPPUNIT_ASSERT_EQUAL((int32_t) 478069345, gp_parse_degrees("47.80693454"));
+        CPPUNIT_ASSERT_EQUAL((int32_t) -478069346, gp_parse_degrees("-47.80693459"));
+}
+
+void GeoPointTest::testParseNmea() {
+        // 25 degrees 3.6319 minutes
+        CPPUNIT_ASSERT_EQUAL((int32_t) 250605317, gp_parse_nmea("2503.6319", 2));
+        // 121 degrees 33.0000 minutes
+        CPPUNIT_ASSERT_EQUAL((int32_t) 1215500000, gp_parse_nmea("12133.0000", 3));
+        CPPUNIT_ASSERT_EQUAL((int32_t) 0, gp_parse_nmea("0000.0000", 2));
+}
+
+void GeoPointTest::testRoundTrip() {
+        const double values[] = { 47.8069345, -122.3714733, 0.0000001, -0.0000001, 179.9999999 };
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+                const int32_t v = gp_from_degrees(values[i]);
+                CPPUNIT_ASSERT_EQUAL(v, gp_from_degrees(gp_to_degrees(v)));
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(values[i], gp_to_degrees(v), 1e-9);
+        }
+
+        CPPUNIT_ASSERT_EQUAL((int32_t) GP_DEGREES(-89.386336), gp_from_degrees(-89.386336));
+}
+
+void GeoPointTest::testDistance() {
+        // 0.001 degrees along a meridian
+        GeoPoint a = gp_create(45.0, -122.0);
+        GeoPoint b = gp_create(45.001, -122.0);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(111.195, distPythag(&a, &b), 0.01);
+
+        // 0.001 degrees along the 60th parallel is half as far
+        a = gp_create(60.0, 10.0);
+        b = gp_create(60.0, 10.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(55.597, distPythag(&a, &b), 0.01);
+
+        // Across the antimeridian
+        a = gp_create(0.0, 179.9995);
+        b = gp_create(0.0, -179.9995);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(111.195, distPythag(&a, &b), 0.01);
+}
+
+void GeoPointTest::testDistanceResolution() {
+        // Far from the equator and the prime meridian, one unit apart
+        const GeoPoint a = gp_create(47.8069345, -122.3714733);
+        GeoPoint b = a;
+        ++b.latitude;
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0111, distPythag(&a, &b), 0.0001);
+
+        CPPUNIT_ASSERT_EQUAL(0.0f, distPythag(&a, &a));
+}
+
+void GeoPointTest::testProjection() {
+        const GeoPoint origin = gp_create(60.0, 10.0);
+        struct gp_projection proj;
+        gp_projection_init(&proj, &origin);
+
+        float x, y;
+        GeoPoint p = gp_create(60.001, 10.001);
+        gp_project(&proj, &p, &x, &y);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(55.597, x, 0.01);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(111.195, y, 0.01);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(55.597 * 55.597 + 111.195 * 111.195,
+                                     gp_dist_sq(&proj, &origin, &p), 5);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(distPythag(&origin, &p),
+                                     gp_dist(&proj, &p, &origin), 0.01);
+
+        // Level with the middle of the line, then before it and past it
+        const GeoPoint s = gp_create(60.0, 10.001);
+        const GeoPoint e = gp_create(60.0, 10.003);
+        p = gp_create(60.0005, 10.002);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, gp_fraction_along(&proj, &s, &e, &p), 1e-4);
+        CPPUNIT_ASSERT(gp_fraction_along(&proj, &s, &e, &origin) < 0);
+        p = gp_create(60.0, 10.004);
+        CPPUNIT_ASSERT(gp_fraction_along(&proj, &s, &e, &p) > 1);
+
+        // Across the antimeridian
+        const GeoPoint west = gp_create(0.0, 179.9995);
+        const GeoPoint east = gp_create(0.0, -179.9995);
+        gp_projection_init(&proj, &west);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(111.195, gp_dist(&proj, &west, &east), 0.01);
+        gp_project(&proj, &east, &x, &y);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(111.195, x, 0.01);
+
+        // Only moves once we are far enough north or south for it to matter
+        gp_projection_init(&proj, &origin);
+        p = gp_create(60.04, 10.5);
+        CPPUNIT_ASSERT(!gp_projection_follow(&proj, &p));
+        CPPUNIT_ASSERT_EQUAL(origin.latitude, proj.origin.latitude);
+        p = gp_create(59.94, 10.0);
+        CPPUNIT_ASSERT(gp_projection_follow(&proj, &p));
+        CPPUNIT_ASSERT_EQUAL(p.latitude, proj.origin.latitude);
+}
+
+/* Great circle distance in meters, in double precision */
+static double haversine(const GeoPoint *a, const GeoPoint *b)
+{
+        const double rad = M_PI / 180;
+        const double lat1 = gp_to_degrees(a->latitude) * rad;
+        const double lat2 = gp_to_degrees(b->latitude) * rad;
+        const double dLat = lat2 - lat1;
+        const double dLon = (gp_to_degrees(b->longitude) -
+                             gp_to_degrees(a->longitude)) * rad;
+        const double h = sin(dLat / 2) * sin(dLat / 2) +
+                cos(lat1) * cos(lat2) * sin(dLon / 2) * sin(dLon / 2);
+
+        return 2 * GP_EARTH_RADIUS_M * asin(sqrt(h));
+}
+
+/* A point up to range meters from the origin in each direction */
+static GeoPoint random_point(const GeoPoint *origin, const double range)
+{
+        const double units = range / GP_METERS_PER_UNIT;
+        const double cos_lat = cos(gp_to_degrees(origin->latitude) * M_PI / 180);
+        GeoPoint p = *origin;
+        p.latitude += (int32_t) ((rand() / (double) RAND_MAX * 2 - 1) * units);
+        p.longitude += (int32_t) ((rand() / (double) RAND_MAX * 2 - 1) *
+                                  units / cos_lat);
+        return p;
+}
+
+/*
+ * Pairs of points around a track, against haversine.  The frame of the
+ * track has to be good to a meter in a kilometer, and still good to a
+ * few where it is about to follow us at 0.05 degrees off.
+ */
+void GeoPointTest::testProjectionAccuracy() {
+        const double lats[] = { 0, 30, 47.8, 60, 70 };
+
+        srand(46);
+        for (size_t l = 0; l < sizeof(lats) / sizeof(lats[0]); ++l) {
+                const GeoPoint origin = gp_create(lats[l], -122.3);
+                const GeoPoint edge = gp_create(lats[l] + 0.05, -122.3);
+                struct gp_projection proj;
+                gp_projection_init(&proj, &origin);
+
+                double worst_pythag = 0, worst_track = 0, worst_edge = 0;
+                for (int i = 0; i < 2000; ++i) {
+                        const GeoPoint a = random_point(&origin, 2000);
+                        const GeoPoint b = random_point(&a, 500);
+                        const double d = haversine(&a, &b);
+                        if (d < 1)
+                                continue;
+
+                        const double pythag = fabs(distPythag(&a, &b) - d) / d;
+                        const double track = fabs(gp_dist(&proj, &a, &b) - d) / d;
+                        if (pythag > worst_pythag)
+                                worst_pythag = pythag;
+                        if (track > worst_track)
+                                worst_track = track;
+
+                        const GeoPoint ea = random_point(&edge, 2000);
+                        const GeoPoint eb = random_point(&ea, 500);
+                        const double ed = haversine(&ea, &eb);
+                        const double e = fabs(gp_dist(&proj, &ea, &eb) - ed) / ed;
+                        if (ed >= 1 && e > worst_edge)
+                                worst_edge = e;
+                }
+
+                printf("\r\nDistance at %.1f degrees, worst error against "
+                       "haversine: distPythag %.4f%%, frame %.4f%%, "
+                       "0.05 degrees off the frame %.4f%%", lats[l],
+                       worst_pythag * 100, worst_track * 100, worst_edge * 100);
+
+                CPPUNIT_ASSERT(worst_track < 0.001);
+                CPPUNIT_ASSERT(worst_edge < 0.01);
+        }
+        printf("\r\n");
+}
+
+void GeoPointTest::testProjectionBenchmark() {
+        const int count = 100000;
+        const GeoPoint origin = gp_create(47.8069345, -122.3714733);
+        struct gp_projection proj;
+        gp_projection_init(&proj, &origin);
+
+        srand(46);
+        GeoPoint *points = new GeoPoint[count + 1];
+        for (int i = 0; i <= count; ++i)
+                points[i] = random_point(&origin, 2000);
+
+        volatile float sink = 0;
+        clock_t c = clock();
+        for (int i = 0; i < count; ++i)
+                sink = sink + distPythag(points + i, points + i + 1);
+        const double pythag = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        c = clock();
+        for (int i = 0; i < count; ++i)
+                sink = sink + gp_dist(&proj, points + i, points + i + 1);
+        const double dist = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        c = clock();
+        for (int i = 0; i < count; ++i)
+                sink = sink + gp_dist_sq(&proj, points + i, points + i + 1);
+        const double dist_sq = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        delete[] points;
+
+        printf("\r\nDistance: distPythag %.1fns, frame %.1fns, frame "
+               "squared %.1fns\r\n", pythag * 1e9 / count, dist * 1e9 / count,
+               dist_sq * 1e9 / count);
+}
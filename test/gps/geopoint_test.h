@@ -0,0 +1,51 @@
+/**
+ * Race Capture Pro Firmware
+ *
+ * Copyright Autosport Labs Inc.
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOPOINTTEST_H
+#define GEOPOINTTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class GeoPointTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( GeoPointTest );
+    CPPUNIT_TEST( testParseDegrees );
+    CPPUNIT_TEST( testParseNmea );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST( testDistance );
+    CPPUNIT_TEST( testDistanceResolution );
+    CPPUNIT_TEST( testProjection );
+    CPPUNIT_TEST( testProjectionAccuracy );
+    CPPUNIT_TEST( testProjectionBenchmark );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+    void testParseDegrees();
+    void testParseNmea();
+    void testRoundTrip();
+    void testDistance();
+    void testDistanceResolution();
+    void testProjection();
+    void testProjectionAccuracy();
+    void testProjectionBenchmark();
+};
+
+#endif  // GEOPOINTTEST_H
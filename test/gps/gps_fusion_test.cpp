@@ -0,0 +1,382 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geopoint.h"
+#include "gps.h"
+#include "gps_fusion.h"
+#include "gps_fusion_test.h"
+#include "mod_string.h"
+#include "modp_atonum.h"
+
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using std::ifstream;
+using std::string;
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( GpsFusionTest );
+
+#define LOG_FILE		"predictive_time_test_lap.log"
+#define ORIGIN_LAT		47.8
+#define ORIGIN_LON		-122.3
+#define METERS_PER_DEGREE	(GP_EARTH_RADIUS_M * M_PI / 180.0)
+#define FIX_INTERVAL_MS		100
+#define BENCHMARK_FIXES		100000
+#define MPH_TO_KPH		1.609344
+
+/* A car driven along a path in a local frame, in m and radians */
+struct car {
+        double north;
+        double east;
+        double speed;
+        double heading;
+        int time_ms;
+};
+
+static GpsSample make_fix(const car &c)
+{
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        s.quality = GPS_QUALITY_3D;
+        s.point = gp_create(ORIGIN_LAT + c.north / METERS_PER_DEGREE,
+                            ORIGIN_LON + c.east / METERS_PER_DEGREE /
+                            cos(ORIGIN_LAT * M_PI / 180));
+        s.speed = (float) (c.speed * 3.6);
+        s.time = 1400000000000LL + c.time_ms;
+        return s;
+}
+
+/* How far the filter is from the car, in m */
+static double error_m(const car &c)
+{
+        const double north = (gps_fusion_get_latitude() - ORIGIN_LAT) *
+                METERS_PER_DEGREE;
+        const double east = (gps_fusion_get_longitude() - ORIGIN_LON) *
+                METERS_PER_DEGREE * cos(ORIGIN_LAT * M_PI / 180);
+        return hypot(north - c.north, east - c.east);
+}
+
+static void drive(car &c, const int ms, const double accel,
+                  const double yaw_rate)
+{
+        for (int i = 0; i < ms; ++i) {
+                const double dt = 0.001;
+                c.north += c.speed * dt * cos(c.heading);
+                c.east += c.speed * dt * sin(c.heading);
+                c.speed += accel * dt;
+                c.heading += yaw_rate * dt;
+                ++c.time_ms;
+        }
+}
+
+/*
+ * Drives a car with a varying yaw rate and acceleration, giving the
+ * filter a fix every 100ms and the IMU through the given scale and
+ * offset every 10ms.
+ * @return The mean error half way between fixes, after the first 2s.
+ */
+static double drive_varying(const bool use_imu, const double imu_yaw_scale,
+                            const double imu_yaw_offset)
+{
+        gps_fusion_init();
+        car c = { 0, 0, 20, 0, 0 };
+        double total = 0;
+        int count = 0;
+
+        for (int step = 0; step < 1000; ++step) {
+                const double t = c.time_ms / 1000.0;
+                /* Slaloming while braking and accelerating hard */
+                const double yaw_rate = 0.5 * sin(t * 5);
+                const double accel = fmod(t, 1.5) < 0.75 ? 5 : -5;
+
+                if (c.time_ms % FIX_INTERVAL_MS == 0) {
+                        const GpsSample s = make_fix(c);
+                        gps_fusion_add_fix(&s, c.time_ms);
+                }
+
+                const float imu_accel = use_imu ? (float) (accel / 9.80665) : 0;
+                const float imu_yaw = use_imu ? (float) (yaw_rate * 180 / M_PI *
+                                                         imu_yaw_scale + imu_yaw_offset) : 0;
+                gps_fusion_update(imu_accel, imu_yaw, c.time_ms);
+
+                if (c.time_ms > 2000 && c.time_ms % FIX_INTERVAL_MS == 90) {
+                        total += error_m(c);
+                        ++count;
+                }
+
+                drive(c, 10, accel, yaw_rate);
+        }
+
+        return total / count;
+}
+
+void GpsFusionTest::setUp()
+{
+        gps_fusion_init();
+}
+
+void GpsFusionTest::tearDown() {}
+
+void GpsFusionTest::noFixTest()
+{
+        gps_fusion_update(0, 0, 100);
+        CPPUNIT_ASSERT(!gps_fusion_valid());
+        CPPUNIT_ASSERT_EQUAL(0.0, gps_fusion_get_longitude());
+        CPPUNIT_ASSERT_EQUAL(0.0f, gps_fusion_get_speed());
+}
+
+void GpsFusionTest::straightLineTest()
+{
+        /* North east at 20 m/s */
+        car c = { 0, 0, 20, M_PI / 4, 0 };
+
+        for (int i = 0; i < 3; ++i) {
+                const GpsSample s = make_fix(c);
+                gps_fusion_add_fix(&s, c.time_ms);
+                gps_fusion_update(0, 0, c.time_ms);
+                CPPUNIT_ASSERT(error_m(c) < 0.01);
+                drive(c, FIX_INTERVAL_MS, 0, 0);
+        }
+
+        /* Half way to the next fix we are 1m further on, not at the last */
+        car half = c;
+        half.north -= 0.5 * 20 * FIX_INTERVAL_MS / 1000.0 * cos(M_PI / 4);
+        half.east -= 0.5 * 20 * FIX_INTERVAL_MS / 1000.0 * sin(M_PI / 4);
+        gps_fusion_update(0, 0, c.time_ms - FIX_INTERVAL_MS / 2);
+        CPPUNIT_ASSERT(error_m(half) < 0.01);
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(72.0, gps_fusion_get_speed(), 0.01);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(45.0, gps_fusion_get_heading(), 0.5);
+}
+
+void GpsFusionTest::turnTest()
+{
+        /* A 50m radius left hand circle at 15 m/s, no IMU */
+        car c = { 0, 0, 15, 0, 0 };
+        const double yaw_rate = -15.0 / 50;
+        double fused = 0;
+        double held = 0;
+
+        for (int i = 0; i < 40; ++i) {
+                const GpsSample s = make_fix(c);
+                gps_fusion_add_fix(&s, c.time_ms);
+                gps_fusion_update(0, 0, c.time_ms);
+
+                const car last = c;
+                drive(c, 90, 0, yaw_rate);
+                gps_fusion_update(0, 0, c.time_ms);
+                if (i >= 5) {
+                        fused = fmax(fused, error_m(c));
+                        held = fmax(held, hypot(c.north - last.north,
+                                                c.east - last.east));
+                }
+                drive(c, 10, 0, yaw_rate);
+        }
+
+        CPPUNIT_ASSERT(fused < 0.05);
+        CPPUNIT_ASSERT(held > 1.3);
+}
+
+void GpsFusionTest::imuTest()
+{
+        const double without = drive_varying(false, 1, 0);
+        /* Backwards, twice as sensitive and 3 deg/s off */
+        const double with = drive_varying(true, -2, 3);
+
+        CPPUNIT_ASSERT(with < without / 2);
+        CPPUNIT_ASSERT(with < 0.05);
+}
+
+void GpsFusionTest::extrapolationLimitTest()
+{
+        car c = { 0, 0, 10, 0, 0 };
+        const GpsSample s = make_fix(c);
+        gps_fusion_add_fix(&s, 0);
+        gps_fusion_update(0, 0, 5000);
+
+        drive(c, GPS_FUSION_MAX_EXTRAPOLATION_MS, 0, 0);
+        CPPUNIT_ASSERT(error_m(c) < 0.01);
+}
+
+/* East across the antimeridian at 20 m/s, on the equator */
+void GpsFusionTest::antimeridianTest()
+{
+        const double step = 2 / METERS_PER_DEGREE;
+        double lon = 180 - 2.5 * step;
+
+        for (int i = 0; i < 5; ++i) {
+                GpsSample s;
+                memset(&s, 0, sizeof(s));
+                s.quality = GPS_QUALITY_3D;
+                s.point = gp_create(0, lon);
+                s.speed = 72;
+                s.time = 1400000000000LL + i * FIX_INTERVAL_MS;
+                gps_fusion_add_fix(&s, i * FIX_INTERVAL_MS);
+                gps_fusion_update(0, 0, i * FIX_INTERVAL_MS);
+
+                lon += step;
+                if (lon > 180)
+                        lon -= 360;
+        }
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(90.0, gps_fusion_get_heading(), 0.5);
+
+        /* Half way to the next fix */
+        gps_fusion_update(0, 0, 4 * FIX_INTERVAL_MS + FIX_INTERVAL_MS / 2);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(lon - step / 2, gps_fusion_get_longitude(),
+                                     0.01 / METERS_PER_DEGREE);
+}
+
+struct log_row {
+        int time_ms;
+        bool fix;
+        GpsSample sample;
+        float accel_g;
+        float yaw_dps;
+};
+
+static vector<log_row> load_log()
+{
+        ifstream f(LOG_FILE);
+        if (!f.is_open())
+                f.open("test/" LOG_FILE);
+        CPPUNIT_ASSERT(f.is_open());
+
+        vector<log_row> rows;
+        log_row row;
+        memset(&row, 0, sizeof(row));
+        int last_fix_ms = -1;
+        double t0 = -1;
+        string line;
+
+        while (getline(f, line)) {
+                vector<string> v;
+                std::istringstream ss(line);
+                for (string item; getline(ss, item, ',');)
+                        v.push_back(item);
+
+                if ('#' == line[0] || v.size() < 9)
+                        continue;
+
+                /* Accelerometer Y is forward, mounted backwards */
+                if (!v[2].empty())
+                        row.accel_g = -modp_atof(v[2].c_str());
+                if (!v[4].empty())
+                        row.yaw_dps = modp_atof(v[4].c_str());
+
+                row.fix = !v[5].empty();
+                if (row.fix) {
+                        const double t = atof(v[8].c_str());
+                        if (t0 < 0)
+                                t0 = t;
+                        row.time_ms = (int) ((t - t0) * 1000 + 0.5);
+                        /* Repeated fixes are the logger catching up */
+                        if (row.time_ms <= last_fix_ms)
+                                continue;
+
+                        last_fix_ms = row.time_ms;
+                        memset(&row.sample, 0, sizeof(row.sample));
+                        row.sample.quality = GPS_QUALITY_3D;
+                        row.sample.point.latitude = gp_parse_degrees(v[5].c_str());
+                        row.sample.point.longitude = gp_parse_degrees(v[6].c_str());
+                        row.sample.speed = (float) (atof(v[7].c_str()) * MPH_TO_KPH);
+                        row.sample.time = row.time_ms;
+                }
+
+                rows.push_back(row);
+        }
+
+        return rows;
+}
+
+void GpsFusionTest::logReplayTest()
+{
+        /*
+         * Give the filter every other fix of a recorded 10Hz lap and see
+         * how close it gets to the ones it did not get.
+         */
+        const vector<log_row> rows = load_log();
+        double fused = 0;
+        double held = 0;
+        size_t checked = 0;
+        size_t fixes = 0;
+        GeoPoint last = { 0, 0 };
+
+        for (size_t i = 0; i < rows.size(); ++i) {
+                const log_row &r = rows[i];
+                if (!r.fix)
+                        continue;
+
+                if (fixes++ % 2 == 0) {
+                        gps_fusion_add_fix(&r.sample, r.time_ms);
+                        gps_fusion_update(r.accel_g, r.yaw_dps, r.time_ms);
+                        last = r.sample.point;
+                        continue;
+                }
+
+                if (!gps_fusion_valid())
+                        continue;
+
+                gps_fusion_update(r.accel_g, r.yaw_dps, r.time_ms);
+                const GeoPoint p = gp_create(gps_fusion_get_latitude(),
+                                             gps_fusion_get_longitude());
+                fused += distPythag(&p, &r.sample.point);
+                held += distPythag(&last, &r.sample.point);
+                ++checked;
+        }
+
+        printf("\r\nGPS fusion on %u fixes at 5Hz: %.2fm off half way, "
+               "%.2fm without\r\n", (unsigned) checked, fused / checked,
+               held / checked);
+
+        CPPUNIT_ASSERT(checked > 5000);
+        CPPUNIT_ASSERT(fused < held / 3);
+}
+
+void GpsFusionTest::updateBenchmark()
+{
+        car c = { 0, 0, 20, 0, 0 };
+        vector<GpsSample> fixes;
+        for (size_t i = 0; i < 100; ++i) {
+                fixes.push_back(make_fix(c));
+                drive(c, FIX_INTERVAL_MS, 0.5, 0.1);
+        }
+
+        /* A fix every 100ms and an update every 10ms */
+        const clock_t start = clock();
+        for (size_t i = 0; i < BENCHMARK_FIXES; ++i) {
+                const tiny_millis_t fix_ms = i * FIX_INTERVAL_MS;
+                gps_fusion_add_fix(&fixes[i % fixes.size()], fix_ms);
+                for (int u = 0; u < 10; ++u)
+                        gps_fusion_update(0.05f, 5.0f, fix_ms + u * 10);
+        }
+        const double ns = (double) (clock() - start) * 1e9 / CLOCKS_PER_SEC /
+                (BENCHMARK_FIXES * 10.0);
+
+        printf("\r\nGPS fusion: %.0fns per update\r\n", ns);
+        CPPUNIT_ASSERT(gps_fusion_valid());
+}
@@ -0,0 +1,407 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gps.h"
+#include "mod_string.h"
+#include "modp_atonum.h"
+#include "nmea.h"
+#include "nmea_test.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using std::ifstream;
+using std::string;
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NmeaTest );
+
+#define CORPUS_FILE		"gps/nmea_lap.log"
+#define CORPUS_SOURCE_FILE	"predictive_time_test_lap.log"
+#define CORPUS_FIXES		600
+#define BENCHMARK_ROUNDS	20
+#define MPH_TO_KPH		1.609344
+
+static string read_file(const string &name)
+{
+        ifstream f(name.c_str(), std::ios::binary);
+        if (!f.is_open())
+                f.open(("test/" + name).c_str(), std::ios::binary);
+        CPPUNIT_ASSERT(f.is_open());
+
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+}
+
+static enum nmea_result feed(struct nmea_parser *p, const char *s)
+{
+        enum nmea_result res = NMEA_PENDING;
+        for (; *s; ++s) {
+                const enum nmea_result r = nmea_feed(p, *s);
+                if (NMEA_PENDING != r)
+                        res = r;
+        }
+        return res;
+}
+
+/*
+ * What the MTK3339 driver used to do with each line, kept here as the
+ * benchmark baseline: check the checksum, find the sentence with strstr
+ * and walk the fields with strchr.
+ */
+static void baseline_parse_gga(GpsSample *gpsSample, char *data)
+{
+        char *delim = strchr(data, ',');
+        int param = 0;
+
+        while (delim != NULL) {
+                *delim = '\0';
+                switch (param) {
+                case 5:
+                        gpsSample->quality = (enum GpsSignalQuality) modp_atoi(data);
+                        break;
+                case 6:
+                        gpsSample->satellites = (uint8_t) modp_atoi(data);
+                        break;
+                case 7:
+                        gpsSample->DOP = modp_atof(data);
+                        break;
+                case 8:
+                        gpsSample->altitude = modp_atof(data);
+                        break;
+                }
+                param++;
+                data = delim + 1;
+                delim = strchr(data, ',');
+        }
+}
+
+static int baseline_atoi(const char *str, size_t offset, size_t len)
+{
+        char buff[4] = { 0 };
+        memcpy(buff, str + offset, len);
+        return modp_atoi(buff);
+}
+
+static void baseline_parse_rmc(GpsSample *gpsSample, char *data)
+{
+        char *delim = strchr(data, ',');
+        int param = 0;
+        DateTime dt = { 0 };
+        int32_t latitude = 0;
+        int32_t longitude = 0;
+
+        while (delim) {
+                *delim = '\0';
+                switch (param) {
+                case 0:
+                        dt.hour = (int8_t) baseline_atoi(data, 0, 2);
+                        dt.minute = (int8_t) baseline_atoi(data, 2, 2);
+                        dt.second = (int8_t) baseline_atoi(data, 4, 2);
+                        dt.millisecond = (int16_t) baseline_atoi(data, 7, 3);
+                        break;
+                case 2:
+                        latitude = gp_parse_nmea(data, 2);
+                        break;
+                case 3:
+                        if (data[0] == 'S') latitude = -latitude;
+                        break;
+                case 4:
+                        longitude = gp_parse_nmea(data, 3);
+                        break;
+                case 5:
+                        if (data[0] == 'W') longitude = -longitude;
+                        break;
+                case 6:
+                        gpsSample->speed = modp_atof(data) * 1.852f;
+                        break;
+                case 8:
+                        dt.day = (int8_t) baseline_atoi(data, 0, 2);
+                        dt.month = (int8_t) baseline_atoi(data, 2, 2);
+                        dt.year = (int16_t) (baseline_atoi(data, 4, 2) + 2000);
+                        break;
+                }
+                ++param;
+                data = ++delim;
+                delim = strchr(delim, ',');
+        }
+
+        gpsSample->point.latitude = latitude;
+        gpsSample->point.longitude = longitude;
+        gpsSample->time = getMillisecondsSinceUnixEpoch(dt);
+}
+
+static bool baseline_process(GpsSample *gpsSample, char *gpsData, size_t len)
+{
+        if (len <= 4 || !checksumValid(gpsData, len) ||
+            strstr(gpsData, "$GP") != gpsData)
+                return false;
+
+        gpsData += 3;
+        if (strstr(gpsData, "GGA,"))
+                baseline_parse_gga(gpsSample, gpsData + 4);
+        else if (strstr(gpsData, "VTG,"))
+                return true;
+        else if (strstr(gpsData, "RMC,"))
+                baseline_parse_rmc(gpsSample, gpsData + 4);
+
+        return false;
+}
+
+void NmeaTest::setUp() {}
+
+void NmeaTest::tearDown() {}
+
+void NmeaTest::checksumTest()
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GPGLL,5300.97914,N,00259.98174,E,125926,A*28\r\n"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_GLL, nmea_sentence(&p));
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GPGSA,M,3,12,17,04,25,29,10,,,,,,,2.45,1.89,1.56*03\r\n"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_GSA, nmea_sentence(&p));
+
+        /* Lower case hex is fine too */
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GNVTG,87.51,T,,M,7.73,N,14.32,K,A*2f"));
+
+        CPPUNIT_ASSERT_EQUAL(NMEA_ERROR, feed(&p, "$GPGLL,5300.97914,N,00259.98174,E,125926,A*29\r\n"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_ERROR, feed(&p, "$GPGLL,5300.97914,N,00259.98174,E,125926,A*2G\r\n"));
+
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 3, p.stats.sentences);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, p.stats.checksum_errors);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, p.stats.framing_errors);
+}
+
+void NmeaTest::fieldsTest()
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GPRMC,053740.000,A,2503.6319,N,12136.0099,E,2.69,79.65,100106,,,A*53\r\n"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_RMC, nmea_sentence(&p));
+        CPPUNIT_ASSERT_EQUAL((size_t) 13, nmea_field_count(&p));
+        CPPUNIT_ASSERT_EQUAL(string("GPRMC"), string(nmea_field(&p, 0)));
+        CPPUNIT_ASSERT_EQUAL(string("053740.000"), string(nmea_field(&p, 1)));
+        CPPUNIT_ASSERT_EQUAL(string("100106"), string(nmea_field(&p, 9)));
+        CPPUNIT_ASSERT_EQUAL(string(""), string(nmea_field(&p, 10)));
+        CPPUNIT_ASSERT_EQUAL(string("A"), string(nmea_field(&p, 12)));
+        CPPUNIT_ASSERT_EQUAL(string(""), string(nmea_field(&p, 13)));
+
+        /* Any talker will do */
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GNVTG,87.51,T,,M,7.73,N,14.32,K,A*2F"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_VTG, nmea_sentence(&p));
+
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$PMTK001,314,3*36"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_UNKNOWN, nmea_sentence(&p));
+}
+
+void NmeaTest::framingTest()
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+
+        /* Noise between sentences is ignored */
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "\x01garbage\r\n$GPGSA,M,3,12,17,04,25,29,10,,,,,,,2.45,1.89,1.56*03"));
+
+        /*
+         * Cut short by the next sentence, which still gets through.  We
+         * only know once the next one starts.
+         */
+        CPPUNIT_ASSERT_EQUAL(NMEA_PENDING, feed(&p, "$GPGGA,0347"));
+        CPPUNIT_ASSERT_EQUAL(NMEA_READY, feed(&p, "$GPGSA,M,3,12,17,04,25,29,10,,,,,,,2.45,1.89,1.56*03"));
+
+        /* No checksum */
+        CPPUNIT_ASSERT_EQUAL(NMEA_ERROR, feed(&p, "$GPGSA,M,3,12\r\n"));
+
+        /* Too long */
+        string longest = "$GPXXX,";
+        longest.append(NMEA_MAX_SENTENCE, '1');
+        CPPUNIT_ASSERT_EQUAL(NMEA_ERROR, feed(&p, (longest + "*00").c_str()));
+
+        /* Too many fields */
+        string fields = "$GPXXX";
+        fields.append(NMEA_MAX_FIELDS, ',');
+        CPPUNIT_ASSERT_EQUAL(NMEA_ERROR, feed(&p, (fields + "*00").c_str()));
+
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, p.stats.sentences);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 4, p.stats.framing_errors);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.checksum_errors);
+}
+
+void NmeaTest::decodeGgaTest()
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+
+        feed(&p, "$GPGGA,034722.200,3745.1353,N,12224.6551,W,1,6,1.42,0.4,M,-25.3,M,,*61");
+        CPPUNIT_ASSERT_EQUAL(NMEA_GGA, nmea_decode(&p, &s));
+        CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_2D, s.quality);
+        CPPUNIT_ASSERT_EQUAL(6, (int) s.satellites);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.42, s.DOP, 0.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.4, s.altitude, 0.001);
+        /* GGA does not touch the position */
+        CPPUNIT_ASSERT_EQUAL((int32_t) 0, s.point.latitude);
+}
+
+void NmeaTest::decodeRmcTest()
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+
+        feed(&p, "$GPRMC,053740.000,A,2503.6319,N,12136.0099,E,2.69,79.65,100106,,,A*53");
+        CPPUNIT_ASSERT_EQUAL(NMEA_RMC, nmea_decode(&p, &s));
+        CPPUNIT_ASSERT_EQUAL((int32_t) 250605317, s.point.latitude);
+        CPPUNIT_ASSERT_EQUAL((int32_t) 1216001650, s.point.longitude);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2.69 * 1.852, s.speed, 0.0001);
+        CPPUNIT_ASSERT_EQUAL((millis_t) 1136871460000LL, s.time);
+
+        feed(&p, "$GPRMC,034722.250,A,3745.1353,S,12224.6551,W,0.03,281.72,280414,,,A*61");
+        CPPUNIT_ASSERT_EQUAL(NMEA_RMC, nmea_decode(&p, &s));
+        CPPUNIT_ASSERT_EQUAL((int32_t) -377522550, s.point.latitude);
+        CPPUNIT_ASSERT_EQUAL((int32_t) -1224109183, s.point.longitude);
+        CPPUNIT_ASSERT_EQUAL((millis_t) 250, s.time % 1000);
+}
+
+/* Position and speed of the fixes the corpus was made from */
+struct fix {
+        int32_t latitude;
+        int32_t longitude;
+        double kph;
+};
+
+static vector<fix> load_fixes()
+{
+        std::istringstream log(read_file(CORPUS_SOURCE_FILE));
+        vector<fix> fixes;
+        string line;
+
+        while (fixes.size() < CORPUS_FIXES && getline(log, line)) {
+                vector<string> values;
+                std::istringstream ss(line);
+                string v;
+                while (getline(ss, v, ','))
+                        values.push_back(v);
+
+                if ('#' == line[0] || values.size() < 9 || values[5].empty())
+                        continue;
+
+                fix f;
+                f.latitude = gp_parse_degrees(values[5].c_str());
+                f.longitude = gp_parse_degrees(values[6].c_str());
+                f.kph = modp_atof(values[7].c_str()) * MPH_TO_KPH;
+                fixes.push_back(f);
+        }
+
+        return fixes;
+}
+
+void NmeaTest::corpusTest()
+{
+        const string corpus = read_file(CORPUS_FILE);
+        const vector<fix> fixes = load_fixes();
+        CPPUNIT_ASSERT_EQUAL((size_t) CORPUS_FIXES, fixes.size());
+
+        struct nmea_parser p;
+        nmea_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        size_t updates = 0;
+        millis_t last_time = 0;
+
+        for (const char *c = corpus.c_str(); *c; ++c) {
+                if (NMEA_READY != nmea_feed(&p, *c))
+                        continue;
+
+                if (NMEA_VTG != nmea_decode(&p, &s))
+                        continue;
+
+                /* A whole update is in.  Minutes have 4 decimals */
+                const fix &f = fixes[updates++];
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(f.latitude, s.point.latitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(f.longitude, s.point.longitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(f.kph, s.speed, 0.01);
+                CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_2D, s.quality);
+                CPPUNIT_ASSERT_EQUAL(9, (int) s.satellites);
+                CPPUNIT_ASSERT(s.time >= last_time);
+                last_time = s.time;
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) CORPUS_FIXES, updates);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) CORPUS_FIXES * 4, p.stats.sentences);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.checksum_errors);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.framing_errors);
+}
+
+void NmeaTest::parseBenchmark()
+{
+        const string corpus = read_file(CORPUS_FILE);
+        vector<string> lines;
+        std::istringstream ss(corpus);
+        for (string line; getline(ss, line);)
+                lines.push_back(line + "\n");
+
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        size_t baseline_updates = 0;
+        size_t updates = 0;
+        char line[200];
+
+        clock_t start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r) {
+                for (size_t i = 0; i < lines.size(); ++i) {
+                        /* The copy get_line used to make */
+                        const size_t len = lines[i].size();
+                        memcpy(line, lines[i].c_str(), len + 1);
+                        baseline_updates += baseline_process(&s, line, len);
+                }
+        }
+        const double baseline_s = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        struct nmea_parser p;
+        nmea_init(&p);
+        start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r) {
+                for (const char *c = corpus.c_str(); *c; ++c)
+                        if (NMEA_READY == nmea_feed(&p, *c))
+                                updates += NMEA_VTG == nmea_decode(&p, &s);
+        }
+        const double streaming_s = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        const double sentences = (double) BENCHMARK_ROUNDS * CORPUS_FIXES * 4;
+        printf("\r\nNMEA (%u bytes): line based %.0fns, streaming %.0fns "
+               "per sentence\r\n", (unsigned) corpus.size(),
+               baseline_s * 1e9 / sentences, streaming_s * 1e9 / sentences);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) BENCHMARK_ROUNDS * CORPUS_FIXES,
+                             baseline_updates);
+        CPPUNIT_ASSERT_EQUAL((size_t) BENCHMARK_ROUNDS * CORPUS_FIXES, updates);
+}
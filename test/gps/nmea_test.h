@@ -0,0 +1,52 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NMEA_TEST_H_
+#define _NMEA_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class NmeaTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( NmeaTest );
+        CPPUNIT_TEST( checksumTest );
+        CPPUNIT_TEST( fieldsTest );
+        CPPUNIT_TEST( framingTest );
+        CPPUNIT_TEST( decodeGgaTest );
+        CPPUNIT_TEST( decodeRmcTest );
+        CPPUNIT_TEST( corpusTest );
+        CPPUNIT_TEST( parseBenchmark );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+
+        void checksumTest();
+        void fieldsTest();
+        void framingTest();
+        void decodeGgaTest();
+        void decodeRmcTest();
+        void corpusTest();
+        void parseBenchmark();
+};
+
+#endif /* _NMEA_TEST_H_ */
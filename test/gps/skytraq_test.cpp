@@ -0,0 +1,358 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gps.h"
+#include "mod_string.h"
+#include "nmea.h"
+#include "skytraq.h"
+#include "skytraq_test.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using std::ifstream;
+using std::string;
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SkytraqTest );
+
+/*
+ * The fixes of gps/nmea_lap.log as navigation data messages, the way a
+ * Venus 8 sends them in binary mode.
+ */
+#define CORPUS_FILE		"gps/skytraq_lap.bin"
+#define NMEA_CORPUS_FILE	"gps/nmea_lap.log"
+#define CORPUS_FIXES		600
+#define BENCHMARK_ROUNDS	20
+#define NAVIGATION_DATA_LEN	59
+
+static string read_file(const string &name)
+{
+        ifstream f(name.c_str(), std::ios::binary);
+        if (!f.is_open())
+                f.open(("test/" + name).c_str(), std::ios::binary);
+        CPPUNIT_ASSERT(f.is_open());
+
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+}
+
+static enum skytraq_result feed(struct skytraq_parser *p, const uint8_t *b,
+                                const size_t len)
+{
+        enum skytraq_result res = SKYTRAQ_PENDING;
+        for (size_t i = 0; i < len; ++i) {
+                const enum skytraq_result r = skytraq_feed(p, b[i]);
+                if (SKYTRAQ_PENDING != r)
+                        res = r;
+        }
+        return res;
+}
+
+static void put_u16(uint8_t *b, const uint16_t v)
+{
+        b[0] = v >> 8;
+        b[1] = v;
+}
+
+static void put_u32(uint8_t *b, const uint32_t v)
+{
+        put_u16(b, v >> 16);
+        put_u16(b + 2, v);
+}
+
+static size_t navigation_frame(uint8_t *buf, const uint8_t fix_mode,
+                               const uint16_t week, const uint32_t tow)
+{
+        uint8_t nav[NAVIGATION_DATA_LEN];
+        memset(nav, 0, sizeof(nav));
+        nav[0] = SKYTRAQ_MSG_NAVIGATION_DATA;
+        nav[1] = fix_mode;
+        nav[2] = 11;
+        put_u16(nav + 3, week);
+        put_u32(nav + 5, tow);
+        put_u32(nav + 9, (uint32_t) -377522550);
+        put_u32(nav + 13, (uint32_t) -1224109183);
+        put_u32(nav + 21, 1240);
+        put_u16(nav + 27, 124);
+        put_u32(nav + 47, 300);
+        put_u32(nav + 51, (uint32_t) -400);
+        put_u32(nav + 55, 0);
+
+        return skytraq_frame(buf, SKYTRAQ_MAX_PAYLOAD + 7, nav, sizeof(nav));
+}
+
+void SkytraqTest::framingTest()
+{
+        const uint8_t ack[] = { SKYTRAQ_MSG_ACK, 0x09 };
+        uint8_t buf[16];
+        const size_t len = skytraq_frame(buf, sizeof(buf), ack, sizeof(ack));
+
+        const uint8_t expected[] = {
+                0xA0, 0xA1, 0x00, 0x02, 0x83, 0x09, 0x8A, 0x0D, 0x0A
+        };
+        CPPUNIT_ASSERT_EQUAL(sizeof(expected), len);
+        for (size_t i = 0; i < len; ++i)
+                CPPUNIT_ASSERT_EQUAL(expected[i], buf[i]);
+
+        /* Does not fit */
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, skytraq_frame(buf, 8, ack, 2));
+
+        struct skytraq_parser p;
+        skytraq_init(&p);
+        for (size_t i = 0; i < 6; ++i)
+                CPPUNIT_ASSERT_EQUAL(SKYTRAQ_PENDING, skytraq_feed(&p, buf[i]));
+
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, skytraq_feed(&p, buf[6]));
+        CPPUNIT_ASSERT_EQUAL((uint8_t) SKYTRAQ_MSG_ACK, skytraq_message_id(&p));
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, skytraq_payload_len(&p));
+        CPPUNIT_ASSERT_EQUAL((uint8_t) 0x09, skytraq_payload(&p)[1]);
+
+        /* The CR LF is just noise between frames */
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_PENDING, feed(&p, buf + 7, 2));
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, p.stats.messages);
+}
+
+void SkytraqTest::checksumTest()
+{
+        const uint8_t ack[] = { SKYTRAQ_MSG_ACK, 0x09 };
+        uint8_t buf[16];
+        const size_t len = skytraq_frame(buf, sizeof(buf), ack, sizeof(ack));
+
+        struct skytraq_parser p;
+        skytraq_init(&p);
+        buf[5] ^= 0x10;
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_ERROR, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, p.stats.checksum_errors);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.messages);
+
+        buf[5] ^= 0x10;
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, p.stats.messages);
+}
+
+void SkytraqTest::lengthTest()
+{
+        struct skytraq_parser p;
+        skytraq_init(&p);
+
+        const uint8_t empty[] = { 0xA0, 0xA1, 0x00, 0x00 };
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_ERROR, feed(&p, empty, sizeof(empty)));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, p.stats.framing_errors);
+
+        const uint8_t huge[] = { 0xA0, 0xA1, 0x01, 0x01 };
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_ERROR, feed(&p, huge, sizeof(huge)));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, p.stats.framing_errors);
+
+        /* The largest one there is */
+        uint8_t payload[SKYTRAQ_MAX_PAYLOAD];
+        memset(payload, 0x55, sizeof(payload));
+        uint8_t buf[SKYTRAQ_MAX_PAYLOAD + 7];
+        const size_t len = skytraq_frame(buf, sizeof(buf), payload,
+                                         sizeof(payload));
+        CPPUNIT_ASSERT_EQUAL(sizeof(buf), len);
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL((size_t) SKYTRAQ_MAX_PAYLOAD,
+                             skytraq_payload_len(&p));
+}
+
+void SkytraqTest::resyncTest()
+{
+        struct skytraq_parser p;
+        skytraq_init(&p);
+
+        /* What is left of the NMEA output before binary mode kicks in */
+        const char *nmea = "$GPGGA,140526.301,4748.4332,N,12220.7985,W,1,"
+                "9,0.92,12.4,M,-17.2,M,,*5D\r\n";
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_PENDING,
+                             feed(&p, (const uint8_t *) nmea, strlen(nmea)));
+
+        const uint8_t noise[] = { 0x00, 0xA0, 0xA0, 0xFF, 0xA0 };
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_PENDING, feed(&p, noise, sizeof(noise)));
+
+        /* A repeated sync byte still lines up */
+        uint8_t buf[SKYTRAQ_MAX_PAYLOAD + 7];
+        const size_t len = navigation_frame(buf, 2, 1790, 13714230);
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, feed(&p, buf, len));
+
+        /* Cut off half way.  The next whole frame still comes through */
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_PENDING, feed(&p, buf, 20));
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_ERROR, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL(SKYTRAQ_READY, feed(&p, buf, len));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, p.stats.messages);
+}
+
+void SkytraqTest::decodeNavigationTest()
+{
+        struct skytraq_parser p;
+        skytraq_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        uint8_t buf[SKYTRAQ_MAX_PAYLOAD + 7];
+
+        feed(&p, buf, navigation_frame(buf, 2, 1790, 13714230));
+        CPPUNIT_ASSERT(skytraq_decode_navigation(&p, &s));
+        CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_3D, s.quality);
+        CPPUNIT_ASSERT_EQUAL(11, (int) s.satellites);
+        CPPUNIT_ASSERT_EQUAL((int32_t) -377522550, s.point.latitude);
+        CPPUNIT_ASSERT_EQUAL((int32_t) -1224109183, s.point.longitude);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(12.4 * 3.28084, s.altitude, 0.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.24, s.DOP, 0.0001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(18.0, s.speed, 0.0001);
+        /* 2014-04-28 14:05:26.300 UTC.  GPS was 16s ahead */
+        CPPUNIT_ASSERT_EQUAL((millis_t) 1398693926300LL, s.time);
+
+        /* 2018-05-06 00:00:00 UTC.  18s by then */
+        feed(&p, buf, navigation_frame(buf, 3, 2000, 1800));
+        CPPUNIT_ASSERT(skytraq_decode_navigation(&p, &s));
+        CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_3D_DGNSS, s.quality);
+        CPPUNIT_ASSERT_EQUAL((millis_t) 1525564800000LL, s.time);
+
+        feed(&p, buf, navigation_frame(buf, 1, 2000, 1800));
+        CPPUNIT_ASSERT(skytraq_decode_navigation(&p, &s));
+        CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_2D, s.quality);
+
+        feed(&p, buf, navigation_frame(buf, 0, 2000, 1800));
+        CPPUNIT_ASSERT(skytraq_decode_navigation(&p, &s));
+        CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_NO_FIX, s.quality);
+
+        /* Not navigation data */
+        const uint8_t ack[] = { SKYTRAQ_MSG_ACK, 0x09 };
+        feed(&p, buf, skytraq_frame(buf, sizeof(buf), ack, sizeof(ack)));
+        CPPUNIT_ASSERT(!skytraq_decode_navigation(&p, &s));
+
+        /* Navigation data, but too short */
+        uint8_t nav[NAVIGATION_DATA_LEN];
+        memset(nav, 0, sizeof(nav));
+        nav[0] = SKYTRAQ_MSG_NAVIGATION_DATA;
+        feed(&p, buf, skytraq_frame(buf, sizeof(buf), nav, sizeof(nav) - 1));
+        CPPUNIT_ASSERT(!skytraq_decode_navigation(&p, &s));
+}
+
+/* What the NMEA parser makes of the same fixes */
+static vector<GpsSample> load_nmea_samples(const string &corpus)
+{
+        struct nmea_parser p;
+        nmea_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        vector<GpsSample> samples;
+
+        for (const char *c = corpus.c_str(); *c; ++c)
+                if (NMEA_READY == nmea_feed(&p, *c) &&
+                    NMEA_VTG == nmea_decode(&p, &s))
+                        samples.push_back(s);
+
+        return samples;
+}
+
+void SkytraqTest::corpusTest()
+{
+        const string corpus = read_file(CORPUS_FILE);
+        const vector<GpsSample> nmea =
+                load_nmea_samples(read_file(NMEA_CORPUS_FILE));
+        CPPUNIT_ASSERT_EQUAL((size_t) CORPUS_FIXES, nmea.size());
+
+        struct skytraq_parser p;
+        skytraq_init(&p);
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        size_t updates = 0;
+        const uint8_t *b = (const uint8_t *) corpus.data();
+
+        for (size_t i = 0; i < corpus.size(); ++i) {
+                if (SKYTRAQ_READY != skytraq_feed(&p, b[i]))
+                        continue;
+
+                CPPUNIT_ASSERT(skytraq_decode_navigation(&p, &s));
+
+                /*
+                 * Binary has the full 1e-7 degrees.  NMEA only has 4
+                 * decimals on the minutes.
+                 */
+                const GpsSample &n = nmea[updates++];
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(n.point.latitude,
+                                             s.point.latitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(n.point.longitude,
+                                             s.point.longitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(n.speed, s.speed, 0.05);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(n.altitude * 3.28084,
+                                             s.altitude, 0.01);
+                /* Time of week only has 1/100 s */
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(n.time, s.time, 10);
+                CPPUNIT_ASSERT_EQUAL(GPS_QUALITY_3D, s.quality);
+                CPPUNIT_ASSERT_EQUAL(9, (int) s.satellites);
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) CORPUS_FIXES, updates);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) CORPUS_FIXES, p.stats.messages);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.checksum_errors);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, p.stats.framing_errors);
+}
+
+void SkytraqTest::parseBenchmark()
+{
+        const string corpus = read_file(CORPUS_FILE);
+        const string nmea_corpus = read_file(NMEA_CORPUS_FILE);
+        const uint8_t *b = (const uint8_t *) corpus.data();
+        GpsSample s;
+        memset(&s, 0, sizeof(s));
+        size_t nmea_updates = 0;
+        size_t updates = 0;
+
+        struct nmea_parser np;
+        nmea_init(&np);
+        clock_t start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r) {
+                for (const char *c = nmea_corpus.c_str(); *c; ++c)
+                        if (NMEA_READY == nmea_feed(&np, *c))
+                                nmea_updates += NMEA_VTG == nmea_decode(&np, &s);
+        }
+        const double nmea_s = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        struct skytraq_parser p;
+        skytraq_init(&p);
+        start = clock();
+        for (size_t r = 0; r < BENCHMARK_ROUNDS; ++r) {
+                for (size_t i = 0; i < corpus.size(); ++i)
+                        if (SKYTRAQ_READY == skytraq_feed(&p, b[i]))
+                                updates += skytraq_decode_navigation(&p, &s);
+        }
+        const double binary_s = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        const double fixes = (double) BENCHMARK_ROUNDS * CORPUS_FIXES;
+        printf("\r\nGPS fix: NMEA %.0fns (%u bytes), binary %.0fns "
+               "(%u bytes)\r\n", nmea_s * 1e9 / fixes,
+               (unsigned) (nmea_corpus.size() / CORPUS_FIXES),
+               binary_s * 1e9 / fixes,
+               (unsigned) (corpus.size() / CORPUS_FIXES));
+
+        CPPUNIT_ASSERT_EQUAL((size_t) BENCHMARK_ROUNDS * CORPUS_FIXES,
+                             nmea_updates);
+        CPPUNIT_ASSERT_EQUAL((size_t) BENCHMARK_ROUNDS * CORPUS_FIXES, updates);
+}
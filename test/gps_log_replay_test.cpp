@@ -0,0 +1,513 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GpsLogReader.h"
+#include "GpsLogReplay.h"
+#include "capabilities.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "gps_log_replay_test.h"
+#include "mod_string.h"
+#include "predictive_timer_2.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( GpsLogReplayTest );
+
+#define CORPUS_FIXES	600
+#define MPH_TO_KPH	1.609344
+
+/*
+ * Every replay file checked in.  A new recorded session goes in here once
+ * its results have been recorded with gpsreplay -w.  It should hold at
+ * least one whole lap; the NMEA and Skytraq corpora do not, which is why
+ * they are only checked against the CSV log in readerFormatsTest.
+ */
+static const char *replays[] = {
+        "replay/lap.replay",
+        "replay/lap2.replay",
+};
+
+/*
+ * The start of predictive_time_test_lap.log is also checked in as NMEA and
+ * as Skytraq binary.  All three must give the same fixes.
+ */
+void GpsLogReplayTest::readerFormatsTest()
+{
+        GpsLogReader csv("predictive_time_test_lap.log");
+        GpsLogReader nmea("gps/nmea_lap.log");
+        GpsLogReader skytraq("gps/skytraq_lap.bin");
+        CPPUNIT_ASSERT_EQUAL(GpsLogReader::FORMAT_CSV, csv.format());
+        CPPUNIT_ASSERT_EQUAL(GpsLogReader::FORMAT_NMEA, nmea.format());
+        CPPUNIT_ASSERT_EQUAL(GpsLogReader::FORMAT_SKYTRAQ, skytraq.format());
+
+        GpsSample c, n, s;
+        GpsSample c0, n0, s0;
+        for (size_t i = 0; i < CORPUS_FIXES; ++i) {
+                CPPUNIT_ASSERT(csv.next(&c));
+                CPPUNIT_ASSERT(nmea.next(&n));
+                CPPUNIT_ASSERT(skytraq.next(&s));
+
+                /* NMEA only has 4 decimals on the minutes */
+                CPPUNIT_ASSERT_EQUAL(c.point.latitude, s.point.latitude);
+                CPPUNIT_ASSERT_EQUAL(c.point.longitude, s.point.longitude);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(c.point.latitude,
+                                             n.point.latitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(c.point.longitude,
+                                             n.point.longitude, 9);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(c.speed, n.speed, 0.01);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(c.speed, s.speed, 0.05);
+
+                /*
+                 * The logs are of different days, so only the times since
+                 * the first fix.  Skytraq only has 1/100 s.
+                 */
+                if (!i) {
+                        c0 = c;
+                        n0 = n;
+                        s0 = s;
+                }
+                CPPUNIT_ASSERT_EQUAL(c.time - c0.time, n.time - n0.time);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(c.time - c0.time,
+                                             s.time - s0.time, 10);
+        }
+
+        /* The CSV log is in MPH */
+        csv.rewind();
+        CPPUNIT_ASSERT(csv.next(&c));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(8.90 * MPH_TO_KPH, c.speed, 0.001);
+}
+
+void GpsLogReplayTest::goldenTest()
+{
+        for (size_t i = 0; i < sizeof(replays) / sizeof(*replays); ++i) {
+                const GpsLogReplay replay(replays[i]);
+                CPPUNIT_ASSERT(replay.hasGolden());
+
+                const ReplayResult r = replay.run();
+                const ReplayResult &g = replay.golden();
+
+                printf("\r\nReplay %s: %u laps, %u fixes at %.2fus, predicted "
+                       "lap time %dms average %dms worst error\r\n",
+                       replays[i], (unsigned) r.laps.size(),
+                       (unsigned) r.updates, r.usPerUpdate,
+                       r.predictedErrorAvg, r.predictedErrorMax);
+
+                CPPUNIT_ASSERT_EQUAL(g.laps.size(), r.laps.size());
+                for (size_t l = 0; l < r.laps.size(); ++l) {
+                        CPPUNIT_ASSERT_EQUAL(g.laps[l].time, r.laps[l].time);
+                        CPPUNIT_ASSERT(g.laps[l].sectors == r.laps[l].sectors);
+                }
+
+                /*
+                 * Better predictions are welcome, but then record them so
+                 * that they stay that way.
+                 */
+                CPPUNIT_ASSERT(r.predictedErrorAvg <= g.predictedErrorAvg);
+                CPPUNIT_ASSERT(r.predictedErrorMax <= g.predictedErrorMax);
+        }
+}
+
+/*
+ * The predictive timer as it was before the reference lap became a
+ * polyline in a local frame: points picked by time and a scan of all of
+ * them, with a distPythag per point, for every lookup.  Kept here to
+ * benchmark against.
+ */
+struct BaselinePoint {
+        GeoPoint point;
+        tiny_millis_t time;
+};
+
+static bool baselineInBounds(float v)
+{
+        return v >= 0 && v <= 1;
+}
+
+static bool baselineSplit(const vector<BaselinePoint> &ref, const GeoPoint *p,
+                          const tiny_millis_t lapTime, tiny_millis_t *split)
+{
+        const int count = ref.size();
+        int best = 0;
+        float bestDist = distPythag(p, &ref[0].point);
+        for (int i = 1; i < count; ++i) {
+                const float d = distPythag(p, &ref[i].point);
+                if (d < bestDist) {
+                        bestDist = d;
+                        best = i;
+                }
+        }
+
+        const float up = best + 1 < count ?
+                distPctBtwnTwoPoints(&ref[best].point, &ref[best + 1].point,
+                                     p) : -1;
+        const float dn = best > 0 ?
+                distPctBtwnTwoPoints(&ref[best].point, &ref[best - 1].point,
+                                     p) : -1;
+        if (!baselineInBounds(up) && !baselineInBounds(dn))
+                return false;
+
+        const BaselinePoint *a = &ref[best];
+        const BaselinePoint *b = &ref[baselineInBounds(up) ? best + 1 : best - 1];
+        if (b->time < a->time) {
+                const BaselinePoint *tmp = a;
+                a = b;
+                b = tmp;
+        }
+
+        const float pct = distPctBtwnTwoPoints(&a->point, &b->point, p);
+        if (!baselineInBounds(pct))
+                return false;
+
+        *split = a->time + (b->time - a->time) * pct - lapTime;
+        return true;
+}
+
+/* The reference as the old timer recorded it: a point every so often */
+static vector<BaselinePoint> baselineRecord(const vector<GpsSample> &fixes,
+                                            const ReplayLap &lap,
+                                            const size_t slots)
+{
+        const millis_t start = fixes[lap.startFix].time;
+        const tiny_millis_t interval = lap.time / (slots / 0.9);
+        vector<BaselinePoint> ref;
+
+        for (size_t i = lap.startFix; i < lap.endFix; ++i) {
+                const tiny_millis_t t = fixes[i].time - start;
+                if (ref.size() == slots - 1)
+                        break;
+                if (ref.size() && t - ref.back().time < interval)
+                        continue;
+
+                const BaselinePoint bp = { fixes[i].point, t };
+                ref.push_back(bp);
+        }
+
+        const BaselinePoint last = { fixes[lap.endFix - 1].point,
+                                     (tiny_millis_t) (fixes[lap.endFix - 1].time -
+                                                      start) };
+        ref.push_back(last);
+        return ref;
+}
+
+/*
+ * Records the reference lap into the predictive timer the way lap_stats
+ * does.  Twice, so that the second time round the spacing is set from the
+ * length of the lap.  Leaves the timer at the start of the given lap, with
+ * the reference lap as the target lap too if asked.
+ */
+static void predictiveRecord(const vector<GpsSample> &fixes,
+                             const ReplayLap &ref, const ReplayLap &lap,
+                             const bool target = false)
+{
+        const millis_t start = fixes[ref.startFix].time;
+        resetPredictiveTimer();
+
+        for (int pass = 0; pass < 2; ++pass) {
+                startLap(&fixes[ref.startFix].point, 0);
+                for (size_t i = ref.startFix + 1; i < ref.endFix; ++i) {
+                        GpsSnapshot snap;
+                        memset(&snap, 0, sizeof(snap));
+                        snap.sample = fixes[i];
+                        snap.deltaFirstFix = fixes[i].time - start;
+                        addGpsSample(&snap);
+                }
+                finishLap(&fixes[ref.endFix - 1].point,
+                          fixes[ref.endFix - 1].time - start);
+        }
+
+        if (target)
+                CPPUNIT_ASSERT(setTargetLap(PREDICTIVE_REF_BEST));
+        startLap(&fixes[lap.startFix].point, 0);
+}
+
+/*
+ * Looks up every fix of lap.replay on the fastest of its laps: the old
+ * timer with its 96 points and with a point for every fix, against the
+ * windowed search over as many points as the test build allows.  The
+ * fastest lap is also looked up on itself, where the split should be 0
+ * all the way round: how far off it is, is down to the reference.
+ */
+void GpsLogReplayTest::predictiveTimerBenchmark()
+{
+        const GpsLogReplay replay("replay/lap.replay");
+        const ReplayResult r = replay.run();
+        CPPUNIT_ASSERT(r.laps.size() > 1);
+
+        vector<GpsSample> fixes;
+        GpsLogReader reader(replay.logName());
+        for (GpsSample s; reader.next(&s);)
+                fixes.push_back(s);
+
+        size_t fast = 0;
+        for (size_t l = 1; l < r.laps.size(); ++l)
+                if (r.laps[l].time < r.laps[fast].time)
+                        fast = l;
+        const ReplayLap &ref = r.laps[fast];
+
+        const vector<BaselinePoint> ref96 = baselineRecord(fixes, ref, 96);
+        const vector<BaselinePoint> refAll =
+                baselineRecord(fixes, ref, ref.endFix - ref.startFix);
+
+        double oldSeconds = 0, oldAllSeconds = 0, newSeconds = 0;
+        double oldSelfError = 0, newSelfError = 0;
+        size_t lookups = 0, selfLookups = 0;
+
+        for (size_t l = 0; l < r.laps.size(); ++l) {
+                const ReplayLap &lap = r.laps[l];
+                const millis_t start = fixes[lap.startFix].time;
+                tiny_millis_t oldSplit = 0, newSplit = 0;
+                predictiveRecord(fixes, ref, lap);
+
+                clock_t c = clock();
+                for (size_t i = lap.startFix; i < lap.endFix; ++i)
+                        newSplit = getSplitAgainstFastLap(&fixes[i].point,
+                                                          fixes[i].time - start);
+                newSeconds += (double) (clock() - c) / CLOCKS_PER_SEC;
+
+                c = clock();
+                for (size_t i = lap.startFix; i < lap.endFix; ++i)
+                        baselineSplit(refAll, &fixes[i].point,
+                                      fixes[i].time - start, &oldSplit);
+                oldAllSeconds += (double) (clock() - c) / CLOCKS_PER_SEC;
+
+                c = clock();
+                for (size_t i = lap.startFix; i < lap.endFix; ++i)
+                        baselineSplit(ref96, &fixes[i].point,
+                                      fixes[i].time - start, &oldSplit);
+                oldSeconds += (double) (clock() - c) / CLOCKS_PER_SEC;
+
+                lookups += lap.endFix - lap.startFix;
+                if (l != fast)
+                        continue;
+
+                /* The lookups again, one at a time, for their errors */
+                predictiveRecord(fixes, ref, lap);
+                for (size_t i = lap.startFix; i < lap.endFix; ++i) {
+                        const tiny_millis_t t = fixes[i].time - start;
+                        newSplit = getSplitAgainstFastLap(&fixes[i].point, t);
+                        baselineSplit(ref96, &fixes[i].point, t, &oldSplit);
+                        newSelfError += abs(newSplit);
+                        oldSelfError += abs(oldSplit);
+                        ++selfLookups;
+                }
+        }
+
+        printf("\r\nPredictive timer (%u lookups): linear scan %.0fns on %u "
+               "points, %.0fns on %u points, windowed %.0fns on up to %u "
+               "points\r\n", (unsigned) lookups, oldSeconds * 1e9 / lookups,
+               (unsigned) ref96.size(), oldAllSeconds * 1e9 / lookups,
+               (unsigned) refAll.size(), newSeconds * 1e9 / lookups,
+               (unsigned) PREDICTIVE_TIMER_SAMPLES);
+        printf("Predictive timer split on its own reference lap: %.0fms "
+               "average error on %u points, %.0fms windowed\r\n",
+               oldSelfError / selfLookups, (unsigned) ref96.size(),
+               newSelfError / selfLookups);
+
+        CPPUNIT_ASSERT(newSelfError <= oldSelfError);
+}
+
+static tiny_millis_t drivenLapTime(const vector<GpsSample> &fixes,
+                                   const ReplayLap &lap)
+{
+        return fixes[lap.endFix - 1].time - fixes[lap.startFix].time;
+}
+
+/*
+ * Drives a lap through the predictive timer the way lap_stats does,
+ * looking up the split against every reference at each fix.
+ */
+static void driveLap(const vector<GpsSample> &fixes, const ReplayLap &lap,
+                     vector<tiny_millis_t> splits[PREDICTIVE_TIMER_REFS])
+{
+        const millis_t start = fixes[lap.startFix].time;
+        startLap(&fixes[lap.startFix].point, 0);
+
+        for (size_t r = 0; r < PREDICTIVE_TIMER_REFS; ++r)
+                splits[r].clear();
+
+        for (size_t i = lap.startFix + 1; i < lap.endFix; ++i) {
+                GpsSnapshot snap;
+                memset(&snap, 0, sizeof(snap));
+                snap.sample = fixes[i];
+                snap.deltaFirstFix = fixes[i].time - start;
+                addGpsSample(&snap);
+
+                for (size_t r = 0; r < PREDICTIVE_TIMER_REFS; ++r)
+                        splits[r].push_back(getSplitAgainstReference(
+                                                    (enum PredictiveRef) r,
+                                                    &fixes[i].point,
+                                                    snap.deltaFirstFix));
+        }
+
+        finishLap(&fixes[lap.endFix - 1].point, drivenLapTime(fixes, lap));
+}
+
+/*
+ * The best lap, the session best and a target lap, through a session that
+ * starts from a saved best lap.  The target must stay the lap it was
+ * copied from while the laps around it come and go.
+ */
+void GpsLogReplayTest::referencesTest()
+{
+        CPPUNIT_ASSERT(PREDICTIVE_TIMER_REFS >= 3);
+
+        const GpsLogReplay replay("replay/lap.replay");
+        const ReplayResult r = replay.run();
+        CPPUNIT_ASSERT(r.laps.size() > 2);
+
+        vector<GpsSample> fixes;
+        GpsLogReader reader(replay.logName());
+        for (GpsSample s; reader.next(&s);)
+                fixes.push_back(s);
+
+        size_t fast = 0, slow = 0;
+        for (size_t l = 1; l < r.laps.size(); ++l) {
+                if (drivenLapTime(fixes, r.laps[l]) <
+                    drivenLapTime(fixes, r.laps[fast]))
+                        fast = l;
+                if (drivenLapTime(fixes, r.laps[l]) >
+                    drivenLapTime(fixes, r.laps[slow]))
+                        slow = l;
+        }
+        const tiny_millis_t fastTime = drivenLapTime(fixes, r.laps[fast]);
+        const tiny_millis_t slowTime = drivenLapTime(fixes, r.laps[slow]);
+        CPPUNIT_ASSERT(fastTime < slowTime);
+
+        vector<tiny_millis_t> splits[PREDICTIVE_TIMER_REFS];
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(!setTargetLap(PREDICTIVE_REF_SESSION));
+
+        /* With no saved lap the best and the session best are the same */
+        for (size_t l = 0; l < r.laps.size(); ++l)
+                driveLap(fixes, r.laps[l], splits);
+        CPPUNIT_ASSERT_EQUAL(fastTime, getReferenceLapTime(PREDICTIVE_REF_BEST));
+        CPPUNIT_ASSERT_EQUAL(fastTime,
+                             getReferenceLapTime(PREDICTIVE_REF_SESSION));
+        CPPUNIT_ASSERT(!isReferenceAvailable(PREDICTIVE_REF_TARGET));
+
+        /* The target is taken up with the next lap */
+        CPPUNIT_ASSERT(setTargetLap(PREDICTIVE_REF_SESSION));
+        driveLap(fixes, r.laps[slow], splits);
+        CPPUNIT_ASSERT_EQUAL(fastTime,
+                             getReferenceLapTime(PREDICTIVE_REF_TARGET));
+        for (size_t i = 0; i < splits[0].size(); ++i)
+                CPPUNIT_ASSERT_EQUAL(splits[PREDICTIVE_REF_SESSION][i],
+                                     splits[PREDICTIVE_REF_TARGET][i]);
+
+        /* A new session from the saved best lap */
+        uint8_t buf[FAST_LAP_SAVE_SIZE];
+        const size_t len = saveFastLap(1, 2, buf, sizeof(buf));
+        CPPUNIT_ASSERT(len);
+        resetPredictiveTimer();
+        CPPUNIT_ASSERT(loadFastLap(1, 2, buf, len));
+        CPPUNIT_ASSERT(isReferenceAvailable(PREDICTIVE_REF_BEST));
+        CPPUNIT_ASSERT(!isReferenceAvailable(PREDICTIVE_REF_SESSION));
+        CPPUNIT_ASSERT(!isReferenceAvailable(PREDICTIVE_REF_TARGET));
+
+        CPPUNIT_ASSERT(setTargetLap(PREDICTIVE_REF_BEST));
+        vector<tiny_millis_t> targetSplits[PREDICTIVE_TIMER_REFS];
+        driveLap(fixes, r.laps[slow], targetSplits);
+        CPPUNIT_ASSERT_EQUAL(fastTime, getReferenceLapTime(PREDICTIVE_REF_BEST));
+        CPPUNIT_ASSERT_EQUAL(slowTime,
+                             getReferenceLapTime(PREDICTIVE_REF_SESSION));
+        CPPUNIT_ASSERT_EQUAL(fastTime,
+                             getReferenceLapTime(PREDICTIVE_REF_TARGET));
+
+        /*
+         * Driving the fastest lap again takes over the best lap from the
+         * saved one.  The target still has the saved one.
+         */
+        for (size_t l = 0; l < r.laps.size(); ++l)
+                driveLap(fixes, r.laps[l], splits);
+        CPPUNIT_ASSERT_EQUAL(fastTime,
+                             getReferenceLapTime(PREDICTIVE_REF_SESSION));
+        driveLap(fixes, r.laps[slow], splits);
+        for (size_t i = 0; i < splits[0].size(); ++i) {
+                CPPUNIT_ASSERT_EQUAL(targetSplits[PREDICTIVE_REF_TARGET][i],
+                                     splits[PREDICTIVE_REF_TARGET][i]);
+                CPPUNIT_ASSERT_EQUAL(splits[PREDICTIVE_REF_BEST][i],
+                                     splits[PREDICTIVE_REF_SESSION][i]);
+        }
+
+        /* Dropping the target */
+        CPPUNIT_ASSERT(setTargetLap(PREDICTIVE_REF_TARGET));
+        driveLap(fixes, r.laps[slow], splits);
+        CPPUNIT_ASSERT(!isReferenceAvailable(PREDICTIVE_REF_TARGET));
+        CPPUNIT_ASSERT_EQUAL((tiny_millis_t) 0, splits[PREDICTIVE_REF_TARGET].back());
+}
+
+/*
+ * The cost of a lookup against one, two and three references.  Each one
+ * keeps its own place on its lap, so the cost should grow linearly.
+ */
+void GpsLogReplayTest::referencesBenchmark()
+{
+        const GpsLogReplay replay("replay/lap.replay");
+        const ReplayResult r = replay.run();
+        CPPUNIT_ASSERT(r.laps.size() > 1);
+
+        vector<GpsSample> fixes;
+        GpsLogReader reader(replay.logName());
+        for (GpsSample s; reader.next(&s);)
+                fixes.push_back(s);
+
+        size_t fast = 0;
+        for (size_t l = 1; l < r.laps.size(); ++l)
+                if (r.laps[l].time < r.laps[fast].time)
+                        fast = l;
+
+        double seconds[PREDICTIVE_TIMER_REFS] = { 0 };
+        size_t lookups = 0;
+
+        for (size_t n = 0; n < PREDICTIVE_TIMER_REFS; ++n) {
+                lookups = 0;
+                for (size_t l = 0; l < r.laps.size(); ++l) {
+                        const ReplayLap &lap = r.laps[l];
+                        const millis_t start = fixes[lap.startFix].time;
+                        predictiveRecord(fixes, r.laps[fast], lap, true);
+
+                        const clock_t c = clock();
+                        for (size_t i = lap.startFix; i < lap.endFix; ++i)
+                                for (size_t ref = 0; ref <= n; ++ref)
+                                        getSplitAgainstReference(
+                                                (enum PredictiveRef) ref,
+                                                &fixes[i].point,
+                                                fixes[i].time - start);
+                        seconds[n] += (double) (clock() - c) / CLOCKS_PER_SEC;
+                        lookups += lap.endFix - lap.startFix;
+                }
+        }
+
+        printf("\r\nPredictive timer (%u fixes):", (unsigned) lookups);
+        for (size_t n = 0; n < PREDICTIVE_TIMER_REFS; ++n)
+                printf(" %.0fns per fix with %u reference%s%s",
+                       seconds[n] * 1e9 / lookups, (unsigned) n + 1,
+                       n ? "s" : "", n + 1 < PREDICTIVE_TIMER_REFS ? "," : "");
+        printf("\r\n");
+}
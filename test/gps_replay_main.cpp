@@ -0,0 +1,136 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays recorded GPS logs through the lap timing chain and reports the
+ * laps, the sector times, how good the predicted lap times were and how
+ * long each fix took.  If a replay file has recorded results, they are
+ * checked.  See GpsLogReplay.h for the file format.
+ *
+ *   gpsreplay [-w] file.replay...
+ *
+ *   -w  Record the results in the replay files instead of checking them
+ */
+
+#include "GpsLogReplay.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using std::string;
+
+static void report(const char *name, const ReplayResult &r)
+{
+        printf("%s: %u fixes, %.2fus per fix\n", name, (unsigned) r.updates,
+               r.usPerUpdate);
+
+        for (size_t i = 0; i < r.laps.size(); ++i) {
+                const ReplayLap &lap = r.laps[i];
+                printf("  lap %2u %s |", (unsigned) i + 1,
+                       replayFormatTime(lap.time).c_str());
+                for (size_t s = 0; s < lap.sectors.size(); ++s)
+                        printf(" %s", replayFormatTime(lap.sectors[s]).c_str());
+                printf("\n");
+        }
+
+        printf("  predicted lap time error: %dms average, %dms worst over "
+               "%u predictions\n", r.predictedErrorAvg, r.predictedErrorMax,
+               (unsigned) r.predictions);
+}
+
+static bool sameLaps(const ReplayResult &a, const ReplayResult &b)
+{
+        if (a.laps.size() != b.laps.size())
+                return false;
+
+        for (size_t i = 0; i < a.laps.size(); ++i)
+                if (a.laps[i].time != b.laps[i].time ||
+                    a.laps[i].sectors != b.laps[i].sectors)
+                        return false;
+
+        return true;
+}
+
+static bool replay(const char *name, const bool write)
+{
+        try {
+                const GpsLogReplay replay(name);
+                const ReplayResult r = replay.run();
+                report(name, r);
+
+                if (write) {
+                        if (!replay.record(r)) {
+                                printf("  could not write %s\n", name);
+                                return false;
+                        }
+                        printf("  recorded\n");
+                        return true;
+                }
+
+                if (!replay.hasGolden())
+                        return true;
+
+                const ReplayResult &g = replay.golden();
+                if (!sameLaps(r, g)) {
+                        printf("  FAIL: laps differ from the recorded ones\n");
+                        return false;
+                }
+
+                if (r.predictedErrorAvg > g.predictedErrorAvg ||
+                    r.predictedErrorMax > g.predictedErrorMax) {
+                        printf("  FAIL: predictions worse than the recorded "
+                               "%dms average, %dms worst\n",
+                               g.predictedErrorAvg, g.predictedErrorMax);
+                        return false;
+                }
+
+                printf("  matches the recorded results\n");
+                return true;
+        } catch (const string &e) {
+                printf("%s: %s\n", name, e.c_str());
+                return false;
+        }
+}
+
+int main(int argc, char **argv)
+{
+        bool write = false;
+        bool ok = true;
+        int files = 0;
+
+        for (int i = 1; i < argc; ++i) {
+                if (0 == strcmp(argv[i], "-w")) {
+                        write = true;
+                        continue;
+                }
+
+                ok = replay(argv[i], write) && ok;
+                ++files;
+        }
+
+        if (!files) {
+                fprintf(stderr, "usage: %s [-w] file.replay...\n", argv[0]);
+                return 2;
+        }
+
+        return ok ? 0 : 1;
+}
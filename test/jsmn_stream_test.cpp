@@ -0,0 +1,349 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.h"
+#include "jsmn_stream.h"
+#include "jsmn_stream_test.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "luaScript.h"
+#include "mock_serial.h"
+#include "tracks.h"
+
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( JsmnStreamTest );
+
+/* Containers at or below this depth are captured whole */
+static int g_capture_depth;
+static string g_events;
+
+static bool record_event(struct jsmn_stream_parser *p,
+                         jsmn_stream_event_t event, jsmntype_t type,
+                         char *data, size_t len, void *ctx)
+{
+        CPPUNIT_ASSERT_EQUAL(data ? strlen(data) : 0, len);
+
+        switch (event) {
+        case JSMN_STREAM_OBJECT_START:
+        case JSMN_STREAM_ARRAY_START:
+                if (g_capture_depth && p->depth >= g_capture_depth)
+                        return true;
+                g_events += JSMN_STREAM_OBJECT_START == event ? "{" : "[";
+                break;
+        case JSMN_STREAM_OBJECT_END:
+                g_events += "}";
+                break;
+        case JSMN_STREAM_ARRAY_END:
+                g_events += "]";
+                break;
+        case JSMN_STREAM_KEY:
+                g_events += "k:" + string(data) + " ";
+                break;
+        case JSMN_STREAM_VALUE:
+                g_events += (JSMN_STRING == type ? "s:" :
+                             JSMN_PRIMITIVE == type ? "p:" : "c:");
+                g_events += string(data) + " ";
+                break;
+        case JSMN_STREAM_VALUE_PART:
+                g_events += "+:" + string(data) + " ";
+                break;
+        }
+        return false;
+}
+
+static jsmnerr_t parse_whole(struct jsmn_stream_parser *p, const string &js)
+{
+        jsmn_stream_init(p, record_event, NULL);
+        return jsmn_stream_parse(p, js.c_str(), js.size());
+}
+
+/* Feeds a streamed API message in small pieces, like a slow link would */
+static char* stream_message(const string &msg, const size_t chunk)
+{
+        mock_resetTxBuffer();
+        api_stream_begin(getMockSerial());
+        for (size_t i = 0; i < msg.size(); i += chunk) {
+                const string piece = msg.substr(i, chunk);
+                api_stream_feed(piece.c_str(), piece.size());
+        }
+        api_stream_end();
+        return mock_getTxBuffer();
+}
+
+static string track_json(const int id)
+{
+        std::ostringstream js;
+        js << "{\"id\":" << id << ",\"type\":0,\"sf\":[" << id
+           << ".5,-122.25],\"sec\":[";
+        for (int i = 0; i < CIRCUIT_SECTOR_COUNT; ++i)
+                js << (i ? "," : "") << "[" << id << "." << i + 1
+                   << ",-122." << i + 1 << "]";
+        js << "]}";
+        return js.str();
+}
+
+void JsmnStreamTest::setUp()
+{
+        g_capture_depth = 0;
+        g_events.clear();
+        initApi();
+        initialize_logger_config();
+        setupMockSerial();
+}
+
+void JsmnStreamTest::tearDown()
+{
+}
+
+void JsmnStreamTest::eventsTest()
+{
+        struct jsmn_stream_parser p;
+        const string js = "{\"a\": 1, \"b\" : [true, \"x\\\"y\", null],"
+                "\"c\":{\"d\":-2.5e3}, \"e\":[]}";
+
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS, parse_whole(&p, js));
+        CPPUNIT_ASSERT_EQUAL(string("{k:a p:1 k:b [p:true s:x\\\"y p:null ]"
+                                    "k:c {k:d p:-2.5e3 }k:e []}"), g_events);
+}
+
+void JsmnStreamTest::chunkedInputTest()
+{
+        struct jsmn_stream_parser p;
+        const string js = "{\"name\":\"value\",\"list\":[1,22,333]}";
+
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS, parse_whole(&p, js));
+        const string whole = g_events;
+
+        /* One byte at a time must give exactly the same events */
+        g_events.clear();
+        jsmn_stream_init(&p, record_event, NULL);
+        for (size_t i = 0; i < js.size() - 1; ++i)
+                CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_PART,
+                                     jsmn_stream_parse(&p, js.c_str() + i, 1));
+
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS,
+                             jsmn_stream_parse(&p, js.c_str() + js.size() - 1, 1));
+        CPPUNIT_ASSERT_EQUAL(whole, g_events);
+
+        /* Trailing whitespace is fine, anything else is not */
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS, jsmn_stream_parse(&p, " \r\n", 3));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, jsmn_stream_parse(&p, "{", 1));
+}
+
+void JsmnStreamTest::longStringTest()
+{
+        struct jsmn_stream_parser p;
+
+        /* Escapes placed so that some straddle the buffer boundary */
+        string content;
+        while (content.size() < JSMN_STREAM_BUFFER_SIZE * 3)
+                content += "ab\\ncd\\\"";
+
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS,
+                             parse_whole(&p, "[\"" + content + "\"]"));
+
+        string joined;
+        size_t pieces = 0;
+        std::istringstream events(g_events.substr(1, g_events.size() - 2));
+        string ev;
+        while (events >> ev) {
+                ++pieces;
+                joined += ev.substr(2);
+                if (ev[0] == 's')
+                        break;
+                CPPUNIT_ASSERT_EQUAL('+', ev[0]);
+                /* Never split in the middle of an escape */
+                CPPUNIT_ASSERT(ev[ev.size() - 1] != '\\' ||
+                               ev[ev.size() - 2] == '\\');
+        }
+        CPPUNIT_ASSERT(pieces > 3);
+        CPPUNIT_ASSERT_EQUAL(content, joined);
+
+        /* Keys and primitives have to fit */
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_NOMEM,
+                             parse_whole(&p, "{\"" + content + "\":1}"));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_NOMEM,
+                             parse_whole(&p, "[" + string(JSMN_STREAM_BUFFER_SIZE + 1, '1') + "]"));
+}
+
+void JsmnStreamTest::captureTest()
+{
+        struct jsmn_stream_parser p;
+        const string js = "{\"list\":[{\"a\":\"}]\",\"b\":[1,{}]}, [2,3], 4]}";
+
+        g_capture_depth = 3;
+        CPPUNIT_ASSERT_EQUAL(JSMN_SUCCESS, parse_whole(&p, js));
+        CPPUNIT_ASSERT_EQUAL(string("{k:list [c:{\"a\":\"}]\",\"b\":[1,{}]} "
+                                    "c:[2,3] p:4 ]}"), g_events);
+
+        /* A capture that doesn't fit is an error */
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_NOMEM,
+                             parse_whole(&p, "[[[\"" + string(JSMN_STREAM_BUFFER_SIZE, 'x') + "\"]]]"));
+}
+
+void JsmnStreamTest::errorTest()
+{
+        struct jsmn_stream_parser p;
+
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, parse_whole(&p, "{\"a\":1]"));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, parse_whole(&p, "{1:2}"));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, parse_whole(&p, "]"));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_NOMEM,
+                             parse_whole(&p, string(JSMN_STREAM_MAX_DEPTH + 1, '[')));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_PART, parse_whole(&p, "{\"a\":[1,2"));
+
+        /* Errors stick */
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, parse_whole(&p, "}"));
+        CPPUNIT_ASSERT_EQUAL(JSMN_ERROR_INVAL, jsmn_stream_parse(&p, "{}", 2));
+}
+
+void JsmnStreamTest::streamTrackDbTest()
+{
+        /* The whole DB in one message, far bigger than any line buffer */
+        string msg = "{\"addTrackDb\":{\"tracks\":[";
+        for (int i = 0; i < MAX_TRACK_COUNT; ++i)
+                msg += (i ? "," : "") + track_json(i + 1);
+        msg += "]}}";
+        CPPUNIT_ASSERT(msg.size() > 10000);
+
+        const char *reply = stream_message(msg, 64);
+        CPPUNIT_ASSERT_EQUAL(string("{\"addTrackDb\":{\"rc\":1}}\r\n"),
+                             string(reply));
+
+        const Tracks *tracks = get_tracks();
+        CPPUNIT_ASSERT_EQUAL((size_t) MAX_TRACK_COUNT, (size_t) tracks->count);
+        for (int i = 0; i < MAX_TRACK_COUNT; ++i) {
+                const Track *t = tracks->tracks + i;
+                CPPUNIT_ASSERT_EQUAL(i + 1, (int) t->trackId);
+                CPPUNIT_ASSERT_EQUAL(TRACK_TYPE_CIRCUIT, t->track_type);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(i + 1.5,
+                                             gp_to_degrees(t->circuit.startFinish.latitude),
+                                             0.0001);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(-122.1,
+                                             gp_to_degrees(t->circuit.sectors[0].longitude),
+                                             0.0001);
+        }
+}
+
+void JsmnStreamTest::parsedTrackDbTest()
+{
+        /* Small enough for the regular path, same form */
+        string msg = "{\"addTrackDb\":{\"tracks\":[" + track_json(7) + "," +
+                track_json(8) + "]}}";
+
+        mock_resetTxBuffer();
+        process_api(getMockSerial(), (char *) msg.c_str(), msg.size());
+        CPPUNIT_ASSERT_EQUAL(string("{\"addTrackDb\":{\"rc\":1}}\r\n"),
+                             string(mock_getTxBuffer()));
+
+        const Tracks *tracks = get_tracks();
+        CPPUNIT_ASSERT_EQUAL(2, (int) tracks->count);
+        CPPUNIT_ASSERT_EQUAL(7, (int) tracks->tracks[0].trackId);
+        CPPUNIT_ASSERT_EQUAL(8, (int) tracks->tracks[1].trackId);
+
+        /* An empty DB is not something we can flash */
+        msg = "{\"addTrackDb\":{\"tracks\":[]}}";
+        CPPUNIT_ASSERT_EQUAL(string("{\"addTrackDb\":{\"rc\":-2}}\r\n"),
+                             string(stream_message(msg, 8)));
+}
+
+void JsmnStreamTest::streamScriptTest()
+{
+        string script;
+        for (int i = 0; script.size() < SCRIPT_PAGE_SIZE * 5 + 17; ++i) {
+                char line[64];
+                sprintf(line, "x%d = %d\n", i, i);
+                script += line;
+        }
+
+        string escaped;
+        for (size_t i = 0; i < script.size(); ++i)
+                escaped += script[i] == '\n' ? string("\\n") : string(1, script[i]);
+
+        const string msg = "{\"setScriptCfg\":{\"data\":\"" + escaped + "\"}}";
+        CPPUNIT_ASSERT_EQUAL(string("{\"setScriptCfg\":{\"rc\":1}}\r\n"),
+                             string(stream_message(msg, 100)));
+        CPPUNIT_ASSERT_EQUAL(script, string(getScript()));
+
+        /* Too big for script memory */
+        const string huge = "{\"setScriptCfg\":{\"data\":\"" +
+                string(SCRIPT_MEMORY_LENGTH, 'x') + "\"}}";
+        CPPUNIT_ASSERT_EQUAL(string("{\"setScriptCfg\":{\"rc\":-1}}\r\n"),
+                             string(stream_message(huge, 100)));
+        CPPUNIT_ASSERT_EQUAL(script, string(getScript()));
+}
+
+void JsmnStreamTest::streamObd2Test()
+{
+        /* More PIDs than a single parsed message may carry */
+        string msg = "{\"setObd2Cfg\":{\"en\":1,\"pids\":[";
+        for (int i = 0; i < OBD2_CHANNELS; ++i) {
+                char pid[128];
+                sprintf(pid, "%s{\"nm\":\"Pid%d\",\"ut\":\"U\",\"min\":0,"
+                        "\"max\":100,\"sr\":10,\"prec\":1,\"pid\":%d}",
+                        i ? "," : "", i, i + 5);
+                msg += pid;
+        }
+        msg += "]}}";
+
+        CPPUNIT_ASSERT_EQUAL(string("{\"setObd2Cfg\":{\"rc\":1}}\r\n"),
+                             string(stream_message(msg, 50)));
+
+        OBD2Config *cfg = &getWorkingLoggerConfig()->OBD2Configs;
+        CPPUNIT_ASSERT_EQUAL(1, (int) cfg->enabled);
+        CPPUNIT_ASSERT_EQUAL(OBD2_CHANNELS, (int) cfg->enabledPids);
+        CPPUNIT_ASSERT_EQUAL(string("Pid19"), string(cfg->pids[19].cfg.label));
+        CPPUNIT_ASSERT_EQUAL(24, (int) cfg->pids[19].pid);
+
+        /* One past the end */
+        msg = "{\"setObd2Cfg\":{\"index\":1,\"pids\":[" + msg.substr(msg.find('[') + 1);
+        CPPUNIT_ASSERT_EQUAL(string("{\"setObd2Cfg\":{\"rc\":-1}}\r\n"),
+                             string(stream_message(msg, 50)));
+}
+
+void JsmnStreamTest::streamUnknownTest()
+{
+        const string msg = "{\"noSuchThing\":{\"data\":[1,2,3]}}";
+        CPPUNIT_ASSERT_EQUAL(string("{\"noSuchThing\":{\"rc\":0}}\r\n"),
+                             string(stream_message(msg, 5)));
+
+        /* Has a regular handler but no streaming one */
+        const string small = "{\"getVer\":null}";
+        CPPUNIT_ASSERT_EQUAL(string("{\"getVer\":{\"rc\":0}}\r\n"),
+                             string(stream_message(small, 5)));
+}
+
+void JsmnStreamTest::streamMalformedTest()
+{
+        /* Cut off part way through */
+        const string msg = "{\"addTrackDb\":{\"tracks\":[" + track_json(1);
+        CPPUNIT_ASSERT_EQUAL(string("{\"addTrackDb\":{\"rc\":-2}}\r\n"),
+                             string(stream_message(msg, 16)));
+
+        /* Garbage before we even know what it is gets no reply */
+        CPPUNIT_ASSERT_EQUAL(string(""), string(stream_message("{]", 1)));
+}
@@ -0,0 +1,59 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSMN_STREAM_TEST_H_
+#define _JSMN_STREAM_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class JsmnStreamTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( JsmnStreamTest );
+        CPPUNIT_TEST( eventsTest );
+        CPPUNIT_TEST( chunkedInputTest );
+        CPPUNIT_TEST( longStringTest );
+        CPPUNIT_TEST( captureTest );
+        CPPUNIT_TEST( errorTest );
+        CPPUNIT_TEST( streamTrackDbTest );
+        CPPUNIT_TEST( parsedTrackDbTest );
+        CPPUNIT_TEST( streamScriptTest );
+        CPPUNIT_TEST( streamObd2Test );
+        CPPUNIT_TEST( streamUnknownTest );
+        CPPUNIT_TEST( streamMalformedTest );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void eventsTest();
+        void chunkedInputTest();
+        void longStringTest();
+        void captureTest();
+        void errorTest();
+        void streamTrackDbTest();
+        void parsedTrackDbTest();
+        void streamScriptTest();
+        void streamObd2Test();
+        void streamUnknownTest();
+        void streamMalformedTest();
+};
+
+#endif /* _JSMN_STREAM_TEST_H_ */
@@ -38,7 +38,7 @@ void Current_Lap_Test::setUp() {
 void Current_Lap_Test::test_lap_increment() {
         CPPUNIT_ASSERT_EQUAL(0, lapstats_current_lap());
 
-        lap_started_normal_event(&gpsSnap);
+        lap_started_normal_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
 
         CPPUNIT_ASSERT_EQUAL(1, lapstats_current_lap());
 }
@@ -46,13 +46,13 @@ void Current_Lap_Test::test_lap_increment() {
 void Current_Lap_Test::test_no_increment() {
         CPPUNIT_ASSERT_EQUAL(0, lapstats_current_lap());
 
-        lap_finished_event(&gpsSnap);
+        lap_finished_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
 
         CPPUNIT_ASSERT_EQUAL(0, lapstats_current_lap());
 }
 
 void Current_Lap_Test::test_reset() {
-        lap_started_normal_event(&gpsSnap);
+        lap_started_normal_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
         CPPUNIT_ASSERT_EQUAL(1, lapstats_current_lap());
 
         reset_current_lap();
@@ -0,0 +1,166 @@
+/**
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2014 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this code. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors: Stieg
+ */
+
+#include "distance_test.h"
+#include "geopoint.h"
+#include "gps.h"
+#include "lap_stats.testing.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Center of a 500m radius circle, far enough north for lon to matter */
+#define CENTER_LAT	45.0
+#define CENTER_LON	-122.0
+#define RADIUS_M	500.0
+
+static GpsSnapshot gpsSnap;
+static Track track;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( Distance_Test );
+
+static GeoPoint on_circle(const double angle)
+{
+        const double lat = CENTER_LAT + RADIUS_M * cos(angle) / 111194.927;
+        const double lon = CENTER_LON + RADIUS_M * sin(angle) /
+                (111194.927 * cos(CENTER_LAT * M_PI / 180));
+        return gp_create(lat, lon);
+}
+
+static void fix(const GeoPoint *point, const float speed, const float dop,
+                const tiny_millis_t dt)
+{
+        gpsSnap.previousPoint = gpsSnap.sample.point;
+        gpsSnap.previousSpeed = gpsSnap.sample.speed;
+        gpsSnap.previousDeltaFirstFix = gpsSnap.deltaFirstFix;
+
+        gpsSnap.sample.point = *point;
+        gpsSnap.sample.speed = speed;
+        gpsSnap.sample.DOP = dop;
+        gpsSnap.deltaFirstFix += dt;
+
+        update_distance(&gpsSnap);
+}
+
+void Distance_Test::setUp() {
+        memset(&track, 0, sizeof(track));
+        track.circuit.startFinish = gp_create(CENTER_LAT, CENTER_LON);
+
+        lapStats_init();
+        set_active_track(&track);
+        memset(&gpsSnap, 0, sizeof(GpsSnapshot));
+}
+
+/*
+ * 24 hours at 25Hz and 100kph around the circle.  The distance must be
+ * the sum of the steps, worked out in double precision.  A float sum is
+ * off by kilometers by the end.
+ */
+void Distance_Test::test_long_session() {
+        const size_t fixes = 24 * 3600 * 25;
+        const float speed = 100;
+        const double step = speed / 3.6 / 25 / RADIUS_M;
+
+        struct gp_projection frame;
+        gp_projection_init(&frame, &track.circuit.startFinish);
+
+        GeoPoint point = on_circle(0);
+        fix(&point, speed, 1, 40);
+
+        double expected = 0;
+        for (size_t i = 1; i <= fixes; ++i) {
+                const GeoPoint prev = point;
+                point = on_circle(i * step);
+                expected += gp_dist(&frame, &prev, &point);
+                fix(&point, speed, 1, 40);
+        }
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2400, expected / 1000, 5);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(expected / 1000,
+                                     lapstats_session_distance(), 0.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(expected / 1000, getLapDistance(),
+                                     0.001);
+}
+
+/* Jitter while parked does not add up */
+void Distance_Test::test_stationary() {
+        const GeoPoint a = on_circle(0);
+        const GeoPoint b = on_circle(0.01);
+
+        for (int i = 0; i < 1000; ++i)
+                fix(i & 1 ? &a : &b, 0.5, 1, 40);
+
+        CPPUNIT_ASSERT_EQUAL(0.0f, lapstats_session_distance());
+
+        /* Pulling away counts */
+        fix(&b, 10, 1, 40);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.005, lapstats_session_distance(),
+                                     0.0001);
+}
+
+/* With a bad DOP the distance comes from the speed */
+void Distance_Test::test_high_dop() {
+        const GeoPoint a = on_circle(0);
+        const GeoPoint b = on_circle(M_PI);
+
+        fix(&a, 72, 1, 100);
+        /* A 1km jump in 100ms at an average of 90kph is 2.5m */
+        fix(&b, 108, 20, 100);
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0025, lapstats_session_distance(),
+                                     0.000001);
+}
+
+void Distance_Test::test_lap_and_session() {
+        const double step = 0.01;
+        GeoPoint point = on_circle(0);
+        fix(&point, 60, 1, 100);
+
+        for (int i = 1; i <= 100; ++i) {
+                point = on_circle(i * step);
+                fix(&point, 60, 1, 100);
+        }
+
+        const float first = lapstats_session_distance();
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, first, 0.001);
+
+        /* A new lap starts the lap distance over, not the session */
+        lap_started_normal_event(&point, gpsSnap.deltaFirstFix);
+        for (int i = 101; i <= 200; ++i) {
+                point = on_circle(i * step);
+                fix(&point, 60, 1, 100);
+        }
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2 * first, lapstats_session_distance(),
+                                     0.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(first, getLapDistance(), 0.001);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.621371 * 2 * first,
+                                     lapstats_session_distance_miles(),
+                                     0.001);
+
+        /* A config change only starts the lap over */
+        lapstats_reset_distance();
+        CPPUNIT_ASSERT_EQUAL(0.0f, getLapDistance());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2 * first, lapstats_session_distance(),
+                                     0.001);
+
+        lapstats_start_session();
+        CPPUNIT_ASSERT_EQUAL(0.0f, lapstats_session_distance());
+}
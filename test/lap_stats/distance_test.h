@@ -0,0 +1,44 @@
+/**
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2014 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this code. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors: Stieg
+ */
+
+#ifndef _DISTANCE_TEST_H_
+#define _DISTANCE_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class Distance_Test : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( Distance_Test );
+    CPPUNIT_TEST( test_long_session );
+    CPPUNIT_TEST( test_stationary );
+    CPPUNIT_TEST( test_high_dop );
+    CPPUNIT_TEST( test_lap_and_session );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void test_long_session();
+    void test_stationary();
+    void test_high_dop();
+    void test_lap_and_session();
+};
+
+
+#endif /* _DISTANCE_TEST_H_ */
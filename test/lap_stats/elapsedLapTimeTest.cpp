@@ -42,7 +42,7 @@ void ElapsedLapTimeTest::testSamples() {
         update_elapsed_time(&gpsSnap);
         CPPUNIT_ASSERT_EQUAL(0, lapstats_elapsed_time());
 
-        lap_started_normal_event(&gpsSnap);
+        lap_started_normal_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
         CPPUNIT_ASSERT_EQUAL(0, lapstats_elapsed_time());
 
         gpsSnap.deltaFirstFix = 15;
@@ -56,7 +56,7 @@ void ElapsedLapTimeTest::testSamples() {
 
 void ElapsedLapTimeTest::testStopRecording() {
         gpsSnap.deltaFirstFix = 3;
-        lap_started_normal_event(&gpsSnap);
+        lap_started_normal_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
         CPPUNIT_ASSERT_EQUAL(0, lapstats_elapsed_time());
 
         gpsSnap.deltaFirstFix = 15;
@@ -64,14 +64,14 @@ void ElapsedLapTimeTest::testStopRecording() {
         CPPUNIT_ASSERT_EQUAL(12, lapstats_elapsed_time());
 
         gpsSnap.deltaFirstFix = 122;
-        lap_finished_event(&gpsSnap);
+        lap_finished_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
         update_elapsed_time(&gpsSnap);
         CPPUNIT_ASSERT_EQUAL(12, lapstats_elapsed_time());
 }
 
 void ElapsedLapTimeTest::testReset() {
         gpsSnap.deltaFirstFix = 3;
-        lap_started_normal_event(&gpsSnap);
+        lap_started_normal_event(&gpsSnap.sample.point, gpsSnap.deltaFirstFix);
         CPPUNIT_ASSERT_EQUAL(0, lapstats_elapsed_time());
 
         gpsSnap.deltaFirstFix = 15;
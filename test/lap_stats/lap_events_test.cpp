@@ -0,0 +1,159 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lap_events.h"
+#include "lap_events_test.h"
+#include "lap_stats.testing.h"
+#include "loggerApi.h"
+#include "mock_serial.h"
+
+#include <string>
+#include <string.h>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LapEventsTest );
+
+static void push(const int lap, const tiny_millis_t time)
+{
+        const struct lap_event e = { LAP_EVENT_LAP, lap, 0, time, time * 2 };
+        lap_events_push(&e);
+}
+
+static void check_next(uint32_t *pos, const int lap)
+{
+        struct lap_event e;
+        CPPUNIT_ASSERT(lap_events_read(pos, &e));
+        CPPUNIT_ASSERT_EQUAL(LAP_EVENT_LAP, e.type);
+        CPPUNIT_ASSERT_EQUAL(lap, e.lap);
+        CPPUNIT_ASSERT_EQUAL((tiny_millis_t) lap * 1000, e.time);
+        CPPUNIT_ASSERT_EQUAL((tiny_millis_t) lap * 2000, e.at);
+}
+
+void LapEventsTest::setUp()
+{
+        lap_events_reset();
+}
+
+void LapEventsTest::readTest()
+{
+        uint32_t pos = lap_events_position();
+        struct lap_event e;
+        CPPUNIT_ASSERT(!lap_events_read(&pos, &e));
+
+        for (int i = 1; i <= 3; ++i)
+                push(i, i * 1000);
+
+        for (int i = 1; i <= 3; ++i)
+                check_next(&pos, i);
+        CPPUNIT_ASSERT(!lap_events_read(&pos, &e));
+        CPPUNIT_ASSERT_EQUAL(lap_events_position(), pos);
+}
+
+/* Every reader gets every event, and only those after it started */
+void LapEventsTest::readersTest()
+{
+        uint32_t a = lap_events_position();
+        push(1, 1000);
+        uint32_t b = lap_events_position();
+        push(2, 2000);
+
+        check_next(&a, 1);
+        check_next(&a, 2);
+        check_next(&b, 2);
+
+        struct lap_event e;
+        CPPUNIT_ASSERT(!lap_events_read(&a, &e));
+        CPPUNIT_ASSERT(!lap_events_read(&b, &e));
+}
+
+/* A reader that falls behind carries on from the oldest event held */
+void LapEventsTest::overrunTest()
+{
+        uint32_t pos = lap_events_position();
+        const int count = LAP_EVENT_QUEUE_SIZE + 3;
+        for (int i = 1; i <= count; ++i)
+                push(i, i * 1000);
+
+        for (int i = 4; i <= count; ++i)
+                check_next(&pos, i);
+
+        struct lap_event e;
+        CPPUNIT_ASSERT(!lap_events_read(&pos, &e));
+}
+
+void LapEventsTest::resetTest()
+{
+        uint32_t pos = lap_events_position();
+        push(1, 1000);
+        push(2, 2000);
+        lap_events_reset();
+
+        struct lap_event e;
+        CPPUNIT_ASSERT(!lap_events_read(&pos, &e));
+
+        push(3, 3000);
+        check_next(&pos, 3);
+}
+
+void LapEventsTest::lapStatsTest()
+{
+        static Track track;
+        const GeoPoint point = { 0, 0 };
+
+        lapStats_init();
+        set_active_track(&track);
+        uint32_t pos = lap_events_position();
+
+        lap_started_normal_event(&point, 1500);
+        lap_finished_event(&point, 91500);
+
+        struct lap_event e;
+        CPPUNIT_ASSERT(lap_events_read(&pos, &e));
+        CPPUNIT_ASSERT_EQUAL(LAP_EVENT_LAP, e.type);
+        CPPUNIT_ASSERT_EQUAL(1, e.lap);
+        CPPUNIT_ASSERT_EQUAL((tiny_millis_t) 90000, e.time);
+        CPPUNIT_ASSERT_EQUAL((tiny_millis_t) 91500, e.at);
+        CPPUNIT_ASSERT(!lap_events_read(&pos, &e));
+}
+
+void LapEventsTest::apiTest()
+{
+        setupMockSerial();
+
+        const struct lap_event lap = { LAP_EVENT_LAP, 3, 0, 92345, 400000 };
+        mock_resetTxBuffer();
+        api_send_lap_event(getMockSerial(), &lap);
+        CPPUNIT_ASSERT_EQUAL(
+                string("{\"lapEvt\":{\"type\":\"lap\",\"lap\":3,"
+                       "\"ms\":92345,\"t\":400000}}"),
+                string(mock_getTxBuffer()));
+
+        const struct lap_event sector = {
+                LAP_EVENT_SECTOR, 4, 1, 31250, 712030
+        };
+        mock_resetTxBuffer();
+        api_send_lap_event(getMockSerial(), &sector);
+        CPPUNIT_ASSERT_EQUAL(
+                string("{\"lapEvt\":{\"type\":\"sector\",\"lap\":4,"
+                       "\"sector\":1,\"ms\":31250,\"t\":712030}}"),
+                string(mock_getTxBuffer()));
+}
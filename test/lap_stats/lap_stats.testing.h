@@ -30,10 +30,11 @@
  */
 
 void set_active_track(const Track *defaultTrack);
-void lap_started_normal_event(const GpsSnapshot *gpsSnapshot);
-void lap_finished_event(const GpsSnapshot *gpsSnapshot);
+void lap_started_normal_event(const GeoPoint *point, const tiny_millis_t time);
+void lap_finished_event(const GeoPoint *point, const tiny_millis_t time);
 void update_elapsed_time(const GpsSnapshot *snap);
 void reset_elapsed_time();
 void reset_current_lap();
+void update_distance(const GpsSnapshot *gpsSnapshot);
 
 #endif /* _LAP_STATS_TESTING_H_ */
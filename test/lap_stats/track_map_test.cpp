@@ -0,0 +1,338 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geopoint.h"
+#include "gps.h"
+#include "track_map.h"
+#include "track_map_test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using std::vector;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TrackMapTest );
+
+#define TRACK_ID	42
+#define TRACK_HASH	0xc0ffee
+#define RADIUS_M	400.0
+/* 30 m/s at 25Hz */
+#define STEP_M		1.2
+#define FIX_MS		40
+
+static const double center_lat = 47.8;
+static const double center_lon = -122.34;
+
+/* A lap of a circle with the given number of bumps of the given size */
+struct lap {
+        vector<GeoPoint> points;
+        /* Meters driven to each point */
+        vector<double> distance;
+};
+
+static GeoPoint lap_point(const double angle, const int bumps,
+                          const double bump_m)
+{
+        const double m_per_deg = GP_EARTH_RADIUS_M * M_PI / 180;
+        const double r = RADIUS_M + bump_m * sin(bumps * angle);
+        const double lat = center_lat + r * sin(angle) / m_per_deg;
+        const double lon = center_lon + r * cos(angle) /
+                (m_per_deg * cos(center_lat * M_PI / 180));
+        return gp_create(lat, lon);
+}
+
+static struct lap make_lap(const int bumps, const double bump_m)
+{
+        struct lap l;
+        struct gp_projection frame;
+        const GeoPoint start = lap_point(0, bumps, bump_m);
+        gp_projection_init(&frame, &start);
+
+        /* Fine steps in angle, thinned out to a fix every STEP_M */
+        const int steps = 200000;
+        GeoPoint prev = start;
+        l.points.push_back(start);
+        l.distance.push_back(0);
+
+        for (int i = 1; i <= steps; ++i) {
+                const GeoPoint p = lap_point(2 * M_PI * i / steps, bumps,
+                                             bump_m);
+                const double d = gp_dist(&frame, &prev, &p);
+                if (d < STEP_M && i < steps)
+                        continue;
+
+                l.points.push_back(p);
+                l.distance.push_back(l.distance.back() + d);
+                prev = p;
+        }
+
+        return l;
+}
+
+static GpsSnapshot snap_at(const GeoPoint *p, const tiny_millis_t time)
+{
+        GpsSnapshot snap;
+        memset(&snap, 0, sizeof(snap));
+        snap.sample.point = *p;
+        snap.sample.DOP = 1;
+        snap.deltaFirstFix = time;
+        return snap;
+}
+
+/*
+ * Drives a lap the way lap_stats sees it: the lap starts, then every fix
+ * past the start and the lap finishes at the start again.
+ * @return What finishing the lap said.
+ */
+static bool drive_lap(const struct lap *l, tiny_millis_t gap_at = -1)
+{
+        const GeoPoint start = l->points[0];
+        track_map_start_lap(&start);
+
+        tiny_millis_t time = 0;
+        for (size_t i = 1; i + 1 < l->points.size(); ++i) {
+                time += FIX_MS;
+                if ((tiny_millis_t) i == gap_at)
+                        time += 2000;
+
+                const GpsSnapshot snap = snap_at(&l->points[i], time);
+                track_map_update(&snap);
+        }
+
+        return track_map_finish_lap(&start);
+}
+
+static double dist_to_segment(const struct gp_projection *frame,
+                              const GeoPoint *a, const GeoPoint *b,
+                              const GeoPoint *m)
+{
+        float ax, ay, bx, by, mx, my;
+        gp_project(frame, a, &ax, &ay);
+        gp_project(frame, b, &bx, &by);
+        gp_project(frame, m, &mx, &my);
+
+        const double dx = bx - ax;
+        const double dy = by - ay;
+        const double len_sq = dx * dx + dy * dy;
+        double t = len_sq > 0 ? ((mx - ax) * dx + (my - ay) * dy) / len_sq : 0;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+
+        return hypot(ax + t * dx - mx, ay + t * dy - my);
+}
+
+/* The furthest any point of the lap is from the outline */
+static double worst_error(const struct lap *l)
+{
+        const struct track_map_point *pts = track_map_points();
+        const size_t count = track_map_count();
+        struct gp_projection frame;
+        gp_projection_init(&frame, &l->points[0]);
+
+        double worst = 0;
+        for (size_t i = 0; i < l->points.size(); ++i) {
+                double best = INFINITY;
+                for (size_t s = 0; s + 1 < count; ++s)
+                        best = fmin(best, dist_to_segment(&frame,
+                                                          &pts[s].point,
+                                                          &pts[s + 1].point,
+                                                          &l->points[i]));
+                worst = fmax(worst, best);
+        }
+
+        return worst;
+}
+
+void TrackMapTest::setUp()
+{
+        track_map_reset();
+}
+
+void TrackMapTest::learnTest()
+{
+        const struct lap l = make_lap(5, 40);
+        CPPUNIT_ASSERT(!track_map_available());
+        CPPUNIT_ASSERT(drive_lap(&l));
+        CPPUNIT_ASSERT(track_map_available());
+
+        /* Nothing more to learn once we have it */
+        CPPUNIT_ASSERT(!drive_lap(&l));
+
+        const size_t count = track_map_count();
+        CPPUNIT_ASSERT(count > 10);
+        CPPUNIT_ASSERT(count <= TRACK_MAP_POINTS);
+        CPPUNIT_ASSERT_EQUAL(TRACK_MAP_TOLERANCE, track_map_tolerance());
+        CPPUNIT_ASSERT(worst_error(&l) <= TRACK_MAP_TOLERANCE + 0.05);
+
+        const struct track_map_point *pts = track_map_points();
+        CPPUNIT_ASSERT(!memcmp(&l.points[0], &pts[0].point, sizeof(GeoPoint)));
+        CPPUNIT_ASSERT(!memcmp(&l.points[0], &pts[count - 1].point,
+                               sizeof(GeoPoint)));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(l.distance.back(), pts[count - 1].distance,
+                                     0.5);
+}
+
+/* Too much detail for the points we have.  The tolerance goes up */
+void TrackMapTest::boundedTest()
+{
+        const struct lap l = make_lap(60, 15);
+        CPPUNIT_ASSERT(drive_lap(&l));
+
+        const float tolerance = track_map_tolerance();
+        CPPUNIT_ASSERT(tolerance > TRACK_MAP_TOLERANCE);
+        CPPUNIT_ASSERT(track_map_count() <= TRACK_MAP_POINTS);
+        /* Simplified more than once, each time to twice the tolerance */
+        CPPUNIT_ASSERT(worst_error(&l) <= 2 * tolerance);
+}
+
+void TrackMapTest::uncleanTest()
+{
+        const struct lap l = make_lap(5, 40);
+
+        /* Lost the fix for a while */
+        CPPUNIT_ASSERT(!drive_lap(&l, 500));
+        CPPUNIT_ASSERT(!track_map_available());
+
+        /* Not a lap at all */
+        const GeoPoint start = l.points[0];
+        track_map_start_lap(&start);
+        CPPUNIT_ASSERT(!track_map_finish_lap(&start));
+        CPPUNIT_ASSERT(!track_map_available());
+
+        CPPUNIT_ASSERT(drive_lap(&l));
+        CPPUNIT_ASSERT(track_map_available());
+}
+
+void TrackMapTest::placeTest()
+{
+        const struct lap l = make_lap(5, 40);
+        CPPUNIT_ASSERT_EQUAL(0.0f, track_map_distance());
+        CPPUNIT_ASSERT(drive_lap(&l));
+
+        const double length = l.distance.back();
+        double worst = 0;
+        for (size_t i = 1; i + 1 < l.points.size(); ++i) {
+                const GpsSnapshot snap = snap_at(&l.points[i], i * FIX_MS);
+                track_map_update(&snap);
+                worst = fmax(worst, fabs(track_map_distance() - l.distance[i]));
+        }
+        CPPUNIT_ASSERT(worst < 1);
+        CPPUNIT_ASSERT(track_map_lap_percent() > 99.9);
+        CPPUNIT_ASSERT(track_map_lap_percent() <= 100);
+
+        /* Over the line and round again */
+        GpsSnapshot snap = snap_at(&l.points[1], 0);
+        track_map_update(&snap);
+        CPPUNIT_ASSERT(track_map_lap_percent() < 0.1);
+
+        /* A jump half way round is found by searching everything */
+        const size_t half = l.points.size() / 2;
+        snap = snap_at(&l.points[half], 0);
+        track_map_update(&snap);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(l.distance[half], track_map_distance(), 1);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(100 * l.distance[half] / length,
+                                     track_map_lap_percent(), 0.1);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(track_map_distance() * 0.621371 / 1000,
+                                     track_map_distance_miles(), 1e-5);
+}
+
+void TrackMapTest::saveLoadTest()
+{
+        uint8_t buf[TRACK_MAP_SAVE_SIZE];
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, track_map_save(TRACK_ID, TRACK_HASH,
+                                                        buf, sizeof(buf)));
+
+        const struct lap l = make_lap(5, 40);
+        drive_lap(&l);
+        const size_t len = track_map_save(TRACK_ID, TRACK_HASH, buf,
+                                          sizeof(buf));
+        CPPUNIT_ASSERT(len > 0);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, track_map_save(TRACK_ID, TRACK_HASH,
+                                                        buf, len - 1));
+
+        const size_t count = track_map_count();
+        const float tolerance = track_map_tolerance();
+        vector<struct track_map_point> before(track_map_points(),
+                                              track_map_points() + count);
+
+        /* We already have one */
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID, TRACK_HASH, buf, len));
+
+        track_map_reset();
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID + 1, TRACK_HASH, buf, len));
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID, TRACK_HASH + 1, buf, len));
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID, TRACK_HASH, buf, len - 1));
+        buf[len / 2] ^= 1;
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID, TRACK_HASH, buf, len));
+        buf[len / 2] ^= 1;
+        ++buf[4];
+        CPPUNIT_ASSERT(!track_map_load(TRACK_ID, TRACK_HASH, buf, len));
+        --buf[4];
+        CPPUNIT_ASSERT(!track_map_available());
+
+        CPPUNIT_ASSERT(track_map_load(TRACK_ID, TRACK_HASH, buf, len));
+        CPPUNIT_ASSERT(track_map_available());
+        CPPUNIT_ASSERT_EQUAL(count, track_map_count());
+        CPPUNIT_ASSERT_EQUAL(tolerance, track_map_tolerance());
+        for (size_t i = 0; i < count; ++i) {
+                const struct track_map_point *tp = track_map_points() + i;
+                CPPUNIT_ASSERT(!memcmp(&before[i].point, &tp->point,
+                                       sizeof(GeoPoint)));
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(before[i].distance, tp->distance,
+                                             0.01);
+        }
+}
+
+void TrackMapTest::benchmarkTest()
+{
+        const struct lap l = make_lap(5, 40);
+
+        clock_t c = clock();
+        drive_lap(&l);
+        const double learn = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        /* Round and round, and then jumping about so that we are lost */
+        const int laps = 10;
+        const size_t fixes = l.points.size() - 2;
+        c = clock();
+        for (int lap = 0; lap < laps; ++lap) {
+                for (size_t i = 1; i <= fixes; ++i) {
+                        const GpsSnapshot snap = snap_at(&l.points[i], 0);
+                        track_map_update(&snap);
+                }
+        }
+        const double windowed = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        c = clock();
+        for (size_t i = 1; i <= fixes; ++i) {
+                const size_t j = 1 + (i * 7919) % fixes;
+                const GpsSnapshot snap = snap_at(&l.points[j], 0);
+                track_map_update(&snap);
+        }
+        const double lost = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        printf("\r\nTrack map of %u points: learning %.0fns, windowed %.0fns, "
+               "lost %.0fns per fix\r\n", (unsigned) track_map_count(),
+               learn * 1e9 / fixes, windowed * 1e9 / (laps * fixes),
+               lost * 1e9 / fixes);
+}
@@ -51,15 +51,15 @@ void LaunchControlTest::testCircuitLaunch() {
     * A circuit launch is the same as traditional launch.  This just ensures
     * we haven't regresed.
     */
-   Circuit c = {{1.0, 1.0}};
+   Circuit c = {{GP_DEGREES(1.0), GP_DEGREES(1.0)}};
    Track t = { TRACK_TYPE_CIRCUIT };
    t.circuit = c;
 
    const GeoPoint pts[] = {
-      {0.9, 0.9},
-      {1.0, 1.0},
-      {1.1, 1.1},
-      {0.0, 0.0},
+      {GP_DEGREES(0.9), GP_DEGREES(0.9)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.1), GP_DEGREES(1.1)},
+      {GP_DEGREES(0.0), GP_DEGREES(0.0)},
    };
 
    lc_setup(&t, 1.0);
@@ -91,20 +91,20 @@ void LaunchControlTest::testStageSimpleLaunch() {
     * A Stage launch has a time where the driver is in the zone below a certain
     * speed.  We need to detect when they start driving.
     */
-   Stage s = {{1.0, 1.0}};
+   Stage s = {{GP_DEGREES(1.0), GP_DEGREES(1.0)}};
    Track t = { TRACK_TYPE_CIRCUIT };
    t.stage = s;
 
    const GeoPoint pts[] = {
-      {0.9, 0.9},
-      {1.0, 1.0}, // <-- This is the arming point
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.0, 1.0}, // <-- This is the launch point
-      {1.1, 1.1}, // <-- Launch registered here.
-      {0.0, 0.0},
+      {GP_DEGREES(0.9), GP_DEGREES(0.9)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)}, // <-- This is the arming point
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)}, // <-- This is the launch point
+      {GP_DEGREES(1.1), GP_DEGREES(1.1)}, // <-- Launch registered here.
+      {GP_DEGREES(0.0), GP_DEGREES(0.0)},
    };
 
    lc_setup(&t, 1.0);
@@ -145,23 +145,23 @@ void LaunchControlTest::testStageTrickyLaunch() {
     *
     * This test tests that the speed logic works.
     */
-   Stage s = {{1.0, 1.0}};
+   Stage s = {{GP_DEGREES(1.0), GP_DEGREES(1.0)}};
    Track t = { TRACK_TYPE_CIRCUIT };
    t.stage = s;
 
    const GeoPoint pts[] = {
-      {0.9, 0.9},
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.0, 1.0}, // <-- This is the launch point time
-      {1.0, 1.0},
-      {1.0, 1.0},
-      {1.1, 1.1}, // <-- Launch registered here.
-      {1.11, 1.11},
-      {1.11, 1.11},
-      {1.11, 1.11},
-      {0.0, 0.0},
+      {GP_DEGREES(0.9), GP_DEGREES(0.9)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)}, // <-- This is the launch point time
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.0), GP_DEGREES(1.0)},
+      {GP_DEGREES(1.1), GP_DEGREES(1.1)}, // <-- Launch registered here.
+      {GP_DEGREES(1.11), GP_DEGREES(1.11)},
+      {GP_DEGREES(1.11), GP_DEGREES(1.11)},
+      {GP_DEGREES(1.11), GP_DEGREES(1.11)},
+      {GP_DEGREES(0.0), GP_DEGREES(0.0)},
    };
 
    lc_setup(&t, 1.0);
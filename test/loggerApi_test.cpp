@@ -451,6 +451,7 @@ void LoggerApiTest::testSetConnectivityCfgFile(string filename){
 	CPPUNIT_ASSERT_EQUAL(1, (int)connCfg->telemetryConfig.backgroundStreaming);
 	CPPUNIT_ASSERT_EQUAL(string("xyz123"), string(connCfg->telemetryConfig.telemetryDeviceId));
 	CPPUNIT_ASSERT_EQUAL(string("a.b.c"), string(connCfg->telemetryConfig.telemetryServerHost));
+	CPPUNIT_ASSERT_EQUAL(1, (int)connCfg->telemetryConfig.udpMode);
 }
 
 void LoggerApiTest::testSetConnectivityCfg(){
@@ -486,6 +487,7 @@ void LoggerApiTest::testGetConnectivityCfg(){
 	CPPUNIT_ASSERT_EQUAL((int)connCfg->telemetryConfig.backgroundStreaming, (int)(Number)connJson["telCfg"]["bgStream"]);
 	CPPUNIT_ASSERT_EQUAL(string(connCfg->telemetryConfig.telemetryDeviceId), string((String)connJson["telCfg"]["deviceId"]));
 	CPPUNIT_ASSERT_EQUAL(string(connCfg->telemetryConfig.telemetryServerHost), string((String)connJson["telCfg"]["host"]));
+	CPPUNIT_ASSERT_EQUAL((int)connCfg->telemetryConfig.udpMode, (int)(Number)connJson["telCfg"]["udp"]);
 }
 
 void LoggerApiTest::testGetPwmConfigFile(string filename, int index){
@@ -766,7 +768,7 @@ void LoggerApiTest::testChannelConfig(ChannelConfig *cfg, string expNm, string e
     CPPUNIT_ASSERT_EQUAL((int) sr, decodeSampleRate(cfg->sampleRate));
 }
 
-void LoggerApiTest::testSetGpsConfigFile(string filename, unsigned char channelsEnabled, unsigned short sampleRate){
+void LoggerApiTest::testSetGpsConfigFile(string filename, unsigned char channelsEnabled, unsigned short sampleRate, unsigned short fusedSampleRate){
 	processApiGeneric(filename);
 	char *txBuffer = mock_getTxBuffer();
 
@@ -784,13 +786,18 @@ void LoggerApiTest::testSetGpsConfigFile(string filename, unsigned char channels
         testChannelConfig(&gpsCfg->satellites, string("GPSSats"), string(""), sampleRate);
         testChannelConfig(&gpsCfg->quality, string("GPSQual"), string(""), sampleRate);
         testChannelConfig(&gpsCfg->DOP, string("GPSDOP"), string(""), sampleRate);
+        testChannelConfig(&gpsCfg->fusedLatitude, string("FusedLat"), string("Degrees"), fusedSampleRate);
+        testChannelConfig(&gpsCfg->fusedLongitude, string("FusedLon"), string("Degrees"), fusedSampleRate);
+        testChannelConfig(&gpsCfg->fusedSpeed, string("FusedSpeed"), string("MPH"), fusedSampleRate);
+        testChannelConfig(&gpsCfg->heading, string("Heading"), string("Degrees"), fusedSampleRate);
 
 	assertGenericResponse(txBuffer, "setGpsCfg", API_SUCCESS);
 }
 
 void LoggerApiTest::testSetGpsCfg(){
-	testSetGpsConfigFile("setGpsCfg1.json", 1, 100);
-	testSetGpsConfigFile("setGpsCfg2.json", 0, 50);
+	testSetGpsConfigFile("setGpsCfg1.json", 1, 100, 200);
+	/* Leaves the fused rate alone when it is not given */
+	testSetGpsConfigFile("setGpsCfg2.json", 0, 50, 200);
 }
 
 void LoggerApiTest::testGetGpsConfigFile(string filename){
@@ -805,6 +812,7 @@ void LoggerApiTest::testGetGpsConfigFile(string filename){
    populateChannelConfig(&gpsCfg->satellites, 0, 100);
    populateChannelConfig(&gpsCfg->quality, 0, 100);
    populateChannelConfig(&gpsCfg->DOP, 0, 100);
+   populateChannelConfig(&gpsCfg->fusedLatitude, 0, 200);
 
    char * response = processApiGeneric(filename);
 
@@ -822,6 +830,7 @@ void LoggerApiTest::testGetGpsConfigFile(string filename){
    CPPUNIT_ASSERT_EQUAL(1, (int)(Number)gpsCfgJson["sats"]);
    CPPUNIT_ASSERT_EQUAL(1, (int)(Number)gpsCfgJson["qual"]);
    CPPUNIT_ASSERT_EQUAL(1, (int)(Number)gpsCfgJson["dop"]);
+   CPPUNIT_ASSERT_EQUAL(200, (int)(Number)gpsCfgJson["fusedSr"]);
 }
 
 void LoggerApiTest::testGetGpsCfg(){
@@ -846,6 +855,15 @@ void LoggerApiTest::testSetLapConfigFile(string filename){
         testChannelConfig(&cfg->sectorCfg, string("Sector"), string(""), 50);
         testChannelConfig(&cfg->sectorTimeCfg, string("SectorTime"), string("Min"), 50);
         testChannelConfig(&cfg->predTimeCfg, string("PredTime"), string("Min"), 50);
+        testChannelConfig(&cfg->optimal_time_cfg, string("OptTime"), string("Min"), 10);
+        testChannelConfig(&cfg->sector_delta_cfg, string("SectorDelta"), string("Sec"), 10);
+        testChannelConfig(&cfg->optimal_delta_cfg, string("OptDelta"), string("Sec"), 10);
+        testChannelConfig(&cfg->pred_delta_cfg, string("PredDelta"), string("Sec"), 10);
+        testChannelConfig(&cfg->session_delta_cfg, string("SessDelta"), string("Sec"), 10);
+        testChannelConfig(&cfg->target_delta_cfg, string("TargetDelta"), string("Sec"), 10);
+        testChannelConfig(&cfg->session_distance_cfg, string("SessionDist"), string("Miles"), 10);
+        testChannelConfig(&cfg->track_distance_cfg, string("TrackDist"), string("Miles"), 10);
+        testChannelConfig(&cfg->lap_percent_cfg, string("LapPct"), string("%"), 10);
 }
 
 void LoggerApiTest::testGetLapConfigFile(string filename){
@@ -858,6 +876,8 @@ void LoggerApiTest::testGetLapConfigFile(string filename){
         populateChannelConfig(&cfg->sectorCfg, 3, 50);
         populateChannelConfig(&cfg->sectorTimeCfg, 4, 50);
         populateChannelConfig(&cfg->predTimeCfg, 5, 50);
+        populateChannelConfig(&cfg->optimal_delta_cfg, 6, 10);
+        populateChannelConfig(&cfg->target_delta_cfg, 7, 10);
 
 	char * response = processApiGeneric(filename);
 
@@ -869,18 +889,24 @@ void LoggerApiTest::testGetLapConfigFile(string filename){
         Object &lapSector = json["lapCfg"]["sector"];
         Object &lapSectorTime = json["lapCfg"]["sectorTime"];
         Object &lapPredTime = json["lapCfg"]["predTime"];
+        Object &lapOptDelta = json["lapCfg"]["optDelta"];
+        Object &lapTargetDelta = json["lapCfg"]["targetDelta"];
 
         string str1 = string("1");
         string str2 = string("2");
         string str3 = string("3");
         string str4 = string("4");
         string str5 = string("5");
+        string str6 = string("6");
+        string str7 = string("7");
 
         checkChannelConfig(lapCount, 1, str1, 50);
         checkChannelConfig(lapTime, 2, str2, 50);
         checkChannelConfig(lapSector, 3, str3, 50);
         checkChannelConfig(lapSectorTime, 4, str4, 50);
         checkChannelConfig(lapPredTime, 5, str5, 50);
+        checkChannelConfig(lapOptDelta, 6, str6, 10);
+        checkChannelConfig(lapTargetDelta, 7, str7, 10);
 }
 
 void LoggerApiTest::testGetLapCfg(){
@@ -902,15 +928,15 @@ void LoggerApiTest::testSetTrackCfgCircuit(){
         CPPUNIT_ASSERT_EQUAL(6674, cfg->track.trackId);
 	CPPUNIT_ASSERT_CLOSE_ENOUGH(0.0001F, cfg->radius);
 	CPPUNIT_ASSERT_EQUAL(0, (int)cfg->auto_detect);
-	CPPUNIT_ASSERT_CLOSE_ENOUGH(1.0F, cfg->track.circuit.startFinish.latitude);
-	CPPUNIT_ASSERT_CLOSE_ENOUGH(2.0F, cfg->track.circuit.startFinish.longitude);
+	CPPUNIT_ASSERT_CLOSE_ENOUGH(1.0F, gp_to_degrees(cfg->track.circuit.startFinish.latitude));
+	CPPUNIT_ASSERT_CLOSE_ENOUGH(2.0F, gp_to_degrees(cfg->track.circuit.startFinish.longitude));
 
 	float startingValue = 1.1;
 
 	for (int i = 0; i < sectors; i++){
-		CPPUNIT_ASSERT_CLOSE_ENOUGH(startingValue, cfg->track.circuit.sectors[i].latitude);
+		CPPUNIT_ASSERT_CLOSE_ENOUGH(startingValue, gp_to_degrees(cfg->track.circuit.sectors[i].latitude));
 		startingValue++;
-		CPPUNIT_ASSERT_CLOSE_ENOUGH(startingValue, cfg->track.circuit.sectors[i].longitude);
+		CPPUNIT_ASSERT_CLOSE_ENOUGH(startingValue, gp_to_degrees(cfg->track.circuit.sectors[i].longitude));
 		startingValue++;
 	}
 }
@@ -919,14 +945,14 @@ void LoggerApiTest::testGetTrackCfgCircuit(){
 	LoggerConfig *c = getWorkingLoggerConfig();
 	TrackConfig *cfg = &c->TrackConfigs;
 
-	cfg->track.circuit.startFinish.latitude  = 1.0;
-	cfg->track.circuit.startFinish.longitude = 2.0;
+	cfg->track.circuit.startFinish.latitude  = GP_DEGREES(1.0);
+	cfg->track.circuit.startFinish.longitude = GP_DEGREES(2.0);
 	float startingValue = 1.1;
 	for (size_t i = 0; i < CIRCUIT_SECTOR_COUNT; i++){
 		GeoPoint *point = (cfg->track.circuit.sectors + i);
-		point->latitude = startingValue;
+		point->latitude = gp_from_degrees(startingValue);
 		startingValue++;
-		point->longitude = startingValue;
+		point->longitude = gp_from_degrees(startingValue);
 		startingValue++;
 	}
 	cfg->radius = 0.009;
@@ -980,33 +1006,33 @@ void LoggerApiTest::testAddTrackDbFile(string filename){
 
 	if (trackType == TRACK_TYPE_CIRCUIT){
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sf"][0],
-                               (float)track->circuit.startFinish.latitude);
+                               (float)gp_to_degrees(track->circuit.startFinish.latitude));
 
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sf"][1],
-                               (float)track->circuit.startFinish.longitude);
+                               (float)gp_to_degrees(track->circuit.startFinish.longitude));
 	} else {
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["st"][0],
-                               (float)track->stage.start.latitude);
+                               (float)gp_to_degrees(track->stage.start.latitude));
 
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["st"][1],
-                               (float)track->stage.start.longitude);
+                               (float)gp_to_degrees(track->stage.start.longitude));
 
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["fin"][0],
-                               (float)track->stage.finish.latitude);
+                               (float)gp_to_degrees(track->stage.finish.latitude));
 
           CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["fin"][1],
-                               (float)track->stage.finish.longitude);
+                               (float)gp_to_degrees(track->stage.finish.longitude));
 	}
 
 	Array secNode = (Array)jsonCompare["addTrackDb"]["track"]["sec"];
 	for (int i = 0; i < secNode.Size(); i++){
 		if (trackType == TRACK_TYPE_CIRCUIT){
-			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][0], (float)track->circuit.sectors[i].latitude);
-			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][1], (float)track->circuit.sectors[i].longitude);
+			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][0], (float)gp_to_degrees(track->circuit.sectors[i].latitude));
+			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][1], (float)gp_to_degrees(track->circuit.sectors[i].longitude));
 		}
 		else{
-			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][0], (float)track->stage.sectors[i].latitude);
-			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][1], (float)track->stage.sectors[i].longitude);
+			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][0], (float)gp_to_degrees(track->stage.sectors[i].latitude));
+			CPPUNIT_ASSERT_EQUAL((float)(Number)jsonCompare["addTrackDb"]["track"]["sec"][i][1], (float)gp_to_degrees(track->stage.sectors[i].longitude));
 		}
 	}
 }
@@ -1102,6 +1128,33 @@ void LoggerApiTest::testGetObd2Cfg(){
 	testGetObd2ConfigFile("getObd2Cfg1.json");
 }
 
+void LoggerApiTest::testGetObd2CfgIndex(){
+	OBD2Config *obd2Config = &getWorkingLoggerConfig()->OBD2Configs;
+	obd2Config->enabled = 1;
+	obd2Config->enabledPids = 2;
+	populateChannelConfig(&obd2Config->pids[1].cfg, 2, 50);
+	obd2Config->pids[1].pid = 0x06;
+
+	char msg[] = "{\"getObd2Cfg\":1}";
+	mock_resetTxBuffer();
+	process_api(getMockSerial(), msg, sizeof(msg));
+
+	Object json;
+	stringToJson(mock_getTxBuffer(), json);
+	Array pids = (Array)json["obd2Cfg"]["pids"];
+	CPPUNIT_ASSERT_EQUAL(1, (int)(Number)json["obd2Cfg"]["index"]);
+	CPPUNIT_ASSERT_EQUAL((size_t)1, pids.Size());
+	CPPUNIT_ASSERT_EQUAL(0x06, (int)(Number)((Object)pids[0])["pid"]);
+
+	/* Past the last enabled PID there is nothing */
+	char msg2[] = "{\"getObd2Cfg\":2}";
+	mock_resetTxBuffer();
+	process_api(getMockSerial(), msg2, sizeof(msg2));
+	Object empty;
+	stringToJson(mock_getTxBuffer(), empty);
+	CPPUNIT_ASSERT_EQUAL((size_t)0, ((Array)empty["obd2Cfg"]["pids"]).Size());
+}
+
 void LoggerApiTest::testGetObd2ConfigFile(string filename){
 	LoggerConfig *c = getWorkingLoggerConfig();
 	OBD2Config *obd2Config = &c->OBD2Configs;
@@ -1312,6 +1365,8 @@ void LoggerApiTest::testGetStatus(){
     CPPUNIT_ASSERT_EQUAL(0.0f, (float)(Number)json["status"]["GPS"]["lon"]);
     CPPUNIT_ASSERT_EQUAL(0, (int)(Number)json["status"]["GPS"]["sats"]);
     CPPUNIT_ASSERT_EQUAL(0, (int)(Number)json["status"]["GPS"]["DOP"]);
+    CPPUNIT_ASSERT_EQUAL(0, (int)(Number)json["status"]["GPS"]["latency"]);
+    CPPUNIT_ASSERT_EQUAL(0, (int)(Number)json["status"]["GPS"]["latencyMax"]);
 
     CPPUNIT_ASSERT_EQUAL((int)CELLMODEM_STATUS_NOT_INIT, (int)(Number)json["status"]["cell"]["init"]);
     CPPUNIT_ASSERT_EQUAL(string(""), (string)(String)json["status"]["cell"]["IMEI"]);
@@ -1331,3 +1386,91 @@ void LoggerApiTest::testGetStatus(){
     CPPUNIT_ASSERT_EQUAL((int)TELEMETRY_STATUS_IDLE, (int)(Number)json["status"]["telemetry"]["status"]);
     CPPUNIT_ASSERT_EQUAL(0, (int)(Number)json["status"]["telemetry"]["started"]);
 }
+
+static string sendApi(const string &msg)
+{
+	char buffer[256];
+	strcpy(buffer, msg.c_str());
+	mock_resetTxBuffer();
+	process_api(getMockSerial(), buffer, sizeof(buffer));
+	return mock_getTxBuffer();
+}
+
+void LoggerApiTest::testGetConfigHash()
+{
+	Object json;
+	stringToJson(sendApi("{\"getCfgHash\":null}"), json);
+	Object before = (Object)json["cfgHash"]["hash"];
+
+	/* Only the section that changed gets a new hash */
+	getWorkingLoggerConfig()->GPSConfigs.speed.sampleRate = SAMPLE_1Hz;
+	Object json2;
+	stringToJson(sendApi("{\"getCfgHash\":null}"), json2);
+	Object after = (Object)json2["cfgHash"]["hash"];
+
+	CPPUNIT_ASSERT((double)(Number)before["gpsCfg"] !=
+		       (double)(Number)after["gpsCfg"]);
+	CPPUNIT_ASSERT_EQUAL((double)(Number)before["analogCfg"],
+			     (double)(Number)after["analogCfg"]);
+	CPPUNIT_ASSERT_EQUAL((double)(Number)before["trackCfg"],
+			     (double)(Number)after["trackCfg"]);
+	CPPUNIT_ASSERT_EQUAL((double)(Number)before["scriptCfg"],
+			     (double)(Number)after["scriptCfg"]);
+}
+
+void LoggerApiTest::testAllConfigRoundTrip()
+{
+	LoggerConfig *config = getWorkingLoggerConfig();
+	ADCConfig *adc = &config->ADCConfigs[3];
+	strcpy(adc->cfg.label, "Oil");
+	adc->linearScaling = 2.5f;
+	config->GPSConfigs.altitude.sampleRate = SAMPLE_DISABLED;
+	config->ConnectivityConfigs.cellularConfig.cellEnabled = 1;
+	strcpy(config->ConnectivityConfigs.cellularConfig.apnHost, "apn.example");
+	config->OBD2Configs.enabled = 1;
+	config->OBD2Configs.enabledPids = 3;
+	for (int i = 0; i < 3; i++) {
+		populateChannelConfig(&config->OBD2Configs.pids[i].cfg, i, 10);
+		config->OBD2Configs.pids[i].pid = 0x10 + i;
+	}
+
+	const string all = sendApi("{\"getAllCfg\":null}");
+	Object json;
+	stringToJson(all, json);
+	Object hash;
+	stringToJson(sendApi("{\"getCfgHash\":null}"), hash);
+	CPPUNIT_ASSERT_EQUAL((double)(Number)hash["cfgHash"]["hash"]["analogCfg"],
+			     (double)(Number)json["allCfg"]["hash"]["analogCfg"]);
+
+	initialize_logger_config();
+	CPPUNIT_ASSERT(strcmp("Oil", config->ADCConfigs[3].cfg.label) != 0);
+
+	/* What getAllCfg sends is what setAllCfg takes */
+	string set = all;
+	CPPUNIT_ASSERT_EQUAL(1, findAndReplace(set, "{\"allCfg\":", "{\"setAllCfg\":"));
+
+	mock_resetTxBuffer();
+	api_stream_begin(getMockSerial());
+	for (size_t i = 0; i < set.size(); i += 64) {
+		const string piece = set.substr(i, 64);
+		api_stream_feed(piece.c_str(), piece.size());
+	}
+	api_stream_end();
+	assertGenericResponse(mock_getTxBuffer(), "setAllCfg", API_SUCCESS);
+
+	CPPUNIT_ASSERT_EQUAL(string("Oil"), string(config->ADCConfigs[3].cfg.label));
+	CPPUNIT_ASSERT_EQUAL(2.5f, config->ADCConfigs[3].linearScaling);
+	CPPUNIT_ASSERT_EQUAL((int)SAMPLE_DISABLED, (int)config->GPSConfigs.altitude.sampleRate);
+	CPPUNIT_ASSERT_EQUAL(string("apn.example"),
+			     string(config->ConnectivityConfigs.cellularConfig.apnHost));
+	CPPUNIT_ASSERT_EQUAL(3, (int)config->OBD2Configs.enabledPids);
+	CPPUNIT_ASSERT_EQUAL(0x12, (int)config->OBD2Configs.pids[2].pid);
+
+	/* Everything a client can see came back */
+	const string again = sendApi("{\"getAllCfg\":null}");
+	CPPUNIT_ASSERT_EQUAL(all.substr(all.find("\"cfg\":")),
+			     again.substr(again.find("\"cfg\":")));
+
+	/* Unknown sections are refused */
+	CPPUNIT_ASSERT(sendApi("{\"setAllCfg\":{\"cfg\":[{\"fooCfg\":{}}]}}").find("\"rc\":-1") != string::npos);
+}
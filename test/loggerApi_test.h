@@ -57,12 +57,15 @@ class LoggerApiTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testSetObd2ConfigFile_fromIndex);
     CPPUNIT_TEST( testSetObd2ConfigFile_invalid);
     CPPUNIT_TEST( testGetObd2Cfg);
+    CPPUNIT_TEST( testGetObd2CfgIndex);
     CPPUNIT_TEST( testGetScript);
     CPPUNIT_TEST( testSetScript);
     CPPUNIT_TEST( testRunScript);
     CPPUNIT_TEST( testGetVersion);
     CPPUNIT_TEST( testGetStatus);
     CPPUNIT_TEST( testGetCapabilities);
+    CPPUNIT_TEST( testGetConfigHash);
+    CPPUNIT_TEST( testAllConfigRoundTrip);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -112,12 +115,15 @@ public:
     void testSetObd2ConfigFile_fromIndex();
     void testSetObd2ConfigFile_invalid();
     void testGetObd2Cfg();
+    void testGetObd2CfgIndex();
     void testSetScript();
     void testGetScript();
     void testRunScript();
     void testGetVersion();
     void testGetStatus();
     void testGetCapabilities();
+    void testGetConfigHash();
+    void testAllConfigRoundTrip();
 
 private:
     void testSetScriptFile(string filename);
@@ -137,7 +143,7 @@ private:
     void testGetTimerConfigFile(string filename, int index);
     void testSetTimerConfigFile(string filename);
     void testGetGpsConfigFile(string filename);
-    void testSetGpsConfigFile(string filename, unsigned char channelsEnabled, unsigned short sampleRate);
+    void testSetGpsConfigFile(string filename, unsigned char channelsEnabled, unsigned short sampleRate, unsigned short fusedSampleRate);
     void testAddTrackDbFile(string filename);
     void testGetTrackDbFile(string filename, string addedFilename);
     void testSetLapConfigFile(string filename);
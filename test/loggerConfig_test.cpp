@@ -223,6 +223,51 @@ void LoggerConfigTest::testLoggerInitLapConfig() {
    CPPUNIT_ASSERT_EQUAL(string("Min"), string(cc->units));
    CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_10Hz);
 
+   cc = &lc->LapConfigs.optimal_time_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("OptTime"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Min"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.sector_delta_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("SectorDelta"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Sec"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.optimal_delta_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("OptDelta"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Sec"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.pred_delta_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("PredDelta"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Sec"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.session_delta_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("SessDelta"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Sec"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.target_delta_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("TargetDelta"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Sec"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.session_distance_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("SessionDist"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Miles"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.track_distance_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("TrackDist"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("Miles"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
+   cc = &lc->LapConfigs.lap_percent_cfg;
+   CPPUNIT_ASSERT_EQUAL(string("LapPct"), string(cc->label));
+   CPPUNIT_ASSERT_EQUAL(string("%"), string(cc->units));
+   CPPUNIT_ASSERT(cc->sampleRate == SAMPLE_DISABLED);
+
 }
 
 
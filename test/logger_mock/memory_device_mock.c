@@ -4,10 +4,14 @@
 #include <stdio.h>
 
 static int g_isFlashed = 0;
+static int g_flashCount = 0;
+static unsigned int g_maxFlashLength = 0;
 
 enum memory_flash_result_t memory_device_flash_region(const void *vAddress, const void *vData, unsigned int length)
 {
     g_isFlashed = 1;
+    g_flashCount++;
+    if (length > g_maxFlashLength) g_maxFlashLength = length;
     void * addr = (void *)vAddress;
     memcpy(addr, vData, length);
     //printf("\r\nflash: %d %d |%s|\r\n", length, strlen((const char *)vData), (const char*)vData);
@@ -23,3 +27,19 @@ int memory_mock_get_is_flashed()
 {
     return g_isFlashed;
 }
+
+void memory_mock_reset_flash_count()
+{
+    g_flashCount = 0;
+    g_maxFlashLength = 0;
+}
+
+int memory_mock_get_flash_count()
+{
+    return g_flashCount;
+}
+
+unsigned int memory_mock_get_max_flash_length()
+{
+    return g_maxFlashLength;
+}
@@ -11,5 +11,10 @@
 void memory_mock_set_is_flashed(int isFlashed);
 int memory_mock_get_is_flashed();
 
+/* Flashes and the longest one since the last reset */
+void memory_mock_reset_flash_count();
+int memory_mock_get_flash_count();
+unsigned int memory_mock_get_max_flash_length();
+
 
 #endif /* MEMORY_MOCK_C_ */
@@ -1,6 +1,15 @@
 #include "sim900_device.h"
+#include "sim900_mock.h"
+
+static unsigned int g_presses;
 
 void sim900_device_power_button(uint32_t pressed)
 {
+    if (pressed)
+        g_presses++;
+}
 
+unsigned int sim900_mock_power_presses(void)
+{
+    return g_presses;
 }
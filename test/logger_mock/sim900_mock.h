@@ -0,0 +1,7 @@
+#ifndef SIM900_MOCK_H_
+#define SIM900_MOCK_H_
+
+/* How many times the power button was pressed so far */
+unsigned int sim900_mock_power_presses(void);
+
+#endif /* SIM900_MOCK_H_ */
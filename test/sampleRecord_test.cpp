@@ -15,6 +15,7 @@
 #include "sampleRecord_test.h"
 #include "task.h"
 #include "task_testing.h"
+#include "track_map.h"
 #include <string>
 
 using std::string;
@@ -237,8 +238,8 @@ void SampleRecordTest::testInitSampleRecord()
                 CPPUNIT_ASSERT_EQUAL((void *) &gpsConfig->latitude,
                                      (void *) ts->cfg);
                 CPPUNIT_ASSERT_EQUAL((void *) GPS_getLatitude,
-                                     (void *) ts->get_float_sample);
-                CPPUNIT_ASSERT_EQUAL(SampleData_Float_Noarg, ts->sampleData);
+                                     (void *) ts->get_double_sample);
+                CPPUNIT_ASSERT_EQUAL(SampleData_Double_Noarg, ts->sampleData);
                 ts++;
         }
 
@@ -246,8 +247,8 @@ void SampleRecordTest::testInitSampleRecord()
                 CPPUNIT_ASSERT_EQUAL((void *) &gpsConfig->longitude,
                                      (void *) ts->cfg);
                 CPPUNIT_ASSERT_EQUAL((void *) GPS_getLongitude,
-                                     (void *) ts->get_float_sample);
-                CPPUNIT_ASSERT_EQUAL(SampleData_Float_Noarg, ts->sampleData);
+                                     (void *) ts->get_double_sample);
+                CPPUNIT_ASSERT_EQUAL(SampleData_Double_Noarg, ts->sampleData);
                 ts++;
         }
 
@@ -305,6 +306,24 @@ void SampleRecordTest::testInitSampleRecord()
                 ts++;
         }
 
+        /* The fused getters are private to the sampler */
+        ChannelConfig * const fused[] = {
+                &gpsConfig->fusedLatitude, &gpsConfig->fusedLongitude,
+                &gpsConfig->fusedSpeed, &gpsConfig->heading,
+        };
+        const enum SampleData fused_types[] = {
+                SampleData_Double_Noarg, SampleData_Double_Noarg,
+                SampleData_Float_Noarg, SampleData_Float_Noarg,
+        };
+        for (size_t i = 0; i < 4; ++i) {
+                if (fused[i]->sampleRate == SAMPLE_DISABLED)
+                        continue;
+
+                CPPUNIT_ASSERT_EQUAL((void *) fused[i], (void *) ts->cfg);
+                CPPUNIT_ASSERT_EQUAL(fused_types[i], ts->sampleData);
+                ts++;
+        }
+
         LapConfig *lapConfig = &(lc->LapConfigs);
         if (lapConfig->lapCountCfg.sampleRate != SAMPLE_DISABLED){
                 CPPUNIT_ASSERT_EQUAL((void *) &lapConfig->lapCountCfg,
@@ -369,6 +388,63 @@ void SampleRecordTest::testInitSampleRecord()
                 ts++;
         }
 
+        ChannelConfig * const optimal[] = {
+                &lapConfig->optimal_time_cfg, &lapConfig->sector_delta_cfg,
+                &lapConfig->optimal_delta_cfg,
+        };
+        float (* const optimal_getters[])() = {
+                lapstats_optimal_lap_time_minutes,
+                lapstats_sector_delta_seconds,
+                lapstats_optimal_delta_seconds,
+        };
+        for (size_t i = 0; i < 3; ++i) {
+                if (optimal[i]->sampleRate == SAMPLE_DISABLED)
+                        continue;
+
+                CPPUNIT_ASSERT_EQUAL((void *) optimal[i], (void *) ts->cfg);
+                CPPUNIT_ASSERT_EQUAL(SampleData_Float_Noarg, ts->sampleData);
+                CPPUNIT_ASSERT_EQUAL((void *) optimal_getters[i],
+                                     (void *) ts->get_float_sample);
+                ts++;
+        }
+
+        ChannelConfig * const deltas[] = {
+                &lapConfig->pred_delta_cfg, &lapConfig->session_delta_cfg,
+                &lapConfig->target_delta_cfg,
+        };
+        for (size_t i = 0; i < 3; ++i) {
+                if (deltas[i]->sampleRate == SAMPLE_DISABLED)
+                        continue;
+
+                CPPUNIT_ASSERT_EQUAL((void *) deltas[i], (void *) ts->cfg);
+                CPPUNIT_ASSERT_EQUAL(SampleData_Float, ts->sampleData);
+                CPPUNIT_ASSERT_EQUAL(i, ts->channelIndex);
+                CPPUNIT_ASSERT_EQUAL((void *) getPredictedDeltaInSeconds,
+                                     (void *) ts->get_float_sample);
+                ts++;
+        }
+
+        ChannelConfig * const distances[] = {
+                &lapConfig->session_distance_cfg,
+                &lapConfig->track_distance_cfg,
+                &lapConfig->lap_percent_cfg,
+        };
+        float (* const distance_getters[])() = {
+                lapstats_session_distance_miles,
+                track_map_distance_miles,
+                track_map_lap_percent,
+        };
+        for (size_t i = 0; i < 3; ++i) {
+                if (distances[i]->sampleRate == SAMPLE_DISABLED)
+                        continue;
+
+                CPPUNIT_ASSERT_EQUAL((void *) distances[i], (void *) ts->cfg);
+                CPPUNIT_ASSERT_EQUAL(SampleData_Float_Noarg, ts->sampleData);
+                CPPUNIT_ASSERT_EQUAL((void *) distance_getters[i],
+                                     (void *) ts->get_float_sample);
+                ts++;
+        }
+
         //amount shoud match
         const size_t size = ts - s.channel_samples;
         CPPUNIT_ASSERT_EQUAL(expectedEnabledChannels, size);
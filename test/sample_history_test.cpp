@@ -0,0 +1,312 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.h"
+#include "capabilities.h"
+#include "loggerConfig.h"
+#include "mock_serial.h"
+#include "sampleRecord.h"
+#include "sample_history.h"
+#include "sample_history_test.h"
+
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleHistoryTest );
+
+#define CHANNELS 10
+
+static ChannelSample channels[CHANNELS];
+static ChannelSample out_channels[CHANNELS];
+static struct sample s;
+static struct sample out;
+
+static const enum SampleData types[] = {
+        SampleData_Int_Noarg,
+        SampleData_LongLong_Noarg,
+        SampleData_Float,
+        SampleData_Double_Noarg,
+};
+
+/* A sample whose values are derived from its tick */
+static void fill(const size_t ticks)
+{
+        s.ticks = ticks;
+        for (size_t i = 0; i < CHANNELS; ++i) {
+                ChannelSample *cs = channels + i;
+                cs->populated = (ticks + i) % 3 != 0;
+
+                switch (cs->sampleData) {
+                case SampleData_Int_Noarg:
+                        cs->valueInt = ticks * 10 + i;
+                        break;
+                case SampleData_LongLong_Noarg:
+                        cs->valueLongLong = 1000000000000LL + ticks;
+                        break;
+                case SampleData_Float:
+                        cs->valueFloat = ticks + 0.5f;
+                        break;
+                default:
+                        cs->valueDouble = ticks / 3.0;
+                        break;
+                }
+        }
+}
+
+static void add(const size_t ticks)
+{
+        fill(ticks);
+        sample_history_add(&s);
+}
+
+static void assert_matches(const size_t ticks)
+{
+        fill(ticks);
+        CPPUNIT_ASSERT_EQUAL(ticks, out.ticks);
+        for (size_t i = 0; i < CHANNELS; ++i) {
+                const ChannelSample *a = channels + i;
+                const ChannelSample *b = out_channels + i;
+                CPPUNIT_ASSERT_EQUAL(a->populated, b->populated);
+                if (!a->populated)
+                        continue;
+
+                switch (a->sampleData) {
+                case SampleData_Int_Noarg:
+                        CPPUNIT_ASSERT_EQUAL(a->valueInt, b->valueInt);
+                        break;
+                case SampleData_LongLong_Noarg:
+                        CPPUNIT_ASSERT_EQUAL(a->valueLongLong, b->valueLongLong);
+                        break;
+                case SampleData_Float:
+                        CPPUNIT_ASSERT_EQUAL(a->valueFloat, b->valueFloat);
+                        break;
+                default:
+                        CPPUNIT_ASSERT_EQUAL(a->valueDouble, b->valueDouble);
+                        break;
+                }
+        }
+}
+
+void SampleHistoryTest::setUp()
+{
+        memset(channels, 0, sizeof(channels));
+        memset(out_channels, 0, sizeof(out_channels));
+        for (size_t i = 0; i < CHANNELS; ++i) {
+                channels[i].sampleData = types[i % 4];
+                out_channels[i].sampleData = types[i % 4];
+        }
+
+        s.channel_count = CHANNELS;
+        s.channel_samples = channels;
+        out.channel_count = CHANNELS;
+        out.channel_samples = out_channels;
+
+        sample_history_reset(CHANNELS);
+}
+
+void SampleHistoryTest::tearDown()
+{
+}
+
+void SampleHistoryTest::roundTripTest()
+{
+        for (size_t t = 1; t <= 3; ++t)
+                add(t);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, sample_history_count());
+
+        uint32_t pos = sample_history_last(3);
+        for (size_t t = 1; t <= 3; ++t) {
+                CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+                assert_matches(t);
+        }
+
+        /* The end */
+        CPPUNIT_ASSERT(!sample_history_valid(pos));
+        CPPUNIT_ASSERT(!sample_history_read(&pos, &out));
+}
+
+void SampleHistoryTest::lastTest()
+{
+        for (size_t t = 1; t <= 20; ++t)
+                add(t * 10);
+
+        uint32_t pos = sample_history_last(5);
+        CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+        CPPUNIT_ASSERT_EQUAL((size_t) 160, out.ticks);
+
+        /* Asking for more than we have gives everything */
+        pos = sample_history_last(100);
+        CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, out.ticks);
+
+        pos = sample_history_last(0);
+        CPPUNIT_ASSERT(!sample_history_valid(pos));
+}
+
+void SampleHistoryTest::sinceTest()
+{
+        for (size_t t = 1; t <= 20; ++t)
+                add(t * 10);
+
+        uint32_t pos = sample_history_since(105);
+        CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+        CPPUNIT_ASSERT_EQUAL((size_t) 110, out.ticks);
+
+        pos = sample_history_since(110);
+        CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+        CPPUNIT_ASSERT_EQUAL((size_t) 120, out.ticks);
+
+        pos = sample_history_since(0);
+        CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, out.ticks);
+
+        pos = sample_history_since(200);
+        CPPUNIT_ASSERT(!sample_history_valid(pos));
+}
+
+void SampleHistoryTest::evictionTest()
+{
+        add(1);
+        const uint32_t first = sample_history_last(1);
+
+        size_t t;
+        for (t = 2; t < 10000; ++t)
+                add(t);
+
+        /* Old records went to make room, the newest are all there */
+        const size_t count = sample_history_count();
+        CPPUNIT_ASSERT(count > 100);
+        CPPUNIT_ASSERT(count < 1000);
+
+        uint32_t stale = first;
+        CPPUNIT_ASSERT(!sample_history_valid(stale));
+        CPPUNIT_ASSERT(!sample_history_read(&stale, &out));
+
+        uint32_t pos = sample_history_last(count);
+        for (size_t i = t - count; i < t; ++i) {
+                CPPUNIT_ASSERT(sample_history_read(&pos, &out));
+                assert_matches(i);
+        }
+}
+
+void SampleHistoryTest::resetTest()
+{
+        add(1);
+        uint32_t pos = sample_history_last(1);
+
+        sample_history_reset(CHANNELS);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, sample_history_count());
+        CPPUNIT_ASSERT(!sample_history_valid(pos));
+
+        /* Nothing is recorded or read back with the wrong layout */
+        sample_history_reset(CHANNELS - 1);
+        add(2);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, sample_history_count());
+
+        sample_history_reset(CHANNELS);
+        add(3);
+        pos = sample_history_last(1);
+        out.channel_count = CHANNELS - 1;
+        CPPUNIT_ASSERT(!sample_history_read(&pos, &out));
+}
+
+/* Value of a numeric field in a reply */
+static size_t field(const string &reply, const string &name)
+{
+        const size_t at = reply.find("\"" + name + "\":");
+        CPPUNIT_ASSERT(at != string::npos);
+        return strtoul(reply.c_str() + at + name.size() + 3, NULL, 10);
+}
+
+void SampleHistoryTest::apiPagingTest()
+{
+        initApi();
+        initialize_logger_config();
+        setupMockSerial();
+
+        /* Record with the real channel layout */
+        LoggerConfig *config = getWorkingLoggerConfig();
+        const size_t count = get_enabled_channel_count(config);
+        struct sample live;
+        memset(&live, 0, sizeof(live));
+        CPPUNIT_ASSERT(init_sample_buffer(&live, count));
+        sample_history_reset(count);
+
+        for (size_t t = 1; t <= 120; ++t) {
+                live.ticks = t * 100;
+                for (size_t i = 0; i < count; ++i)
+                        live.channel_samples[i].populated = i < 2;
+                sample_history_add(&live);
+        }
+        free_sample_buffer(&live);
+
+        char msg[64];
+        strcpy(msg, "{\"getHist\":{\"n\":100}}");
+        size_t rows = 0;
+        size_t pages = 0;
+        size_t next = 0;
+
+        while (true) {
+                mock_resetTxBuffer();
+                process_api(getMockSerial(), msg, sizeof(msg));
+                const string reply = mock_getTxBuffer();
+                ++pages;
+
+                /* One bracket for "d" and one per record */
+                size_t brackets = 0;
+                for (size_t i = 0; i < reply.size(); ++i)
+                        brackets += reply[i] == '[';
+                rows += brackets - 1;
+
+                if (1 == pages) {
+                        CPPUNIT_ASSERT_EQUAL((size_t) 2100, field(reply, "t"));
+                        CPPUNIT_ASSERT(reply.find("\"d\":[[0,") != string::npos);
+                }
+
+                next = field(reply, "next");
+                if (!field(reply, "more"))
+                        break;
+
+                sprintf(msg, "{\"getHist\":{\"since\":%u}}", (unsigned) next);
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 100, rows);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, pages);
+        CPPUNIT_ASSERT_EQUAL((size_t) 12000, next);
+
+        /* Caught up: nothing new, same cursor */
+        mock_resetTxBuffer();
+        sprintf(msg, "{\"getHist\":{\"since\":%u}}", (unsigned) next);
+        process_api(getMockSerial(), msg, sizeof(msg));
+        const string reply = mock_getTxBuffer();
+        CPPUNIT_ASSERT(reply.find("\"d\":[]") != string::npos);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, field(reply, "more"));
+
+        mock_resetTxBuffer();
+        strcpy(msg, "{\"getHist\":{}}");
+        process_api(getMockSerial(), msg, sizeof(msg));
+        CPPUNIT_ASSERT_EQUAL(string("{\"getHist\":{\"rc\":-1}}\r\n"),
+                             string(mock_getTxBuffer()));
+}
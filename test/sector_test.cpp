@@ -1,6 +1,10 @@
 #include "sector_test.h"
+#include "geopoint.h"
 #include "gps.testing.h"
 #include "loggerConfig.h"
+#include "tracks.h"
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <fstream>
 #include <streambuf>
@@ -90,11 +94,11 @@ string SectorTest::readFile(string filename){
 	TRACK_TYPE_CIRCUIT, \
 	{ \
 		{ \
-			{47.806934,-122.341150}, \
-			{47.806875,-122.335818}, \
-			{47.79974,-122.335704}, \
-			{47.799719,-122.346416}, \
-			{47.806886,-122.346494}, \
+			{GP_DEGREES(47.806934), GP_DEGREES(-122.341150)}, \
+			{GP_DEGREES(47.806875), GP_DEGREES(-122.335818)}, \
+			{GP_DEGREES(47.79974), GP_DEGREES(-122.335704)}, \
+			{GP_DEGREES(47.799719), GP_DEGREES(-122.346416)}, \
+			{GP_DEGREES(47.806886), GP_DEGREES(-122.346494)}, \
 		}\
 	} \
 	}
@@ -154,8 +158,8 @@ void SectorTest::testSectorTimes(){
                printf("%d,%d,%d,%f\n",lapstats_current_lap(), getLapCount(), getSector(), getLapDistanceInMiles());
            }
 
-           float lat = modp_atof(latitudeRaw.c_str());
-           float lon = modp_atof(longitudeRaw.c_str());
+           const int32_t lat = gp_parse_degrees(latitudeRaw.c_str());
+           const int32_t lon = gp_parse_degrees(longitudeRaw.c_str());
            float speed = modp_atof(speedRaw.c_str());
 
            const char *utcTimeStr = timeRaw.c_str();
@@ -169,6 +173,7 @@ void SectorTest::testSectorTimes(){
            dt.millisecond = (int16_t) atoiOffsetLenSafe(utcTimeStr, 7, 3);
 
            GpsSample sample;
+           memset(&sample, 0, sizeof(sample));
            sample.quality = GPS_QUALITY_3D;
            sample.point.latitude = lat;
            sample.point.longitude = lon;
@@ -237,36 +242,36 @@ void SectorTest::testStageSectorTimes() {
     TRACK_TYPE_STAGE,
     {
       {
-        {47.806934,-122.341150}, // Start
-        {47.806875,-122.335818}, // Finish
-        {47.79974,-122.335704},  // Sectors from here down
-        {47.799719,-122.346416},
-        {47.806886,-122.346494},
+        {GP_DEGREES(47.806934), GP_DEGREES(-122.341150)}, // Start
+        {GP_DEGREES(47.806875), GP_DEGREES(-122.335818)}, // Finish
+        {GP_DEGREES(47.79974), GP_DEGREES(-122.335704)},  // Sectors from here down
+        {GP_DEGREES(47.799719), GP_DEGREES(-122.346416)},
+        {GP_DEGREES(47.806886), GP_DEGREES(-122.346494)},
       }
     }
   };
 
-  const GeoPoint fakePoint = {1.0, 2.0};
+  const GeoPoint fakePoint = {GP_DEGREES(1.0), GP_DEGREES(2.0)};
 
   const GeoPoint points[] = {
     fakePoint,
-    {47.806934,-122.341150},
-    {47.79974,-122.335704}, // Sector Time = 1
+    {GP_DEGREES(47.806934), GP_DEGREES(-122.341150)},
+    {GP_DEGREES(47.79974), GP_DEGREES(-122.335704)}, // Sector Time = 1
     fakePoint,
     fakePoint,
-    {47.799719,-122.346416}, // Sector Time = 3
+    {GP_DEGREES(47.799719), GP_DEGREES(-122.346416)}, // Sector Time = 3
     fakePoint,
     fakePoint,
     fakePoint,
     fakePoint,
-    {47.806886,-122.346494}, // Sector Time = 5
+    {GP_DEGREES(47.806886), GP_DEGREES(-122.346494)}, // Sector Time = 5
     fakePoint,
     fakePoint,
     fakePoint,
     fakePoint,
     fakePoint,
     fakePoint,
-    {47.806875,-122.335818}, // Sector Time = 7
+    {GP_DEGREES(47.806875), GP_DEGREES(-122.335818)}, // Sector Time = 7
     {0,0},
   };
 
@@ -293,6 +298,7 @@ void SectorTest::testStageSectorTimes() {
 
     // Fake the GPS info.
     GpsSample sample;
+    memset(&sample, 0, sizeof(sample));
     sample.quality = GPS_QUALITY_3D;
     sample.point = *gp;
     sample.time = getMillisecondsSinceUnixEpoch(dt);
@@ -320,3 +326,285 @@ void SectorTest::testStageSectorTimes() {
     ++gp;
   }
 }
+
+vector<GpsSample> SectorTest::readSamples(string filename)
+{
+    string log = readFile(filename);
+    std::istringstream iss(log);
+    vector<GpsSample> samples;
+    string line;
+
+    while (std::getline(iss, line)) {
+        vector<string> values = split(line, ',');
+        if (values.size() < 9 || values[0][0] == '#' ||
+            values[5].size() == 0 || values[5][0] == '"' ||
+            values[6].size() == 0 || values[7].size() == 0 ||
+            values[8].size() == 0)
+            continue;
+
+        const string timeRaw = "0" + values[8];
+        const char *utcTimeStr = timeRaw.c_str();
+        DateTime dt;
+        dt.year = 2014;
+        dt.month = 5;
+        dt.day = 3;
+        dt.hour = (int8_t) atoiOffsetLenSafe(utcTimeStr, 0, 2);
+        dt.minute = (int8_t) atoiOffsetLenSafe(utcTimeStr, 2, 2);
+        dt.second = (int8_t) atoiOffsetLenSafe(utcTimeStr, 4, 2);
+        dt.millisecond = (int16_t) atoiOffsetLenSafe(utcTimeStr, 7, 3);
+
+        GpsSample sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.quality = GPS_QUALITY_3D;
+        sample.point.latitude = gp_parse_degrees(values[5].c_str());
+        sample.point.longitude = gp_parse_degrees(values[6].c_str());
+        sample.time = getMillisecondsSinceUnixEpoch(dt);
+        sample.speed = modp_atof(values[7].c_str());
+        sample.satellites = 8;
+        samples.push_back(sample);
+    }
+
+    return samples;
+}
+
+/**
+ * Replays every step-th fix of a log, starting at offset, against the test
+ * track and returns the lap times in the order the laps were finished.
+ */
+vector<tiny_millis_t> SectorTest::replayLapTimes(const vector<GpsSample> &samples,
+                                                 const size_t step,
+                                                 const size_t offset)
+{
+    GPS_init(10, get_serial(SERIAL_GPS));
+    lapStats_init();
+
+    LoggerConfig *lc = getWorkingLoggerConfig();
+    Track testTrack = Test_Track;
+    memcpy(&lc->TrackConfigs.track, &testTrack, sizeof(Track));
+    lc->TrackConfigs.auto_detect = 0;
+    lc->TrackConfigs.radius = DEFAULT_TRACK_TARGET_RADIUS;
+
+    vector<tiny_millis_t> lapTimes;
+    int lapCount = 0;
+
+    for (size_t i = offset; i < samples.size(); i += step) {
+        GpsSample sample = samples[i];
+        GPS_sample_update(&sample);
+        GpsSnapshot snap = getGpsSnapshot();
+        lapstats_processUpdate(&snap);
+
+        if (getLapCount() != lapCount) {
+            lapCount = getLapCount();
+            lapTimes.push_back(getLastLapTime());
+        }
+    }
+
+    return lapTimes;
+}
+
+/*
+ * Thinning the logs out to one fix in every few must not move the
+ * start/finish crossings by much more than the positions themselves allow.
+ * Taking the first fix in the circle instead would be off by up to a full
+ * fix period.  The first lap is left out since launch control times it.
+ */
+void SectorTest::testInterpolatedCrossings()
+{
+    const struct {
+        const char *file;
+        tiny_millis_t period;
+        size_t steps[4];
+    } logs[] = {
+        { "predictive_time_test_lap.log", 100, { 2, 5, 10 } },
+        { "predictive_time_test_lap2.log", 300, { 2, 3, 0 } },
+    };
+
+    for (size_t l = 0; l < sizeof(logs) / sizeof(*logs); ++l) {
+        const vector<GpsSample> samples = readSamples(logs[l].file);
+        const vector<tiny_millis_t> ref = replayLapTimes(samples, 1, 0);
+        CPPUNIT_ASSERT(ref.size() >= 3);
+
+        printf("\r\nLap crossings (%s):", logs[l].file);
+        for (const size_t *step = logs[l].steps; *step; ++step) {
+            const tiny_millis_t period = logs[l].period * *step;
+            tiny_millis_t maxErr = 0;
+            double sumErr = 0;
+            size_t n = 0;
+
+            for (size_t offset = 0; offset < *step; ++offset) {
+                const vector<tiny_millis_t> laps =
+                    replayLapTimes(samples, *step, offset);
+                CPPUNIT_ASSERT_EQUAL(ref.size(), laps.size());
+
+                for (size_t i = 1; i < laps.size(); ++i) {
+                    const tiny_millis_t err = abs(laps[i] - ref[i]);
+                    maxErr = err > maxErr ? err : maxErr;
+                    sumErr += err;
+                    ++n;
+                }
+            }
+
+            printf(" %dms fixes %.1fms avg %dms max,", (int) period,
+                   sumErr / n, (int) maxErr);
+            CPPUNIT_ASSERT(maxErr < period / 4);
+        }
+        printf("\r\n");
+    }
+}
+
+static GeoPoint offset_from(const GeoPoint *origin, const double east,
+                            const double north)
+{
+    const double metersPerDegree = GP_EARTH_RADIUS_M * M_PI / 180;
+    const double lat = gp_to_degrees(origin->latitude);
+    const double lon = gp_to_degrees(origin->longitude);
+    const GeoPoint p = {
+        gp_from_degrees(lat + north / metersPerDegree),
+        gp_from_degrees(lon + east / metersPerDegree /
+                        cos(lat * M_PI / 180)),
+    };
+    return p;
+}
+
+/*
+ * Drives east across the start/finish three times at 1Hz, going back round
+ * well to the north.  Each pass changes speed steadily, so the crossing
+ * times are known exactly and fall between fixes.
+ */
+void SectorTest::testCrossingBetweenFixes()
+{
+    const GeoPoint sf = { GP_DEGREES(47.0), GP_DEGREES(-122.0) };
+    LoggerConfig *lc = getWorkingLoggerConfig();
+    Track track;
+    memset(&track, 0, sizeof(track));
+    track.trackId = 4444;
+    track.track_type = TRACK_TYPE_CIRCUIT;
+    track.circuit.startFinish = sf;
+    memcpy(&lc->TrackConfigs.track, &track, sizeof(Track));
+    lc->TrackConfigs.auto_detect = 0;
+    lc->TrackConfigs.radius = DEFAULT_TRACK_TARGET_RADIUS;
+
+    /* Start of pass, speed in m/s and acceleration in m/s^2 */
+    const struct {
+        double x0;
+        double v0;
+        double a;
+    } passes[] = {
+        { -195.3, 20.0, 0.0 },
+        { -201.7, 31.0, -1.0 },
+        { -188.2, 14.0, 1.5 },
+    };
+    double crossings[3];
+    millis_t time = 1000000;
+
+    for (size_t p = 0; p < 3; ++p) {
+        const double v0 = passes[p].v0;
+        const double a = passes[p].a;
+        const double x0 = passes[p].x0;
+
+        /* When x0 + v0 * t + a * t^2 / 2 is 0 */
+        crossings[p] = time + 1000 *
+            (a ? (-v0 + sqrt(v0 * v0 - 2 * a * x0)) / a : -x0 / v0);
+
+        /* The last fix of each pass is the way back round */
+        for (double t = 0, x = x0; x < 250; t += 1, time += 1000) {
+            x = x0 + v0 * t + a * t * t / 2;
+
+            GpsSample sample;
+            memset(&sample, 0, sizeof(sample));
+            sample.quality = GPS_QUALITY_3D;
+            sample.point = offset_from(&sf, x, x < 250 ? 0 : 500);
+            sample.time = time;
+            sample.speed = (v0 + a * t) * 3.6;
+            sample.satellites = 8;
+
+            GPS_sample_update(&sample);
+            GpsSnapshot snap = getGpsSnapshot();
+            lapstats_processUpdate(&snap);
+        }
+    }
+
+    CPPUNIT_ASSERT_EQUAL(2, getLapCount());
+    const double expected = crossings[2] - crossings[1];
+    CPPUNIT_ASSERT(fabs(getLastLapTime() - expected) <= 2);
+}
+
+/*
+ * Keeps its own best sector times over the recorded laps and checks the
+ * theoretical best lap and the deltas against them at every crossing.
+ */
+void SectorTest::testOptimalLap()
+{
+    const vector<GpsSample> samples = readSamples("predictive_time_test_lap.log");
+
+    GPS_init(10, get_serial(SERIAL_GPS));
+    lapStats_init();
+
+    LoggerConfig *lc = getWorkingLoggerConfig();
+    Track testTrack = Test_Track;
+    memcpy(&lc->TrackConfigs.track, &testTrack, sizeof(Track));
+    lc->TrackConfigs.auto_detect = 0;
+    lc->TrackConfigs.radius = DEFAULT_TRACK_TARGET_RADIUS;
+
+    vector<tiny_millis_t> best(5, 0);
+    tiny_millis_t split = 0;
+    tiny_millis_t lapTime = 0;
+    bool splitValid = true;
+    int sector = -1;
+    int lapCount = 0;
+    size_t crossings = 0;
+    size_t faster = 0;
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        GpsSample sample = samples[i];
+        GPS_sample_update(&sample);
+        GpsSnapshot snap = getGpsSnapshot();
+        lapstats_processUpdate(&snap);
+
+        if (getSector() == sector && getLapCount() == lapCount)
+            continue;
+
+        if (getAtSector()) {
+            const int s = getLastSector();
+            const tiny_millis_t t = getLastSectorTime();
+            CPPUNIT_ASSERT(s >= 0 && s < 5);
+
+            lapTime += t;
+            if (best[s]) {
+                split += best[s];
+                CPPUNIT_ASSERT_EQUAL(t - best[s], lapstats_sector_delta());
+                faster += t < best[s];
+            } else {
+                splitValid = false;
+                CPPUNIT_ASSERT_EQUAL((tiny_millis_t) 0, lapstats_sector_delta());
+            }
+
+            CPPUNIT_ASSERT_EQUAL(splitValid ? lapTime - split : 0,
+                                 lapstats_optimal_delta());
+            if (!best[s] || t < best[s])
+                best[s] = t;
+            ++crossings;
+
+            tiny_millis_t optimal = 0;
+            for (size_t j = 0; j < best.size(); ++j)
+                optimal = best[j] && optimal >= 0 ? optimal + best[j] : -1;
+            CPPUNIT_ASSERT_EQUAL(optimal > 0 ? optimal : 0,
+                                 lapstats_optimal_lap_time());
+        }
+
+        if (getSector() == 0 && sector != 0) {
+            split = 0;
+            lapTime = 0;
+            splitValid = true;
+        }
+
+        sector = getSector();
+        lapCount = getLapCount();
+    }
+
+    // Every lap is timed by its sectors and some sectors got faster.
+    CPPUNIT_ASSERT_EQUAL((size_t) 5 * lapCount, crossings);
+    CPPUNIT_ASSERT(faster > 0);
+    CPPUNIT_ASSERT(lapstats_optimal_lap_time() > 0);
+    CPPUNIT_ASSERT(lapstats_optimal_lap_time() <= getLastLapTime());
+}
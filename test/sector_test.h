@@ -1,8 +1,11 @@
 #ifndef PREDICTIVE_TIME_TEST_H_
 #define PREDICTIVE_TIME_TEST_H_
 
+#include "gps.h"
+
 #include <cppunit/extensions/HelperMacros.h>
 #include <string>
+#include <vector>
 using std::string;
 using std::vector;
 
@@ -11,6 +14,9 @@ class SectorTest : public CppUnit::TestFixture
     CPPUNIT_TEST_SUITE( SectorTest );
     CPPUNIT_TEST( testSectorTimes );
     CPPUNIT_TEST( testStageSectorTimes );
+    CPPUNIT_TEST( testInterpolatedCrossings );
+    CPPUNIT_TEST( testCrossingBetweenFixes );
+    CPPUNIT_TEST( testOptimalLap );
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -25,6 +31,15 @@ public:
     void outputSectorTimes(vector<float> & sectorTimes, int lap);
     void testSectorTimes();
     void testStageSectorTimes();
+    void testInterpolatedCrossings();
+    void testCrossingBetweenFixes();
+    void testOptimalLap();
+
+private:
+    vector<GpsSample> readSamples(string filename);
+    vector<tiny_millis_t> replayLapTimes(const vector<GpsSample> &samples,
+                                         const size_t step,
+                                         const size_t offset);
 };
 
 
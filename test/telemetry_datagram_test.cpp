@@ -0,0 +1,263 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "mock_serial.h"
+#include "sampleRecord.h"
+#include "telemetry_datagram.h"
+#include "telemetry_datagram_test.h"
+#include "telemetry_subscription.h"
+#include "udp_receiver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetryDatagramTest );
+
+static ChannelConfig cfgs[4];
+static ChannelSample channels[4];
+static struct sample s;
+static struct telemetry_datagram td;
+static Serial *serial;
+
+static const char *labels[] = {"RPM", "Speed", "Coolant", "Fuel"};
+
+static string sent(void)
+{
+        return mock_getTxBuffer();
+}
+
+void TelemetryDatagramTest::setUp()
+{
+        memset(cfgs, 0, sizeof(cfgs));
+        memset(channels, 0, sizeof(channels));
+        for (size_t i = 0; i < 4; ++i) {
+                strcpy(cfgs[i].label, labels[i]);
+                cfgs[i].sampleRate = SAMPLE_25Hz;
+                channels[i].cfg = cfgs + i;
+                channels[i].sampleData = SampleData_Int;
+                channels[i].valueInt = i + 1;
+                channels[i].populated = true;
+        }
+        /* Fuel is slow */
+        cfgs[3].sampleRate = SAMPLE_1Hz;
+        channels[3].populated = false;
+
+        s.ticks = 0;
+        s.channel_count = 4;
+        s.channel_samples = channels;
+
+        telemetry_datagram_init(&td);
+
+        setupMockSerial();
+        serial = getMockSerial();
+        mock_resetTxBuffer();
+}
+
+void TelemetryDatagramTest::tearDown()
+{
+        telemetry_datagram_free(&td);
+}
+
+void TelemetryDatagramTest::holdTest()
+{
+        const struct sample *held = telemetry_datagram_update(&td, &s);
+        CPPUNIT_ASSERT(held != NULL);
+        CPPUNIT_ASSERT(held != &s);
+        CPPUNIT_ASSERT(held->channel_samples[0].populated);
+        CPPUNIT_ASSERT(!held->channel_samples[3].populated);
+
+        /* Fuel comes in on its own.  Everything else is still there */
+        for (size_t i = 0; i < 4; ++i)
+                channels[i].populated = false;
+        channels[3].populated = true;
+        channels[3].valueInt = 40;
+        s.ticks = 200;
+        held = telemetry_datagram_update(&td, &s);
+        CPPUNIT_ASSERT_EQUAL((size_t) 200, held->ticks);
+        for (size_t i = 0; i < 4; ++i)
+                CPPUNIT_ASSERT(held->channel_samples[i].populated);
+        CPPUNIT_ASSERT_EQUAL(1, held->channel_samples[0].valueInt);
+        CPPUNIT_ASSERT_EQUAL(40, held->channel_samples[3].valueInt);
+
+        /* The newest value wins */
+        channels[0].populated = true;
+        channels[0].valueInt = 7000;
+        held = telemetry_datagram_update(&td, &s);
+        CPPUNIT_ASSERT_EQUAL(7000, held->channel_samples[0].valueInt);
+        CPPUNIT_ASSERT_EQUAL(40, held->channel_samples[3].valueInt);
+
+        /* A new channel layout starts over */
+        s.channel_count = 3;
+        held = telemetry_datagram_update(&td, &s);
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, held->channel_count);
+        CPPUNIT_ASSERT(held->channel_samples[0].populated);
+        CPPUNIT_ASSERT(!held->channel_samples[1].populated);
+}
+
+void TelemetryDatagramTest::layoutTest()
+{
+        telemetry_datagram_update(&td, &s);
+        const uint32_t all = telemetry_datagram_layout(&td, NULL);
+        CPPUNIT_ASSERT(all != 0);
+        CPPUNIT_ASSERT_EQUAL(all, telemetry_datagram_layout(&td, NULL));
+
+        /* Fewer channels, different layout */
+        struct telemetry_subscription *sub = telemetry_subscription_get(serial);
+        const uint16_t index[] = {1, 3};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        telemetry_datagram_layout_changed(&td);
+        const uint32_t some = telemetry_datagram_layout(&td, sub);
+        CPPUNIT_ASSERT(some != all);
+
+        /* So is a change to a channel setting */
+        cfgs[1].precision = 2;
+        telemetry_datagram_layout_changed(&td);
+        CPPUNIT_ASSERT(some != telemetry_datagram_layout(&td, sub));
+
+        telemetry_subscription_clear(sub);
+}
+
+void TelemetryDatagramTest::metaDueTest()
+{
+        telemetry_datagram_update(&td, &s);
+        telemetry_datagram_layout(&td, NULL);
+        CPPUNIT_ASSERT(telemetry_datagram_meta_due(&td));
+        telemetry_datagram_meta_sent(&td);
+        CPPUNIT_ASSERT(!telemetry_datagram_meta_due(&td));
+
+        /* Again every so often */
+        for (size_t i = 0; i < TELEMETRY_DATAGRAM_META_INTERVAL - 1; ++i)
+                CPPUNIT_ASSERT_EQUAL((uint32_t) i,
+                                     telemetry_datagram_next_seq(&td));
+        CPPUNIT_ASSERT(!telemetry_datagram_meta_due(&td));
+        telemetry_datagram_next_seq(&td);
+        CPPUNIT_ASSERT(telemetry_datagram_meta_due(&td));
+        telemetry_datagram_meta_sent(&td);
+
+        /* And when the channels change */
+        cfgs[0].sampleRate = SAMPLE_50Hz;
+        telemetry_datagram_layout_changed(&td);
+        telemetry_datagram_layout(&td, NULL);
+        CPPUNIT_ASSERT(telemetry_datagram_meta_due(&td));
+}
+
+void TelemetryDatagramTest::sampleFormatTest()
+{
+        channels[3].populated = true;
+        const struct sample *held = telemetry_datagram_update(&td, &s);
+        api_send_sample_datagram(serial, held, 12, 34, 56, false, NULL);
+        CPPUNIT_ASSERT_EQUAL(string("{\"u\":{\"seq\":12,\"t\":34,\"l\":56,"
+                                    "\"d\":[1,2,3,4,15]}}"), sent());
+
+        /* Only what was subscribed, in that order */
+        mock_resetTxBuffer();
+        struct telemetry_subscription *sub = telemetry_subscription_get(serial);
+        const uint16_t index[] = {3, 0};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        api_send_sample_datagram(serial, held, 13, 35, 57, false, sub);
+        CPPUNIT_ASSERT_EQUAL(string("{\"u\":{\"seq\":13,\"t\":35,\"l\":57,"
+                                    "\"d\":[4,1,3]}}"), sent());
+        telemetry_subscription_clear(sub);
+}
+
+void TelemetryDatagramTest::metaFormatTest()
+{
+        api_send_meta_datagram(serial, &s, 1, 99, 3, 3, NULL);
+        const string meta = sent();
+        CPPUNIT_ASSERT(meta.find("{\"um\":{\"seq\":1,\"l\":99,\"i\":3,\"n\":4,"
+                                 "\"meta\":[{\"nm\":\"Fuel\"") == 0);
+        CPPUNIT_ASSERT(meta.find("Coolant") == string::npos);
+        CPPUNIT_ASSERT_EQUAL(string("}]}}"), meta.substr(meta.size() - 4));
+}
+
+void TelemetryDatagramTest::lossTest()
+{
+        struct udp_receiver_stats stats;
+        memset(&stats, 0, sizeof(stats));
+
+        const uint32_t seqs[] = {5, 6, 9, 7, 7, 10, 200, 100};
+        for (size_t i = 0; i < sizeof(seqs) / sizeof(seqs[0]); ++i)
+                udp_receiver_track(&stats, seqs[i]);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 8, stats.received);
+        /* 8 and 11 to 199 */
+        CPPUNIT_ASSERT_EQUAL((size_t) 1 + 189, stats.lost);
+        /* 7 was late.  100 is too far back to tell and no use anyway */
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, stats.late);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, stats.duplicate);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 201, stats.next_seq);
+}
+
+void TelemetryDatagramTest::loopbackTest()
+{
+        struct udp_receiver r;
+        const int port = udp_receiver_open(&r, 0, false);
+        CPPUNIT_ASSERT(port > 0);
+
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        CPPUNIT_ASSERT(fd >= 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        /* The network loses one and delivers another twice */
+        const struct sample *held = telemetry_datagram_update(&td, &s);
+        const uint32_t layout = telemetry_datagram_layout(&td, NULL);
+        for (size_t i = 0; i < 5; ++i) {
+                const uint32_t seq = telemetry_datagram_next_seq(&td);
+                mock_resetTxBuffer();
+                api_send_sample_datagram(serial, held, seq, i, layout, false,
+                                         NULL);
+                const string d = sent();
+                const int copies = 2 == seq ? 0 : 3 == seq ? 2 : 1;
+                for (int c = 0; c < copies; ++c)
+                        sendto(fd, d.data(), d.size(), 0,
+                               (struct sockaddr *) &addr, sizeof(addr));
+        }
+        close(fd);
+
+        char buf[256];
+        for (size_t i = 0; i < 5; ++i)
+                CPPUNIT_ASSERT(udp_receiver_receive(&r, buf, sizeof(buf), 1000) > 0);
+        CPPUNIT_ASSERT_EQUAL(0, udp_receiver_receive(&r, buf, sizeof(buf), 0));
+        udp_receiver_close(&r);
+
+        /* Every datagram is whole on its own */
+        CPPUNIT_ASSERT(strstr(buf, "\"seq\":4,\"t\":4,") != NULL);
+        CPPUNIT_ASSERT(strstr(buf, "\"d\":[1,2,3,7]}}") != NULL);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 5, r.stats.received);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, r.stats.lost);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, r.stats.duplicate);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, r.stats.late);
+}
@@ -0,0 +1,192 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loggerConfig.h"
+#include "sampleRecord.h"
+#include "telemetry_rate.h"
+#include "telemetry_rate_test.h"
+
+#include <string.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetryRateTest );
+
+static struct telemetry_rate tr;
+static ChannelConfig fast_cfg;
+static ChannelConfig slow_cfg;
+static ChannelSample channels[3];
+static struct sample s;
+
+static void congest(const size_t count)
+{
+        for (size_t i = 0; i < count; ++i)
+                telemetry_rate_update(&tr, TELEMETRY_RATE_BACKLOG_HIGH, 0);
+}
+
+static void clear(const size_t count)
+{
+        for (size_t i = 0; i < count; ++i)
+                telemetry_rate_update(&tr, 0, 0);
+}
+
+void TelemetryRateTest::setUp()
+{
+        telemetry_rate_init(&tr, SAMPLE_10Hz);
+
+        memset(&fast_cfg, 0, sizeof(fast_cfg));
+        fast_cfg.sampleRate = SAMPLE_10Hz;
+        memset(&slow_cfg, 0, sizeof(slow_cfg));
+        slow_cfg.sampleRate = SAMPLE_1Hz;
+
+        memset(channels, 0, sizeof(channels));
+        /* A high priority, a low priority and a slow channel */
+        channels[0].cfg = &fast_cfg;
+        channels[1].cfg = &fast_cfg;
+        channels[1].low_priority = true;
+        channels[2].cfg = &slow_cfg;
+
+        s.ticks = 0;
+        s.channel_count = 3;
+        s.channel_samples = channels;
+}
+
+void TelemetryRateTest::tearDown() {}
+
+void TelemetryRateTest::initTest()
+{
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, telemetry_rate_get_rate(&tr));
+        CPPUNIT_ASSERT_EQUAL(false, telemetry_rate_drop_low_priority(&tr));
+
+        /* Everything goes at full speed */
+        channels[1].populated = true;
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_should_send(&tr, &s));
+}
+
+void TelemetryRateTest::stepDownTest()
+{
+        /* First step sheds low priority channels at the same rate */
+        congest(1);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, telemetry_rate_get_rate(&tr));
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_drop_low_priority(&tr));
+
+        /* Must settle before stepping again */
+        congest(TELEMETRY_RATE_SETTLE_UPDATES - 1);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, telemetry_rate_get_rate(&tr));
+
+        congest(1);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_5Hz, telemetry_rate_get_rate(&tr));
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_drop_low_priority(&tr));
+}
+
+void TelemetryRateTest::slowSendStepDownTest()
+{
+        /* A write that takes longer than the sample period is congestion */
+        telemetry_rate_update(&tr, 0, SAMPLE_10Hz);
+        CPPUNIT_ASSERT_EQUAL(false, telemetry_rate_drop_low_priority(&tr));
+
+        telemetry_rate_update(&tr, 0, SAMPLE_10Hz + 1);
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_drop_low_priority(&tr));
+}
+
+void TelemetryRateTest::floorTest()
+{
+        congest(100);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_1Hz, telemetry_rate_get_rate(&tr));
+
+        congest(100);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_1Hz, telemetry_rate_get_rate(&tr));
+}
+
+void TelemetryRateTest::recoverTest()
+{
+        congest(1 + TELEMETRY_RATE_SETTLE_UPDATES);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_5Hz, telemetry_rate_get_rate(&tr));
+
+        clear(TELEMETRY_RATE_RECOVER_UPDATES - 1);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_5Hz, telemetry_rate_get_rate(&tr));
+
+        clear(1);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, telemetry_rate_get_rate(&tr));
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_drop_low_priority(&tr));
+
+        /* A hiccup restarts the recovery count */
+        clear(TELEMETRY_RATE_RECOVER_UPDATES - 1);
+        telemetry_rate_update(&tr, 1, 0);
+        clear(1);
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_drop_low_priority(&tr));
+
+        clear(TELEMETRY_RATE_RECOVER_UPDATES);
+        CPPUNIT_ASSERT_EQUAL(false, telemetry_rate_drop_low_priority(&tr));
+}
+
+void TelemetryRateTest::shedLowPriorityTest()
+{
+        congest(1);
+
+        /* Nothing worth sending if only low priority channels have data */
+        channels[1].populated = true;
+        CPPUNIT_ASSERT_EQUAL(false, telemetry_rate_should_send(&tr, &s));
+
+        channels[0].populated = true;
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_should_send(&tr, &s));
+}
+
+void TelemetryRateTest::decimateTest()
+{
+        congest(1 + TELEMETRY_RATE_SETTLE_UPDATES);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_5Hz, telemetry_rate_get_rate(&tr));
+
+        /* 10Hz samples going out at 5Hz means every other one */
+        channels[0].populated = true;
+        size_t sent = 0;
+        for (size_t i = 0; i < 20; ++i) {
+                s.ticks += SAMPLE_10Hz;
+                if (telemetry_rate_should_send(&tr, &s))
+                        ++sent;
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, sent);
+}
+
+void TelemetryRateTest::slowChannelPassesTest()
+{
+        congest(1 + TELEMETRY_RATE_SETTLE_UPDATES);
+        channels[0].populated = true;
+
+        /* Burn the credit granted at the level change */
+        s.ticks += SAMPLE_10Hz;
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_should_send(&tr, &s));
+        s.ticks += SAMPLE_10Hz;
+        CPPUNIT_ASSERT_EQUAL(false, telemetry_rate_should_send(&tr, &s));
+
+        /* The 1Hz channel is slower than 5Hz so it must get through */
+        channels[2].populated = true;
+        s.ticks += SAMPLE_10Hz;
+        CPPUNIT_ASSERT_EQUAL(true, telemetry_rate_should_send(&tr, &s));
+}
+
+void TelemetryRateTest::currentRateTest()
+{
+        telemetry_rate_set_current(SERIAL_TELEMETRY, SAMPLE_10Hz);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_get_current(SERIAL_TELEMETRY));
+
+        telemetry_rate_set_current(SERIAL_TELEMETRY, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT_EQUAL(0, telemetry_rate_get_current(SERIAL_TELEMETRY));
+}
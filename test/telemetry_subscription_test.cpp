@@ -0,0 +1,286 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "mock_serial.h"
+#include "sampleRecord.h"
+#include "telemetry_subscription.h"
+#include "telemetry_subscription_test.h"
+
+#include <string>
+#include <string.h>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetrySubscriptionTest );
+
+static Serial serial_a;
+static Serial serial_b;
+static struct telemetry_subscription *sub;
+static ChannelConfig cfgs[4];
+static ChannelSample channels[4];
+static struct sample s;
+
+static const char *labels[] = {"RPM", "Speed", "Coolant", "Fuel"};
+
+static size_t count_sent(const size_t samples, const size_t period)
+{
+        size_t sent = 0;
+        for (size_t i = 0; i < samples; ++i) {
+                s.ticks += period;
+                sent += telemetry_subscription_should_send(sub, &s);
+        }
+        return sent;
+}
+
+void TelemetrySubscriptionTest::setUp()
+{
+        memset(cfgs, 0, sizeof(cfgs));
+        memset(channels, 0, sizeof(channels));
+        for (size_t i = 0; i < 4; ++i) {
+                strcpy(cfgs[i].label, labels[i]);
+                cfgs[i].sampleRate = SAMPLE_25Hz;
+                channels[i].cfg = cfgs + i;
+                channels[i].populated = true;
+        }
+        /* Fuel is slow */
+        cfgs[3].sampleRate = SAMPLE_1Hz;
+        channels[3].populated = false;
+
+        s.ticks = 0;
+        s.channel_count = 4;
+        s.channel_samples = channels;
+
+        sub = telemetry_subscription_get(&serial_a);
+        telemetry_subscription_clear(sub);
+}
+
+void TelemetrySubscriptionTest::tearDown() {}
+
+void TelemetrySubscriptionTest::slotTest()
+{
+        CPPUNIT_ASSERT(sub != NULL);
+        CPPUNIT_ASSERT(sub == telemetry_subscription_get(&serial_a));
+
+        struct telemetry_subscription *other =
+                telemetry_subscription_get(&serial_b);
+        CPPUNIT_ASSERT(other != NULL);
+        CPPUNIT_ASSERT(other != sub);
+
+        /* Every change is seen by the connection */
+        const size_t generation = sub->generation;
+        const uint16_t index[] = {1};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 1, SAMPLE_5Hz);
+        CPPUNIT_ASSERT(generation != sub->generation);
+        CPPUNIT_ASSERT(telemetry_subscription_active(sub));
+        CPPUNIT_ASSERT(!telemetry_subscription_active(other));
+        CPPUNIT_ASSERT(!telemetry_subscription_active(NULL));
+
+        telemetry_subscription_clear(sub);
+        CPPUNIT_ASSERT(!telemetry_subscription_active(sub));
+}
+
+void TelemetrySubscriptionTest::findChannelTest()
+{
+        CPPUNIT_ASSERT_EQUAL(0, telemetry_subscription_find_channel(&s, "RPM"));
+        CPPUNIT_ASSERT_EQUAL(3, telemetry_subscription_find_channel(&s, "Fuel"));
+        CPPUNIT_ASSERT_EQUAL(-1, telemetry_subscription_find_channel(&s, "rpm"));
+
+        /* Channels come out in the order subscribed */
+        const uint16_t index[] = {2, 0};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2,
+                             telemetry_subscription_channel_count(sub, &s));
+        CPPUNIT_ASSERT(channels + 2 ==
+                       telemetry_subscription_channel(sub, &s, 0));
+        CPPUNIT_ASSERT(channels ==
+                       telemetry_subscription_channel(sub, &s, 1));
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 4,
+                             telemetry_subscription_channel_count(NULL, &s));
+        CPPUNIT_ASSERT(channels + 3 ==
+                       telemetry_subscription_channel(NULL, &s, 3));
+
+        CPPUNIT_ASSERT(telemetry_subscription_matches(sub, &s));
+        s.channel_count = 5;
+        CPPUNIT_ASSERT(!telemetry_subscription_matches(sub, &s));
+}
+
+void TelemetrySubscriptionTest::layoutTest()
+{
+        const uint16_t index[] = {0, 1};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT(telemetry_subscription_matches(sub, &s));
+
+        /* Same number of channels, but maybe not the same ones */
+        telemetry_subscription_layout_changed();
+        CPPUNIT_ASSERT(!telemetry_subscription_matches(sub, &s));
+
+        /* Looked up before a change that came in while subscribing */
+        const size_t layout = telemetry_subscription_layout();
+        telemetry_subscription_layout_changed();
+        telemetry_subscription_set(sub, layout, 4, index, 2, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT(!telemetry_subscription_matches(sub, &s));
+
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT(telemetry_subscription_matches(sub, &s));
+}
+
+void TelemetrySubscriptionTest::rateTest()
+{
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_25Hz,
+                             telemetry_subscription_get_rate(NULL, SAMPLE_25Hz));
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_25Hz,
+                             telemetry_subscription_get_rate(sub, SAMPLE_25Hz));
+
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   NULL, 0, SAMPLE_5Hz);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_5Hz,
+                             telemetry_subscription_get_rate(sub, SAMPLE_25Hz));
+
+        /* Can't go faster than the samples come in */
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_1Hz,
+                             telemetry_subscription_get_rate(sub, SAMPLE_1Hz));
+}
+
+void TelemetrySubscriptionTest::decimateTest()
+{
+        /* Everything while not subscribed */
+        CPPUNIT_ASSERT_EQUAL((size_t) 25, count_sent(25, SAMPLE_25Hz));
+
+        const uint16_t index[] = {0, 1};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_5Hz);
+        CPPUNIT_ASSERT_EQUAL((size_t) 5, count_sent(25, SAMPLE_25Hz));
+        CPPUNIT_ASSERT_EQUAL((size_t) 50, count_sent(250, SAMPLE_25Hz));
+
+        /* Channels only, at the telemetry rate */
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_DISABLED);
+        CPPUNIT_ASSERT_EQUAL((size_t) 25, count_sent(25, SAMPLE_25Hz));
+}
+
+void TelemetrySubscriptionTest::unsubscribedDataTest()
+{
+        const uint16_t index[] = {2};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 1, SAMPLE_DISABLED);
+
+        channels[2].populated = false;
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, count_sent(10, SAMPLE_25Hz));
+
+        channels[2].populated = true;
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, count_sent(10, SAMPLE_25Hz));
+}
+
+void TelemetrySubscriptionTest::slowChannelTest()
+{
+        const uint16_t index[] = {0, 3};
+        telemetry_subscription_set(sub, telemetry_subscription_layout(), 4,
+                                   index, 2, SAMPLE_5Hz);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, count_sent(5, SAMPLE_25Hz));
+
+        /* The 1Hz channel is never held back */
+        channels[3].populated = true;
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, count_sent(1, SAMPLE_25Hz));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, count_sent(1, SAMPLE_25Hz));
+}
+
+static string send(const char *json)
+{
+        char buffer[256];
+        strcpy(buffer, json);
+        mock_resetTxBuffer();
+        process_api(getMockSerial(), buffer, sizeof(buffer));
+        return mock_getTxBuffer();
+}
+
+static size_t count(const string &str, const string &what)
+{
+        size_t n = 0;
+        for (size_t at = str.find(what); at != string::npos;
+             at = str.find(what, at + 1))
+                ++n;
+        return n;
+}
+
+void TelemetrySubscriptionTest::apiTest()
+{
+        initApi();
+        initialize_logger_config();
+        setupMockSerial();
+
+        LoggerConfig *config = getWorkingLoggerConfig();
+        const size_t channel_count = get_enabled_channel_count(config);
+        struct sample live;
+        memset(&live, 0, sizeof(live));
+        CPPUNIT_ASSERT(init_sample_buffer(&live, channel_count));
+        CPPUNIT_ASSERT(channel_count > 3);
+
+        const string first = live.channel_samples[3].cfg->label;
+        const string second = live.channel_samples[1].cfg->label;
+        const string msg = "{\"subscribe\":{\"ch\":[\"" + first + "\",\"" +
+                second + "\"],\"sr\":1}}";
+
+        CPPUNIT_ASSERT_EQUAL(string("{\"subscribe\":{\"rc\":1}}\r\n"),
+                             send(msg.c_str()));
+
+        struct telemetry_subscription *mock_sub =
+                telemetry_subscription_get(getMockSerial());
+        CPPUNIT_ASSERT(telemetry_subscription_active(mock_sub));
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, mock_sub->count);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_1Hz, mock_sub->rate);
+
+        /* Only the subscribed channels go out, in order */
+        for (size_t i = 0; i < channel_count; ++i) {
+                live.channel_samples[i].populated = true;
+                live.channel_samples[i].valueInt = 0;
+        }
+
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &live, 0, 1, false, mock_sub);
+        const string record = mock_getTxBuffer();
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, count(record, "\"nm\""));
+        CPPUNIT_ASSERT(record.find("\"nm\":\"" + first + "\"") <
+                       record.find("\"nm\":\"" + second + "\""));
+        CPPUNIT_ASSERT(record.find(",3]") != string::npos);
+
+        CPPUNIT_ASSERT_EQUAL(
+                string("{\"subscribe\":{\"rc\":-1}}\r\n"),
+                send("{\"subscribe\":{\"ch\":[\"NoSuchChannel\"]}}"));
+        /* A failed subscribe leaves the old one alone */
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, mock_sub->count);
+
+        CPPUNIT_ASSERT_EQUAL(string("{\"subscribe\":{\"rc\":-1}}\r\n"),
+                             send("{\"subscribe\":{\"sr\":7}}"));
+
+        CPPUNIT_ASSERT_EQUAL(string("{\"subscribe\":{\"rc\":1}}\r\n"),
+                             send("{\"subscribe\":{}}"));
+        CPPUNIT_ASSERT(!telemetry_subscription_active(mock_sub));
+
+        free_sample_buffer(&live);
+}
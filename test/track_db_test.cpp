@@ -0,0 +1,220 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capabilities.h"
+#include "geopoint.h"
+#include "memory_mock.h"
+#include "track_db_test.h"
+#include "tracks.h"
+
+#include <stddef.h>
+#include <string.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TrackDbTest );
+
+#define DB_PAGES	((sizeof(Tracks) + TRACKS_FLASH_PAGE_SIZE - 1) / \
+			 TRACKS_FLASH_PAGE_SIZE)
+
+static Track make_track(const int32_t id)
+{
+        Track t;
+        memset(&t, 0, sizeof(t));
+        t.trackId = id;
+        t.track_type = TRACK_TYPE_CIRCUIT;
+        t.circuit.startFinish = gp_create(40 + id * 0.01, -120);
+        for (int i = 0; i < 4; ++i)
+                t.circuit.sectors[i] = gp_create(40 + id * 0.01 + i * 0.001,
+                                                 -120.002);
+        return t;
+}
+
+/* Sends a whole DB the way the addTrackDb stream does */
+static bool send_db(const size_t count, const int32_t first_id)
+{
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i) {
+                const Track t = make_track(first_id + i);
+                const int mode = i + 1 < count ?
+                        TRACK_ADD_MODE_IN_PROGRESS : TRACK_ADD_MODE_COMPLETE;
+                ok &= add_track(&t, i, mode) == TRACK_ADD_RESULT_OK;
+        }
+        return ok;
+}
+
+/* Pages the bytes of tracks [first, last] fall in */
+static size_t track_pages(const size_t first, const size_t last)
+{
+        const size_t start = offsetof(Tracks, tracks) + first * sizeof(Track);
+        const size_t end = offsetof(Tracks, tracks) +
+                (last + 1) * sizeof(Track) - 1;
+        return end / TRACKS_FLASH_PAGE_SIZE - start / TRACKS_FLASH_PAGE_SIZE + 1;
+}
+
+static void check_db(const size_t count, const int32_t first_id)
+{
+        const Tracks *tracks = get_tracks();
+        CPPUNIT_ASSERT_EQUAL(count, tracks->count);
+        for (size_t i = 0; i < count; ++i) {
+                const Track t = make_track(first_id + i);
+                CPPUNIT_ASSERT_EQUAL(t.trackId, tracks->tracks[i].trackId);
+                CPPUNIT_ASSERT(!memcmp(&t, tracks->tracks + i, sizeof(t)));
+        }
+}
+
+void TrackDbTest::setUp()
+{
+        flash_default_tracks();
+        memory_mock_reset_flash_count();
+}
+
+void TrackDbTest::tearDown()
+{
+        flash_default_tracks();
+}
+
+void TrackDbTest::streamTest()
+{
+        CPPUNIT_ASSERT(send_db(MAX_TRACK_COUNT, 100));
+        check_db(MAX_TRACK_COUNT, 100);
+
+        /*
+         * Every page once, one page at a time, and the first one again
+         * for the CRCs and the count.
+         */
+        CPPUNIT_ASSERT(memory_mock_get_flash_count() <= (int) DB_PAGES + 1);
+        CPPUNIT_ASSERT_EQUAL((unsigned int) TRACKS_FLASH_PAGE_SIZE,
+                             memory_mock_get_max_flash_length());
+
+        /* And it checks out on the next start */
+        initialize_tracks();
+        check_db(MAX_TRACK_COUNT, 100);
+}
+
+void TrackDbTest::unchangedTest()
+{
+        CPPUNIT_ASSERT(send_db(10, 100));
+        memory_mock_reset_flash_count();
+
+        CPPUNIT_ASSERT(send_db(10, 100));
+        CPPUNIT_ASSERT_EQUAL(0, memory_mock_get_flash_count());
+        check_db(10, 100);
+}
+
+void TrackDbTest::shorterTest()
+{
+        CPPUNIT_ASSERT(send_db(10, 100));
+        memory_mock_reset_flash_count();
+
+        /* Same first tracks, only the count changes */
+        CPPUNIT_ASSERT(send_db(4, 100));
+        CPPUNIT_ASSERT_EQUAL(1, memory_mock_get_flash_count());
+        check_db(4, 100);
+}
+
+void TrackDbTest::updateTest()
+{
+        CPPUNIT_ASSERT(send_db(20, 100));
+        memory_mock_reset_flash_count();
+
+        const Track t = make_track(500);
+        CPPUNIT_ASSERT_EQUAL(TRACK_ADD_RESULT_OK,
+                             add_track(&t, 12, TRACK_ADD_MODE_UPDATE));
+
+        /* The pages of that track and the one with the CRCs */
+        CPPUNIT_ASSERT(memory_mock_get_flash_count() <=
+                       (int) track_pages(12, 12) + 1);
+
+        const Tracks *tracks = get_tracks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 20, tracks->count);
+        CPPUNIT_ASSERT_EQUAL(500, (int) tracks->tracks[12].trackId);
+        CPPUNIT_ASSERT_EQUAL(111, (int) tracks->tracks[11].trackId);
+        CPPUNIT_ASSERT_EQUAL(113, (int) tracks->tracks[13].trackId);
+
+        initialize_tracks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 20, get_tracks()->count);
+}
+
+void TrackDbTest::appendTest()
+{
+        CPPUNIT_ASSERT(send_db(5, 100));
+
+        const Track t = make_track(105);
+        CPPUNIT_ASSERT_EQUAL(TRACK_ADD_RESULT_OK,
+                             add_track(&t, 5, TRACK_ADD_MODE_UPDATE));
+        check_db(6, 100);
+
+        initialize_tracks();
+        check_db(6, 100);
+}
+
+void TrackDbTest::badIndexTest()
+{
+        CPPUNIT_ASSERT(send_db(5, 100));
+        memory_mock_reset_flash_count();
+
+        /* Would leave a gap */
+        const Track t = make_track(200);
+        CPPUNIT_ASSERT_EQUAL(TRACK_ADD_RESULT_FAIL,
+                             add_track(&t, 7, TRACK_ADD_MODE_UPDATE));
+        CPPUNIT_ASSERT_EQUAL(TRACK_ADD_RESULT_FAIL,
+                             add_track(&t, MAX_TRACK_COUNT,
+                                       TRACK_ADD_MODE_COMPLETE));
+        CPPUNIT_ASSERT_EQUAL(0, memory_mock_get_flash_count());
+        check_db(5, 100);
+}
+
+void TrackDbTest::unfinishedTest()
+{
+        CPPUNIT_ASSERT(send_db(10, 100));
+
+        /*
+         * A new DB that never got to its end: the pages of the first few
+         * tracks were written but not the CRCs.
+         */
+        for (size_t i = 0; i < 4; ++i) {
+                const Track t = make_track(300 + i);
+                CPPUNIT_ASSERT_EQUAL(TRACK_ADD_RESULT_OK,
+                                     add_track(&t, i,
+                                               TRACK_ADD_MODE_IN_PROGRESS));
+        }
+
+        /* Power goes, the track in the staging page is lost */
+        initialize_tracks();
+        const Tracks *tracks = get_tracks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, tracks->count);
+
+        /* The next DB goes in fine */
+        CPPUNIT_ASSERT(send_db(3, 100));
+        check_db(3, 100);
+}
+
+void TrackDbTest::versionTest()
+{
+        CPPUNIT_ASSERT(send_db(10, 100));
+
+        /* A DB from firmware with another layout */
+        Tracks *tracks = (Tracks *) get_tracks();
+        tracks->versionInfo.minor = MINOR_REV - 1;
+
+        initialize_tracks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, tracks->count);
+        CPPUNIT_ASSERT(!versionChanged(&tracks->versionInfo));
+}
@@ -0,0 +1,262 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "auto_track.h"
+#include "geopoint.h"
+#include "mod_string.h"
+#include "printk.h"
+#include "track_index.h"
+#include "track_index_test.h"
+#include "tracks.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TrackIndexTest );
+
+#define GRID_TRACKS	36
+#define SECTOR_RADIUS_M	2000.0
+#define LONG_TRACK	5
+#define FIJI		36
+#define LAYOUT_NORTH	38
+#define LAYOUT_EAST	39
+
+static const double m_per_deg = GP_EARTH_RADIUS_M * M_PI / 180;
+
+static Tracks g_db;
+
+static GeoPoint offset(const GeoPoint &gp, const double north_m,
+                       const double east_m)
+{
+        const double lat = gp_to_degrees(gp.latitude);
+        const double lon = gp_to_degrees(gp.longitude) + east_m /
+                (m_per_deg * cos(lat * M_PI / 180));
+        return gp_create(lat + north_m / m_per_deg,
+                         lon > 180 ? lon - 360 : lon);
+}
+
+/* A circuit with its sectors on a circle around the start */
+static void make_circuit(Track &t, const int32_t id, const GeoPoint &start,
+                         const double radius_m, const int sectors)
+{
+        memset(&t, 0, sizeof(t));
+        t.trackId = id;
+        t.track_type = TRACK_TYPE_CIRCUIT;
+        t.circuit.startFinish = start;
+        for (int i = 0; i < sectors; ++i) {
+                const double a = 2 * M_PI * i / sectors;
+                t.circuit.sectors[i] = offset(start, radius_m * sin(a),
+                                              radius_m * cos(a));
+        }
+}
+
+void TrackIndexTest::setUp()
+{
+        memset(&g_db, 0, sizeof(g_db));
+        g_db.count = MAX_TRACK_COUNT;
+
+        /* Spread over a few countries worth of grid, some close together */
+        for (int i = 0; i < GRID_TRACKS; ++i) {
+                const GeoPoint start = gp_create(30 + (i % 6) * 0.5,
+                                                 -120 + (i / 6) * 0.7);
+                const double radius = LONG_TRACK == i ? SECTOR_RADIUS_M : 400;
+                make_circuit(g_db.tracks[i], 100 + i, start, radius,
+                             CIRCUIT_SECTOR_COUNT);
+        }
+
+        /* Right up against the antimeridian */
+        make_circuit(g_db.tracks[FIJI], 100 + FIJI, gp_create(-16.8, 179.995),
+                     300, 4);
+
+        /* Two layouts with the same start finish, one going each way */
+        const GeoPoint shared = gp_create(47.25, 8.5);
+        make_circuit(g_db.tracks[37], 137, gp_create(-33.9, 151.2), 300, 4);
+        Track &north = g_db.tracks[LAYOUT_NORTH];
+        Track &east = g_db.tracks[LAYOUT_EAST];
+        memset(&north, 0, sizeof(north));
+        memset(&east, 0, sizeof(east));
+        north.trackId = 138;
+        east.trackId = 139;
+        north.circuit.startFinish = east.circuit.startFinish = shared;
+        for (int i = 0; i < 3; ++i) {
+                north.circuit.sectors[i] = offset(shared, 300 * (i + 1), 0);
+                east.circuit.sectors[i] = offset(shared, 0, 300 * (i + 1));
+        }
+
+        flash_tracks(&g_db, sizeof(g_db));
+}
+
+void TrackIndexTest::tearDown()
+{
+        flash_default_tracks();
+}
+
+static int32_t detect(const GeoPoint &gp)
+{
+        const Track *t = auto_configure_track(NULL, &gp);
+        return t ? t->trackId : -1;
+}
+
+void TrackIndexTest::startTest()
+{
+        CPPUNIT_ASSERT(track_index_built());
+        size_t points = 0;
+        for (size_t i = 0; i < MAX_TRACK_COUNT; ++i)
+                for (size_t j = 0; j < SECTOR_COUNT; ++j)
+                        points += isValidPoint(g_db.tracks[i].allSectors + j);
+        CPPUNIT_ASSERT_EQUAL(points < TRACK_INDEX_POINTS ? points :
+                             (size_t) TRACK_INDEX_POINTS, track_index_size());
+
+        const GeoPoint near = offset(g_db.tracks[3].circuit.startFinish,
+                                     -150, 120);
+        CPPUNIT_ASSERT_EQUAL(103, detect(near));
+}
+
+void TrackIndexTest::sectorTest()
+{
+        /* Too far from the start line to be found by it */
+        const Track &t = g_db.tracks[LONG_TRACK];
+        const GeoPoint gp = offset(t.circuit.sectors[9], 0, 80);
+        CPPUNIT_ASSERT(distPythag(&t.circuit.startFinish, &gp) >
+                       MAX_DIST_FROM_SF);
+
+        CPPUNIT_ASSERT_EQUAL(100 + LONG_TRACK, detect(gp));
+}
+
+void TrackIndexTest::sharedStartTest()
+{
+        const GeoPoint sf = g_db.tracks[LAYOUT_NORTH].circuit.startFinish;
+
+        CPPUNIT_ASSERT_EQUAL(138, detect(offset(sf, 120, 10)));
+        CPPUNIT_ASSERT_EQUAL(139, detect(offset(sf, 10, 120)));
+}
+
+void TrackIndexTest::antimeridianTest()
+{
+        const GeoPoint gp = gp_create(-16.8, -179.998);
+        CPPUNIT_ASSERT(distPythag(&g_db.tracks[FIJI].circuit.startFinish,
+                                  &gp) < MAX_DIST_FROM_SF);
+
+        CPPUNIT_ASSERT_EQUAL(100 + FIJI, detect(gp));
+}
+
+void TrackIndexTest::noTrackTest()
+{
+        Track fallback;
+        fallback.trackId = 42;
+        const GeoPoint gp = gp_create(0.5, -30);
+
+        CPPUNIT_ASSERT_EQUAL(&fallback,
+                             (Track *) auto_configure_track(&fallback, &gp));
+}
+
+/* Every point within the radius must come back from the index */
+void TrackIndexTest::supersetTest()
+{
+        struct track_index_hit hits[TRACK_INDEX_POINTS];
+        uint32_t seed = 1;
+        size_t checked = 0;
+
+        for (int n = 0; n < 2000; ++n) {
+                seed = seed * 1103515245 + 12345;
+                const Track &t = g_db.tracks[(seed >> 8) % MAX_TRACK_COUNT];
+                seed = seed * 1103515245 + 12345;
+                const double north = (int) (seed >> 8) % 3000 - 1500.0;
+                seed = seed * 1103515245 + 12345;
+                const double east = (int) (seed >> 8) % 3000 - 1500.0;
+                const GeoPoint gp = offset(t.circuit.startFinish, north, east);
+
+                const size_t found = track_index_near(&gp, MAX_DIST_FROM_SF,
+                                                      hits,
+                                                      TRACK_INDEX_POINTS);
+                CPPUNIT_ASSERT(found <= TRACK_INDEX_POINTS);
+
+                for (size_t i = 0; i < MAX_TRACK_COUNT; ++i) {
+                        for (size_t j = 0; j < SECTOR_COUNT; ++j) {
+                                const GeoPoint *p = g_db.tracks[i].allSectors + j;
+                                if (!isValidPoint(p) ||
+                                    distPythag(p, &gp) >= MAX_DIST_FROM_SF)
+                                        continue;
+
+                                size_t k = 0;
+                                while (k < found && (hits[k].track != i ||
+                                                     hits[k].point != j))
+                                        ++k;
+                                CPPUNIT_ASSERT(k < found);
+                                ++checked;
+                        }
+                }
+        }
+
+        CPPUNIT_ASSERT(checked > 1000);
+}
+
+/* What detection did before the index: every start point, every time */
+static const Track * linear_closest(const Tracks *tracks, const GeoPoint *gp)
+{
+        float dist = MAX_DIST_FROM_SF;
+        const Track *best = NULL;
+
+        for (size_t i = 0; i < tracks->count; ++i) {
+                const GeoPoint start = getStartPoint(tracks->tracks + i);
+                const float d = distPythag(&start, gp);
+                if (d < dist) {
+                        dist = d;
+                        best = tracks->tracks + i;
+                }
+        }
+
+        return best;
+}
+
+void TrackIndexTest::benchmark()
+{
+        const size_t lookups = 20000;
+        GeoPoint points[64];
+        for (size_t i = 0; i < 64; ++i)
+                points[i] = offset(g_db.tracks[i % GRID_TRACKS].circuit.startFinish,
+                                   (double) (i * 37 % 400), 100);
+
+        const Tracks *tracks = get_tracks();
+        size_t agree = 0;
+
+        /* Finding a track logs it, which would swamp the timing */
+        const enum log_level level = get_log_level();
+        set_log_level(ERR);
+
+        clock_t c = clock();
+        for (size_t i = 0; i < lookups; ++i)
+                agree += NULL != linear_closest(tracks, points + i % 64);
+        const double linear = (double) (clock() - c) / CLOCKS_PER_SEC;
+
+        c = clock();
+        for (size_t i = 0; i < lookups; ++i)
+                agree -= NULL != auto_configure_track(NULL, points + i % 64);
+        const double indexed = (double) (clock() - c) / CLOCKS_PER_SEC;
+        set_log_level(level);
+
+        printf("\r\nTrack detection (%u tracks): linear %.0fns, index "
+               "%.0fns per lookup\r\n", (unsigned) tracks->count,
+               linear * 1e9 / lookups, indexed * 1e9 / lookups);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, agree);
+}
@@ -26,11 +26,11 @@
       TRACK_TYPE_CIRCUIT,                               \
          {                                              \
             {                                           \
-               {47.806934,-122.341150},                 \
-                  {47.806875,-122.335818},              \
-                     {47.79974,-122.335704},            \
-                        {47.799719,-122.346416},        \
-                           {47.806886,-122.346494},     \
+               {GP_DEGREES(47.806934), GP_DEGREES(-122.341150)},                 \
+                  {GP_DEGREES(47.806875), GP_DEGREES(-122.335818)},              \
+                     {GP_DEGREES(47.79974), GP_DEGREES(-122.335704)},            \
+                        {GP_DEGREES(47.799719), GP_DEGREES(-122.346416)},        \
+                           {GP_DEGREES(47.806886), GP_DEGREES(-122.346494)},     \
                               }                         \
          }                                              \
    }
@@ -41,11 +41,11 @@
       TRACK_TYPE_STAGE,                                 \
          {                                              \
             {                                           \
-               {48.806934,-120.341150},                 \
-                  {48.806886,-120.346494},              \
-                     {48.806875,-120.335818},           \
-                        {48.79974,-120.335704},         \
-                           {48.799719,-120.346416},     \
+               {GP_DEGREES(48.806934), GP_DEGREES(-120.341150)},                 \
+                  {GP_DEGREES(48.806886), GP_DEGREES(-120.346494)},              \
+                     {GP_DEGREES(48.806875), GP_DEGREES(-120.335818)},           \
+                        {GP_DEGREES(48.79974), GP_DEGREES(-120.335704)},         \
+                           {GP_DEGREES(48.799719), GP_DEGREES(-120.346416)},     \
                               }                         \
          }                                              \
    }
@@ -55,7 +55,7 @@
       TRACK_TYPE_CIRCUIT,                       \
          {                                      \
             {                                   \
-               {0.0, 0.0},                      \
+               {GP_DEGREES(0.0), GP_DEGREES(0.0)},                      \
                   }                             \
          }                                      \
    }
@@ -66,7 +66,7 @@
       TRACK_TYPE_STAGE,                         \
          {                                      \
             {                                   \
-               {0.0, 0.0},                      \
+               {GP_DEGREES(0.0), GP_DEGREES(0.0)},                      \
                   }                             \
          }                                      \
    }
@@ -146,8 +146,8 @@ void TrackTest::testGetSector() {
 }
 
 void TrackTest::testGeoPointsEqual() {
-  GeoPoint a = { .latitude = 1.0, .longitude = 2.0 };
-  GeoPoint b = { .latitude = 3.0, .longitude = 4.0 };
+  GeoPoint a = { .latitude = GP_DEGREES(1.0), .longitude = GP_DEGREES(2.0) };
+  GeoPoint b = { .latitude = GP_DEGREES(3.0), .longitude = GP_DEGREES(4.0) };
 
   CPPUNIT_ASSERT(areGeoPointsEqual(a, a));
   CPPUNIT_ASSERT(areGeoPointsEqual(b, b));
@@ -155,9 +155,9 @@ void TrackTest::testGeoPointsEqual() {
 }
 
 void TrackTest::testGeoPointsValid() {
-  GeoPoint v1 = { .latitude = 0.0, .longitude = 2.0 };
-  GeoPoint v2 = { .latitude = 1.0, .longitude = 0.0 };
-  GeoPoint i = { .latitude = 0.0, .longitude = 0.0 };
+  GeoPoint v1 = { .latitude = GP_DEGREES(0.0), .longitude = GP_DEGREES(2.0) };
+  GeoPoint v2 = { .latitude = GP_DEGREES(1.0), .longitude = GP_DEGREES(0.0) };
+  GeoPoint i = { .latitude = GP_DEGREES(0.0), .longitude = GP_DEGREES(0.0) };
 
   CPPUNIT_ASSERT(isValidPoint(&v1));
   CPPUNIT_ASSERT(isValidPoint(&v2));
@@ -0,0 +1,133 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "udp_receiver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void udp_receiver_track(struct udp_receiver_stats *stats, uint32_t seq)
+{
+        ++stats->received;
+
+        if (!stats->started) {
+                stats->started = true;
+                stats->next_seq = seq + 1;
+                stats->seen = 1;
+                return;
+        }
+
+        const uint32_t ahead = seq - stats->next_seq;
+        if ((int32_t) ahead >= 0) {
+                /* Everything we skipped over is missing, for now */
+                stats->lost += ahead;
+                const uint32_t shift = ahead + 1;
+                stats->seen = shift < UDP_RECEIVER_WINDOW ?
+                        stats->seen << shift : 0;
+                stats->seen |= 1;
+                stats->next_seq = seq + 1;
+                return;
+        }
+
+        const uint32_t back = stats->next_seq - 1 - seq;
+        if (back < UDP_RECEIVER_WINDOW &&
+            !(stats->seen & ((uint64_t) 1 << back))) {
+                stats->seen |= (uint64_t) 1 << back;
+                --stats->lost;
+                ++stats->late;
+        } else {
+                /* Too old to tell, or we had it.  Either way no use */
+                ++stats->duplicate;
+        }
+}
+
+int udp_receiver_open(struct udp_receiver *r, uint16_t port, bool any)
+{
+        memset(r, 0, sizeof(*r));
+
+        r->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (r->fd < 0)
+                return -1;
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(any ? INADDR_ANY : INADDR_LOOPBACK);
+
+        socklen_t len = sizeof(addr);
+        if (bind(r->fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+            getsockname(r->fd, (struct sockaddr *) &addr, &len)) {
+                udp_receiver_close(r);
+                return -1;
+        }
+
+        return ntohs(addr.sin_port);
+}
+
+void udp_receiver_close(struct udp_receiver *r)
+{
+        if (r->fd >= 0)
+                close(r->fd);
+        r->fd = -1;
+}
+
+int udp_receiver_receive(struct udp_receiver *r, char *buf, size_t len,
+                         int timeout_ms)
+{
+        struct pollfd pfd;
+        pfd.fd = r->fd;
+        pfd.events = POLLIN;
+
+        const int ready = poll(&pfd, 1, timeout_ms);
+        if (ready <= 0)
+                return ready;
+
+        socklen_t peer_len = sizeof(r->peer);
+        const ssize_t count = recvfrom(r->fd, buf, len - 1, 0,
+                                       (struct sockaddr *) r->peer, &peer_len);
+        if (count < 0)
+                return -1;
+
+        buf[count] = '\0';
+        r->peer_len = peer_len;
+
+        const char *seq = strstr(buf, "\"seq\":");
+        if (seq)
+                udp_receiver_track(&r->stats, strtoul(seq + 6, NULL, 10));
+
+        return count;
+}
+
+bool udp_receiver_reply(struct udp_receiver *r, const char *msg)
+{
+        if (!r->peer_len)
+                return false;
+
+        const size_t len = strlen(msg);
+        return sendto(r->fd, msg, len, 0, (struct sockaddr *) r->peer,
+                      r->peer_len) == (ssize_t) len;
+}
@@ -0,0 +1,91 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UDP_RECEIVER_H_
+#define _UDP_RECEIVER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A stand in for the telemetry server when testing UDP telemetry on the
+ * bench.  It listens on a local port, answers the auth and keeps count of
+ * the datagrams by their sequence number: how many came, went missing,
+ * arrived late or came twice.  A datagram counts as lost until it shows
+ * up, so one that arrives late moves from lost to late.
+ */
+
+/* How far back we remember which datagrams came */
+#define UDP_RECEIVER_WINDOW	64
+
+struct udp_receiver_stats {
+        bool started;
+        /* One past the highest sequence number seen */
+        uint32_t next_seq;
+        /* Bit i set if next_seq - 1 - i was seen */
+        uint64_t seen;
+        size_t received;
+        size_t lost;
+        size_t late;
+        size_t duplicate;
+};
+
+struct udp_receiver {
+        int fd;
+        /* Whoever sent us the last datagram, for the reply */
+        uint8_t peer[32];
+        size_t peer_len;
+        struct udp_receiver_stats stats;
+};
+
+/**
+ * Accounts for a datagram with the given sequence number.
+ */
+void udp_receiver_track(struct udp_receiver_stats *stats, uint32_t seq);
+
+/**
+ * Opens the receiver on 127.0.0.1.
+ * @param port The port, 0 for any free one.
+ * @param any true to listen on all interfaces instead.
+ * @return The port listened on, or -1 on error.
+ */
+int udp_receiver_open(struct udp_receiver *r, uint16_t port, bool any);
+
+void udp_receiver_close(struct udp_receiver *r);
+
+/**
+ * Waits for the next datagram and accounts for it.  Datagrams without a
+ * sequence number, like the auth, are not counted.
+ * @param buf Where the datagram goes, NUL terminated.
+ * @param timeout_ms How long to wait.
+ * @return The length of the datagram, 0 on timeout or -1 on error.
+ */
+int udp_receiver_receive(struct udp_receiver *r, char *buf, size_t len,
+                         int timeout_ms);
+
+/**
+ * Sends a datagram back to whoever sent the last one.
+ * @return true if sent.
+ */
+bool udp_receiver_reply(struct udp_receiver *r, const char *msg);
+
+#endif /* _UDP_RECEIVER_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Local UDP telemetry receiver.  Point the telemetry server of a logger
+ * in UDP mode at this machine and it will authenticate it, print what
+ * comes in and report the datagrams lost along the way.
+ *
+ *   udprecv [port]
+ */
+
+#include "udp_receiver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_PORT	8080
+#define REPORT_SECONDS	5
+
+static void report(const struct udp_receiver_stats *s)
+{
+        const size_t expected = s->received - s->duplicate + s->lost;
+        printf("-- received %zu lost %zu (%.1f%%) late %zu duplicate %zu\n",
+               s->received, s->lost,
+               expected ? 100.0 * s->lost / expected : 0.0,
+               s->late, s->duplicate);
+        fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+        const int port = argc > 1 ? atoi(argv[1]) : DEFAULT_PORT;
+        struct udp_receiver r;
+
+        if (udp_receiver_open(&r, port, true) < 0) {
+                perror("udprecv");
+                return 1;
+        }
+        printf("listening on port %d\n", port);
+
+        char buf[2048];
+        time_t last_report = time(NULL);
+        while (1) {
+                const int len = udp_receiver_receive(&r, buf, sizeof(buf), 1000);
+                if (len < 0) {
+                        perror("udprecv");
+                        break;
+                }
+
+                if (len > 0) {
+                        printf("%s\n", buf);
+                        if (strstr(buf, "{\"auth\":"))
+                                udp_receiver_reply(&r, "{\"status\":\"ok\"}\r\n");
+                }
+
+                if (time(NULL) - last_report >= REPORT_SECONDS) {
+                        report(&r.stats);
+                        last_report = time(NULL);
+                }
+        }
+
+        udp_receiver_close(&r);
+        return 1;
+}
@@ -1,5 +1,5 @@
 MAJOR=2
-MINOR=8
-BUGFIX=4
+MINOR=9
+BUGFIX=0
 API=1
 